@@ -0,0 +1,401 @@
+/**
+ * harness.c - Runtime benchmark harness for kernels
+ *
+ * Usage: <kernel binary> --list
+ *        <kernel binary> --kernel=<name> [--size=N] [--warmup=N]
+ *                        [--repetitions=N] [--min-time-us=N] [--cpu=N]
+ *
+ * Each repetition runs the kernel enough times to take --min-time-us
+ * (the count is calibrated once, before the warmups) and reports the time
+ * and counters of one run. --cpu=-1 leaves the process unpinned; the
+ * default pins it to the core it started on.
+ *
+ * Output is one JSON object on stdout; counters the kernel or machine
+ * cannot provide (perf_event_paranoid, virtual machines) are null.
+ */
+
+#define _GNU_SOURCE
+
+#include "harness.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//===----------------------------------------------------------------------===//
+// Counters
+//===----------------------------------------------------------------------===//
+
+enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_CACHE_MISSES,
+    NUM_COUNTERS
+};
+
+static const char *const counter_names[NUM_COUNTERS] = {
+    "cycles", "instructions", "branch_misses", "cache_misses"};
+
+typedef struct counters {
+    // Descriptor of each counter, -1 if it could not be opened
+    int fds[NUM_COUNTERS];
+
+    // Group leader (the first counter opened), -1 if there is none
+    int leader;
+
+    // Position of each counter in a group read
+    int slot[NUM_COUNTERS];
+    int opened;
+} counters;
+
+#ifdef __linux__
+static int perf_event_open(struct perf_event_attr *attr, int group) {
+    return (int)syscall(__NR_perf_event_open, attr, 0, -1, group, 0);
+}
+#endif
+
+static void counters_open(counters *c) {
+    c->leader = -1;
+    c->opened = 0;
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        c->fds[i] = -1;
+        c->slot[i] = -1;
+    }
+
+#ifdef __linux__
+    static const uint64_t configs[NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.disabled = c->leader < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP |
+                           PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        int fd = perf_event_open(&attr, c->leader);
+        if (fd < 0) {
+            continue;
+        }
+        if (c->leader < 0) {
+            c->leader = fd;
+        }
+        c->fds[i] = fd;
+        c->slot[i] = c->opened++;
+    }
+#endif
+}
+
+static void counters_close(counters *c) {
+#ifdef __linux__
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (c->fds[i] >= 0) {
+            close(c->fds[i]);
+        }
+    }
+#endif
+}
+
+static void counters_start(const counters *c) {
+#ifdef __linux__
+    if (c->leader >= 0) {
+        ioctl(c->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(c->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+}
+
+// Stores the counts since counters_start, NAN for counters without one.
+// Counts are scaled up if the kernel multiplexed the group.
+static void counters_stop(const counters *c, double values[NUM_COUNTERS]) {
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        values[i] = NAN;
+    }
+
+#ifdef __linux__
+    if (c->leader < 0) {
+        return;
+    }
+    ioctl(c->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // nr, time_enabled, time_running, then one value per counter
+    uint64_t data[3 + NUM_COUNTERS];
+    ssize_t size = read(c->leader, data, sizeof(data));
+    if (size < (ssize_t)(3 * sizeof(uint64_t)) || data[2] == 0) {
+        return;
+    }
+    double scale = (double)data[1] / (double)data[2];
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (c->slot[i] >= 0 && (uint64_t)c->slot[i] < data[0]) {
+            values[i] = (double)data[3 + c->slot[i]] * scale;
+        }
+    }
+#endif
+}
+
+//===----------------------------------------------------------------------===//
+// Checksums
+//===----------------------------------------------------------------------===//
+
+uint64_t bench_checksum_u32(const uint32_t *values, size_t count) {
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < count; i++) {
+        checksum = bench_mix(checksum, values[i]);
+    }
+    return checksum;
+}
+
+uint64_t bench_checksum_doubles(const double *values, size_t count) {
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < count; i++) {
+        float value = (float)values[i];
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        checksum = bench_mix(checksum, bits);
+    }
+    return checksum;
+}
+
+//===----------------------------------------------------------------------===//
+// Options
+//===----------------------------------------------------------------------===//
+
+typedef struct options {
+    const char *kernel;
+    size_t size;
+    long warmup;
+    long repetitions;
+    long min_time_us;
+    long cpu;
+    int list;
+} options;
+
+// Parses the value of --name=value into *value; 0 if arg is another option
+static int parse_long(const char *arg, const char *name, long *value) {
+    size_t length = strlen(name);
+    if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+        return 0;
+    }
+    char *end;
+    errno = 0;
+    *value = strtol(arg + length + 1, &end, 10);
+    if (errno != 0 || *end != '\0' || end == arg + length + 1) {
+        fprintf(stderr, "error: invalid value in '%s'\n", arg);
+        exit(2);
+    }
+    return 1;
+}
+
+static options parse_options(int argc, char **argv) {
+    options opts = {NULL, 0, 5, 30, 10000, -2, 0};
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        long size = 0;
+        if (strcmp(arg, "--list") == 0) {
+            opts.list = 1;
+        } else if (strncmp(arg, "--kernel=", 9) == 0) {
+            opts.kernel = arg + 9;
+        } else if (parse_long(arg, "--size", &size)) {
+            if (size <= 0) {
+                fprintf(stderr, "error: --size must be positive\n");
+                exit(2);
+            }
+            opts.size = (size_t)size;
+        } else if (!parse_long(arg, "--warmup", &opts.warmup) &&
+                   !parse_long(arg, "--repetitions", &opts.repetitions) &&
+                   !parse_long(arg, "--min-time-us", &opts.min_time_us) &&
+                   !parse_long(arg, "--cpu", &opts.cpu)) {
+            fprintf(stderr, "error: unknown option '%s'\n", arg);
+            exit(2);
+        }
+    }
+    if (opts.warmup < 0 || opts.repetitions < 1 || opts.min_time_us < 0) {
+        fprintf(stderr, "error: need --warmup >= 0, --repetitions >= 1 "
+                        "and --min-time-us >= 0\n");
+        exit(2);
+    }
+    return opts;
+}
+
+//===----------------------------------------------------------------------===//
+// Measurement
+//===----------------------------------------------------------------------===//
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// Pins the process to cpu, or to the current core for -2; returns the core
+// or -1 if the process is not pinned
+static long pin(long cpu) {
+#ifdef __linux__
+    if (cpu == -2) {
+        cpu = sched_getcpu();
+    }
+    if (cpu < 0) {
+        return -1;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET((int)cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "warning: cannot pin to CPU %ld: %s\n", cpu,
+                strerror(errno));
+        return -1;
+    }
+    return cpu;
+#else
+    (void)cpu;
+    return -1;
+#endif
+}
+
+// Runs the kernel iterations times; fails if a run's checksum differs
+static void run_batch(const bench_kernel *kernel, void *state,
+                      long iterations, uint64_t expected) {
+    for (long i = 0; i < iterations; i++) {
+        uint64_t checksum = kernel->run(state);
+        if (checksum != expected) {
+            fprintf(stderr,
+                    "error: %s: checksum %016" PRIx64 " differs from the "
+                    "first run's %016" PRIx64 "\n",
+                    kernel->name, checksum, expected);
+            exit(1);
+        }
+    }
+}
+
+static void print_samples(const char *name, const double *samples,
+                          long count) {
+    long missing = 0;
+    for (long i = 0; i < count; i++) {
+        missing += isnan(samples[i]) != 0;
+    }
+
+    printf("\"%s\":", name);
+    if (missing == count) {
+        printf("null");
+        return;
+    }
+    printf("[");
+    for (long i = 0; i < count; i++) {
+        if (isnan(samples[i])) {
+            printf("%snull", i ? "," : "");
+        } else {
+            printf("%s%.3f", i ? "," : "", samples[i]);
+        }
+    }
+    printf("]");
+}
+
+static int measure(const bench_kernel *kernel, const options *opts) {
+    size_t size = opts->size ? opts->size : kernel->default_size;
+    long cpu = pin(opts->cpu);
+    void *state = kernel->setup(size);
+    if (!state) {
+        fprintf(stderr, "error: %s: setup failed for size %zu\n",
+                kernel->name, size);
+        return 1;
+    }
+
+    // The first run sets the checksum and calibrates the batch size
+    double start = now_ns();
+    uint64_t checksum = kernel->run(state);
+    double once = now_ns() - start;
+    long iterations = 1;
+    if (once < opts->min_time_us * 1e3) {
+        iterations = (long)ceil(opts->min_time_us * 1e3 / fmax(once, 1.0));
+    }
+
+    for (long i = 0; i < opts->warmup; i++) {
+        run_batch(kernel, state, iterations, checksum);
+    }
+
+    counters c;
+    counters_open(&c);
+    long n = opts->repetitions;
+    double *ns = malloc(n * sizeof(double));
+    double *counts[NUM_COUNTERS];
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        counts[i] = malloc(n * sizeof(double));
+    }
+
+    for (long r = 0; r < n; r++) {
+        double values[NUM_COUNTERS];
+        counters_start(&c);
+        start = now_ns();
+        run_batch(kernel, state, iterations, checksum);
+        ns[r] = (now_ns() - start) / iterations;
+        counters_stop(&c, values);
+        for (int i = 0; i < NUM_COUNTERS; i++) {
+            counts[i][r] = values[i] / iterations;
+        }
+    }
+    counters_close(&c);
+    kernel->teardown(state);
+
+    printf("{\"kernel\":\"%s\",\"size\":%zu,\"iterations\":%ld,"
+           "\"cpu\":%ld,\"checksum\":\"%016" PRIx64 "\",\"samples\":{",
+           kernel->name, size, iterations, cpu, checksum);
+    print_samples("ns", ns, n);
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        printf(",");
+        print_samples(counter_names[i], counts[i], n);
+    }
+    printf("}}\n");
+
+    free(ns);
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        free(counts[i]);
+    }
+    return 0;
+}
+
+int bench_main(int argc, char **argv, const bench_kernel *kernels,
+               size_t count) {
+    options opts = parse_options(argc, argv);
+
+    if (opts.list) {
+        for (size_t i = 0; i < count; i++) {
+            printf("%s %zu\n", kernels[i].name, kernels[i].default_size);
+        }
+        return 0;
+    }
+
+    if (!opts.kernel) {
+        fprintf(stderr, "usage: %s --list | --kernel=<name> [--size=N] "
+                        "[--warmup=N] [--repetitions=N] [--min-time-us=N] "
+                        "[--cpu=N]\n",
+                argv[0]);
+        return 2;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(kernels[i].name, opts.kernel) == 0) {
+            return measure(&kernels[i], &opts);
+        }
+    }
+    fprintf(stderr, "error: no kernel named '%s'\n", opts.kernel);
+    return 2;
+}
@@ -0,0 +1,54 @@
+/**
+ * harness.h - Runtime benchmark harness for kernels
+ *
+ * A kernel binary is a kernel source file linked with harness.c. The
+ * harness pins itself to one core, warms the kernel up, times each
+ * repetition with CLOCK_MONOTONIC and reads cycles, instructions, branch
+ * misses and cache misses with perf_event_open (Linux). It prints the raw
+ * samples as JSON; scripts/runtime_bench.py turns them into medians and
+ * confidence intervals.
+ *
+ * harness.c is always compiled with clang -O2, never with the pipeline
+ * under test, so its overhead is the same in every configuration.
+ */
+
+#ifndef LLVM_OPT_PASSES_BENCH_HARNESS_H
+#define LLVM_OPT_PASSES_BENCH_HARNESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct bench_kernel {
+    const char *name;
+
+    // Problem size used when --size is not given
+    size_t default_size;
+
+    // Allocates and initializes inputs for problem size n (untimed)
+    void *(*setup)(size_t n);
+
+    // One timed run; returns a checksum of its output, which must be the
+    // same on every run and in every configuration. Runs must not depend
+    // on earlier ones: outputs are overwritten, not accumulated.
+    uint64_t (*run)(void *state);
+
+    // Frees what setup allocated (untimed)
+    void (*teardown)(void *state);
+} bench_kernel;
+
+// Entry point of a kernel binary; see harness.c for the options
+int bench_main(int argc, char **argv, const bench_kernel *kernels,
+               size_t count);
+
+// Mixes a value into a checksum
+static inline uint64_t bench_mix(uint64_t checksum, uint64_t value) {
+    return (checksum ^ value) * 0x100000001b3ULL;
+}
+
+// Checksums of whole outputs. They are part of harness.c, so their cost
+// is the same in every configuration. Doubles are rounded to float first:
+// results that differ only in the last bits still agree.
+uint64_t bench_checksum_u32(const uint32_t *values, size_t count);
+uint64_t bench_checksum_doubles(const double *values, size_t count);
+
+#endif // LLVM_OPT_PASSES_BENCH_HARNESS_H
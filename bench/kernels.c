@@ -0,0 +1,426 @@
+/**
+ * kernels.c - Separately timed kernels for the runtime benchmarks
+ *
+ * Each kernel is a pattern one or more of the passes target, at a problem
+ * size that leaves the caches (--size scales it). Only this file goes
+ * through the pipeline under test; see harness.h.
+ *
+ *   gemm           scalar promotion of C[i][j], unrolling, index CSE
+ *   jacobi-2d      redundancy elimination of the shared stencil indices
+ *   conv-1d        constant folding of the taps, full unrolling
+ *   reduction      runtime unrolling of a sum/min/max loop
+ *   polynomial     power and polynomial rewriting, reassociation
+ *   crc32          table lookups in a loop-carried chain
+ *   hash-buckets   loop-invariant division by a run-time bucket count
+ *   state-machine  jump threading of a switch on the state
+ *   axpy           specialization and inlining of a strided helper
+ */
+
+#include "harness.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//===----------------------------------------------------------------------===//
+// Shared state
+//===----------------------------------------------------------------------===//
+
+// Every kernel's state: up to three buffers, whose meaning is per kernel
+typedef struct state {
+    size_t n;
+    void *a, *b, *c;
+    uint32_t param;
+} state;
+
+static uint32_t next_random(uint64_t *seed) {
+    *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t)(*seed >> 33);
+}
+
+static void free_state(void *p) {
+    state *s = p;
+    free(s->a);
+    free(s->b);
+    free(s->c);
+    free(s);
+}
+
+// Allocates the buffers (zero bytes for none); NULL if any allocation fails
+static state *new_state(size_t n, size_t a_bytes, size_t b_bytes,
+                        size_t c_bytes) {
+    state *s = calloc(1, sizeof(state));
+    if (!s) {
+        return NULL;
+    }
+    s->n = n;
+    s->a = a_bytes ? malloc(a_bytes) : NULL;
+    s->b = b_bytes ? malloc(b_bytes) : NULL;
+    s->c = c_bytes ? calloc(1, c_bytes) : NULL;
+    if ((a_bytes && !s->a) || (b_bytes && !s->b) || (c_bytes && !s->c)) {
+        free_state(s);
+        return NULL;
+    }
+    return s;
+}
+
+static void fill_doubles(double *values, size_t count, uint64_t seed) {
+    for (size_t i = 0; i < count; i++) {
+        values[i] = (double)(next_random(&seed) % 1000) / 100.0 - 5.0;
+    }
+}
+
+static void fill_u32(uint32_t *values, size_t count, uint64_t seed) {
+    for (size_t i = 0; i < count; i++) {
+        values[i] = next_random(&seed);
+    }
+}
+
+//===----------------------------------------------------------------------===//
+// GEMM: n x n matrices
+//===----------------------------------------------------------------------===//
+
+static void *gemm_setup(size_t n) {
+    state *s = new_state(n, n * n * sizeof(double), n * n * sizeof(double),
+                         n * n * sizeof(double));
+    if (s) {
+        fill_doubles(s->a, n * n, 1);
+        fill_doubles(s->b, n * n, 2);
+    }
+    return s;
+}
+
+// C[i][j] accumulates in memory across k; restrict lets it be promoted
+static void gemm(size_t n, const double *restrict a, const double *restrict b,
+                 double *restrict c) {
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            c[i * n + j] = 0.0;
+            for (size_t k = 0; k < n; k++) {
+                c[i * n + j] += a[i * n + k] * b[k * n + j];
+            }
+        }
+    }
+}
+
+static uint64_t gemm_run(void *p) {
+    state *s = p;
+    gemm(s->n, s->a, s->b, s->c);
+    return bench_checksum_doubles(s->c, s->n * s->n);
+}
+
+//===----------------------------------------------------------------------===//
+// Jacobi 2-D: one 5-point sweep over an n x n grid
+//===----------------------------------------------------------------------===//
+
+static void *jacobi_setup(size_t n) {
+    if (n < 3) {
+        return NULL;
+    }
+    state *s = new_state(n, n * n * sizeof(double), 0,
+                         n * n * sizeof(double));
+    if (s) {
+        fill_doubles(s->a, n * n, 3);
+    }
+    return s;
+}
+
+static void jacobi_2d(size_t n, const double *in, double *out) {
+    for (size_t i = 1; i < n - 1; i++) {
+        for (size_t j = 1; j < n - 1; j++) {
+            out[i * n + j] = 0.2 * (in[i * n + j] + in[(i - 1) * n + j] +
+                                    in[(i + 1) * n + j] +
+                                    in[i * n + j - 1] + in[i * n + j + 1]);
+        }
+    }
+}
+
+static uint64_t jacobi_run(void *p) {
+    state *s = p;
+    jacobi_2d(s->n, s->a, s->c);
+    return bench_checksum_doubles(s->c, s->n * s->n);
+}
+
+//===----------------------------------------------------------------------===//
+// Convolution 1-D: a 7-tap filter over n samples
+//===----------------------------------------------------------------------===//
+
+#define TAPS 7
+
+static const double taps[TAPS] = {0.0625, 0.125, 0.1875, 0.25,
+                                  0.1875, 0.125, 0.0625};
+
+static void *conv_setup(size_t n) {
+    state *s = new_state(n, (n + TAPS - 1) * sizeof(double), 0,
+                         n * sizeof(double));
+    if (s) {
+        fill_doubles(s->a, n + TAPS - 1, 4);
+    }
+    return s;
+}
+
+// The taps are constant and the inner trip count is known
+static void conv_1d(size_t n, const double *in, double *out) {
+    for (size_t i = 0; i < n; i++) {
+        double sum = 0.0;
+        for (int k = 0; k < TAPS; k++) {
+            sum += taps[k] * in[i + k];
+        }
+        out[i] = sum;
+    }
+}
+
+static uint64_t conv_run(void *p) {
+    state *s = p;
+    conv_1d(s->n, s->a, s->c);
+    return bench_checksum_doubles(s->c, s->n);
+}
+
+//===----------------------------------------------------------------------===//
+// Reduction: sum, minimum and maximum of n integers
+//===----------------------------------------------------------------------===//
+
+static void *reduction_setup(size_t n) {
+    state *s = new_state(n, n * sizeof(uint32_t), 0, 0);
+    if (s) {
+        fill_u32(s->a, n, 5);
+    }
+    return s;
+}
+
+static uint64_t reduction_run(void *p) {
+    state *s = p;
+    const int32_t *values = s->a;
+    int64_t sum = 0;
+    int32_t min = values[0], max = values[0];
+    for (size_t i = 0; i < s->n; i++) {
+        sum += values[i];
+        if (values[i] < min) {
+            min = values[i];
+        }
+        if (values[i] > max) {
+            max = values[i];
+        }
+    }
+    return bench_mix(bench_mix((uint64_t)sum, (uint32_t)min), (uint32_t)max);
+}
+
+//===----------------------------------------------------------------------===//
+// Polynomial: a degree-5 polynomial at n points, written term by term
+//===----------------------------------------------------------------------===//
+
+static void *polynomial_setup(size_t n) {
+    state *s = new_state(n, n * sizeof(uint32_t), 0, n * sizeof(uint32_t));
+    if (s) {
+        fill_u32(s->a, n, 6);
+    }
+    return s;
+}
+
+// Unsigned, so the rewrites need no fast-math flags
+static void polynomial(size_t n, const uint32_t *in, uint32_t *out) {
+    for (size_t i = 0; i < n; i++) {
+        uint32_t x = in[i];
+        out[i] = 9 * x * x * x * x * x + 3 * x * x * x * x +
+                 2 * x * x * x + 5 * x * x + 7 * x + 11;
+    }
+}
+
+static uint64_t polynomial_run(void *p) {
+    state *s = p;
+    polynomial(s->n, s->a, s->c);
+    return bench_checksum_u32(s->c, s->n);
+}
+
+//===----------------------------------------------------------------------===//
+// CRC-32: byte-wise table lookups over n bytes
+//===----------------------------------------------------------------------===//
+
+static void *crc32_setup(size_t n) {
+    state *s = new_state(n, n, 256 * sizeof(uint32_t), 0);
+    if (!s) {
+        return NULL;
+    }
+    uint64_t seed = 7;
+    unsigned char *bytes = s->a;
+    for (size_t i = 0; i < n; i++) {
+        bytes[i] = (unsigned char)next_random(&seed);
+    }
+    uint32_t *table = s->b;
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+        table[i] = crc;
+    }
+    return s;
+}
+
+static uint64_t crc32_run(void *p) {
+    state *s = p;
+    const unsigned char *bytes = s->a;
+    const uint32_t *table = s->b;
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < s->n; i++) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+//===----------------------------------------------------------------------===//
+// Hash buckets: n keys counted into a run-time number of buckets
+//===----------------------------------------------------------------------===//
+
+static void *buckets_setup(size_t n) {
+    // Prime and only known at run time, so the division stays in the loop
+    uint32_t buckets = 4093;
+    state *s = new_state(n, n * sizeof(uint32_t), 0,
+                         buckets * sizeof(uint32_t));
+    if (s) {
+        fill_u32(s->a, n, 8);
+        s->param = buckets;
+    }
+    return s;
+}
+
+static void count_buckets(size_t n, const uint32_t *keys, uint32_t buckets,
+                          uint32_t *counts) {
+    memset(counts, 0, buckets * sizeof(uint32_t));
+    for (size_t i = 0; i < n; i++) {
+        counts[keys[i] % buckets] += keys[i] / buckets % 2 + 1;
+    }
+}
+
+static uint64_t buckets_run(void *p) {
+    state *s = p;
+    count_buckets(s->n, s->a, s->param, s->c);
+    return bench_checksum_u32(s->c, s->param);
+}
+
+//===----------------------------------------------------------------------===//
+// State machine: a tokenizer over n characters
+//===----------------------------------------------------------------------===//
+
+static void *tokenizer_setup(size_t n) {
+    static const char alphabet[] = "abcxyz_019 \t\n\"#+-*/=;";
+    state *s = new_state(n, n + 1, 0, 0);
+    if (!s) {
+        return NULL;
+    }
+    uint64_t seed = 9;
+    char *text = s->a;
+    for (size_t i = 0; i < n; i++) {
+        text[i] = alphabet[next_random(&seed) % (sizeof(alphabet) - 1)];
+    }
+    text[n] = '\0';
+    return s;
+}
+
+enum { START, IDENT, NUMBER, STRING, COMMENT };
+
+// Counts identifiers, numbers, strings, comments and operators. The state
+// is a constant on most edges into the switch, which threading exploits.
+static uint64_t tokenizer_run(void *p) {
+    state *s = p;
+    const char *text = s->a;
+    uint64_t counts[5] = {0, 0, 0, 0, 0};
+    int current = START;
+    for (size_t i = 0; i < s->n; i++) {
+        char c = text[i];
+        int letter = (c >= 'a' && c <= 'z') || c == '_';
+        int digit = c >= '0' && c <= '9';
+        switch (current) {
+        case START:
+            if (letter) {
+                current = IDENT;
+            } else if (digit) {
+                current = NUMBER;
+            } else if (c == '"') {
+                current = STRING;
+            } else if (c == '#') {
+                current = COMMENT;
+            } else if (c != ' ' && c != '\t' && c != '\n') {
+                counts[START]++;
+            }
+            break;
+        case IDENT:
+            if (!letter && !digit) {
+                counts[IDENT]++;
+                current = START;
+            }
+            break;
+        case NUMBER:
+            if (!digit) {
+                counts[NUMBER]++;
+                current = START;
+            }
+            break;
+        case STRING:
+            if (c == '"') {
+                counts[STRING]++;
+                current = START;
+            }
+            break;
+        case COMMENT:
+            if (c == '\n') {
+                counts[COMMENT]++;
+                current = START;
+            }
+            break;
+        }
+    }
+    uint64_t checksum = 0;
+    for (int i = 0; i < 5; i++) {
+        checksum = bench_mix(checksum, counts[i]);
+    }
+    return checksum;
+}
+
+//===----------------------------------------------------------------------===//
+// AXPY: a general strided helper, called with unit strides
+//===----------------------------------------------------------------------===//
+
+static void *axpy_setup(size_t n) {
+    state *s = new_state(n, n * sizeof(double), n * sizeof(double),
+                         n * sizeof(double));
+    if (s) {
+        fill_doubles(s->a, n, 10);
+        fill_doubles(s->b, n, 11);
+    }
+    return s;
+}
+
+// out = alpha * x + y, as a BLAS-style library would write it
+static void axpy(size_t n, double alpha, const double *x, size_t incx,
+                 const double *y, size_t incy, double *out) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = alpha * x[i * incx] + y[i * incy];
+    }
+}
+
+static uint64_t axpy_run(void *p) {
+    state *s = p;
+    axpy(s->n, 2.5, s->a, 1, s->b, 1, s->c);
+    return bench_checksum_doubles(s->c, s->n);
+}
+
+//===----------------------------------------------------------------------===//
+// Registry
+//===----------------------------------------------------------------------===//
+
+static const bench_kernel kernels[] = {
+    {"gemm", 256, gemm_setup, gemm_run, free_state},
+    {"jacobi-2d", 1024, jacobi_setup, jacobi_run, free_state},
+    {"conv-1d", 1 << 20, conv_setup, conv_run, free_state},
+    {"reduction", 1 << 22, reduction_setup, reduction_run, free_state},
+    {"polynomial", 1 << 20, polynomial_setup, polynomial_run, free_state},
+    {"crc32", 1 << 22, crc32_setup, crc32_run, free_state},
+    {"hash-buckets", 1 << 20, buckets_setup, buckets_run, free_state},
+    {"state-machine", 1 << 22, tokenizer_setup, tokenizer_run, free_state},
+    {"axpy", 1 << 20, axpy_setup, axpy_run, free_state},
+};
+
+int main(int argc, char **argv) {
+    return bench_main(argc, argv, kernels,
+                      sizeof(kernels) / sizeof(kernels[0]));
+}
@@ -0,0 +1,82 @@
+//===- AllocaPromotionPass.h - SSA Construction -----------------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Rewrites stack slots into SSA values. Aggregate allocas that are only
+// accessed through constant-index GEPs are first split into one alloca per
+// element (scalar replacement of aggregates), then every promotable alloca
+// is handed to PromoteMemToReg (mem2reg).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_ALLOCA_PROMOTION_H
+#define LLVM_OPT_PASSES_ALLOCA_PROMOTION_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/AssumptionCache.h"
+
+#include <vector>
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// AllocaPromotionPass
+//
+// New Pass Manager transformation pass that turns -O0 style memory traffic
+// on local variables into SSA registers so the folding, redundancy and
+// unrolling passes can see through it.
+//===----------------------------------------------------------------------===//
+
+class AllocaPromotionPass : public PassInfoMixin<AllocaPromotionPass> {
+public:
+    /// Main entry point for the pass
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+
+    /// Pass name for registration
+    static StringRef name() { return "AllocaPromotionPass"; }
+
+    /// Enable debug output
+    void setDebug(bool Enable) { DebugMode = Enable; }
+
+    /// Maximum number of elements an aggregate may have to be split
+    static constexpr unsigned MaxAggregateElements = 32;
+
+    /// Statistics structure
+    struct Statistics {
+        unsigned AggregatesSplit = 0;
+        unsigned ElementAllocasCreated = 0;
+        unsigned AllocasPromoted = 0;
+    };
+
+    const Statistics& getStatistics() const { return Stats; }
+
+private:
+    Statistics Stats;
+    bool DebugMode = false;
+
+    /// Check that every use of an aggregate alloca is a constant-index GEP
+    /// selecting a top-level element, or a lifetime marker
+    bool isSplittable(AllocaInst *AI);
+
+    /// Replace an aggregate alloca with one alloca per top-level element.
+    /// Newly created aggregate elements are pushed onto the worklist.
+    void splitAggregate(AllocaInst *AI, std::vector<AllocaInst*> &Worklist);
+
+    /// Run scalar replacement of aggregates over the entry block
+    bool splitAggregates(Function &F);
+
+    /// Promote all promotable entry-block allocas to SSA registers
+    bool promoteAllocas(Function &F, DominatorTree &DT, AssumptionCache &AC);
+
+    /// Print debug information
+    void debugPrint(const Twine &Msg) const;
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_ALLOCA_PROMOTION_H
@@ -0,0 +1,135 @@
+//===- ArgumentSpecializationPass.h - Function Specialization ---*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Clones functions for call sites that pass constant arguments, when the
+// constants are estimated to fold instructions, resolve branches, turn
+// divisions into divisions by a constant, or give loops a constant trip
+// count that the unroller can use. Functions too large to inline thereby
+// still receive the constants of their hottest call sites.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_ARGUMENT_SPECIALIZATION_H
+#define LLVM_OPT_PASSES_ARGUMENT_SPECIALIZATION_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// SpecializationCandidate
+//
+// One set of constant arguments for one function, with the call sites
+// that pass it. Arguments that are not specialized are nullptr.
+//===----------------------------------------------------------------------===//
+
+struct SpecializationCandidate {
+    Function *F = nullptr;
+    SmallVector<Constant*, 4> Arguments;      // Per argument, or nullptr
+    SmallVector<CallBase*, 4> CallSites;      // Calls redirected to the clone
+    unsigned Benefit = 0;                     // Estimated per call
+    unsigned Weight = 0;                      // Sum of call site weights
+    unsigned KnownLoops = 0;                  // Loops with known trip count
+};
+
+//===----------------------------------------------------------------------===//
+// ArgumentSpecializationConfig
+//
+// Benefit units are roughly instructions saved per call.
+//===----------------------------------------------------------------------===//
+
+struct ArgumentSpecializationConfig {
+    /// Clones created per module at most, to bound code growth
+    unsigned MaxClones = 8;
+
+    /// Clones of a single function at most
+    unsigned MaxClonesPerFunction = 2;
+
+    /// Functions with more instructions than this are never cloned
+    unsigned MaxFunctionSize = 500;
+
+    /// Smallest estimated benefit per call worth a clone
+    unsigned MinBenefit = 10;
+
+    /// Benefit of a loop whose trip count becomes a constant
+    unsigned TripCountBonus = 20;
+
+    /// Benefit of a division whose divisor becomes a constant
+    unsigned DivisionBonus = 10;
+
+    /// Weight of a call site inside a loop; other call sites weigh 1
+    unsigned LoopCallWeight = 8;
+};
+
+//===----------------------------------------------------------------------===//
+// ArgumentSpecializationPass
+//
+// New Pass Manager module pass. Clones keep the original signature; the
+// specialized arguments are simply unused in the clone.
+//===----------------------------------------------------------------------===//
+
+class ArgumentSpecializationPass
+    : public PassInfoMixin<ArgumentSpecializationPass> {
+public:
+    /// Constructor with optional custom configuration
+    explicit ArgumentSpecializationPass(
+        ArgumentSpecializationConfig Config = ArgumentSpecializationConfig())
+        : Config(Config) {}
+
+    /// Main entry point for the pass
+    PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
+
+    /// Pass name for registration
+    static StringRef name() { return "ArgumentSpecializationPass"; }
+
+    /// Set configuration
+    void setConfig(const ArgumentSpecializationConfig &NewConfig) {
+        Config = NewConfig;
+    }
+
+    /// Enable debug output
+    void setDebug(bool Enable) { DebugMode = Enable; }
+
+    /// Statistics structure
+    struct Statistics {
+        unsigned CallSitesAnalyzed = 0;
+        unsigned NotProfitable = 0;
+        unsigned FunctionsCloned = 0;
+        unsigned CallSitesRedirected = 0;
+        unsigned LoopsWithKnownTripCount = 0;
+    };
+
+    const Statistics& getStatistics() const { return Stats; }
+
+private:
+    ArgumentSpecializationConfig Config;
+    Statistics Stats;
+    bool DebugMode = false;
+
+    /// True if F may be cloned at all
+    bool isSpecializable(const Function &F) const;
+
+    /// Estimated benefit per call of specializing F on Arguments; clears
+    /// the arguments that contribute nothing
+    unsigned estimateBenefit(Function &F,
+                             SmallVectorImpl<Constant*> &Arguments,
+                             LoopInfo &LI, unsigned &KnownLoops) const;
+
+    /// Clone the candidate's function and redirect its call sites
+    Function *createSpecialization(SpecializationCandidate &Candidate);
+
+    /// Print debug information
+    void debugPrint(const Twine &Msg) const;
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_ARGUMENT_SPECIALIZATION_H
@@ -0,0 +1,110 @@
+//===- ColdRegionSplittingPass.h - Hot/Cold Splitting -----------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Moves cold regions out of their function into separate cold, minsize
+// functions, so the hot path falls through densely. A block is cold if it
+// ends in unreachable, calls a noreturn or cold function, is reached only
+// through branches with zero profile weight, or only leads to (or is only
+// reached from) cold blocks.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_COLD_REGION_SPLITTING_H
+#define LLVM_OPT_PASSES_COLD_REGION_SPLITTING_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/AssumptionCache.h"
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// ColdRegionSplittingConfig
+//
+// Outlining replaces a region with a call; the region has to be larger
+// than the call and its argument setup.
+//===----------------------------------------------------------------------===//
+
+struct ColdRegionSplittingConfig {
+    /// Instructions a region must save beyond the cost of the call
+    unsigned MinRegionBenefit = 3;
+
+    /// Treat successors reached only through zero-weight edges as cold
+    bool UseProfileWeights = true;
+};
+
+//===----------------------------------------------------------------------===//
+// ColdRegionSplittingPass
+//
+// New Pass Manager module pass, since outlining adds functions. Regions
+// are single-entry sets of cold blocks extracted with CodeExtractor.
+//===----------------------------------------------------------------------===//
+
+class ColdRegionSplittingPass : public PassInfoMixin<ColdRegionSplittingPass> {
+public:
+    /// Constructor with optional custom configuration
+    explicit ColdRegionSplittingPass(
+        ColdRegionSplittingConfig Config = ColdRegionSplittingConfig())
+        : Config(Config) {}
+
+    /// Main entry point for the pass
+    PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
+
+    /// Pass name for registration
+    static StringRef name() { return "ColdRegionSplittingPass"; }
+
+    /// Set configuration
+    void setConfig(const ColdRegionSplittingConfig &NewConfig) {
+        Config = NewConfig;
+    }
+
+    /// Enable debug output
+    void setDebug(bool Enable) { DebugMode = Enable; }
+
+    /// Statistics structure
+    struct Statistics {
+        unsigned ColdBlocks = 0;
+        unsigned RegionsOutlined = 0;
+        unsigned InstructionsOutlined = 0;
+        unsigned NotProfitable = 0;
+        unsigned NotEligible = 0;
+    };
+
+    const Statistics& getStatistics() const { return Stats; }
+
+private:
+    ColdRegionSplittingConfig Config;
+    Statistics Stats;
+    bool DebugMode = false;
+
+    /// True if BB is cold by itself: unreachable, noreturn or cold calls
+    static bool isColdSeed(const BasicBlock &BB);
+
+    /// Collect the cold blocks of F, propagating from the seeds
+    void findColdBlocks(Function &F, SmallPtrSetImpl<BasicBlock*> &Cold);
+
+    /// Grow a single-entry region of cold blocks from Header
+    static void growRegion(BasicBlock *Header,
+                           const SmallPtrSetImpl<BasicBlock*> &Cold,
+                           SmallVectorImpl<BasicBlock*> &Region);
+
+    /// True if the region is larger than the call that replaces it
+    bool isProfitable(ArrayRef<BasicBlock*> Region) const;
+
+    /// Outline the cold regions of F; returns true if any was outlined
+    bool splitFunction(Function &F, AssumptionCache &AC);
+
+    /// Print debug information
+    void debugPrint(const Twine &Msg) const;
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_COLD_REGION_SPLITTING_H
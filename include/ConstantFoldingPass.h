@@ -85,6 +85,16 @@ private:
     bool allOperandsConstant(Instruction &I);
 };
 
+//===----------------------------------------------------------------------===//
+// ConstantFoldingConfig
+//===----------------------------------------------------------------------===//
+
+struct ConstantFoldingConfig {
+    /// Folding sweeps over the function before stopping short of a fixed
+    /// point; 0 means no limit
+    unsigned MaxIterations = 0;
+};
+
 //===----------------------------------------------------------------------===//
 // ConstantFoldingPass
 //
@@ -94,16 +104,33 @@ private:
 
 class ConstantFoldingPass : public PassInfoMixin<ConstantFoldingPass> {
 public:
+    /// Constructor with optional custom configuration
+    explicit ConstantFoldingPass(
+        ConstantFoldingConfig Config = ConstantFoldingConfig())
+        : Config(Config) {}
+
     /// Main entry point for the pass
     PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
 
     /// Pass name for registration
     static StringRef name() { return "ConstantFoldingPass"; }
 
+    /// Set configuration
+    void setConfig(const ConstantFoldingConfig &NewConfig) {
+        Config = NewConfig;
+    }
+
     /// Enable debug output
     void setDebug(bool Enable) { DebugMode = Enable; }
 
+    /// Fold I as if its operands were Ops, e.g. the values they take along
+    /// one incoming edge. Handles the same instruction kinds as the visitor;
+    /// returns nullptr if the result is not a constant.
+    static Constant* foldWithOperands(Instruction *I, ArrayRef<Constant*> Ops,
+                                      const DataLayout &DL);
+
 private:
+    ConstantFoldingConfig Config;
     bool DebugMode = false;
 
     /// Attempt to fold a single instruction
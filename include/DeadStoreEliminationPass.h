@@ -0,0 +1,210 @@
+//===- DeadStoreEliminationPass.h - MemorySSA-Based DSE ---------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Removes stores whose bytes are overwritten before they can be read, trims
+// memsets that are partially overwritten, and drops stores to local objects
+// that are never read again before the end of their lifetime. Reads and
+// overwrites are discovered by walking the MemorySSA def chain downwards.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_DEAD_STORE_ELIMINATION_H
+#define LLVM_OPT_PASSES_DEAD_STORE_ELIMINATION_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/MemorySSAUpdater.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+
+#include <map>
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// DeadStoreConfig
+//
+// Compile-time limits for the MemorySSA walks.
+//===----------------------------------------------------------------------===//
+
+struct DeadStoreConfig {
+    /// Maximum number of MemoryDefs visited below a single candidate store
+    unsigned MemorySSAWalkLimit = 90;
+
+    /// Maximum number of MemoryDefs visited across the whole function;
+    /// keeps the pass linear on huge functions
+    unsigned FunctionWalkBudget = 20000;
+
+    /// Trim the overwritten prefix/suffix of partially dead memsets
+    bool TrimPartialMemSets = true;
+};
+
+//===----------------------------------------------------------------------===//
+// OverwriteTracker
+//
+// Tracks, for each byte of a dead-store candidate, whether it was first
+// overwritten by a later post-dominating store or first read. Offsets are
+// relative to the common base pointer. Bytes never touched stay unknown.
+//===----------------------------------------------------------------------===//
+
+class OverwriteTracker {
+public:
+    OverwriteTracker(int64_t Start, int64_t End) : Start(Start), End(End) {}
+
+    /// Record that [S, E) is overwritten; bytes already read stay read
+    void addOverwrite(int64_t S, int64_t E) { paint(S, E, Overwritten); }
+
+    /// Record that [S, E) is read; bytes already overwritten stay overwritten
+    void addRead(int64_t S, int64_t E) { paint(S, E, Read); }
+
+    /// Record a read of unknown extent
+    void addReadOfEverything() { paint(Start, End, Read); }
+
+    /// True when every byte was overwritten before being read
+    bool isFullyOverwritten() const;
+
+    /// True when some byte of the candidate may be observed
+    bool hasReads() const { return HasReads; }
+
+    /// Length of the overwritten run starting at the beginning of the range
+    int64_t getOverwrittenPrefix() const;
+
+    /// Length of the overwritten run ending at the end of the range
+    int64_t getOverwrittenSuffix() const;
+
+private:
+    enum ByteState { Overwritten, Read };
+
+    struct Interval {
+        int64_t End;
+        ByteState State;
+    };
+
+    int64_t Start;
+    int64_t End;
+    bool HasReads = false;
+    /// Disjoint painted intervals keyed by start offset
+    std::map<int64_t, Interval> Intervals;
+
+    /// Paint the still-unknown bytes of [S, E) with the given state
+    void paint(int64_t S, int64_t E, ByteState State);
+};
+
+//===----------------------------------------------------------------------===//
+// DeadStoreEliminationPass
+//
+// New Pass Manager transformation pass built on MemorySSA and AliasAnalysis.
+//===----------------------------------------------------------------------===//
+
+class DeadStoreEliminationPass
+    : public PassInfoMixin<DeadStoreEliminationPass> {
+public:
+    /// Constructor with optional custom configuration
+    explicit DeadStoreEliminationPass(DeadStoreConfig Config = DeadStoreConfig())
+        : Config(Config) {}
+
+    /// Main entry point for the pass
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+
+    /// Pass name for registration
+    static StringRef name() { return "DeadStoreEliminationPass"; }
+
+    /// Set configuration
+    void setConfig(const DeadStoreConfig &NewConfig) { Config = NewConfig; }
+
+    /// Enable debug output
+    void setDebug(bool Enable) { DebugMode = Enable; }
+
+    /// Statistics structure
+    struct Statistics {
+        unsigned StoresAnalyzed = 0;
+        unsigned OverwrittenStoresDeleted = 0;
+        unsigned EndOfLifetimeStoresDeleted = 0;
+        unsigned MemSetsTrimmed = 0;
+        unsigned WalkLimitReached = 0;
+    };
+
+    const Statistics& getStatistics() const { return Stats; }
+
+private:
+    DeadStoreConfig Config;
+    Statistics Stats;
+    bool DebugMode = false;
+
+    /// Outcome of walking the def chain below one candidate
+    enum class WalkResult {
+        Live,               // A read was found, or the walk gave up
+        Overwritten,        // Every byte is overwritten before any read
+        EndOfLifetime       // Object is local and dies without being read
+    };
+
+    /// Per-function state shared by the helpers
+    struct FunctionState {
+        MemorySSA &MSSA;
+        AAResults &AA;
+        PostDominatorTree &PDT;
+        const DataLayout &DL;
+        unsigned BudgetLeft;
+        DenseMap<const Value*, bool> NonEscapingCache;
+
+        /// Blocks with an instruction that may unwind and is not a
+        /// MemoryDef. Optimized MemoryUses and instructions without an
+        /// access are not on the def chain, so the walk does not see them.
+        SmallPtrSet<const BasicBlock*, 8> UnwindBlocks;
+    };
+
+    /// Bytes written by a store, as a constant offset from a base pointer
+    struct WriteExtent {
+        MemoryLocation Loc;
+        const Value *Base = nullptr;
+        int64_t Offset = 0;
+        const Value *Object = nullptr;
+    };
+
+    /// Stores and constant-length memsets that are not volatile/atomic
+    static bool isRemovableStore(Instruction *I);
+
+    /// Compute the bytes written by a store or constant-length memset
+    static bool getWriteExtent(Instruction *I, const DataLayout &DL,
+                               WriteExtent &Extent);
+
+    /// True for allocas whose address never escapes the function
+    bool isNonEscapingLocal(const Value *Obj, FunctionState &State);
+
+    /// Mark the candidate bytes a reading instruction may observe
+    void recordRead(Instruction *ReadI, const WriteExtent &Dead,
+                    FunctionState &State, OverwriteTracker &Tracker);
+
+    /// Whether an instruction off the def chain may unwind between DeadI
+    /// and KillingI, letting the caller see the bytes DeadI wrote
+    bool mayUnwindBetween(Instruction *DeadI, Instruction *KillingI,
+                          const WriteExtent &Dead, FunctionState &State);
+
+    /// Walk MemorySSA below DeadI, recording overwritten bytes in Tracker
+    WalkResult walkDefChain(Instruction *DeadI, const WriteExtent &Dead,
+                            FunctionState &State, OverwriteTracker &Tracker);
+
+    /// Drop the overwritten prefix/suffix of a memset
+    bool trimMemSet(MemSetInst *MSI, const OverwriteTracker &Tracker);
+
+    /// Remove a dead store along with its now-unused operands
+    void deleteDeadStore(Instruction *I, MemorySSAUpdater &MSSAU,
+                         const TargetLibraryInfo &TLI);
+
+    /// Print debug information
+    void debugPrint(const Twine &Msg) const;
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_DEAD_STORE_ELIMINATION_H
@@ -0,0 +1,136 @@
+//===- FunctionCachePass.h - Per-function optimization cache ----*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Caches the result of a function pipeline on disk, keyed by a hash of
+// everything the pipeline reads. In incremental builds most functions are
+// unchanged, so their optimized bodies are spliced back in from the cache
+// and the pipeline is skipped.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_FUNCTION_CACHE_H
+#define LLVM_OPT_PASSES_FUNCTION_CACHE_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CachePruning.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// FunctionCacheConfig
+//===----------------------------------------------------------------------===//
+
+struct FunctionCacheConfig {
+    /// Directory of the cache entries; created on first use
+    std::string Directory;
+
+    /// Eviction policy in the syntax of the linkers' LTO cache policy
+    /// option, e.g. "prune_after=168h:cache_size_bytes=1g"
+    std::string PruningPolicy = "prune_interval=20m:prune_after=168h:"
+                                "cache_size_bytes=1g";
+
+    /// Print hit and miss counts to stderr when the cache is released
+    bool PrintStatistics = false;
+};
+
+//===----------------------------------------------------------------------===//
+// FunctionCache
+//
+// One cache directory, shared by the copies of a FunctionCachePass in a
+// pipeline. Entries are bitcode modules holding one optimized function and
+// declarations of the globals it uses. They are written under a temporary
+// name and renamed, so concurrent compiles can share a directory. The
+// directory is pruned when the last pass using it is destroyed.
+//===----------------------------------------------------------------------===//
+
+class FunctionCache {
+public:
+    explicit FunctionCache(FunctionCacheConfig Config);
+    ~FunctionCache();
+
+    FunctionCache(const FunctionCache&) = delete;
+    FunctionCache& operator=(const FunctionCache&) = delete;
+
+    /// Cache key of F under the pipeline PipelineKey, or none if F cannot
+    /// be cached (debug info, block addresses, unnamed or aliased globals)
+    std::optional<std::string> computeKey(const Function &F,
+                                          StringRef PipelineKey) const;
+
+    /// Replace F's body with the entry for Key; false on a miss, leaving
+    /// F untouched
+    bool lookup(StringRef Key, Function &F);
+
+    /// Save F's (optimized) body as the entry for Key
+    void store(StringRef Key, const Function &F);
+
+    /// Statistics structure
+    struct Statistics {
+        unsigned Lookups = 0;
+        unsigned Hits = 0;
+        unsigned Misses = 0;
+        unsigned Stores = 0;
+        unsigned Uncacheable = 0;
+        unsigned StaleEntries = 0;   // unreadable or no longer fitting
+    };
+
+    const Statistics& getStatistics() const { return Stats; }
+
+    /// Count a function computeKey refused
+    void noteUncacheable() { ++Stats.Uncacheable; }
+
+private:
+    FunctionCacheConfig Config;
+    CachePruningPolicy Policy;
+    Statistics Stats;
+
+    /// Path of the entry for Key
+    std::string getEntryPath(StringRef Key) const;
+};
+
+//===----------------------------------------------------------------------===//
+// FunctionCachePass
+//
+// New Pass Manager function pass wrapping a function pipeline. On a hit
+// the cached body replaces F's; on a miss the pipeline runs and its result
+// is stored. PipelineKey names the pipeline and its configuration, so a
+// change to either misses rather than reusing stale bodies.
+//===----------------------------------------------------------------------===//
+
+class FunctionCachePass : public PassInfoMixin<FunctionCachePass> {
+public:
+    FunctionCachePass(std::shared_ptr<FunctionCache> Cache,
+                      FunctionPassManager Pipeline, std::string PipelineKey)
+        : Cache(std::move(Cache)), Pipeline(std::move(Pipeline)),
+          PipelineKey(std::move(PipelineKey)) {}
+
+    /// Main entry point for the pass
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+
+    /// Pass name for registration
+    static StringRef name() { return "FunctionCachePass"; }
+
+    /// Enable debug output
+    void setDebug(bool Enable) { DebugMode = Enable; }
+
+private:
+    std::shared_ptr<FunctionCache> Cache;
+    FunctionPassManager Pipeline;
+    std::string PipelineKey;
+    bool DebugMode = false;
+
+    /// Print debug information
+    void debugPrint(const Twine &Msg) const;
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_FUNCTION_CACHE_H
@@ -0,0 +1,137 @@
+//===- FunctionOrderingPass.h - Function Ordering ---------------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Orders hot functions so that callers and their hottest callees end up
+// next to each other, using call-chain clustering (C3) over profile
+// counts. Fewer pages hold the hot code, which saves i-cache lines and
+// i-TLB entries.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_FUNCTION_ORDERING_H
+#define LLVM_OPT_PASSES_FUNCTION_ORDERING_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Function.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <string>
+#include <vector>
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// FunctionCluster
+//
+// Functions laid out back to back, in order. Samples are the summed
+// entry counts, Size the estimated code size in bytes.
+//===----------------------------------------------------------------------===//
+
+struct FunctionCluster {
+    SmallVector<Function*, 4> Functions;
+    uint64_t Samples = 0;
+    uint64_t Size = 0;
+
+    /// Samples per byte; clusters are laid out densest first
+    double getDensity() const {
+        return Size ? static_cast<double>(Samples) / Size : 0.0;
+    }
+};
+
+//===----------------------------------------------------------------------===//
+// FunctionOrderingConfig
+//===----------------------------------------------------------------------===//
+
+struct FunctionOrderingConfig {
+    /// Largest cluster in bytes; a page, so a cluster costs one i-TLB entry
+    unsigned MaxClusterSize = 4096;
+
+    /// Estimated bytes of machine code per IR instruction
+    unsigned BytesPerInstruction = 4;
+
+    /// A callee joins its caller's cluster only if at least this percentage
+    /// of its calls come from that caller
+    unsigned MinCallerPercent = 10;
+
+    /// Put ordered functions in .text.hot and never-run ones in
+    /// .text.unlikely
+    bool SetSectionPrefixes = true;
+
+    /// If set, the order is also written here, one symbol per line, for
+    /// the linker's symbol ordering option
+    std::string OrderFile;
+};
+
+//===----------------------------------------------------------------------===//
+// FunctionOrderingPass
+//
+// New Pass Manager module pass. Reads function_entry_count and call site
+// counts, so it does nothing on modules without a profile. The order is
+// applied to the module's function list, which is the emission order when
+// all functions share one section.
+//===----------------------------------------------------------------------===//
+
+class FunctionOrderingPass : public PassInfoMixin<FunctionOrderingPass> {
+public:
+    /// Constructor with optional custom configuration
+    explicit FunctionOrderingPass(
+        FunctionOrderingConfig Config = FunctionOrderingConfig())
+        : Config(Config) {}
+
+    /// Main entry point for the pass
+    PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
+
+    /// Pass name for registration
+    static StringRef name() { return "FunctionOrderingPass"; }
+
+    /// Set configuration
+    void setConfig(const FunctionOrderingConfig &NewConfig) {
+        Config = NewConfig;
+    }
+
+    /// Enable debug output
+    void setDebug(bool Enable) { DebugMode = Enable; }
+
+    /// Statistics structure
+    struct Statistics {
+        unsigned FunctionsWithProfile = 0;
+        unsigned CallEdges = 0;
+        unsigned ClustersMerged = 0;
+        unsigned FunctionsOrdered = 0;
+        unsigned FunctionsUnlikely = 0;
+    };
+
+    const Statistics& getStatistics() const { return Stats; }
+
+private:
+    FunctionOrderingConfig Config;
+    Statistics Stats;
+    bool DebugMode = false;
+
+    /// Weighted call edges, per callee: caller and call count
+    using CallerList = SmallVector<std::pair<Function*, uint64_t>, 4>;
+
+    /// Collect profiled call counts between defined functions
+    void buildCallGraph(Module &M, FunctionAnalysisManager &FAM,
+                        DenseMap<Function*, CallerList> &Callers);
+
+    /// Run C3 over the hot functions; returns clusters densest first
+    std::vector<FunctionCluster> clusterFunctions(
+        ArrayRef<Function*> Hot, const DenseMap<Function*, uint64_t> &Samples,
+        const DenseMap<Function*, CallerList> &Callers);
+
+    /// Write the ordered symbol names to Config.OrderFile
+    void writeOrderFile(Module &M, ArrayRef<Function*> Order) const;
+
+    /// Print debug information
+    void debugPrint(const Twine &Msg) const;
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_FUNCTION_ORDERING_H
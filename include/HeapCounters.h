@@ -0,0 +1,44 @@
+//===- HeapCounters.h - Heap accounting hook interface ----------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// The C interface of LLVMOptPassesHeapHook, a library that replaces malloc
+// and friends when preloaded (LD_PRELOAD) and counts every allocation of
+// the process, including those of LLVM and of the compiler around it.
+// MemoryProfiler looks these functions up at run time, so neither the
+// plugin nor the driver depends on the hook being present.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_HEAP_COUNTERS_H
+#define LLVM_OPT_PASSES_HEAP_COUNTERS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct llvm_opt_passes_heap_counters {
+    /// Successful allocations so far, reallocations included
+    uint64_t allocations;
+
+    /// Bytes allocated and not yet freed, as malloc_usable_size counts them
+    uint64_t live_bytes;
+
+    /// Highest live_bytes since the last llvm_opt_passes_heap_exchange_peak
+    uint64_t peak_bytes;
+} llvm_opt_passes_heap_counters;
+
+/// Reads the counters
+void llvm_opt_passes_heap_read(llvm_opt_passes_heap_counters *counters);
+
+/// Sets peak_bytes to peak and returns its old value. Setting it to the
+/// current live_bytes starts a new high-water mark.
+uint64_t llvm_opt_passes_heap_exchange_peak(uint64_t peak);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // LLVM_OPT_PASSES_HEAP_COUNTERS_H
@@ -0,0 +1,109 @@
+//===- InliningPass.h - Cost-Based Inliner ----------------------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Bottom-up CGSCC inliner. Callees are visited before their callers, so the
+// cost of a call site is measured on a callee that has already been
+// optimized. The cost is the callee's TargetTransformInfo size and latency,
+// reduced by the instructions that constant arguments would fold; call
+// sites inside loops get a larger threshold.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_INLINING_H
+#define LLVM_OPT_PASSES_INLINING_H
+
+#include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/LazyCallGraph.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// InliningConfig
+//
+// Costs are in TargetTransformInfo size-and-latency units, roughly one per
+// simple instruction.
+//===----------------------------------------------------------------------===//
+
+struct InliningConfig {
+    /// Call sites whose net cost is at most this are inlined
+    int InlineThreshold = 45;
+
+    /// Added to the threshold for call sites inside a loop
+    int LoopBonus = 30;
+
+    /// Subtracted from the cost for each constant argument that folds at
+    /// least one instruction of the callee
+    int ConstantArgBonus = 10;
+
+    /// Call, return and argument setup removed by inlining, per call site
+    int CallSiteSavings = 5;
+
+    /// Callers are not grown past this many instructions
+    unsigned MaxCallerSize = 2000;
+};
+
+//===----------------------------------------------------------------------===//
+// InliningPass
+//
+// New Pass Manager CGSCC pass. Calls into the SCC being visited (recursion)
+// are never inlined, and call sites exposed by inlining are left alone: the
+// callee's own calls were already considered when the callee was visited.
+//===----------------------------------------------------------------------===//
+
+class InliningPass : public PassInfoMixin<InliningPass> {
+public:
+    /// Constructor with optional custom configuration
+    explicit InliningPass(InliningConfig Config = InliningConfig())
+        : Config(Config) {}
+
+    /// Main entry point for the pass
+    PreservedAnalyses run(LazyCallGraph::SCC &C, CGSCCAnalysisManager &AM,
+                          LazyCallGraph &CG, CGSCCUpdateResult &UR);
+
+    /// Pass name for registration
+    static StringRef name() { return "InliningPass"; }
+
+    /// Set configuration
+    void setConfig(const InliningConfig &NewConfig) { Config = NewConfig; }
+
+    /// Enable debug output
+    void setDebug(bool Enable) { DebugMode = Enable; }
+
+    /// Statistics structure
+    struct Statistics {
+        unsigned CallSitesAnalyzed = 0;
+        unsigned CallsInlined = 0;
+        unsigned NotViable = 0;
+        unsigned NotProfitable = 0;
+        unsigned ConstantArgsFolding = 0;
+    };
+
+    const Statistics& getStatistics() const { return Stats; }
+
+private:
+    InliningConfig Config;
+    Statistics Stats;
+    bool DebugMode = false;
+
+    /// Direct callee of CB if inlining it is legal, else nullptr
+    Function *getInlinableCallee(CallBase &CB, TargetTransformInfo &TTI);
+
+    /// Net cost of inlining CB: callee size minus folded instructions,
+    /// constant argument bonuses and call overhead
+    int getInlineCost(CallBase &CB, Function &Callee,
+                      TargetTransformInfo &CalleeTTI);
+
+    /// Print debug information
+    void debugPrint(const Twine &Msg) const;
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_INLINING_H
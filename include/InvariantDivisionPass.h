@@ -0,0 +1,136 @@
+//===- InvariantDivisionPass.h - Loop-Invariant Division --------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Replaces udiv/urem/sdiv/srem by a divisor that is invariant in a loop but
+// unknown at compile time with a multiply-high sequence. The magic
+// multiplier and shift are computed once in the preheader at run time,
+// following libdivide's branch-free algorithms, so the loop body needs no
+// division instruction.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_INVARIANT_DIVISION_H
+#define LLVM_OPT_PASSES_INVARIANT_DIVISION_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// DivisorMagic
+//
+// Run-time constants for one divisor, computed in a preheader. Unsigned
+// division uses Magic, Shift and IsOne; signed division uses Magic, Shift,
+// Bias and Sign. WideMagic is shared by both.
+//===----------------------------------------------------------------------===//
+
+struct DivisorMagic {
+    Value *Magic = nullptr;       // Multiplier (0 for powers of two)
+    Value *WideMagic = nullptr;   // Magic extended to the mulhi width
+    Value *Shift = nullptr;       // Final right shift
+    Value *IsOne = nullptr;       // Unsigned: divisor is 1
+    Value *Bias = nullptr;        // Signed: added to negative quotients
+    Value *Sign = nullptr;        // Signed: all ones if the divisor is negative
+};
+
+//===----------------------------------------------------------------------===//
+// InvariantDivisionConfig
+//
+// Cost model, in cycles. A divisor is prepared when the expected savings
+// over all iterations exceed the one-time setup cost.
+//===----------------------------------------------------------------------===//
+
+struct InvariantDivisionConfig {
+    /// Latency of a hardware division
+    unsigned DivisionCost = 26;
+
+    /// Multiply-high sequence that replaces one division
+    unsigned MagicDivideCost = 6;
+
+    /// Preheader setup: one double-width division plus a dozen simple ops
+    unsigned MagicSetupCost = 40;
+
+    /// Iterations assumed when SCEV cannot bound the trip count
+    unsigned UnknownTripCount = 16;
+};
+
+//===----------------------------------------------------------------------===//
+// InvariantDivisionPass
+//
+// New Pass Manager transformation pass; adds instructions to preheaders and
+// loop bodies only, so the CFG is preserved.
+//===----------------------------------------------------------------------===//
+
+class InvariantDivisionPass : public PassInfoMixin<InvariantDivisionPass> {
+public:
+    /// Constructor with optional custom configuration
+    explicit InvariantDivisionPass(
+        InvariantDivisionConfig Config = InvariantDivisionConfig())
+        : Config(Config) {}
+
+    /// Main entry point for the pass
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+
+    /// Pass name for registration
+    static StringRef name() { return "InvariantDivisionPass"; }
+
+    /// Set configuration
+    void setConfig(const InvariantDivisionConfig &NewConfig) {
+        Config = NewConfig;
+    }
+
+    /// Enable debug output
+    void setDebug(bool Enable) { DebugMode = Enable; }
+
+    /// Statistics structure
+    struct Statistics {
+        unsigned DivisionsAnalyzed = 0;
+        unsigned DivisorsPrepared = 0;
+        unsigned DivisionsRewritten = 0;
+        unsigned RemaindersRewritten = 0;
+        unsigned NotProfitable = 0;
+    };
+
+    const Statistics& getStatistics() const { return Stats; }
+
+private:
+    InvariantDivisionConfig Config;
+    Statistics Stats;
+    bool DebugMode = false;
+
+    /// Outermost loop around I in which the divisor is invariant and that
+    /// has a preheader, or nullptr
+    static Loop *getHoistLoop(BinaryOperator *I, LoopInfo &LI);
+
+    /// Iterations of I's loop per entry into Outer, as far as SCEV knows
+    uint64_t estimateIterations(BinaryOperator *I, Loop *Outer, LoopInfo &LI,
+                                ScalarEvolution &SE) const;
+
+    /// Emit the unsigned magic constants for D before the builder position
+    static DivisorMagic buildUnsignedMagic(Value *D, IRBuilder<> &Builder);
+
+    /// Emit the signed magic constants for D before the builder position
+    static DivisorMagic buildSignedMagic(Value *D, IRBuilder<> &Builder);
+
+    /// Emit the quotient N / D using prepared constants
+    static Value *emitUnsignedQuotient(Value *N, const DivisorMagic &M,
+                                       IRBuilder<> &Builder);
+    static Value *emitSignedQuotient(Value *N, const DivisorMagic &M,
+                                     IRBuilder<> &Builder);
+
+    /// Print debug information
+    void debugPrint(const Twine &Msg) const;
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_INVARIANT_DIVISION_H
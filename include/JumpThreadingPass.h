@@ -0,0 +1,112 @@
+//===- JumpThreadingPass.h - Jump Threading ---------------------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Finds conditional branches and switches whose condition is a constant
+// along a particular incoming edge (typically a PHI with a constant incoming
+// value, or a compare of one), and duplicates the small block for that edge
+// so the predecessor jumps straight to the known successor.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_JUMP_THREADING_H
+#define LLVM_OPT_PASSES_JUMP_THREADING_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/DomTreeUpdater.h"
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// JumpThreadingConfig
+//
+// Cost limits for block duplication.
+//===----------------------------------------------------------------------===//
+
+struct JumpThreadingConfig {
+    /// Maximum number of instructions (excluding PHIs and the terminator)
+    /// in a block that is duplicated for one incoming edge
+    unsigned DuplicationThreshold = 6;
+
+    /// How many instructions deep a condition is evaluated per edge
+    unsigned MaxConditionDepth = 3;
+
+    /// Maximum number of sweeps over the function
+    unsigned MaxIterations = 4;
+};
+
+//===----------------------------------------------------------------------===//
+// JumpThreadingPass
+//
+// New Pass Manager transformation pass; keeps the DominatorTree up to date
+// through a lazy DomTreeUpdater.
+//===----------------------------------------------------------------------===//
+
+class JumpThreadingPass : public PassInfoMixin<JumpThreadingPass> {
+public:
+    /// Constructor with optional custom configuration
+    explicit JumpThreadingPass(JumpThreadingConfig Config = JumpThreadingConfig())
+        : Config(Config) {}
+
+    /// Main entry point for the pass
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+
+    /// Pass name for registration
+    static StringRef name() { return "JumpThreadingPass"; }
+
+    /// Set configuration
+    void setConfig(const JumpThreadingConfig &NewConfig) { Config = NewConfig; }
+
+    /// Enable debug output
+    void setDebug(bool Enable) { DebugMode = Enable; }
+
+    /// Statistics structure
+    struct Statistics {
+        unsigned BlocksAnalyzed = 0;
+        unsigned EdgesThreaded = 0;
+        unsigned InstructionsDuplicated = 0;
+        unsigned TooCostly = 0;
+        unsigned DeadBlocksRemoved = 0;
+    };
+
+    const Statistics& getStatistics() const { return Stats; }
+
+private:
+    JumpThreadingConfig Config;
+    Statistics Stats;
+    bool DebugMode = false;
+
+    /// Evaluate V as seen when BB is entered from Pred, using the plugin's
+    /// constant folder; returns nullptr if it is not a known constant
+    Constant *evaluateOnEdge(Value *V, BasicBlock *BB, BasicBlock *Pred,
+                             const DataLayout &DL, unsigned Depth) const;
+
+    /// Successor taken by BB's terminator when its condition is C
+    static BasicBlock *getKnownSuccessor(Instruction *Term, Constant *C);
+
+    /// Check that BB may be cloned and is cheap enough to duplicate
+    bool canDuplicate(BasicBlock *BB);
+
+    /// Clone BB for the edge Pred->BB, branching directly to Dest
+    void threadEdge(BasicBlock *Pred, BasicBlock *BB, BasicBlock *Dest,
+                    DomTreeUpdater &DTU);
+
+    /// Try to thread every incoming edge of BB with a known condition
+    bool processBlock(BasicBlock *BB,
+                      const SmallPtrSetImpl<BasicBlock*> &LoopHeaders,
+                      DomTreeUpdater &DTU);
+
+    /// Print debug information
+    void debugPrint(const Twine &Msg) const;
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_JUMP_THREADING_H
@@ -0,0 +1,134 @@
+//===- LoopScalarPromotionPass.h - Loop Scalar Promotion --------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Keeps loop-invariant memory locations that are read and written inside an
+// innermost loop (accumulators such as C[i][j] += ...) in a register: the
+// value is loaded once in the preheader, threaded through the loop with
+// SSAUpdater, and stored once in every exit block.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_LOOP_SCALAR_PROMOTION_H
+#define LLVM_OPT_PASSES_LOOP_SCALAR_PROMOTION_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// PromotionCandidate
+//
+// One must-alias group of simple loads/stores inside a loop.
+//===----------------------------------------------------------------------===//
+
+struct PromotionCandidate {
+    Value *Ptr;                       // Address of the first access
+    Type *AccessTy;                   // Type every access loads/stores
+    SmallVector<LoadInst*, 4> Loads;
+    SmallVector<StoreInst*, 4> Stores;
+    Align Alignment;                  // Smallest alignment of the accesses
+
+    PromotionCandidate(Value *Ptr, Type *AccessTy, Align Alignment)
+        : Ptr(Ptr), AccessTy(AccessTy), Alignment(Alignment) {}
+};
+
+//===----------------------------------------------------------------------===//
+// LoopScalarPromotionConfig
+//
+// Configuration parameters for scalar promotion.
+//===----------------------------------------------------------------------===//
+
+struct LoopScalarPromotionConfig {
+    /// Loops with more memory instructions than this are skipped
+    unsigned MaxMemoryInstructions = 128;
+
+    /// Promote locations whose store may not run on every execution of the
+    /// loop when the object is a non-escaping alloca (no other thread can
+    /// observe the extra store at the exit)
+    bool PromoteConditionalLocalStores = true;
+};
+
+//===----------------------------------------------------------------------===//
+// LoopScalarPromotionPass
+//
+// New Pass Manager transformation pass working on innermost loops.
+//===----------------------------------------------------------------------===//
+
+class LoopScalarPromotionPass
+    : public PassInfoMixin<LoopScalarPromotionPass> {
+public:
+    /// Constructor with optional custom configuration
+    explicit LoopScalarPromotionPass(
+        LoopScalarPromotionConfig Config = LoopScalarPromotionConfig())
+        : Config(Config) {}
+
+    /// Main entry point for the pass
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+
+    /// Pass name for registration
+    static StringRef name() { return "LoopScalarPromotionPass"; }
+
+    /// Set configuration
+    void setConfig(const LoopScalarPromotionConfig &NewConfig) {
+        Config = NewConfig;
+    }
+
+    /// Enable debug output
+    void setDebug(bool Enable) { DebugMode = Enable; }
+
+    /// Statistics structure
+    struct Statistics {
+        unsigned LoopsAnalyzed = 0;
+        unsigned LocationsPromoted = 0;
+        unsigned LoadsEliminated = 0;
+        unsigned StoresEliminated = 0;
+        unsigned ExitStoresInserted = 0;
+    };
+
+    const Statistics& getStatistics() const { return Stats; }
+
+private:
+    LoopScalarPromotionConfig Config;
+    Statistics Stats;
+    bool DebugMode = false;
+
+    /// Check loop shape: innermost, preheader, latch, dedicated exits and
+    /// no instruction that may stop execution mid-iteration
+    bool isPromotableLoop(Loop *L) const;
+
+    /// Group the simple loads/stores of the loop by must-alias address;
+    /// returns false if the loop has too many memory instructions
+    bool collectCandidates(Loop *L, AAResults &AA,
+                           std::vector<PromotionCandidate> &Candidates) const;
+
+    /// No other instruction in the loop may read or write the location
+    bool isAccessedOnlyByCandidate(Loop *L, const PromotionCandidate &C,
+                                   AAResults &AA) const;
+
+    /// Some store of the candidate runs in every execution of the loop
+    bool hasGuaranteedStore(Loop *L, const PromotionCandidate &C,
+                            DominatorTree &DT, ScalarEvolution &SE) const;
+
+    /// Storing at the exits is allowed even without a guaranteed store
+    bool isSafeToIntroduceStore(Loop *L, const PromotionCandidate &C) const;
+
+    /// Rewrite the loop to keep the location in a register
+    bool promote(Loop *L, PromotionCandidate &C, ScalarEvolution &SE);
+
+    /// Print debug information
+    void debugPrint(const Twine &Msg) const;
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_LOOP_SCALAR_PROMOTION_H
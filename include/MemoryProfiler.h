@@ -0,0 +1,142 @@
+//===- MemoryProfiler.h - Per-pass heap profile -----------------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Attributes heap usage to passes and analyses through PassInstrumentation:
+// around every pass and analysis run it reads the counters of the heap hook
+// (HeapCounters.h) and records the allocations, the peak above the heap at
+// the start, and the bytes still live at the end. The profile is kept per
+// pass, per function, and per function and pass, and printed when the
+// profiler is released.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_MEMORY_PROFILER_H
+#define LLVM_OPT_PASSES_MEMORY_PROFILER_H
+
+#include "HeapCounters.h"
+
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// MemoryProfilerConfig
+//===----------------------------------------------------------------------===//
+
+struct MemoryProfilerConfig {
+    /// Largest functions (by instruction count) in the high-water mark
+    /// report; 0 leaves it out
+    unsigned TopFunctions = 10;
+
+    /// Print every function's usage per pass, not just the aggregate
+    bool PerFunction = false;
+};
+
+//===----------------------------------------------------------------------===//
+// MemoryUsage
+//===----------------------------------------------------------------------===//
+
+/// Heap usage of one or more runs of a pass or analysis. A pass includes
+/// the analyses it computed.
+struct MemoryUsage {
+    uint64_t Runs = 0;
+    uint64_t Allocations = 0;
+
+    /// Most heap above the level at the start of a run, over the runs
+    uint64_t PeakBytes = 0;
+
+    /// Heap allocated and not freed by the end of the runs; negative when
+    /// they freed more than they kept (e.g. invalidated analyses)
+    int64_t RetainedBytes = 0;
+
+    void add(const MemoryUsage &Other);
+};
+
+//===----------------------------------------------------------------------===//
+// MemoryProfiler
+//
+// Counters come from LLVMOptPassesHeapHook, looked up at run time; create()
+// fails without it. The hook counts the whole process, so runs are
+// attributed correctly only while one thread compiles.
+//===----------------------------------------------------------------------===//
+
+class MemoryProfiler {
+public:
+    /// A profiler writing its report to OS, or nullptr if the heap hook is
+    /// not loaded
+    static std::unique_ptr<MemoryProfiler> create(raw_ostream &OS,
+                                                  MemoryProfilerConfig Config);
+    ~MemoryProfiler();
+
+    MemoryProfiler(const MemoryProfiler&) = delete;
+    MemoryProfiler& operator=(const MemoryProfiler&) = delete;
+
+    /// Profile the passes and analyses run under PIC. Profiler must outlive
+    /// the runs; the callbacks share its ownership.
+    static void registerCallbacks(std::shared_ptr<MemoryProfiler> Profiler,
+                                  PassInstrumentationCallbacks &PIC);
+
+    void print(raw_ostream &OS) const;
+
+private:
+    using ReadFn = void (*)(llvm_opt_passes_heap_counters *);
+    using ExchangePeakFn = uint64_t (*)(uint64_t);
+
+    MemoryProfiler(raw_ostream &OS, MemoryProfilerConfig Config,
+                   ReadFn Read, ExchangePeakFn ExchangePeak);
+
+    /// A pass or analysis being run
+    struct Frame {
+        std::string PassID;
+        std::string Function;   // Empty for module and CGSCC passes
+        bool IsAnalysis;
+        uint64_t StartAllocations;
+        uint64_t StartBytes;
+        uint64_t OuterPeakBytes;  // Enclosing run's high-water mark so far
+    };
+
+    struct FunctionUsage {
+        /// Largest instruction count seen at the start of a run
+        unsigned Instructions = 0;
+
+        /// High-water mark over all runs and the pass that reached it
+        uint64_t PeakBytes = 0;
+        std::string PeakPassID;
+
+        StringMap<MemoryUsage> Passes;
+    };
+
+    void beforeRun(StringRef PassID, Any IR, bool IsAnalysis);
+    void afterRun();
+
+    /// Runs Bookkeeping without charging its allocations to the runs on
+    /// the stack
+    void withoutCharge(function_ref<void()> Bookkeeping);
+
+    raw_ostream &OS;
+    MemoryProfilerConfig Config;
+    ReadFn Read;
+    ExchangePeakFn ExchangePeak;
+
+    /// Nested runs: adaptors hold passes, passes compute analyses
+    SmallVector<Frame, 8> Stack;
+
+    StringMap<MemoryUsage> Passes;
+    StringMap<MemoryUsage> Analyses;
+    StringMap<FunctionUsage> Functions;
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_MEMORY_PROFILER_H
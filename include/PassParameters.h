@@ -0,0 +1,81 @@
+//===- PassParameters.h - Pass name parameters ------------------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Parameters in pass names, such as
+// custom-loop-unroll<full-max=16;partial=8;no-runtime>, so a pipeline
+// string can tune a pass without rebuilding the plugin. Parameters are
+// separated by ';' and are either Name=Value or a flag, which a "no-"
+// prefix turns off. Parameters not given keep the Config's defaults.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_PASS_PARAMETERS_H
+#define LLVM_OPT_PASSES_PASS_PARAMETERS_H
+
+#include "ConstantFoldingPass.h"
+#include "LoopUnrollingPass.h"
+#include "RedundancyEliminationPass.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace llvm {
+namespace optpasses {
+
+/// The parameters of Name if it names PassName: the text between the
+/// angle brackets of "PassName<...>", or empty for a bare "PassName"
+std::optional<StringRef> getPassParameters(StringRef Name,
+                                           StringRef PassName);
+
+//===----------------------------------------------------------------------===//
+// Parsing
+//
+// custom-loop-unroll:     full-max=N, full-max-insts=N, partial=N (N >= 1),
+//                         max-size=N, [no-]runtime, [no-]calls
+// custom-constant-fold:   max-iterations=N
+// custom-redundancy-elim: [no-]load-cse
+//===----------------------------------------------------------------------===//
+
+Expected<LoopUnrollConfig> parseLoopUnrollParameters(StringRef Params);
+
+Expected<ConstantFoldingConfig>
+parseConstantFoldingParameters(StringRef Params);
+
+Expected<RedundancyEliminationConfig>
+parseRedundancyEliminationParameters(StringRef Params);
+
+//===----------------------------------------------------------------------===//
+// Printing
+//
+// Every parameter spelled out, in a form the parsers above read back.
+//===----------------------------------------------------------------------===//
+
+std::string printLoopUnrollParameters(const LoopUnrollConfig &Config);
+
+std::string printConstantFoldingParameters(
+    const ConstantFoldingConfig &Config);
+
+std::string printRedundancyEliminationParameters(
+    const RedundancyEliminationConfig &Config);
+
+//===----------------------------------------------------------------------===//
+// Pipeline Config Files
+//
+// A custom-optimize config file (-custom-optimize-config) lists the passes
+// of its function pipeline in order, one per line, with parameters as
+// above. '#' starts a comment; blank lines are skipped. scripts/autotune.py
+// writes these files.
+//===----------------------------------------------------------------------===//
+
+/// The pass names in the config file at Path
+Expected<std::vector<std::string>> readPipelineConfig(StringRef Path);
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_PASS_PARAMETERS_H
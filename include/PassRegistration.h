@@ -0,0 +1,26 @@
+//===- PassRegistration.h - Pass registration -------------------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Registers the passes, analyses and extension point callbacks with a
+// PassBuilder. The plugin entry point and the custom-opt driver both go
+// through here, so a pipeline string means the same thing in either.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_PASS_REGISTRATION_H
+#define LLVM_OPT_PASSES_PASS_REGISTRATION_H
+
+#include "llvm/Passes/PassBuilder.h"
+
+namespace llvm {
+namespace optpasses {
+
+/// Make every custom-* pass name parseable by PB and hook the passes into
+/// its extension points
+void registerOptPasses(PassBuilder &PB);
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_PASS_REGISTRATION_H
@@ -0,0 +1,178 @@
+//===- PolynomialRewritePass.h - Polynomial Rewriting -----------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Rewrites repeated multiplications (x*x*x*x, llvm.powi with a constant
+// exponent) with exponentiation by squaring, reusing powers already computed
+// in the block, and rewrites sums of c_k * x^k as Horner's scheme or Estrin's
+// scheme. FP expressions are only rewritten when their fast-math flags allow
+// reassociation.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_POLYNOMIAL_REWRITE_H
+#define LLVM_OPT_PASSES_POLYNOMIAL_REWRITE_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallVector.h"
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// ProductTerm
+//
+// A product of powers, c * b0^e0 * b1^e1 * ..., flattened from a tree of
+// single-use multiplies and powi calls.
+//===----------------------------------------------------------------------===//
+
+struct ProductTerm {
+    Constant *Coefficient = nullptr;          // Folded constant factors
+    MapVector<Value*, unsigned> Powers;       // Base -> exponent
+    SmallVector<Instruction*, 8> Nodes;       // Consumed nodes, parents first
+    unsigned MultiplyCost = 0;                // Multiplies the nodes stand for
+};
+
+//===----------------------------------------------------------------------===//
+// PolynomialRewriteConfig
+//
+// Evaluation scheme and size limits.
+//===----------------------------------------------------------------------===//
+
+struct PolynomialRewriteConfig {
+    enum EvaluationScheme {
+        Horner,                   // Fewest multiplies, one long dependency chain
+        Estrin                    // A few more multiplies, log-depth chain
+    };
+
+    /// Scheme used for polynomials of at least EstrinMinDegree
+    EvaluationScheme Scheme = Horner;
+
+    /// Lower-degree polynomials always use Horner's scheme
+    unsigned EstrinMinDegree = 4;
+
+    /// Largest exponent expanded by squaring
+    unsigned MaxExponent = 64;
+
+    /// Largest polynomial degree that is rewritten
+    unsigned MaxDegree = 32;
+};
+
+//===----------------------------------------------------------------------===//
+// PolynomialRewritePass
+//
+// New Pass Manager transformation pass; rewrites instructions inside blocks
+// only, so the CFG is preserved.
+//===----------------------------------------------------------------------===//
+
+class PolynomialRewritePass : public PassInfoMixin<PolynomialRewritePass> {
+public:
+    /// Constructor with optional custom configuration
+    explicit PolynomialRewritePass(
+        PolynomialRewriteConfig Config = PolynomialRewriteConfig())
+        : Config(Config) {}
+
+    /// Main entry point for the pass
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+
+    /// Pass name for registration
+    static StringRef name() { return "PolynomialRewritePass"; }
+
+    /// Set configuration
+    void setConfig(const PolynomialRewriteConfig &NewConfig) {
+        Config = NewConfig;
+    }
+
+    /// Enable debug output
+    void setDebug(bool Enable) { DebugMode = Enable; }
+
+    /// Statistics structure
+    struct Statistics {
+        unsigned PowersExpanded = 0;
+        unsigned PowersReused = 0;
+        unsigned PolynomialsRewritten = 0;
+        unsigned EstrinPolynomials = 0;
+        unsigned MultipliesSaved = 0;
+    };
+
+    const Statistics& getStatistics() const { return Stats; }
+
+private:
+    /// A power and the fast-math flags it was computed under
+    struct CachedPower {
+        Value *Power;
+        FastMathFlags Assumed;
+    };
+
+    /// Powers built in the current block, keyed by (base, exponent)
+    using PowerCache = DenseMap<std::pair<Value*, unsigned>, CachedPower>;
+
+    PolynomialRewriteConfig Config;
+    Statistics Stats;
+    bool DebugMode = false;
+    PowerCache Cache;
+
+    /// Exponent of a powi call with a usable constant exponent, else 0
+    unsigned getPowiExponent(const Value *V) const;
+
+    /// True if V is a multiply of the given opcode that may be regrouped
+    static bool isReassociableMul(const Value *V, unsigned MulOpcode);
+
+    /// True if V is an add of the given opcode that may be regrouped
+    static bool isReassociableAdd(const Value *V, unsigned AddOpcode);
+
+    /// True if V is consumed by the product tree of Parent
+    bool isInnerFactor(const Value *V, const Instruction *Parent,
+                       unsigned MulOpcode) const;
+
+    /// Flatten the product tree rooted at Root into T; false if an exponent
+    /// exceeds the configured limit
+    bool collectProduct(Instruction *Root, unsigned MulOpcode, ProductTerm &T,
+                        const DataLayout &DL) const;
+
+    /// Cached Base^E if it assumes no more than FMF, the flags of the
+    /// expression that would use it
+    Value *findPower(Value *Base, unsigned E, FastMathFlags FMF) const;
+
+    /// Multiplies needed for Base^E by squaring under FMF, given the cached
+    /// powers; Have receives the exponents that would be built
+    unsigned getPowerCost(Value *Base, unsigned E, FastMathFlags FMF,
+                          SmallDenseSet<unsigned, 8> &Have) const;
+
+    /// Build (or reuse) Base^E by squaring before the builder's position,
+    /// under the builder's fast-math flags
+    Value *buildPower(Value *Base, unsigned E, unsigned MulOpcode,
+                      IRBuilder<> &Builder);
+
+    /// Multiply the factors of T together (without the powers of Skip)
+    Value *buildProduct(const ProductTerm &T, Value *Skip, unsigned MulOpcode,
+                        IRBuilder<> &Builder);
+
+    /// Cache Root, a power of T kept as it is, unless its nodes carry
+    /// nsw/nuw, which no rewritten expression has
+    void cacheKeptPower(const ProductTerm &T, Instruction *Root);
+
+    /// Rewrite a product tree with exponentiation by squaring
+    bool rewriteProduct(Instruction *Root, const DataLayout &DL);
+
+    /// Rewrite a sum of c_k * x^k in Horner or Estrin form
+    bool rewritePolynomial(Instruction *Root, const DataLayout &DL);
+
+    /// Process the sums, then the remaining products, of one block
+    bool processBlock(BasicBlock &BB, const DataLayout &DL);
+
+    /// Print debug information
+    void debugPrint(const Twine &Msg) const;
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_POLYNOMIAL_REWRITE_H
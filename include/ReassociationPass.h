@@ -0,0 +1,130 @@
+//===- ReassociationPass.h - Expression Reassociation -----------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Flattens trees of one associative, commutative operator (add, mul, and,
+// or, xor and their fast-math FP counterparts), folds all constant leaves
+// into one, and rebuilds the tree as a chain with operands in rank order.
+// (x + 3) + 5 becomes x + 8, and x*y*z is built the same way however it
+// was written, so ValueNumberTable can match equivalent subtrees.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_REASSOCIATION_H
+#define LLVM_OPT_PASSES_REASSOCIATION_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <utility>
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// ReassociationConfig
+//
+// Limits for tree linearization.
+//===----------------------------------------------------------------------===//
+
+struct ReassociationConfig {
+    /// Trees with more leaves than this are left alone
+    unsigned MaxTreeSize = 32;
+
+    /// Reassociate fadd/fmul trees whose nodes all carry the reassoc and
+    /// nsz fast-math flags; FP trees without them are never touched
+    bool ReassociateFloatingPoint = true;
+};
+
+//===----------------------------------------------------------------------===//
+// ReassociationPass
+//
+// New Pass Manager transformation pass; only rewrites instructions inside a
+// block, so the CFG is preserved.
+//===----------------------------------------------------------------------===//
+
+class ReassociationPass : public PassInfoMixin<ReassociationPass> {
+public:
+    /// Constructor with optional custom configuration
+    explicit ReassociationPass(ReassociationConfig Config = ReassociationConfig())
+        : Config(Config) {}
+
+    /// Main entry point for the pass
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+
+    /// Pass name for registration
+    static StringRef name() { return "ReassociationPass"; }
+
+    /// Set configuration
+    void setConfig(const ReassociationConfig &NewConfig) { Config = NewConfig; }
+
+    /// Enable debug output
+    void setDebug(bool Enable) { DebugMode = Enable; }
+
+    /// Statistics structure
+    struct Statistics {
+        unsigned TreesAnalyzed = 0;
+        unsigned TreesRewritten = 0;
+        unsigned ConstantsFolded = 0;
+        unsigned OperandsCancelled = 0;
+    };
+
+    const Statistics& getStatistics() const { return Stats; }
+
+private:
+    /// (rank, definition order); leaves are sorted by this key
+    using RankKey = std::pair<unsigned, unsigned>;
+
+    ReassociationConfig Config;
+    Statistics Stats;
+    bool DebugMode = false;
+    DenseMap<const Value*, RankKey> Ranks;
+
+    /// Assign ranks: constants 0, arguments by position, instructions one
+    /// above their highest operand; instructions that cannot be moved
+    /// (PHIs, memory accesses, calls) take the rank of their block
+    void computeRanks(Function &F);
+
+    /// Rank key of a leaf
+    RankKey getRank(const Value *V) const;
+
+    /// Opcode of the tree I belongs to (sub-by-constant counts as add), or
+    /// 0 if I cannot be part of a reassociable tree
+    unsigned getTreeOpcode(const Instruction *I) const;
+
+    /// True if Op is folded into the tree of Parent instead of being a leaf
+    bool isInnerNode(const Value *Op, const Instruction *Parent,
+                     unsigned Opcode) const;
+
+    /// Collect the leaves of the tree rooted at Root and its inner nodes
+    /// (parents before children); false if the tree is too large
+    bool linearize(Instruction *Root, unsigned Opcode,
+                   SmallVectorImpl<Value*> &Leaves,
+                   SmallVectorImpl<Instruction*> &Nodes,
+                   const DataLayout &DL);
+
+    /// Fold constants, drop identities and duplicates, and sort the leaves;
+    /// returns a value for the whole tree if it collapsed to one
+    Value *simplifyLeaves(unsigned Opcode, Type *Ty,
+                          SmallVectorImpl<Value*> &Leaves,
+                          const DataLayout &DL);
+
+    /// True if Root already is the left-leaning chain over Leaves
+    static bool matchesChain(Instruction *Root, unsigned Opcode,
+                             ArrayRef<Value*> Leaves);
+
+    /// Rewrite one tree; returns true if the IR changed
+    bool reassociate(Instruction *Root, const DataLayout &DL);
+
+    /// Print debug information
+    void debugPrint(const Twine &Msg) const;
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_REASSOCIATION_H
@@ -90,6 +90,10 @@ public:
     /// Lookup value number (returns 0 if not found)
     unsigned lookupValueNumber(Value *V) const;
 
+    /// Give V the value number of Leader, so expressions using V match
+    /// expressions using Leader
+    void assignLeaderValueNumber(Value *V, Value *Leader);
+
     /// Create expression key for an instruction
     ExpressionKey createExpressionKey(Instruction *I);
 
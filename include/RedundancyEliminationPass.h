@@ -13,10 +13,23 @@
 #include "RedundancyAnalysis.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/MemorySSA.h"
 
 namespace llvm {
 namespace optpasses {
 
+//===----------------------------------------------------------------------===//
+// RedundancyEliminationConfig
+//===----------------------------------------------------------------------===//
+
+struct RedundancyEliminationConfig {
+    /// Also replace a load with a dominating load of the same address that
+    /// no store in between may clobber (MemorySSA). Off by default: the
+    /// analysis itself leaves memory operations alone.
+    bool EliminateLoads = false;
+};
+
 //===----------------------------------------------------------------------===//
 // RedundancyEliminationPass
 //
@@ -27,29 +40,45 @@ namespace optpasses {
 class RedundancyEliminationPass 
     : public PassInfoMixin<RedundancyEliminationPass> {
 public:
+    /// Constructor with optional custom configuration
+    explicit RedundancyEliminationPass(
+        RedundancyEliminationConfig Config = RedundancyEliminationConfig())
+        : Config(Config) {}
+
     /// Main entry point for the pass
     PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
 
     /// Pass name for registration
     static StringRef name() { return "RedundancyEliminationPass"; }
 
+    /// Set configuration
+    void setConfig(const RedundancyEliminationConfig &NewConfig) {
+        Config = NewConfig;
+    }
+
     /// Enable debug output
     void setDebug(bool Enable) { DebugMode = Enable; }
 
     /// Statistics
     struct Statistics {
         unsigned InstructionsEliminated = 0;
+        unsigned LoadsEliminated = 0;
         unsigned FunctionsProcessed = 0;
     };
 
     const Statistics& getStatistics() const { return Stats; }
 
 private:
+    RedundancyEliminationConfig Config;
     Statistics Stats;
     bool DebugMode = false;
 
     /// Perform the elimination
     bool eliminateRedundancies(Function &F, const RedundancyInfo &RI);
+
+    /// Replace loads whose value a dominating load already read
+    bool eliminateRedundantLoads(Function &F, DominatorTree &DT,
+                                 MemorySSA &MSSA);
 };
 
 } // namespace optpasses
@@ -0,0 +1,139 @@
+//===- StoreForwardingPass.h - Store-to-Load Forwarding ---------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Replaces loads with the value a dominating store wrote to the same
+// address. The clobbering store is found with the MemorySSA walker; when
+// stores on several incoming paths reach a load through a MemoryPhi, a PHI
+// of the stored values is inserted instead. Loads that read only part of a
+// stored value get it through extractvalue or shift + truncate.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_STORE_FORWARDING_H
+#define LLVM_OPT_PASSES_STORE_FORWARDING_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/MemorySSA.h"
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// StoreForwardingConfig
+//
+// Limits for the forwarding search.
+//===----------------------------------------------------------------------===//
+
+struct StoreForwardingConfig {
+    /// How many MemoryPhis may be looked through on the way to the stores
+    unsigned MaxPhiDepth = 2;
+
+    /// Maximum number of predecessors of a block that receives a new PHI
+    unsigned MaxPhiIncoming = 16;
+
+    /// Forward into loads that read only part of the stored value
+    bool AllowPartialForwarding = true;
+};
+
+//===----------------------------------------------------------------------===//
+// StoreForwardingPass
+//
+// New Pass Manager transformation pass built on MemorySSA.
+//===----------------------------------------------------------------------===//
+
+class StoreForwardingPass : public PassInfoMixin<StoreForwardingPass> {
+public:
+    /// Constructor with optional custom configuration
+    explicit StoreForwardingPass(
+        StoreForwardingConfig Config = StoreForwardingConfig())
+        : Config(Config) {}
+
+    /// Main entry point for the pass
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+
+    /// Pass name for registration
+    static StringRef name() { return "StoreForwardingPass"; }
+
+    /// Set configuration
+    void setConfig(const StoreForwardingConfig &NewConfig) { Config = NewConfig; }
+
+    /// Enable debug output
+    void setDebug(bool Enable) { DebugMode = Enable; }
+
+    /// Statistics structure
+    struct Statistics {
+        unsigned LoadsAnalyzed = 0;
+        unsigned LoadsForwarded = 0;
+        unsigned PartialForwards = 0;
+        unsigned PhisInserted = 0;
+    };
+
+    const Statistics& getStatistics() const { return Stats; }
+
+private:
+    StoreForwardingConfig Config;
+    Statistics Stats;
+    bool DebugMode = false;
+
+    using PhiKey = std::pair<MemoryPhi*, std::pair<const Value*, Type*>>;
+
+    /// Per-function state shared by the helpers
+    struct FunctionState {
+        MemorySSA &MSSA;
+        MemorySSAWalker &Walker;
+        DominatorTree &DT;
+        const DataLayout &DL;
+        /// PHIs built for a (MemoryPhi, pointer, loaded type) triple
+        DenseMap<PhiKey, PHINode*> PhiCache;
+    };
+
+    /// How the loaded bytes are recovered from a stored value
+    struct Extraction {
+        /// extractvalue path into an aggregate store
+        SmallVector<unsigned, 4> Indices;
+        /// Type reached after the extractvalue path
+        Type *LeafTy = nullptr;
+        /// Byte offset of the loaded bytes inside the leaf
+        uint64_t LeafOffset = 0;
+        /// Leaf must be shifted and truncated to the loaded width
+        bool NeedsShift = false;
+    };
+
+    /// Check that SI writes every byte LI reads and work out the extraction
+    bool planExtraction(StoreInst *SI, LoadInst *LI, const DataLayout &DL,
+                        Extraction &E) const;
+
+    /// Check that every path into a MemoryPhi ends in a forwardable store
+    bool canForwardThroughPhi(MemoryPhi *Phi, LoadInst *LI,
+                              const MemoryLocation &Loc, FunctionState &State,
+                              unsigned Depth,
+                              SmallPtrSetImpl<MemoryPhi*> &Visiting);
+
+    /// Build the loaded value from a stored one before InsertPt
+    Value *materializeFromStore(StoreInst *SI, LoadInst *LI,
+                                Instruction *InsertPt, const DataLayout &DL);
+
+    /// Build (or reuse) the PHI of the stored values reaching a MemoryPhi
+    Value *materializeThroughPhi(MemoryPhi *Phi, LoadInst *LI,
+                                 const MemoryLocation &Loc,
+                                 FunctionState &State);
+
+    /// Try to replace a single load; returns the forwarded value on success
+    Value *forwardLoad(LoadInst *LI, FunctionState &State);
+
+    /// Print debug information
+    void debugPrint(const Twine &Msg) const;
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_STORE_FORWARDING_H
@@ -0,0 +1,307 @@
+#!/usr/bin/env python3
+#
+# autotune.py - Tune the custom-optimize function pipeline for a benchmark
+#
+# Usage: ./autotune.py <path_to_plugin.so> [-o tuned.cfg] [options]
+#
+# The search space is the custom-loop-unroll parameters, the folding and
+# redundancy elimination parameters, and the order of custom-constant-fold,
+# custom-redundancy-elim and custom-loop-unroll among the slots they hold
+# in custom-optimize. Each candidate is written as a config file, compiled
+# with -custom-optimize-config, and timed. Candidates are pruned by
+# successive halving: every round times the survivors with more
+# repetitions and keeps the fastest 1/eta of them.
+#
+# The winner is written only if its 95% confidence interval lies entirely
+# below the default pipeline's; otherwise the default is written, so noise
+# is never mistaken for a tuning result. Load the result with:
+#
+#   opt -load=LLVMOptPasses.so -load-pass-plugin=LLVMOptPasses.so \
+#       -passes=custom-optimize -custom-optimize-config=tuned.cfg ...
+#
+
+import argparse
+import itertools
+import math
+import os
+import random
+import re
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+TEST_DIR = os.path.join(SCRIPT_DIR, "..", "test")
+
+# The function pipeline of custom-optimize (addOptimizationPasses in
+# PassRegistration.cpp), with None for the slots of the tuned passes
+PIPELINE = [
+    "custom-alloca-promote",
+    None,  # custom-constant-fold
+    "custom-jump-thread",
+    "custom-scalar-promote",
+    "custom-store-forward",
+    "custom-reassociate",
+    "custom-poly-rewrite",
+    None,  # custom-redundancy-elim
+    "custom-dse",
+    "custom-invariant-div",
+    None,  # custom-loop-unroll
+]
+
+TUNED_PASSES = ("fold", "cse", "unroll")
+
+# Values tried for each parameter; the first is the pass's default
+UNROLL_SPACE = {
+    "full-max": [8, 4, 16, 32],
+    "full-max-insts": [100, 50, 200, 400],
+    "partial": [4, 2, 8],
+    "max-size": [400, 200, 800, 1600],
+    "runtime": [True, False],
+    "calls": [False, True],
+}
+FOLD_SPACE = {"max-iterations": [0, 1, 2]}
+CSE_SPACE = {"load-cse": [False, True]}
+
+# Two-sided 95% Student t quantiles by degrees of freedom
+T_95 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+        2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101,
+        2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052,
+        2.048, 2.045, 2.042]
+
+
+def t_quantile(df):
+    return T_95[df - 1] if df <= len(T_95) else 1.960
+
+
+def format_params(space, values):
+    params = []
+    for name in space:
+        value = values[name]
+        if isinstance(value, bool):
+            params.append(name if value else "no-" + name)
+        else:
+            params.append("%s=%d" % (name, value))
+    return ";".join(params)
+
+
+class Candidate:
+    def __init__(self, unroll, fold, cse, order):
+        self.unroll = unroll
+        self.fold = fold
+        self.cse = cse
+        self.order = order
+        self.samples = []
+        self.binary = None
+        self.failed = False
+
+    def passes(self):
+        tuned = {
+            "fold": "custom-constant-fold<%s>"
+                    % format_params(FOLD_SPACE, self.fold),
+            "cse": "custom-redundancy-elim<%s>"
+                   % format_params(CSE_SPACE, self.cse),
+            "unroll": "custom-loop-unroll<%s>"
+                      % format_params(UNROLL_SPACE, self.unroll),
+        }
+        slots = iter(self.order)
+        return [p if p is not None else tuned[next(slots)] for p in PIPELINE]
+
+    def config(self):
+        return "".join(p + "\n" for p in self.passes())
+
+    def mean(self):
+        return statistics.mean(self.samples) if self.samples else math.inf
+
+    def interval(self):
+        """Half width of the 95% confidence interval of the mean"""
+        n = len(self.samples)
+        if n < 2:
+            return math.inf
+        return t_quantile(n - 1) * statistics.stdev(self.samples) / math.sqrt(n)
+
+
+def default_candidate():
+    first = lambda space: {name: values[0] for name, values in space.items()}
+    return Candidate(first(UNROLL_SPACE), first(FOLD_SPACE),
+                     first(CSE_SPACE), TUNED_PASSES)
+
+
+def random_candidate(rng):
+    pick = lambda space: {name: rng.choice(v) for name, v in space.items()}
+    order = rng.choice(list(itertools.permutations(TUNED_PASSES)))
+    return Candidate(pick(UNROLL_SPACE), pick(FOLD_SPACE), pick(CSE_SPACE),
+                     order)
+
+
+def run(cmd, **kwargs):
+    return subprocess.run(cmd, check=True, capture_output=True, text=True,
+                          **kwargs)
+
+
+class Tuner:
+    def __init__(self, args, work_dir):
+        self.args = args
+        self.work_dir = work_dir
+        self.unoptimized = os.path.join(work_dir, "unoptimized.ll")
+        self.binaries = {}  # config text -> binary, for repeated candidates
+
+    def prepare(self):
+        # -disable-O0-optnone keeps clang from tagging every function
+        # optnone, which would make the pass manager skip our passes
+        run(["clang", "-O0", "-Xclang", "-disable-O0-optnone", "-emit-llvm",
+             "-S", self.args.source, "-o", self.unoptimized])
+
+    def build(self, candidate, index):
+        config = candidate.config()
+        if config in self.binaries:
+            candidate.binary = self.binaries[config]
+            return
+
+        base = os.path.join(self.work_dir, "candidate%d" % index)
+        with open(base + ".cfg", "w") as f:
+            f.write(config)
+        try:
+            run(["opt", "-load=" + self.args.plugin,
+                 "-load-pass-plugin=" + self.args.plugin,
+                 "-passes=custom-optimize",
+                 "-custom-optimize-config=" + base + ".cfg",
+                 self.unoptimized, "-o", base + ".bc"])
+            run(["llc", "-O1", "-filetype=obj", base + ".bc",
+                 "-o", base + ".o"])
+            run(["clang", base + ".o", "-o", base, "-lm"])
+        except subprocess.CalledProcessError as e:
+            print("  candidate %d failed to build: %s"
+                  % (index, e.stderr.strip().splitlines()[-1:]),
+                  file=sys.stderr)
+            candidate.failed = True
+            return
+        candidate.binary = base
+        self.binaries[config] = base
+
+    def measure(self, candidate, repetitions):
+        while len(candidate.samples) < repetitions and not candidate.failed:
+            try:
+                output = run([candidate.binary],
+                             timeout=self.args.timeout).stdout
+            except (subprocess.CalledProcessError,
+                    subprocess.TimeoutExpired):
+                candidate.failed = True
+                break
+            match = re.search(r"completed in ([0-9.]+)", output)
+            if not match:
+                candidate.failed = True
+                break
+            candidate.samples.append(float(match.group(1)))
+
+
+def report(candidates, title):
+    print(title)
+    for c in sorted(candidates, key=Candidate.mean):
+        if c.failed:
+            continue
+        print("  %.4fs +/- %.4fs (n=%d)  %s"
+              % (c.mean(), c.interval(), len(c.samples),
+                 " -> ".join(c.order)))
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Tune the custom-optimize function pipeline")
+    parser.add_argument("plugin", help="path to LLVMOptPasses.so")
+    parser.add_argument("-o", "--output", default="tuned.cfg",
+                        help="config file to write (default: tuned.cfg)")
+    parser.add_argument("--source",
+                        default=os.path.join(TEST_DIR, "benchmark.c"),
+                        help="benchmark printing 'completed in <seconds>'")
+    parser.add_argument("--candidates", type=int, default=16,
+                        help="candidates in the first round, including "
+                             "the default pipeline (default: 16)")
+    parser.add_argument("--eta", type=int, default=2,
+                        help="fraction kept and repetition growth per "
+                             "round (default: 2)")
+    parser.add_argument("--repetitions", type=int, default=3,
+                        help="repetitions in the first round (default: 3)")
+    parser.add_argument("--timeout", type=float, default=60,
+                        help="seconds before a run counts as failed")
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--keep", action="store_true",
+                        help="keep the work directory")
+    args = parser.parse_args()
+
+    if args.eta < 2 or args.candidates < 2 or args.repetitions < 2:
+        parser.error("--eta, --candidates and --repetitions must be >= 2")
+    for tool in ("clang", "opt", "llc"):
+        if shutil.which(tool) is None:
+            sys.exit("Error: '%s' not found in PATH" % tool)
+    if not os.path.isfile(args.plugin):
+        sys.exit("Error: plugin not found at %s" % args.plugin)
+
+    rng = random.Random(args.seed)
+    default = default_candidate()
+    candidates = [default] + [random_candidate(rng)
+                              for _ in range(args.candidates - 1)]
+
+    work_dir = tempfile.mkdtemp(prefix="autotune-")
+    tuner = Tuner(args, work_dir)
+    try:
+        tuner.prepare()
+        for i, c in enumerate(candidates):
+            tuner.build(c, i)
+
+        # Successive halving; the default is always timed alongside the
+        # survivors, so the final comparison has as many samples for both
+        survivors = [c for c in candidates if not c.failed]
+        repetitions = args.repetitions
+        round_number = 1
+        while True:
+            for c in set(survivors) | {default}:
+                tuner.measure(c, repetitions)
+            survivors = sorted((c for c in survivors if not c.failed),
+                               key=Candidate.mean)
+            report(survivors, "Round %d (%d repetitions):"
+                   % (round_number, repetitions))
+            if len(survivors) <= 1:
+                break
+            survivors = survivors[:math.ceil(len(survivors) / args.eta)]
+            repetitions *= args.eta
+            round_number += 1
+
+        if default.failed:
+            sys.exit("Error: the default pipeline failed to build or run")
+        best = survivors[0] if survivors else default
+        significant = (best is not default and
+                       best.mean() + best.interval() <
+                       default.mean() - default.interval())
+        chosen = best if significant else default
+
+        print("")
+        print("Default: %.4fs +/- %.4fs" % (default.mean(),
+                                             default.interval()))
+        print("Best:    %.4fs +/- %.4fs" % (best.mean(), best.interval()))
+        if not significant:
+            print("The best candidate is not significantly faster; "
+                  "writing the default pipeline")
+
+        with open(args.output, "w") as f:
+            f.write("# custom-optimize function pipeline, tuned by "
+                    "autotune.py on %s\n" % time.strftime("%Y-%m-%d"))
+            f.write("# Benchmark: %s\n" % os.path.basename(args.source))
+            f.write("# Runtime: %.4fs +/- %.4fs (95%% CI, n=%d); "
+                    "default %.4fs +/- %.4fs\n"
+                    % (chosen.mean(), chosen.interval(), len(chosen.samples),
+                       default.mean(), default.interval()))
+            f.write(chosen.config())
+        print("Wrote %s" % args.output)
+    finally:
+        if args.keep:
+            print("Work directory: %s" % work_dir)
+        else:
+            shutil.rmtree(work_dir, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main()
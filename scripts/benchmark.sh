@@ -57,11 +57,13 @@ echo -e "${BLUE}Step 2: Compiling with custom passes${NC}"
 echo "----------------------------------------"
 
 # With custom passes: -O0 to IR, then custom passes, then codegen
-clang -O0 -emit-llvm -S "${TEST_DIR}/benchmark.c" -o unoptimized.ll
+# -disable-O0-optnone keeps clang from tagging every function optnone, which
+# would make the pass manager skip our passes entirely
+clang -O0 -Xclang -disable-O0-optnone -emit-llvm -S "${TEST_DIR}/benchmark.c" -o unoptimized.ll
 
-# Run custom passes
+# Run custom passes (alloca promotion first: -O0 keeps every local in memory)
 opt -load-pass-plugin="${PLUGIN_PATH}" \
-    -passes="custom-constant-fold,custom-redundancy-elim,custom-loop-unroll" \
+    -passes="custom-alloca-promote,custom-constant-fold,custom-redundancy-elim,custom-loop-unroll" \
     unoptimized.ll -S -o custom_optimized.ll
 
 # Generate code
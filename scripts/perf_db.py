@@ -0,0 +1,413 @@
+#!/usr/bin/env python3
+#
+# perf_db.py - Keep benchmark results per revision and compare revisions
+#
+# Usage: ./perf_db.py record [--label L] RESULTS.json...
+#        ./perf_db.py list
+#        ./perf_db.py compare [--threshold PCT] BASE_REV NEW_REV
+#
+# record stores the JSON of runtime_bench.py (kernel times, hardware
+# counters, code size) and of pass-bench -format=json (compile time per
+# instruction, peak memory) in a SQLite database (perf.db by default),
+# together with the git revision of the tree, whether it had uncommitted
+# changes, the machine, the toolchain, and the benchmark settings.
+#
+# compare pools every recorded run of each revision on one machine and
+# label (REV+dirty names the runs of REV with uncommitted changes, so work
+# in progress can be compared with HEAD) and checks each metric for a
+# regression: a change of the median by more than --threshold percent in
+# the worse direction (higher is worse for all metrics) that is also
+# significant. A metric with at least MIN_TEST_SAMPLES observations on
+# both sides gets a two-sided Mann-Whitney U test, and the p-values of all
+# metrics are adjusted for multiple comparisons (Benjamini-Hochberg); with
+# fewer, e.g. the code size of a single run, which is deterministic, the
+# threshold alone decides. compare exits with status 1 when it finds a
+# regression, so it can gate an upgrade of the plugin or of LLVM:
+#
+#   ./runtime_bench.py old/LLVMOptPasses.so -o old.json   # at the old rev
+#   ./perf_db.py record old.json
+#   ./runtime_bench.py new/LLVMOptPasses.so -o new.json   # at the new rev
+#   ./perf_db.py record new.json
+#   ./perf_db.py compare OLD_REV NEW_REV
+#
+
+import argparse
+import datetime
+import json
+import math
+import os
+import sqlite3
+import statistics
+import subprocess
+import sys
+
+from runtime_bench import machine_info
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+REPO_DIR = os.path.join(SCRIPT_DIR, "..")
+
+# Below this many observations per side the U test has no power at the
+# adjusted significance levels; such metrics are compared by threshold
+MIN_TEST_SAMPLES = 5
+
+SCHEMA = """
+CREATE TABLE IF NOT EXISTS runs (
+    id INTEGER PRIMARY KEY,
+    revision TEXT NOT NULL,
+    dirty INTEGER NOT NULL,
+    date TEXT NOT NULL,
+    kind TEXT NOT NULL,
+    label TEXT NOT NULL,
+    machine TEXT NOT NULL,
+    machine_info TEXT NOT NULL,
+    toolchain TEXT,
+    settings TEXT,
+    source TEXT
+);
+CREATE TABLE IF NOT EXISTS results (
+    run_id INTEGER NOT NULL REFERENCES runs(id),
+    benchmark TEXT NOT NULL,
+    metric TEXT NOT NULL,
+    value REAL NOT NULL,
+    samples TEXT
+);
+CREATE INDEX IF NOT EXISTS results_run ON results(run_id);
+"""
+
+
+def run(cmd, **kwargs):
+    return subprocess.run(cmd, check=True, capture_output=True, text=True,
+                          **kwargs)
+
+
+def git(*args):
+    try:
+        return run(["git", "-C", REPO_DIR] + list(args)).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def machine_key(info):
+    return "%s (%s)" % (info.get("hostname"), info.get("cpu"))
+
+
+def open_db(path):
+    db = sqlite3.connect(path)
+    db.executescript(SCHEMA)
+    return db
+
+
+#===------------------------------------------------------------------------===#
+# Reading results
+#===------------------------------------------------------------------------===#
+
+def runtime_results(data):
+    """(benchmark, metric, value, samples) of runtime_bench.py JSON"""
+    for kernel, result in data["kernels"].items():
+        for config, summary in result["configs"].items():
+            name = "runtime/%s/%s" % (kernel, config)
+            yield (name, "time_ns", summary["median_ns"],
+                   summary.get("samples_ns"))
+            for counter in ("cycles", "instructions", "branch_misses",
+                            "cache_misses"):
+                if summary.get(counter) is not None:
+                    yield name, counter, summary[counter], None
+    for config, size in data.get("code_size", {}).items():
+        if size is not None:
+            yield "code-size/%s" % config, "text_bytes", size, None
+
+
+def compile_results(data):
+    """(benchmark, metric, value, samples) of pass-bench JSON"""
+    for point in data:
+        for name, key in ((point["benchmark"], "pass"),
+                          (point["upstream"], "upstream_pass")):
+            measurement = point[key]
+            if not measurement["completed"]:
+                continue
+            benchmark = "compile/%s/%d" % (name, point["instructions"])
+            yield (benchmark, "ns_per_inst", measurement["ns_per_inst"],
+                   measurement.get("samples_ns_per_inst"))
+            if measurement["peak_bytes"]:
+                yield (benchmark, "peak_bytes", measurement["peak_bytes"],
+                       None)
+
+
+def toolchain():
+    try:
+        return run(["opt", "--version"]).stdout.strip().splitlines()[-1]
+    except (OSError, subprocess.CalledProcessError, IndexError):
+        return None
+
+
+def record(args):
+    revision = args.revision or git("rev-parse", "HEAD")
+    if revision is None:
+        sys.exit("Error: not in a git checkout; pass --revision")
+    if args.revision:
+        dirty = False
+    else:
+        dirty = bool(git("status", "--porcelain", "--untracked-files=no"))
+        if dirty:
+            print("Warning: the tree has uncommitted changes; the runs are "
+                  "recorded as %s+dirty" % revision[:12], file=sys.stderr)
+
+    db = open_db(args.db)
+    for path in args.results:
+        with open(path) as f:
+            data = json.load(f)
+        if isinstance(data, list):
+            kind, rows = "compile", list(compile_results(data))
+            info, tools, settings = machine_info(), toolchain(), None
+            date = datetime.datetime.fromtimestamp(
+                os.path.getmtime(path)).isoformat(timespec="seconds")
+        elif isinstance(data, dict) and "kernels" in data:
+            kind, rows = "runtime", list(runtime_results(data))
+            info, tools = data["machine"], data.get("clang")
+            # The baseline plugin is a path, which differs between checkouts
+            settings = {k: v for k, v in data.get("settings", {}).items()
+                        if k != "baseline_plugin"}
+            settings = json.dumps(settings, sort_keys=True)
+            date = data["date"]
+        else:
+            sys.exit("Error: %s is neither runtime_bench.py nor pass-bench "
+                     "JSON" % path)
+        if not rows:
+            sys.exit("Error: %s has no results" % path)
+
+        cursor = db.execute(
+            "INSERT INTO runs (revision, dirty, date, kind, label, machine,"
+            " machine_info, toolchain, settings, source)"
+            " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+            (revision, int(dirty), date, kind, args.label,
+             machine_key(info), json.dumps(info, sort_keys=True), tools,
+             settings, os.path.abspath(path)))
+        db.executemany(
+            "INSERT INTO results (run_id, benchmark, metric, value, samples)"
+            " VALUES (?, ?, ?, ?, ?)",
+            [(cursor.lastrowid, benchmark, metric, value,
+              json.dumps(samples) if samples else None)
+             for benchmark, metric, value, samples in rows])
+        print("Recorded %s: %d %s results for %s%s" % (
+            path, len(rows), kind, revision[:12], "+dirty" if dirty else ""))
+    db.commit()
+
+
+def list_runs(args):
+    db = open_db(args.db)
+    rows = db.execute(
+        "SELECT runs.id, date, revision, dirty, kind, label, machine,"
+        " COUNT(results.run_id) FROM runs"
+        " LEFT JOIN results ON results.run_id = runs.id"
+        " GROUP BY runs.id ORDER BY date, runs.id").fetchall()
+    print("%5s  %-19s  %-18s  %-8s  %-10s  %7s  %s"
+          % ("Run", "Date", "Revision", "Kind", "Label", "Results",
+             "Machine"))
+    for run_id, date, revision, dirty, kind, label, machine, count in rows:
+        print("%5d  %-19s  %-18s  %-8s  %-10s  %7d  %s"
+              % (run_id, date, revision[:12] + ("+dirty" if dirty else ""),
+                 kind, label, count, machine))
+
+
+#===------------------------------------------------------------------------===#
+# Statistics
+#===------------------------------------------------------------------------===#
+
+def mann_whitney(a, b):
+    """Two-sided p-value of the Mann-Whitney U test, normal approximation
+    with tie and continuity corrections"""
+    values = sorted([(v, 0) for v in a] + [(v, 1) for v in b])
+    n = len(values)
+    ranks = [0.0] * n
+    tie_term = 0
+    i = 0
+    while i < n:
+        j = i
+        while j + 1 < n and values[j + 1][0] == values[i][0]:
+            j += 1
+        for k in range(i, j + 1):
+            ranks[k] = (i + j) / 2 + 1
+        t = j - i + 1
+        tie_term += t ** 3 - t
+        i = j + 1
+    n_a, n_b = len(a), len(b)
+    rank_sum = sum(r for r, (_, side) in zip(ranks, values) if side == 0)
+    u = rank_sum - n_a * (n_a + 1) / 2
+    mean = n_a * n_b / 2
+    variance = n_a * n_b / 12 * ((n + 1) - tie_term / (n * (n - 1)))
+    if variance <= 0:
+        return 1.0
+    z = max(abs(u - mean) - 0.5, 0) / math.sqrt(variance)
+    return math.erfc(z / math.sqrt(2))
+
+
+def benjamini_hochberg(p_values):
+    """p-values adjusted to control the false discovery rate"""
+    order = sorted(range(len(p_values)), key=lambda i: p_values[i])
+    adjusted = [1.0] * len(p_values)
+    smallest = 1.0
+    for rank in range(len(order), 0, -1):
+        i = order[rank - 1]
+        smallest = min(smallest, p_values[i] * len(p_values) / rank)
+        adjusted[i] = smallest
+    return adjusted
+
+
+#===------------------------------------------------------------------------===#
+# Comparing revisions
+#===------------------------------------------------------------------------===#
+
+def resolve(db, rev):
+    """(recorded revision, dirty) for a git revision or a prefix of one,
+    with +dirty for the runs of a modified tree"""
+    dirty = rev.endswith("+dirty")
+    if dirty:
+        rev = rev[:-len("+dirty")]
+    full = git("rev-parse", "--verify", "--quiet", rev + "^{commit}")
+    candidates = {r for (r,) in db.execute(
+        "SELECT DISTINCT revision FROM runs WHERE revision LIKE ?"
+        " AND dirty = ?", ((full or rev) + "%", int(dirty)))}
+    if not candidates:
+        sys.exit("Error: no runs recorded for %s" % rev)
+    if len(candidates) > 1:
+        sys.exit("Error: %s is ambiguous: %s"
+                 % (rev, ", ".join(sorted(c[:12] for c in candidates))))
+    return candidates.pop(), dirty
+
+
+def observations(db, revision, dirty, args):
+    """Pooled observations per (benchmark, metric), and the settings of the
+    runs they come from"""
+    query = ("SELECT runs.id, settings FROM runs WHERE revision = ?"
+             " AND dirty = ? AND label = ?")
+    params = [revision, int(dirty), args.label]
+    if args.machine != "any":
+        query += " AND machine = ?"
+        params.append(args.machine)
+    runs = db.execute(query, params).fetchall()
+    pooled = {}
+    for run_id, _ in runs:
+        for benchmark, metric, value, samples in db.execute(
+                "SELECT benchmark, metric, value, samples FROM results"
+                " WHERE run_id = ?", (run_id,)):
+            values = json.loads(samples) if samples else [value]
+            pooled.setdefault((benchmark, metric), []).extend(values)
+    return pooled, {s for _, s in runs if s is not None}
+
+
+def compare(args):
+    db = open_db(args.db)
+    if args.machine is None:
+        args.machine = machine_key(machine_info())
+    base_rev, base_dirty = resolve(db, args.base)
+    new_rev, new_dirty = resolve(db, args.new)
+    base_name = base_rev[:12] + ("+dirty" if base_dirty else "")
+    new_name = new_rev[:12] + ("+dirty" if new_dirty else "")
+    base, base_settings = observations(db, base_rev, base_dirty, args)
+    new, new_settings = observations(db, new_rev, new_dirty, args)
+    if not base or not new:
+        sys.exit("Error: no runs of %s on %s with label '%s'" % (
+            base_name if not base else new_name, args.machine, args.label))
+    if base_settings != new_settings:
+        print("Warning: the revisions were benchmarked with different "
+              "settings", file=sys.stderr)
+
+    keys = sorted(set(base) & set(new))
+    tested = [k for k in keys if min(len(base[k]), len(new[k])) >=
+              MIN_TEST_SAMPLES]
+    adjusted = dict(zip(tested, benjamini_hochberg(
+        [mann_whitney(base[k], new[k]) for k in tested])))
+
+    rows = []
+    for key in keys:
+        before = statistics.median(base[key])
+        after = statistics.median(new[key])
+        if before == 0:
+            change = 0.0 if after == 0 else math.inf
+        else:
+            change = (after / before - 1) * 100
+        p = adjusted.get(key)
+        significant = p is None or p < args.alpha
+        if significant and change > args.threshold:
+            verdict = "regression"
+        elif significant and change < -args.threshold:
+            verdict = "improvement"
+        else:
+            verdict = None
+        rows.append((key, before, after, change, p, verdict))
+
+    print("Comparing %s (base) with %s on %s, label '%s'"
+          % (base_name, new_name, args.machine, args.label))
+    print("%-44s %-14s %14s %14s %9s %9s"
+          % ("Benchmark", "Metric", "Base", "New", "Change", "p"))
+    for (benchmark, metric), before, after, change, p, verdict in rows:
+        if verdict is None and not args.all:
+            continue
+        print(("%-44s %-14s %14.6g %14.6g %+8.2f%% %9s  %s"
+               % (benchmark, metric, before, after, change,
+                  "%.2g" % p if p is not None else "-",
+                  verdict.upper() if verdict == "regression"
+                  else verdict or "")).rstrip())
+    regressions = sum(1 for row in rows if row[5] == "regression")
+    improvements = sum(1 for row in rows if row[5] == "improvement")
+    print("%d metrics: %d regressions, %d improvements beyond %.1f%% "
+          "(adjusted p < %g; '-' = too few samples to test)"
+          % (len(rows), regressions, improvements, args.threshold,
+             args.alpha))
+    for label, only in (("base", set(base) - set(new)),
+                        ("new", set(new) - set(base))):
+        if only:
+            print("Only in %s: %s" % (label, ", ".join(
+                sorted("%s:%s" % k for k in only))))
+    if regressions:
+        sys.exit(1)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Keep benchmark results per revision and compare "
+                    "revisions")
+    parser.add_argument("--db", default="perf.db",
+                        help="SQLite database (default: perf.db)")
+    parser.add_argument("--label", default="default",
+                        help="name of the benchmark setup, e.g. the LLVM "
+                             "version; only equal labels are compared "
+                             "(default: default)")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    record_parser = commands.add_parser(
+        "record", help="store runtime_bench.py or pass-bench JSON")
+    record_parser.add_argument("results", nargs="+", help="JSON files")
+    record_parser.add_argument("--revision",
+                               help="revision the results belong to "
+                                    "(default: HEAD of this checkout)")
+    record_parser.set_defaults(func=record)
+
+    list_parser = commands.add_parser("list", help="list recorded runs")
+    list_parser.set_defaults(func=list_runs)
+
+    compare_parser = commands.add_parser(
+        "compare", help="flag regressions of NEW against BASE")
+    compare_parser.add_argument("base", help="baseline revision")
+    compare_parser.add_argument("new", help="revision to check")
+    compare_parser.add_argument("--threshold", type=float, default=2.0,
+                                help="smallest change in percent that "
+                                     "counts (default: 2)")
+    compare_parser.add_argument("--alpha", type=float, default=0.05,
+                                help="significance level after adjustment "
+                                     "(default: 0.05)")
+    compare_parser.add_argument("--machine",
+                                help="machine of the runs, as shown by "
+                                     "list, or 'any' (default: this one)")
+    compare_parser.add_argument("--all", action="store_true",
+                                help="show unchanged metrics too")
+    compare_parser.set_defaults(func=compare)
+
+    args = parser.parse_args()
+    if getattr(args, "threshold", 0) < 0:
+        parser.error("--threshold must be >= 0")
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
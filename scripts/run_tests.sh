@@ -62,12 +62,24 @@ run_test() {
     fi
 }
 
+echo "----------------------------------------"
+echo "Alloca Promotion Tests"
+echo "----------------------------------------"
+
+if [ -f "${TEST_DIR}/alloca_promotion.ll" ]; then
+    run_test "Alloca Promotion" "${TEST_DIR}/alloca_promotion.ll" "custom-alloca-promote" "SROA and mem2reg"
+else
+    echo -e "${YELLOW}Warning: alloca_promotion.ll not found${NC}"
+fi
+
+echo ""
 echo "----------------------------------------"
 echo "Constant Folding Tests"
 echo "----------------------------------------"
 
 if [ -f "${TEST_DIR}/constant_folding.ll" ]; then
     run_test "Constant Folding Basic" "${TEST_DIR}/constant_folding.ll" "custom-constant-fold" "Basic constant folding operations"
+    run_test "Constant Folding Parameters" "${TEST_DIR}/constant_folding.ll" "custom-constant-fold<max-iterations=1>" "Single folding sweep"
 else
     echo -e "${YELLOW}Warning: constant_folding.ll not found${NC}"
 fi
@@ -79,6 +91,7 @@ echo "----------------------------------------"
 
 if [ -f "${TEST_DIR}/loop_unrolling.ll" ]; then
     run_test "Loop Unrolling Basic" "${TEST_DIR}/loop_unrolling.ll" "custom-loop-unroll" "Basic loop unrolling"
+    run_test "Loop Unrolling Parameters" "${TEST_DIR}/loop_unrolling.ll" "custom-loop-unroll<full-max=16;partial=8;no-runtime;max-size=800>" "Parameterized loop unrolling"
 else
     echo -e "${YELLOW}Warning: loop_unrolling.ll not found${NC}"
 fi
@@ -91,10 +104,158 @@ echo "----------------------------------------"
 if [ -f "${TEST_DIR}/redundancy_elimination.ll" ]; then
     run_test "Redundancy Analysis" "${TEST_DIR}/redundancy_elimination.ll" "print<custom-redundancy>" "Redundancy analysis output"
     run_test "Redundancy Elimination" "${TEST_DIR}/redundancy_elimination.ll" "custom-redundancy-elim" "Redundancy elimination"
+    run_test "Redundancy Elimination Load CSE" "${TEST_DIR}/redundancy_elimination.ll" "custom-redundancy-elim<load-cse>" "Redundancy elimination with loads"
 else
     echo -e "${YELLOW}Warning: redundancy_elimination.ll not found${NC}"
 fi
 
+echo ""
+echo "----------------------------------------"
+echo "Dead Store Elimination Tests"
+echo "----------------------------------------"
+
+if [ -f "${TEST_DIR}/dead_store_elimination.ll" ]; then
+    run_test "Dead Store Elimination" "${TEST_DIR}/dead_store_elimination.ll" "custom-dse" "Dead Store Elimination"
+else
+    echo -e "${YELLOW}Warning: dead_store_elimination.ll not found${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Store Forwarding Tests"
+echo "----------------------------------------"
+
+if [ -f "${TEST_DIR}/store_forwarding.ll" ]; then
+    run_test "Store Forwarding" "${TEST_DIR}/store_forwarding.ll" "custom-store-forward" "Store Forwarding"
+else
+    echo -e "${YELLOW}Warning: store_forwarding.ll not found${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Loop Scalar Promotion Tests"
+echo "----------------------------------------"
+
+if [ -f "${TEST_DIR}/loop_scalar_promotion.ll" ]; then
+    run_test "Loop Scalar Promotion" "${TEST_DIR}/loop_scalar_promotion.ll" "custom-scalar-promote" "Loop Scalar Promotion"
+else
+    echo -e "${YELLOW}Warning: loop_scalar_promotion.ll not found${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Jump Threading Tests"
+echo "----------------------------------------"
+
+if [ -f "${TEST_DIR}/jump_threading.ll" ]; then
+    run_test "Jump Threading" "${TEST_DIR}/jump_threading.ll" "custom-jump-thread" "Jump Threading"
+else
+    echo -e "${YELLOW}Warning: jump_threading.ll not found${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Reassociation Tests"
+echo "----------------------------------------"
+
+if [ -f "${TEST_DIR}/reassociation.ll" ]; then
+    run_test "Reassociation" "${TEST_DIR}/reassociation.ll" "custom-reassociate" "Reassociation"
+else
+    echo -e "${YELLOW}Warning: reassociation.ll not found${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Polynomial Rewriting Tests"
+echo "----------------------------------------"
+
+if [ -f "${TEST_DIR}/polynomial_rewrite.ll" ]; then
+    run_test "Polynomial Rewriting" "${TEST_DIR}/polynomial_rewrite.ll" "custom-poly-rewrite" "Polynomial Rewriting"
+else
+    echo -e "${YELLOW}Warning: polynomial_rewrite.ll not found${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Invariant Division Tests"
+echo "----------------------------------------"
+
+if [ -f "${TEST_DIR}/invariant_division.ll" ]; then
+    run_test "Invariant Division" "${TEST_DIR}/invariant_division.ll" "custom-invariant-div" "Invariant Division"
+else
+    echo -e "${YELLOW}Warning: invariant_division.ll not found${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Inlining Tests"
+echo "----------------------------------------"
+
+if [ -f "${TEST_DIR}/inlining.ll" ]; then
+    run_test "Inlining" "${TEST_DIR}/inlining.ll" "custom-inline" "Inlining"
+else
+    echo -e "${YELLOW}Warning: inlining.ll not found${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Argument Specialization Tests"
+echo "----------------------------------------"
+
+if [ -f "${TEST_DIR}/argument_specialization.ll" ]; then
+    run_test "Argument Specialization" "${TEST_DIR}/argument_specialization.ll" "custom-specialize" "Argument Specialization"
+else
+    echo -e "${YELLOW}Warning: argument_specialization.ll not found${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Hot/Cold Splitting Tests"
+echo "----------------------------------------"
+
+if [ -f "${TEST_DIR}/cold_region_splitting.ll" ]; then
+    run_test "Hot/Cold Splitting" "${TEST_DIR}/cold_region_splitting.ll" "custom-hot-cold-split" "Hot/Cold Splitting"
+else
+    echo -e "${YELLOW}Warning: cold_region_splitting.ll not found${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Function Ordering Tests"
+echo "----------------------------------------"
+
+if [ -f "${TEST_DIR}/function_ordering.ll" ]; then
+    run_test "Function Ordering" "${TEST_DIR}/function_ordering.ll" "custom-function-order" "Function Ordering"
+else
+    echo -e "${YELLOW}Warning: function_ordering.ll not found${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Default Pipeline Tests"
+echo "----------------------------------------"
+
+if [ -f "${TEST_DIR}/default_pipeline.ll" ]; then
+    for level in O1 O2 O3 Os Oz; do
+        run_test "Default Pipeline ${level}" "${TEST_DIR}/default_pipeline.ll" "default<${level}>" "Extension points at ${level}"
+    done
+else
+    echo -e "${YELLOW}Warning: default_pipeline.ll not found${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "LTO Pipeline Tests"
+echo "----------------------------------------"
+
+if [ -f "${TEST_DIR}/lto_pipeline.ll" ]; then
+    for pipeline in "lto-pre-link<O2>" "lto<O2>" "thinlto-pre-link<O2>" "thinlto<O2>" "lto<Oz>"; do
+        run_test "LTO Pipeline ${pipeline}" "${TEST_DIR}/lto_pipeline.ll" "${pipeline}" "Extension points of ${pipeline}"
+    done
+else
+    echo -e "${YELLOW}Warning: lto_pipeline.ll not found${NC}"
+fi
+
 echo ""
 echo "----------------------------------------"
 echo "Combined Pipeline Tests"
@@ -104,6 +265,265 @@ if [ -f "${TEST_DIR}/constant_folding.ll" ]; then
     run_test "Combined Pipeline" "${TEST_DIR}/constant_folding.ll" "custom-optimize" "All passes combined"
 fi
 
+echo ""
+echo "----------------------------------------"
+echo "Pipeline Config Tests"
+echo "----------------------------------------"
+
+# The built-in order written as a config file must optimize identically
+if [ -f "${TEST_DIR}/inlining.ll" ]; then
+    echo -n "Testing Pipeline Config... "
+    CONFIG_FILE="$(mktemp)"
+    cat > "${CONFIG_FILE}" <<'CONFIG'
+# custom-optimize's built-in function pipeline
+custom-alloca-promote
+custom-constant-fold
+custom-jump-thread
+custom-scalar-promote
+custom-store-forward
+custom-reassociate
+custom-poly-rewrite
+custom-redundancy-elim
+custom-dse
+custom-invariant-div
+custom-loop-unroll<full-max=8;partial=4>
+CONFIG
+    expected=$(opt -load-pass-plugin="${PLUGIN_PATH}" -passes="custom-optimize" -S "${TEST_DIR}/inlining.ll" 2>/dev/null)
+    actual=$(opt -load="${PLUGIN_PATH}" -load-pass-plugin="${PLUGIN_PATH}" -passes="custom-optimize" -custom-optimize-config="${CONFIG_FILE}" -S "${TEST_DIR}/inlining.ll" 2>/dev/null)
+    if [ -n "${actual}" ] && [ "${actual}" == "${expected}" ]; then
+        echo -e "${GREEN}PASSED${NC}"
+        ((PASSED++))
+    else
+        echo -e "${RED}FAILED${NC}"
+        echo "  Command: opt -load=${PLUGIN_PATH} -load-pass-plugin=${PLUGIN_PATH} -passes=custom-optimize -custom-optimize-config=${CONFIG_FILE} -S ${TEST_DIR}/inlining.ll"
+        ((FAILED++))
+    fi
+    rm -f "${CONFIG_FILE}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Function Cache Tests"
+echo "----------------------------------------"
+
+# A warm cache must reproduce the cold run's output
+if [ -f "${TEST_DIR}/inlining.ll" ]; then
+    echo -n "Testing Function Cache... "
+    CACHE_DIR="$(mktemp -d)"
+    CACHE_OPT=(opt -load="${PLUGIN_PATH}" -load-pass-plugin="${PLUGIN_PATH}" -passes="custom-optimize" -custom-cache-dir="${CACHE_DIR}" -S "${TEST_DIR}/inlining.ll")
+    cold=$("${CACHE_OPT[@]}" 2>/dev/null)
+    warm=$("${CACHE_OPT[@]}" 2>/dev/null)
+    if [ -n "${cold}" ] && [ "${cold}" == "${warm}" ]; then
+        echo -e "${GREEN}PASSED${NC}"
+        ((PASSED++))
+    else
+        echo -e "${RED}FAILED${NC}"
+        echo "  Command: ${CACHE_OPT[*]}"
+        ((FAILED++))
+    fi
+    rm -rf "${CACHE_DIR}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Memory Profile Tests"
+echo "----------------------------------------"
+
+# The pass, and the analysis it requests, must get rows of their own
+HEAP_HOOK="$(dirname "${PLUGIN_PATH}")/LLVMOptPassesHeapHook.so"
+if [ -f "${HEAP_HOOK}" ] && [ -f "${TEST_DIR}/redundancy_elimination.ll" ]; then
+    echo -n "Testing Memory Profile... "
+    PROFILE_OPT=(opt -load="${PLUGIN_PATH}" -load-pass-plugin="${PLUGIN_PATH}" -passes="custom-redundancy-elim" -custom-memory-profile -disable-output "${TEST_DIR}/redundancy_elimination.ll")
+    profile=$(LD_PRELOAD="${HEAP_HOOK}" "${PROFILE_OPT[@]}" 2>&1 > /dev/null)
+    if grep -q "RedundancyEliminationPass$" <<< "${profile}" && \
+        grep -q "RedundancyAnalysis$" <<< "${profile}" && \
+        grep -q "High-water marks of the largest functions" <<< "${profile}"; then
+        echo -e "${GREEN}PASSED${NC}"
+        ((PASSED++))
+    else
+        echo -e "${RED}FAILED${NC}"
+        echo "  Command: LD_PRELOAD=${HEAP_HOOK} ${PROFILE_OPT[*]}"
+        ((FAILED++))
+    fi
+else
+    echo -e "${YELLOW}Warning: ${HEAP_HOOK} not found; skipping the memory profile${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Standalone Driver Tests"
+echo "----------------------------------------"
+
+# custom-opt links the same passes, so its output must match opt's
+DRIVER_PATH="$(dirname "${PLUGIN_PATH}")/tools/custom-opt/custom-opt"
+CLIENT_PATH="$(dirname "${PLUGIN_PATH}")/tools/custom-opt/custom-opt-client"
+
+run_driver_test() {
+    local test_name="$1"
+    local tool="$2"
+    local test_file="$3"
+    local opt_passes="$4"
+    shift 4
+    
+    echo -n "Testing ${test_name}... "
+    
+    local expected actual
+    expected=$(opt -load-pass-plugin="${PLUGIN_PATH}" -passes="${opt_passes}" -S "${test_file}" 2>/dev/null | grep -v '^; ModuleID')
+    actual=$("${tool}" "$@" -S "${test_file}" 2>/dev/null | grep -v '^; ModuleID')
+    
+    if [ -n "${actual}" ] && [ "${actual}" == "${expected}" ]; then
+        echo -e "${GREEN}PASSED${NC}"
+        ((PASSED++))
+    else
+        echo -e "${RED}FAILED${NC}"
+        echo "  Command: ${tool} $* -S ${test_file}"
+        ((FAILED++))
+    fi
+}
+
+if [ -x "${DRIVER_PATH}" ]; then
+    BITCODE_FILE="$(mktemp)"
+    opt "${TEST_DIR}/inlining.ll" -o "${BITCODE_FILE}"
+    run_driver_test "Driver Pipeline" "${DRIVER_PATH}" "${TEST_DIR}/inlining.ll" "custom-optimize"
+    run_driver_test "Driver Streaming" "${DRIVER_PATH}" "${BITCODE_FILE}" "function(custom-optimize)" -stream-functions
+
+    # The same requests through a compile server
+    if [ -x "${CLIENT_PATH}" ]; then
+        SOCKET_FILE="$(mktemp -u)"
+        "${DRIVER_PATH}" -serve -socket="${SOCKET_FILE}" -jobs=2 2>/dev/null &
+        SERVER_PID=$!
+        for _ in $(seq 50); do
+            [ -S "${SOCKET_FILE}" ] && break
+            sleep 0.1
+        done
+        run_driver_test "Server Pipeline" "${CLIENT_PATH}" "${TEST_DIR}/inlining.ll" "custom-optimize" -socket="${SOCKET_FILE}"
+        run_driver_test "Server Streaming" "${CLIENT_PATH}" "${BITCODE_FILE}" "function(custom-optimize)" -socket="${SOCKET_FILE}" -stream-functions
+        kill "${SERVER_PID}"
+        rm -f "${SOCKET_FILE}"
+    fi
+    rm -f "${BITCODE_FILE}"
+else
+    echo -e "${YELLOW}Warning: custom-opt not found at ${DRIVER_PATH}${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Compile-Time Benchmark Tests"
+echo "----------------------------------------"
+
+# Generated modules must verify and survive the passes, and be the same
+# for the same seed
+IRGEN_PATH="$(dirname "${PLUGIN_PATH}")/tools/ir-gen/ir-gen"
+
+if [ -x "${IRGEN_PATH}" ]; then
+    IRGEN_KNOBS=(
+        ""
+        "-preset=redundancy"
+        "-preset=loops -functions=3"
+        "-branch-width=6 -phi-fan-in=10 -branch-depth=5 -loop-depth=4"
+        "-redundant-percent=100 -constant-percent=100 -block-size=4"
+    )
+    for knobs in "${IRGEN_KNOBS[@]}"; do
+        echo -n "Testing ir-gen ${knobs:-(defaults)}... "
+        if "${IRGEN_PATH}" ${knobs} -function-size=5000 -seed=1 2>/dev/null | \
+            opt -load-pass-plugin="${PLUGIN_PATH}" -passes="verify,custom-redundancy-elim,custom-loop-unroll,verify" -disable-output 2>/dev/null; then
+            echo -e "${GREEN}PASSED${NC}"
+            ((PASSED++))
+        else
+            echo -e "${RED}FAILED${NC}"
+            echo "  Command: ${IRGEN_PATH} ${knobs} -function-size=5000 -seed=1 | opt -passes=verify,custom-redundancy-elim,custom-loop-unroll,verify"
+            ((FAILED++))
+        fi
+    done
+
+    echo -n "Testing ir-gen determinism... "
+    if cmp -s <("${IRGEN_PATH}" -S -seed=42) <("${IRGEN_PATH}" -S -seed=42) && \
+        ! cmp -s <("${IRGEN_PATH}" -S -seed=42) <("${IRGEN_PATH}" -S -seed=43); then
+        echo -e "${GREEN}PASSED${NC}"
+        ((PASSED++))
+    else
+        echo -e "${RED}FAILED${NC}"
+        echo "  Command: ${IRGEN_PATH} -S -seed=42 (twice, then -seed=43)"
+        ((FAILED++))
+    fi
+else
+    echo -e "${YELLOW}Warning: ir-gen not found at ${IRGEN_PATH}${NC}"
+fi
+
+# A small run of every benchmark must complete and report every point
+BENCH_PATH="$(dirname "${PLUGIN_PATH}")/tools/pass-bench/pass-bench"
+
+if [ -x "${BENCH_PATH}" ]; then
+    echo -n "Testing pass-bench... "
+    rows=$("${BENCH_PATH}" -min-instructions=500 -max-instructions=1000 -repetitions=1 -format=csv 2>/dev/null | tail -n +2)
+    if [ "$(echo "${rows}" | grep -c .)" -eq 8 ] && ! echo "${rows}" | grep -q ',,'; then
+        echo -e "${GREEN}PASSED${NC}"
+        ((PASSED++))
+    else
+        echo -e "${RED}FAILED${NC}"
+        echo "  Command: ${BENCH_PATH} -min-instructions=500 -max-instructions=1000 -repetitions=1 -format=csv"
+        ((FAILED++))
+    fi
+else
+    echo -e "${YELLOW}Warning: pass-bench not found at ${BENCH_PATH}${NC}"
+fi
+
+echo ""
+echo "----------------------------------------"
+echo "Runtime Harness Tests"
+echo "----------------------------------------"
+
+# The runtime harness must time a kernel and report its checksum
+if command -v clang &> /dev/null; then
+    echo -n "Testing runtime harness... "
+    HARNESS_BINARY=$(mktemp)
+    if clang -O1 "${SCRIPT_DIR}/../bench/kernels.c" "${SCRIPT_DIR}/../bench/harness.c" -o "${HARNESS_BINARY}" -lm 2>/dev/null && \
+        "${HARNESS_BINARY}" --kernel=crc32 --size=4096 --warmup=1 --repetitions=3 --min-time-us=0 | grep -q '"checksum":"00000000020241f8"'; then
+        echo -e "${GREEN}PASSED${NC}"
+        ((PASSED++))
+    else
+        echo -e "${RED}FAILED${NC}"
+        echo "  Command: ${HARNESS_BINARY} --kernel=crc32 --size=4096 --warmup=1 --repetitions=3 --min-time-us=0"
+        ((FAILED++))
+    fi
+    rm -f "${HARNESS_BINARY}"
+else
+    echo -e "${YELLOW}Warning: clang not found; skipping the runtime harness${NC}"
+fi
+
+# perf_db.py must flag a 10% slower, larger pass and accept an unchanged one
+if command -v python3 &> /dev/null; then
+    echo -n "Testing perf_db.py regression check... "
+    PERF_DIR=$(mktemp -d)
+    for REVISION in base:50 slow:55; do
+        python3 - "${PERF_DIR}/${REVISION%%:*}.json" "${REVISION##*:}" <<'EOF'
+import json, sys
+ns = float(sys.argv[2])
+measurement = {"completed": True, "ns_per_inst": ns,
+               "peak_bytes": int(ns * 1000),
+               "samples_ns_per_inst": [ns + i / 10 for i in range(10)]}
+json.dump([{"benchmark": "redundancy-elim", "upstream": "gvn",
+            "instructions": 1000, "pass": measurement,
+            "upstream_pass": measurement}], open(sys.argv[1], "w"))
+EOF
+    done
+    PERF_DB="${SCRIPT_DIR}/perf_db.py --db ${PERF_DIR}/perf.db"
+    if ${PERF_DB} record --revision base "${PERF_DIR}/base.json" > /dev/null && \
+        ${PERF_DB} record --revision slow "${PERF_DIR}/slow.json" > /dev/null && \
+        ${PERF_DB} compare --machine any base base > /dev/null && \
+        ! ${PERF_DB} compare --machine any base slow > /dev/null; then
+        echo -e "${GREEN}PASSED${NC}"
+        ((PASSED++))
+    else
+        echo -e "${RED}FAILED${NC}"
+        echo "  Command: ${PERF_DB} compare --machine any base slow"
+        ((FAILED++))
+    fi
+    rm -rf "${PERF_DIR}"
+else
+    echo -e "${YELLOW}Warning: python3 not found; skipping perf_db.py${NC}"
+fi
+
 echo ""
 echo "========================================"
 echo "Test Summary"
@@ -0,0 +1,413 @@
+#!/usr/bin/env python3
+#
+# runtime_bench.py - Time kernels built with custom-optimize and with -O1..-O3
+#
+# Usage: ./runtime_bench.py <path_to_plugin.so> [-o results.json] [options]
+#
+# The kernel source (bench/kernels.c by default) is compiled to IR once per
+# configuration: "custom" runs --passes (custom-optimize) on -O0 IR, "O1"..
+# "O3" are clang's own pipelines. All configurations then share llc -O2 and
+# the harness (bench/harness.c, always clang -O2), so differences come from
+# the middle end alone.
+#
+# To measure a pass change, build the plugin before and after it and pass
+# the old one as --baseline-plugin: it adds a "base" configuration running
+# the same --passes, and custom's speedup over it is the change's effect
+# on each kernel.
+#
+# Each kernel runs pinned to one core with warmups (see harness.c). The
+# configurations are run in a shuffled order within each of --rounds
+# rounds, so drift in machine state spreads over all of them, and the
+# samples of all rounds are pooled.
+#
+# Reported per kernel and configuration: the median time per run with a
+# distribution-free 95% confidence interval, and the median cycles,
+# instructions, branch misses and cache misses. Per baseline, the speedup
+# of custom (baseline median / custom median) gets a 95% bootstrap
+# confidence interval; it is significant when that interval excludes 1
+# and both sides have at least MIN_SIGNIFICANT_SAMPLES samples.
+#
+# The JSON also keeps the raw time samples and each configuration's code
+# size (.text bytes of the kernel object, from llvm-size), which
+# perf_db.py records and compares across revisions.
+#
+
+import argparse
+import datetime
+import json
+import math
+import os
+import platform
+import random
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+BENCH_DIR = os.path.join(SCRIPT_DIR, "..", "bench")
+
+COUNTERS = ("cycles", "instructions", "branch_misses", "cache_misses")
+BOOTSTRAP_RESAMPLES = 2000
+
+# Bootstrap intervals of fewer samples are too narrow to trust
+MIN_SIGNIFICANT_SAMPLES = 10
+Z_95 = 1.959964
+
+
+def run(cmd, **kwargs):
+    return subprocess.run(cmd, check=True, capture_output=True, text=True,
+                          **kwargs)
+
+
+#===------------------------------------------------------------------------===#
+# Statistics
+#===------------------------------------------------------------------------===#
+
+def median_interval(samples):
+    """95% confidence interval of the median from order statistics, which
+    assumes nothing about the distribution of the samples"""
+    values = sorted(samples)
+    n = len(values)
+    half_width = Z_95 * math.sqrt(n) / 2
+    lo = max(int(math.floor(n / 2 - half_width)), 0)
+    hi = min(int(math.ceil(n / 2 + half_width)), n - 1)
+    return values[lo], values[hi]
+
+
+def bootstrap_ratio(numerator, denominator, rng):
+    """95% percentile bootstrap interval of median(numerator) /
+    median(denominator)"""
+    ratios = []
+    for _ in range(BOOTSTRAP_RESAMPLES):
+        num = statistics.median(rng.choices(numerator, k=len(numerator)))
+        den = statistics.median(rng.choices(denominator,
+                                            k=len(denominator)))
+        ratios.append(num / den)
+    ratios.sort()
+    return (ratios[int(0.025 * len(ratios))],
+            ratios[int(0.975 * len(ratios)) - 1])
+
+
+def summarize(samples):
+    """Median and interval of the time, medians of the counters"""
+    ns = samples["ns"]
+    lo, hi = median_interval(ns)
+    result = {"median_ns": statistics.median(ns), "ci_ns": [lo, hi],
+              "samples": len(ns), "samples_ns": ns}
+    for counter in COUNTERS:
+        values = [v for v in samples[counter] if v is not None]
+        result[counter] = statistics.median(values) if values else None
+    if result["cycles"] and result["instructions"] is not None:
+        result["ipc"] = result["instructions"] / result["cycles"]
+    else:
+        result["ipc"] = None
+    return result
+
+
+#===------------------------------------------------------------------------===#
+# Machine
+#===------------------------------------------------------------------------===#
+
+def read_first(path, default=None):
+    try:
+        with open(path) as f:
+            return f.read().strip()
+    except OSError:
+        return default
+
+
+def cpu_model():
+    cpuinfo = read_first("/proc/cpuinfo", "")
+    for line in cpuinfo.splitlines():
+        if line.startswith("model name"):
+            return line.split(":", 1)[1].strip()
+    return platform.processor() or platform.machine()
+
+
+def machine_info():
+    return {
+        "hostname": platform.node(),
+        "cpu": cpu_model(),
+        "cores": os.cpu_count(),
+        "os": "%s %s" % (platform.system(), platform.release()),
+        "governor": read_first(
+            "/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor"),
+        "perf_event_paranoid": read_first(
+            "/proc/sys/kernel/perf_event_paranoid"),
+    }
+
+
+#===------------------------------------------------------------------------===#
+# Building and running
+#===------------------------------------------------------------------------===#
+
+def text_size(obj):
+    """Bytes of code in an object file, or None without llvm-size"""
+    if shutil.which("llvm-size") is None:
+        return None
+    total = 0
+    for line in run(["llvm-size", "-A", obj]).stdout.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0].startswith((".text", "__text")):
+            total += int(fields[1])
+    return total
+
+
+class Bench:
+    def __init__(self, args, work_dir):
+        self.args = args
+        self.work_dir = work_dir
+        self.harness = os.path.join(work_dir, "harness.o")
+        self.binaries = {}
+        self.code_size = {}
+        self.sizes = {}
+
+    def path(self, name):
+        return os.path.join(self.work_dir, name)
+
+    def build(self):
+        run(["clang", "-O2", "-c", os.path.join(BENCH_DIR, "harness.c"),
+             "-o", self.harness])
+        for config in self.args.configs:
+            ir = self.path(config + ".bc")
+            if config in ("custom", "base"):
+                # -disable-O0-optnone keeps clang from tagging every function
+                # optnone, which would make the pass manager skip our passes
+                unoptimized = self.path("unoptimized.bc")
+                run(["clang", "-O0", "-Xclang", "-disable-O0-optnone",
+                     "-emit-llvm", "-c", "-I", BENCH_DIR, self.args.source,
+                     "-o", unoptimized])
+                plugin = (self.args.plugin if config == "custom"
+                          else self.args.baseline_plugin)
+                run(["opt", "-load-pass-plugin=" + plugin,
+                     "-passes=" + self.args.passes, unoptimized, "-o", ir])
+            else:
+                run(["clang", "-" + config, "-emit-llvm", "-c", "-I",
+                     BENCH_DIR, self.args.source, "-o", ir])
+            obj = self.path(config + ".o")
+            run(["llc", "-O2", "-filetype=obj", "-relocation-model=pic", ir,
+                 "-o", obj])
+            self.code_size[config] = text_size(obj)
+            binary = self.path(config)
+            run(["clang", obj, self.harness, "-o", binary, "-lm"])
+            self.binaries[config] = binary
+
+    def kernels(self):
+        output = run([self.binaries[self.args.configs[0]], "--list"]).stdout
+        for line in output.splitlines():
+            name, size = line.split()
+            self.sizes[name] = max(int(int(size) * self.args.scale), 1)
+        names = list(self.sizes)
+        if self.args.kernel:
+            missing = set(self.args.kernel) - set(names)
+            if missing:
+                sys.exit("Error: no kernel named %s"
+                         % ", ".join(sorted(missing)))
+            names = [n for n in names if n in self.args.kernel]
+        return names
+
+    def measure(self, config, kernel):
+        cmd = [self.binaries[config], "--kernel=" + kernel,
+               "--warmup=%d" % self.args.warmup,
+               "--repetitions=%d" % self.args.repetitions,
+               "--min-time-us=%d" % self.args.min_time_us,
+               "--size=%d" % self.sizes[kernel]]
+        if self.args.cpu is not None:
+            cmd.append("--cpu=%d" % self.args.cpu)
+        return json.loads(run(cmd, timeout=self.args.timeout).stdout)
+
+
+def collect(bench, kernels, rng):
+    """Pooled samples and checksums per kernel and configuration"""
+    configs = bench.args.configs
+    samples = {k: {c: {"ns": [], **{n: [] for n in COUNTERS}}
+                   for c in configs} for k in kernels}
+    results = {k: {} for k in kernels}
+    for round_number in range(bench.args.rounds):
+        print("Round %d/%d" % (round_number + 1, bench.args.rounds),
+              file=sys.stderr)
+        for kernel in kernels:
+            for config in rng.sample(configs, len(configs)):
+                result = bench.measure(config, kernel)
+                results[kernel][config] = result
+                pooled = samples[kernel][config]
+                for name in pooled:
+                    values = result["samples"][name]
+                    pooled[name].extend(values if values is not None
+                                        else [None] * len(
+                                            result["samples"]["ns"]))
+    return samples, results
+
+
+#===------------------------------------------------------------------------===#
+# Report
+#===------------------------------------------------------------------------===#
+
+def report(kernels, configs, code_size):
+    baselines = [c for c in configs if c != "custom"]
+    print("%-16s %-8s %12s %22s %8s %s"
+          % ("Kernel", "Config", "Median ns", "95% CI", "IPC",
+             "  Speedup vs " + ", ".join(baselines) if baselines else ""))
+    for name, kernel in kernels.items():
+        for config in configs:
+            result = kernel["configs"][config]
+            line = "%-16s %-8s %12.1f %22s %8s" % (
+                name, config, result["median_ns"],
+                "[%.1f, %.1f]" % tuple(result["ci_ns"]),
+                "%.2f" % result["ipc"] if result["ipc"] else "-")
+            if config == "custom":
+                for baseline in baselines:
+                    speedup = kernel["speedup"][baseline]
+                    line += "  %.3fx [%.3f, %.3f]%s" % (
+                        speedup["ratio"], speedup["ci"][0], speedup["ci"][1],
+                        "*" if speedup["significant"] else "")
+            print(line)
+    if "custom" in configs and baselines:
+        print("Speedup: baseline median / custom median; * = 95%% CI "
+              "excludes 1 (n >= %d)" % MIN_SIGNIFICANT_SAMPLES)
+    if any(size is not None for size in code_size.values()):
+        print("Code size (.text bytes): " + ", ".join(
+            "%s %s" % (c, code_size[c] if code_size[c] is not None else "-")
+            for c in configs))
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Time kernels built with custom-optimize and -O1..-O3")
+    parser.add_argument("plugin", help="path to LLVMOptPasses.so")
+    parser.add_argument("-o", "--output", default="runtime_bench.json",
+                        help="JSON file to write (default: "
+                             "runtime_bench.json)")
+    parser.add_argument("--source",
+                        default=os.path.join(BENCH_DIR, "kernels.c"),
+                        help="kernel source using bench/harness.h")
+    parser.add_argument("--configs", default="custom,O1,O2,O3",
+                        help="comma-separated: custom, O0..O3, Os, Oz "
+                             "(default: custom,O1,O2,O3)")
+    parser.add_argument("--passes", default="custom-optimize",
+                        help="pipeline of the custom configuration "
+                             "(default: custom-optimize)")
+    parser.add_argument("--baseline-plugin",
+                        help="older plugin; adds a 'base' configuration "
+                             "running --passes with it")
+    parser.add_argument("--kernel", action="append",
+                        help="kernel to run (repeatable; default: all)")
+    parser.add_argument("--scale", type=float, default=1.0,
+                        help="factor on each kernel's default problem "
+                             "size (default: 1)")
+    parser.add_argument("--rounds", type=int, default=3,
+                        help="runs of each binary per kernel (default: 3)")
+    parser.add_argument("--repetitions", type=int, default=10,
+                        help="samples per run (default: 10)")
+    parser.add_argument("--warmup", type=int, default=5,
+                        help="untimed repetitions per run (default: 5)")
+    parser.add_argument("--min-time-us", type=int, default=10000,
+                        help="minimum time of one sample (default: 10000)")
+    parser.add_argument("--cpu", type=int,
+                        help="core to pin to (default: the one each run "
+                             "starts on; -1: unpinned)")
+    parser.add_argument("--timeout", type=float, default=300,
+                        help="seconds before a run fails")
+    parser.add_argument("--seed", type=int, default=0,
+                        help="seed of the run order and the bootstrap")
+    parser.add_argument("--keep", action="store_true",
+                        help="keep the work directory")
+    args = parser.parse_args()
+
+    args.configs = args.configs.split(",")
+    for config in args.configs:
+        if config != "custom" and config not in ("O0", "O1", "O2", "O3",
+                                                 "Os", "Oz"):
+            parser.error("unknown configuration '%s'" % config)
+    if args.baseline_plugin:
+        if "custom" not in args.configs:
+            parser.error("--baseline-plugin needs the custom configuration")
+        if not os.path.isfile(args.baseline_plugin):
+            sys.exit("Error: plugin not found at %s" % args.baseline_plugin)
+        args.configs.append("base")
+    if args.rounds < 1 or args.repetitions < 1:
+        parser.error("--rounds and --repetitions must be >= 1")
+    if args.scale <= 0:
+        parser.error("--scale must be positive")
+    for tool in ("clang", "opt", "llc"):
+        if shutil.which(tool) is None:
+            sys.exit("Error: '%s' not found in PATH" % tool)
+    if "custom" in args.configs and not os.path.isfile(args.plugin):
+        sys.exit("Error: plugin not found at %s" % args.plugin)
+
+    rng = random.Random(args.seed)
+    work_dir = tempfile.mkdtemp(prefix="runtime-bench-")
+    bench = Bench(args, work_dir)
+    try:
+        bench.build()
+        kernel_names = bench.kernels()
+        samples, last = collect(bench, kernel_names, rng)
+    except subprocess.CalledProcessError as e:
+        sys.exit("Error: %s failed:\n%s" % (e.cmd[0], e.stderr.strip()))
+    finally:
+        if args.keep:
+            print("Work directory: %s" % work_dir, file=sys.stderr)
+        else:
+            shutil.rmtree(work_dir, ignore_errors=True)
+
+    kernels = {}
+    mismatches = []
+    for name in kernel_names:
+        checksums = {last[name][c]["checksum"] for c in args.configs}
+        if len(checksums) > 1:
+            mismatches.append(name)
+        kernel = {
+            "size": last[name][args.configs[0]]["size"],
+            "checksum": sorted(checksums)[0],
+            "configs": {c: summarize(samples[name][c])
+                        for c in args.configs},
+            "speedup": {},
+        }
+        if "custom" in args.configs:
+            for baseline in args.configs:
+                if baseline == "custom":
+                    continue
+                base_ns = samples[name][baseline]["ns"]
+                custom_ns = samples[name]["custom"]["ns"]
+                lo, hi = bootstrap_ratio(base_ns, custom_ns, rng)
+                kernel["speedup"][baseline] = {
+                    "ratio": (statistics.median(base_ns) /
+                              statistics.median(custom_ns)),
+                    "ci": [lo, hi],
+                    "significant": ((lo > 1 or hi < 1) and
+                                    min(len(base_ns), len(custom_ns)) >=
+                                    MIN_SIGNIFICANT_SAMPLES),
+                }
+        kernels[name] = kernel
+
+    results = {
+        "date": datetime.datetime.now().isoformat(timespec="seconds"),
+        "machine": machine_info(),
+        "clang": run(["clang", "--version"]).stdout.splitlines()[0],
+        "source": os.path.relpath(args.source),
+        "settings": {"configs": args.configs, "passes": args.passes,
+                     "baseline_plugin": args.baseline_plugin,
+                     "rounds": args.rounds,
+                     "repetitions": args.repetitions,
+                     "warmup": args.warmup,
+                     "min_time_us": args.min_time_us, "cpu": args.cpu,
+                     "scale": args.scale,
+                     "seed": args.seed},
+        "code_size": bench.code_size,
+        "kernels": kernels,
+    }
+    with open(args.output, "w") as f:
+        json.dump(results, f, indent=2)
+        f.write("\n")
+
+    report(kernels, args.configs, bench.code_size)
+    print("Wrote %s" % args.output)
+    if mismatches:
+        sys.exit("Error: checksums differ between configurations for %s"
+                 % ", ".join(mismatches))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,286 @@
+//===- AllocaPromotionPass.cpp - SSA Construction ---------------*- C++ -*-===//
+//
+// Two phases: scalar replacement of aggregates splits struct/array allocas
+// that are only addressed with constant indices into per-element allocas
+// (worklist driven, so nested aggregates are split recursively), then
+// PromoteMemToReg rewrites every promotable alloca into SSA form.
+//
+//===----------------------------------------------------------------------===//
+
+#include "AllocaPromotionPass.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
+#include "llvm/Support/Debug.h"
+
+#define DEBUG_TYPE "alloca-promotion"
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+/// Number of top-level elements of an aggregate type (0 for scalars)
+static unsigned getNumAggregateElements(Type *Ty) {
+    if (auto *ST = dyn_cast<StructType>(Ty)) {
+        return ST->isOpaque() ? 0 : ST->getNumElements();
+    }
+    if (auto *AT = dyn_cast<ArrayType>(Ty)) {
+        return AT->getNumElements();
+    }
+    return 0;
+}
+
+/// Type of a top-level element of an aggregate type
+static Type *getAggregateElementType(Type *Ty, unsigned Index) {
+    if (auto *ST = dyn_cast<StructType>(Ty)) {
+        return ST->getElementType(Index);
+    }
+    return cast<ArrayType>(Ty)->getElementType();
+}
+
+/// Check that a GEP is "gep Ty, %alloca, 0, C0, C1, ..." with every index
+/// constant and in range, so the address stays inside one top-level element
+static bool isConstantElementGEP(GetElementPtrInst *GEP, Type *AllocTy) {
+    if (GEP->getSourceElementType() != AllocTy || GEP->getNumIndices() < 2) {
+        return false;
+    }
+
+    auto *First = dyn_cast<ConstantInt>(GEP->getOperand(1));
+    if (!First || !First->isZero()) {
+        return false;
+    }
+
+    Type *CurTy = AllocTy;
+    for (unsigned Idx = 2, E = GEP->getNumOperands(); Idx != E; ++Idx) {
+        auto *CI = dyn_cast<ConstantInt>(GEP->getOperand(Idx));
+        unsigned NumElts = getNumAggregateElements(CurTy);
+        if (!CI || NumElts == 0 || CI->getValue().uge(NumElts)) {
+            return false;
+        }
+        CurTy = getAggregateElementType(CurTy, CI->getZExtValue());
+    }
+
+    return true;
+}
+
+//===----------------------------------------------------------------------===//
+// AllocaPromotionPass Implementation
+//===----------------------------------------------------------------------===//
+
+void AllocaPromotionPass::debugPrint(const Twine &Msg) const {
+    if (DebugMode) {
+        errs() << "[AllocaPromotion] " << Msg << "\n";
+    }
+}
+
+bool AllocaPromotionPass::isSplittable(AllocaInst *AI) {
+    Type *AllocTy = AI->getAllocatedType();
+    unsigned NumElts = getNumAggregateElements(AllocTy);
+
+    if (!AI->isStaticAlloca() || AI->isArrayAllocation() ||
+        NumElts == 0 || NumElts > MaxAggregateElements) {
+        return false;
+    }
+
+    const DataLayout &DL = AI->getModule()->getDataLayout();
+
+    for (User *U : AI->users()) {
+        // Lifetime markers cover the whole object and are simply dropped
+        if (auto *II = dyn_cast<IntrinsicInst>(U)) {
+            if (II->isLifetimeStartOrEnd()) {
+                continue;
+            }
+            return false;
+        }
+
+        auto *GEP = dyn_cast<GetElementPtrInst>(U);
+        if (!GEP || GEP->getPointerOperand() != AI ||
+            !isConstantElementGEP(GEP, AllocTy)) {
+            LLVM_DEBUG(dbgs() << "  Unsplittable use: " << *U << "\n");
+            return false;
+        }
+
+        // The element address may only be used for simple loads and stores
+        // that fit inside the element; anything else could reach siblings
+        uint64_t EltSize = DL.getTypeAllocSize(GEP->getResultElementType());
+        for (User *GU : GEP->users()) {
+            Type *AccessTy = nullptr;
+            if (auto *LI = dyn_cast<LoadInst>(GU)) {
+                if (!LI->isSimple()) {
+                    return false;
+                }
+                AccessTy = LI->getType();
+            } else if (auto *SI = dyn_cast<StoreInst>(GU)) {
+                if (!SI->isSimple() || SI->getValueOperand() == GEP) {
+                    return false;
+                }
+                AccessTy = SI->getValueOperand()->getType();
+            } else {
+                return false;
+            }
+
+            if (DL.getTypeStoreSize(AccessTy).getFixedValue() > EltSize) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void AllocaPromotionPass::splitAggregate(AllocaInst *AI,
+                                         std::vector<AllocaInst*> &Worklist) {
+    Type *AllocTy = AI->getAllocatedType();
+    const DataLayout &DL = AI->getModule()->getDataLayout();
+
+    debugPrint("  Splitting aggregate: " + AI->getName());
+
+    // Element allocas are created lazily, only for elements actually used
+    DenseMap<unsigned, AllocaInst*> ElementAllocas;
+    auto getElementAlloca = [&](unsigned Index) {
+        AllocaInst *&Slot = ElementAllocas[Index];
+        if (Slot) {
+            return Slot;
+        }
+
+        uint64_t Offset = 0;
+        if (auto *ST = dyn_cast<StructType>(AllocTy)) {
+            Offset = DL.getStructLayout(ST)->getElementOffset(Index);
+        } else {
+            Type *EltTy = cast<ArrayType>(AllocTy)->getElementType();
+            Offset = DL.getTypeAllocSize(EltTy) * Index;
+        }
+
+        Type *EltTy = getAggregateElementType(AllocTy, Index);
+        Slot = new AllocaInst(EltTy, AI->getType()->getAddressSpace(), nullptr,
+                              commonAlignment(AI->getAlign(), Offset),
+                              AI->getName() + "." + Twine(Index), AI);
+        Stats.ElementAllocasCreated++;
+
+        if (getNumAggregateElements(EltTy) > 0) {
+            Worklist.push_back(Slot);
+        }
+        return Slot;
+    };
+
+    std::vector<Instruction*> ToDelete;
+
+    for (User *U : AI->users()) {
+        auto *GEP = dyn_cast<GetElementPtrInst>(U);
+        if (!GEP) {
+            // Lifetime marker on the original object
+            ToDelete.push_back(cast<Instruction>(U));
+            continue;
+        }
+
+        unsigned Index = cast<ConstantInt>(GEP->getOperand(2))->getZExtValue();
+        AllocaInst *EltAlloca = getElementAlloca(Index);
+
+        Value *Replacement = EltAlloca;
+        if (GEP->getNumIndices() > 2) {
+            // Re-base the remaining indices on the element alloca
+            SmallVector<Value*, 4> Indices;
+            Indices.push_back(GEP->getOperand(1));
+            for (unsigned Idx = 3, E = GEP->getNumOperands(); Idx != E; ++Idx) {
+                Indices.push_back(GEP->getOperand(Idx));
+            }
+            auto *NewGEP = GetElementPtrInst::Create(
+                EltAlloca->getAllocatedType(), EltAlloca, Indices,
+                GEP->getName(), GEP);
+            NewGEP->setIsInBounds(GEP->isInBounds());
+            Replacement = NewGEP;
+        }
+
+        GEP->replaceAllUsesWith(Replacement);
+        ToDelete.push_back(GEP);
+    }
+
+    for (Instruction *I : ToDelete) {
+        I->eraseFromParent();
+    }
+    AI->eraseFromParent();
+
+    Stats.AggregatesSplit++;
+}
+
+bool AllocaPromotionPass::splitAggregates(Function &F) {
+    std::vector<AllocaInst*> Worklist;
+
+    for (Instruction &I : F.getEntryBlock()) {
+        if (auto *AI = dyn_cast<AllocaInst>(&I)) {
+            if (getNumAggregateElements(AI->getAllocatedType()) > 0) {
+                Worklist.push_back(AI);
+            }
+        }
+    }
+
+    bool Changed = false;
+    while (!Worklist.empty()) {
+        AllocaInst *AI = Worklist.back();
+        Worklist.pop_back();
+
+        if (!isSplittable(AI)) {
+            continue;
+        }
+
+        splitAggregate(AI, Worklist);
+        Changed = true;
+    }
+
+    return Changed;
+}
+
+bool AllocaPromotionPass::promoteAllocas(Function &F, DominatorTree &DT,
+                                         AssumptionCache &AC) {
+    std::vector<AllocaInst*> Allocas;
+
+    // Only entry-block allocas are candidates; dynamic allocas stay in memory
+    for (Instruction &I : F.getEntryBlock()) {
+        if (auto *AI = dyn_cast<AllocaInst>(&I)) {
+            if (isAllocaPromotable(AI)) {
+                Allocas.push_back(AI);
+            }
+        }
+    }
+
+    if (Allocas.empty()) {
+        return false;
+    }
+
+    debugPrint("  Promoting " + Twine(Allocas.size()) + " allocas");
+
+    Stats.AllocasPromoted += Allocas.size();
+    PromoteMemToReg(Allocas, DT, &AC);
+    return true;
+}
+
+PreservedAnalyses AllocaPromotionPass::run(Function &F,
+                                           FunctionAnalysisManager &AM) {
+    debugPrint("Processing function: " + F.getName());
+
+    auto &DT = AM.getResult<DominatorTreeAnalysis>(F);
+    auto &AC = AM.getResult<AssumptionAnalysis>(F);
+
+    // Phase 1: Scalar replacement of aggregates
+    bool Changed = splitAggregates(F);
+
+    // Phase 2: mem2reg on everything that is now promotable
+    Changed |= promoteAllocas(F, DT, AC);
+
+    LLVM_DEBUG(dbgs() << "AllocaPromotion Statistics:\n"
+                      << "  Aggregates split: " << Stats.AggregatesSplit << "\n"
+                      << "  Element allocas created: "
+                      << Stats.ElementAllocasCreated << "\n"
+                      << "  Allocas promoted: " << Stats.AllocasPromoted << "\n");
+
+    if (!Changed) {
+        return PreservedAnalyses::all();
+    }
+
+    // Only instructions inside blocks changed; PHIs are inserted but no
+    // edges are added or removed
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    return PA;
+}
@@ -0,0 +1,313 @@
+//===- ArgumentSpecializationPass.cpp - Function Specialization -----------===//
+//
+// Call sites are grouped by function and by the constants they pass. For
+// each group the benefit per call is estimated by substituting the
+// constants into the function:
+//
+//   + 1 per instruction that folds or branch that resolves
+//   + DivisionBonus per division whose divisor becomes a constant
+//   + TripCountBonus per loop whose exit compare gets a constant bound
+//
+// Groups are ranked by benefit times call site weight (call sites inside
+// loops weigh LoopCallWeight), and the best are cloned until the clone
+// budget is used up.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ArgumentSpecializationPass.h"
+#include "ConstantFoldingPass.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include <algorithm>
+
+#define DEBUG_TYPE "argument-specialization"
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+//===----------------------------------------------------------------------===//
+// ArgumentSpecializationPass Implementation
+//===----------------------------------------------------------------------===//
+
+void ArgumentSpecializationPass::debugPrint(const Twine &Msg) const {
+    if (DebugMode) {
+        errs() << "[ArgumentSpecialization] " << Msg << "\n";
+    }
+}
+
+bool ArgumentSpecializationPass::isSpecializable(const Function &F) const {
+    // Interposable bodies may be replaced at link time, so a clone of the
+    // local body would be wrong. Definitions imported by ThinLTO qualify:
+    // their internal clones are what specializes across modules.
+    return !F.isDeclaration() && !F.isInterposable() && !F.hasOptNone() &&
+           !F.isVarArg() && F.getInstructionCount() <= Config.MaxFunctionSize;
+}
+
+unsigned ArgumentSpecializationPass::estimateBenefit(
+    Function &F, SmallVectorImpl<Constant*> &Arguments, LoopInfo &LI,
+    unsigned &KnownLoops) const {
+    const DataLayout &DL = F.getParent()->getDataLayout();
+
+    DenseMap<const Value*, Constant*> Known;
+    for (Argument &A : F.args()) {
+        if (Constant *C = Arguments[A.getArgNo()]) {
+            Known[&A] = C;
+        }
+    }
+
+    auto IsKnown = [&](const Value *V) { return Known.count(V) != 0; };
+    auto Lookup = [&](Value *V) -> Constant* {
+        if (auto *C = dyn_cast<Constant>(V)) {
+            return C;
+        }
+        return Known.lookup(V);
+    };
+
+    // Instructions the constants improve
+    SmallPtrSet<const Instruction*, 32> Affected;
+    unsigned Benefit = 0;
+
+    ReversePostOrderTraversal<Function*> RPOT(&F);
+    for (BasicBlock *BB : RPOT) {
+        for (Instruction &I : *BB) {
+            if (!any_of(I.operands(), IsKnown)) {
+                continue;
+            }
+
+            // A branch on a known condition goes away
+            if (auto *BI = dyn_cast<BranchInst>(&I)) {
+                if (BI->isConditional()) {
+                    Affected.insert(&I);
+                    Benefit++;
+                }
+                continue;
+            }
+            if (isa<SwitchInst>(I)) {
+                Affected.insert(&I);
+                Benefit++;
+                continue;
+            }
+
+            // Division by a constant is strength-reduced by the backend
+            unsigned Opcode = I.getOpcode();
+            if ((Opcode == Instruction::UDiv || Opcode == Instruction::URem ||
+                 Opcode == Instruction::SDiv || Opcode == Instruction::SRem) &&
+                IsKnown(I.getOperand(1)) && !IsKnown(I.getOperand(0))) {
+                Affected.insert(&I);
+                Benefit += Config.DivisionBonus;
+                continue;
+            }
+
+            // Pure instructions over known values fold
+            if (isa<PHINode>(I) || isa<CallBase>(I) ||
+                I.mayReadOrWriteMemory() || I.mayHaveSideEffects()) {
+                continue;
+            }
+            SmallVector<Constant*, 4> Ops;
+            for (Value *Op : I.operands()) {
+                if (Constant *C = Lookup(Op)) {
+                    Ops.push_back(C);
+                }
+            }
+            if (Ops.size() != I.getNumOperands()) {
+                continue;
+            }
+            if (Constant *C =
+                    ConstantFoldingPass::foldWithOperands(&I, Ops, DL)) {
+                Known[&I] = C;
+                Affected.insert(&I);
+                Benefit++;
+            }
+        }
+    }
+
+    // A loop whose exit compares an induction value against a known bound
+    // gets a constant trip count
+    KnownLoops = 0;
+    for (Loop *L : LI.getLoopsInPreorder()) {
+        SmallVector<BasicBlock*, 4> Exiting;
+        L->getExitingBlocks(Exiting);
+
+        for (BasicBlock *BB : Exiting) {
+            auto *BI = dyn_cast<BranchInst>(BB->getTerminator());
+            auto *Cmp = BI && BI->isConditional()
+                            ? dyn_cast<ICmpInst>(BI->getCondition())
+                            : nullptr;
+            if (!Cmp) {
+                continue;
+            }
+
+            Value *LHS = Cmp->getOperand(0);
+            Value *RHS = Cmp->getOperand(1);
+            if ((IsKnown(LHS) && !L->isLoopInvariant(RHS)) ||
+                (IsKnown(RHS) && !L->isLoopInvariant(LHS))) {
+                Affected.insert(Cmp);
+                Benefit += Config.TripCountBonus;
+                KnownLoops++;
+                break;
+            }
+        }
+    }
+
+    // Only arguments that improve something are specialized
+    for (Argument &A : F.args()) {
+        if (!Arguments[A.getArgNo()]) {
+            continue;
+        }
+        bool Used = any_of(A.users(), [&](const User *U) {
+            auto *I = dyn_cast<Instruction>(U);
+            return I && Affected.count(I);
+        });
+        if (!Used) {
+            Arguments[A.getArgNo()] = nullptr;
+        }
+    }
+
+    return Benefit;
+}
+
+Function *ArgumentSpecializationPass::createSpecialization(
+    SpecializationCandidate &Candidate) {
+    Function *F = Candidate.F;
+
+    ValueToValueMapTy VMap;
+    Function *Clone = CloneFunction(F, VMap);
+    Clone->setName(F->getName() + ".spec");
+    Clone->setLinkage(GlobalValue::InternalLinkage);
+    Clone->setComdat(nullptr);
+
+    for (Argument &A : Clone->args()) {
+        if (Constant *C = Candidate.Arguments[A.getArgNo()]) {
+            A.replaceAllUsesWith(C);
+        }
+    }
+
+    for (CallBase *CB : Candidate.CallSites) {
+        CB->setCalledFunction(Clone);
+    }
+
+    Stats.FunctionsCloned++;
+    Stats.CallSitesRedirected += Candidate.CallSites.size();
+    Stats.LoopsWithKnownTripCount += Candidate.KnownLoops;
+    return Clone;
+}
+
+PreservedAnalyses ArgumentSpecializationPass::run(Module &M,
+                                                  ModuleAnalysisManager &AM) {
+    Stats = Statistics();
+
+    auto &FAM =
+        AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+
+    SmallVector<SpecializationCandidate, 8> Candidates;
+
+    for (Function &F : M) {
+        if (!isSpecializable(F)) {
+            continue;
+        }
+
+        for (User *U : F.users()) {
+            auto *CB = dyn_cast<CallBase>(U);
+            // Bodies imported by ThinLTO (available_externally) are
+            // dropped before code generation, so their calls are not
+            // worth a clone
+            if (!CB || CB->getCalledOperand() != &F ||
+                CB->getFunctionType() != F.getFunctionType() ||
+                CB->getFunction()->hasOptNone() ||
+                CB->getFunction()->isDeclarationForLinker()) {
+                continue;
+            }
+            Stats.CallSitesAnalyzed++;
+
+            SmallVector<Constant*, 4> Arguments;
+            bool AnyConstant = false;
+            for (Value *Arg : CB->args()) {
+                Constant *C = nullptr;
+                if (isa<ConstantInt>(Arg) || isa<ConstantFP>(Arg)) {
+                    C = cast<Constant>(Arg);
+                    AnyConstant = true;
+                }
+                Arguments.push_back(C);
+            }
+            if (!AnyConstant) {
+                continue;
+            }
+
+            unsigned KnownLoops = 0;
+            unsigned Benefit = estimateBenefit(
+                F, Arguments, FAM.getResult<LoopAnalysis>(F), KnownLoops);
+            if (Benefit < Config.MinBenefit) {
+                Stats.NotProfitable++;
+                continue;
+            }
+
+            Function *Caller = CB->getFunction();
+            bool InLoop =
+                FAM.getResult<LoopAnalysis>(*Caller).getLoopFor(
+                    CB->getParent()) != nullptr;
+
+            auto It = find_if(Candidates,
+                              [&](const SpecializationCandidate &C) {
+                                  return C.F == &F &&
+                                         C.Arguments == Arguments;
+                              });
+            if (It == Candidates.end()) {
+                SpecializationCandidate New;
+                New.F = &F;
+                New.Arguments = Arguments;
+                New.Benefit = Benefit;
+                New.KnownLoops = KnownLoops;
+                Candidates.push_back(New);
+                It = std::prev(Candidates.end());
+            }
+            It->CallSites.push_back(CB);
+            It->Weight += InLoop ? Config.LoopCallWeight : 1;
+        }
+    }
+
+    // Hottest, most profitable groups first
+    std::stable_sort(Candidates.begin(), Candidates.end(),
+                     [](const SpecializationCandidate &A,
+                        const SpecializationCandidate &B) {
+                         return uint64_t(A.Benefit) * A.Weight >
+                                uint64_t(B.Benefit) * B.Weight;
+                     });
+
+    DenseMap<Function*, unsigned> ClonesPerFunction;
+    for (SpecializationCandidate &Candidate : Candidates) {
+        if (Stats.FunctionsCloned >= Config.MaxClones) {
+            break;
+        }
+        unsigned &Count = ClonesPerFunction[Candidate.F];
+        if (Count >= Config.MaxClonesPerFunction) {
+            continue;
+        }
+
+        Function *Clone = createSpecialization(Candidate);
+        Count++;
+        debugPrint("Specialized " + Candidate.F->getName() + " as " +
+                   Clone->getName() + ": benefit " + Twine(Candidate.Benefit) +
+                   ", " + Twine(Candidate.CallSites.size()) +
+                   " call site(s)");
+    }
+
+    LLVM_DEBUG(dbgs() << "ArgumentSpecialization Statistics:\n"
+                      << "  Call sites analyzed: " << Stats.CallSitesAnalyzed
+                      << "\n"
+                      << "  Not profitable: " << Stats.NotProfitable << "\n"
+                      << "  Functions cloned: " << Stats.FunctionsCloned
+                      << "\n"
+                      << "  Call sites redirected: "
+                      << Stats.CallSitesRedirected << "\n"
+                      << "  Loops with known trip count: "
+                      << Stats.LoopsWithKnownTripCount << "\n");
+
+    if (Stats.FunctionsCloned == 0) {
+        return PreservedAnalyses::all();
+    }
+    return PreservedAnalyses::none();
+}
@@ -0,0 +1,332 @@
+//===- ColdRegionSplittingPass.cpp - Hot/Cold Splitting -------------------===//
+//
+// Cold blocks are seeded from the same static rules BranchProbabilityInfo
+// uses (unreachable, noreturn calls, cold calls) and from zero-weight
+// branch_weights, then propagated to a fixpoint:
+//
+//   - a block whose successors are all cold only leads to cold code
+//   - a block whose predecessors are all cold (or reach it only through
+//     zero-weight edges) only runs when cold code does
+//
+// Each cold block with a hot predecessor heads a region: the cold blocks
+// reachable from it whose predecessors are all inside the region. The
+// entry block is never cold.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ColdRegionSplittingPass.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Utils/CodeExtractor.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+#define DEBUG_TYPE "cold-region-splitting"
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+//===----------------------------------------------------------------------===//
+// ColdRegionSplittingPass Implementation
+//===----------------------------------------------------------------------===//
+
+void ColdRegionSplittingPass::debugPrint(const Twine &Msg) const {
+    if (DebugMode) {
+        errs() << "[ColdRegionSplitting] " << Msg << "\n";
+    }
+}
+
+bool ColdRegionSplittingPass::isColdSeed(const BasicBlock &BB) {
+    if (isa<UnreachableInst>(BB.getTerminator())) {
+        return true;
+    }
+    for (const Instruction &I : BB) {
+        auto *CB = dyn_cast<CallBase>(&I);
+        if (!CB || isa<DbgInfoIntrinsic>(CB)) {
+            continue;
+        }
+        if (CB->doesNotReturn() || CB->hasFnAttr(Attribute::Cold)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Edges of BB's terminator with zero weight in its branch_weights
+static void getZeroWeightEdges(
+    BasicBlock &BB,
+    DenseSet<std::pair<const BasicBlock*, const BasicBlock*>> &Edges) {
+    Instruction *Term = BB.getTerminator();
+    MDNode *MD = Term->getMetadata(LLVMContext::MD_prof);
+    if (!MD || MD->getNumOperands() != Term->getNumSuccessors() + 1) {
+        return;
+    }
+    auto *Tag = dyn_cast<MDString>(MD->getOperand(0));
+    if (!Tag || Tag->getString() != "branch_weights") {
+        return;
+    }
+
+    // A successor reached through several cases is cold only if every
+    // one of them has zero weight
+    SmallPtrSet<const BasicBlock*, 4> Taken;
+    SmallPtrSet<const BasicBlock*, 4> NeverTaken;
+    for (unsigned I = 0, E = Term->getNumSuccessors(); I != E; ++I) {
+        auto *W = mdconst::dyn_extract<ConstantInt>(MD->getOperand(I + 1));
+        if (!W) {
+            return;
+        }
+        if (W->isZero()) {
+            NeverTaken.insert(Term->getSuccessor(I));
+        } else {
+            Taken.insert(Term->getSuccessor(I));
+        }
+    }
+    for (const BasicBlock *Succ : NeverTaken) {
+        if (!Taken.count(Succ)) {
+            Edges.insert({&BB, Succ});
+        }
+    }
+}
+
+void ColdRegionSplittingPass::findColdBlocks(
+    Function &F, SmallPtrSetImpl<BasicBlock*> &Cold) {
+    BasicBlock *Entry = &F.getEntryBlock();
+
+    DenseSet<std::pair<const BasicBlock*, const BasicBlock*>> ZeroEdges;
+    for (BasicBlock &BB : F) {
+        if (&BB != Entry && isColdSeed(BB)) {
+            Cold.insert(&BB);
+        }
+        if (Config.UseProfileWeights) {
+            getZeroWeightEdges(BB, ZeroEdges);
+        }
+    }
+
+    bool Changed = true;
+    while (Changed) {
+        Changed = false;
+        for (BasicBlock &BB : F) {
+            if (&BB == Entry || Cold.count(&BB)) {
+                continue;
+            }
+
+            bool LeadsToCold =
+                succ_begin(&BB) != succ_end(&BB) &&
+                all_of(successors(&BB),
+                       [&](BasicBlock *S) { return Cold.count(S) != 0; });
+            bool ReachedFromCold =
+                pred_begin(&BB) != pred_end(&BB) &&
+                all_of(predecessors(&BB), [&](BasicBlock *P) {
+                    return Cold.count(P) || ZeroEdges.count({P, &BB});
+                });
+
+            if (LeadsToCold || ReachedFromCold) {
+                Cold.insert(&BB);
+                Changed = true;
+            }
+        }
+    }
+}
+
+void ColdRegionSplittingPass::growRegion(
+    BasicBlock *Header, const SmallPtrSetImpl<BasicBlock*> &Cold,
+    SmallVectorImpl<BasicBlock*> &Region) {
+    SmallPtrSet<BasicBlock*, 16> InRegion;
+    Region.push_back(Header);
+    InRegion.insert(Header);
+
+    // A block joins once all its predecessors have; revisiting successors
+    // of every new block lets join points catch up
+    for (unsigned Idx = 0; Idx < Region.size(); ++Idx) {
+        for (BasicBlock *Succ : successors(Region[Idx])) {
+            if (!Cold.count(Succ) || InRegion.count(Succ)) {
+                continue;
+            }
+            bool SingleEntry = all_of(predecessors(Succ), [&](BasicBlock *P) {
+                return InRegion.count(P) != 0;
+            });
+            if (SingleEntry) {
+                Region.push_back(Succ);
+                InRegion.insert(Succ);
+            }
+        }
+    }
+}
+
+bool ColdRegionSplittingPass::isProfitable(
+    ArrayRef<BasicBlock*> Region) const {
+    SmallPtrSet<const BasicBlock*, 16> InRegion(Region.begin(), Region.end());
+    SmallPtrSet<const Value*, 8> Inputs;
+    SmallPtrSet<const Value*, 8> Outputs;
+    SmallPtrSet<const BasicBlock*, 4> Exits;
+    unsigned Size = 0;
+
+    for (BasicBlock *BB : Region) {
+        for (Instruction &I : *BB) {
+            if (isa<DbgInfoIntrinsic>(I)) {
+                continue;
+            }
+            Size++;
+
+            for (Value *Op : I.operands()) {
+                auto *OpI = dyn_cast<Instruction>(Op);
+                if ((OpI && !InRegion.count(OpI->getParent())) ||
+                    isa<Argument>(Op)) {
+                    Inputs.insert(Op);
+                }
+            }
+            for (User *U : I.users()) {
+                auto *UI = cast<Instruction>(U);
+                if (!InRegion.count(UI->getParent())) {
+                    Outputs.insert(&I);
+                }
+            }
+        }
+        for (BasicBlock *Succ : successors(BB)) {
+            if (!InRegion.count(Succ)) {
+                Exits.insert(Succ);
+            }
+        }
+    }
+
+    // The call, one argument per input, a pointer plus a reload per
+    // output, and a switch when there is more than one exit
+    unsigned Penalty = 1 + Inputs.size() + 2 * Outputs.size() +
+                       (Exits.size() > 1 ? 1 : 0);
+    return Size >= Penalty + Config.MinRegionBenefit;
+}
+
+bool ColdRegionSplittingPass::splitFunction(Function &F, AssumptionCache &AC) {
+    SmallPtrSet<BasicBlock*, 16> Cold;
+    findColdBlocks(F, Cold);
+    if (Cold.empty()) {
+        return false;
+    }
+    Stats.ColdBlocks += Cold.size();
+
+    // Regions are found up front: they are disjoint, and extracting one
+    // leaves the blocks of the others in place
+    SmallVector<SmallVector<BasicBlock*, 8>, 4> Regions;
+    SmallPtrSet<BasicBlock*, 16> Claimed;
+    for (BasicBlock &BB : F) {
+        if (!Cold.count(&BB) || Claimed.count(&BB)) {
+            continue;
+        }
+        bool HasHotPred = any_of(predecessors(&BB), [&](BasicBlock *P) {
+            return !Cold.count(P);
+        });
+        if (!HasHotPred) {
+            continue;
+        }
+
+        SmallVector<BasicBlock*, 8> Region;
+        growRegion(&BB, Cold, Region);
+        if (any_of(Region, [&](BasicBlock *R) { return Claimed.count(R); })) {
+            continue;
+        }
+        Claimed.insert(Region.begin(), Region.end());
+
+        if (!isProfitable(Region)) {
+            debugPrint("  Region at " + BB.getName() + " not profitable");
+            Stats.NotProfitable++;
+            continue;
+        }
+        Regions.push_back(std::move(Region));
+    }
+
+    bool Changed = false;
+    for (SmallVector<BasicBlock*, 8> &Region : Regions) {
+        DominatorTree DT(F);
+        CodeExtractorAnalysisCache CEAC(F);
+        CodeExtractor CE(Region, &DT, /*AggregateArgs=*/false,
+                         /*BFI=*/nullptr, /*BPI=*/nullptr, &AC);
+        if (!CE.isEligible()) {
+            debugPrint("  Region at " + Region.front()->getName() +
+                       " not eligible for extraction");
+            Stats.NotEligible++;
+            continue;
+        }
+
+        unsigned Size = 0;
+        for (BasicBlock *BB : Region) {
+            Size += BB->size();
+        }
+
+        Function *Outlined = CE.extractCodeRegion(CEAC);
+        if (!Outlined) {
+            Stats.NotEligible++;
+            continue;
+        }
+
+        // A region without exits leaves a dummy return behind its call;
+        // the call never returns, so say so
+        if (Outlined->doesNotReturn()) {
+            auto *Call = cast<CallInst>(Outlined->user_back());
+            if (Instruction *Next = Call->getNextNode()) {
+                changeToUnreachable(Next);
+            }
+        }
+
+        // Keep the region out of line for good: small, never inlined back
+        Outlined->setName(F.getName() + ".cold");
+        Outlined->addFnAttr(Attribute::Cold);
+        Outlined->addFnAttr(Attribute::MinSize);
+        Outlined->addFnAttr(Attribute::NoInline);
+
+        debugPrint("  Outlined " + Twine(Size) + " instructions into " +
+                   Outlined->getName());
+        Stats.RegionsOutlined++;
+        Stats.InstructionsOutlined += Size;
+        Changed = true;
+    }
+
+    return Changed;
+}
+
+PreservedAnalyses ColdRegionSplittingPass::run(Module &M,
+                                               ModuleAnalysisManager &AM) {
+    Stats = Statistics();
+
+    auto &FAM =
+        AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+
+    // Outlining appends functions to the module; visit the original ones
+    SmallVector<Function*, 16> Functions;
+    for (Function &F : M) {
+        if (!F.isDeclaration() && !F.hasOptNone() &&
+            !F.hasFnAttribute(Attribute::Cold) &&
+            !F.hasFnAttribute(Attribute::Naked)) {
+            Functions.push_back(&F);
+        }
+    }
+
+    bool Changed = false;
+    for (Function *F : Functions) {
+        debugPrint("Running on function: " + F->getName());
+
+        auto &AC = FAM.getResult<AssumptionAnalysis>(*F);
+        if (splitFunction(*F, AC)) {
+            FAM.invalidate(*F, PreservedAnalyses::none());
+            Changed = true;
+        }
+    }
+
+    LLVM_DEBUG(dbgs() << "ColdRegionSplitting Statistics:\n"
+                      << "  Cold blocks: " << Stats.ColdBlocks << "\n"
+                      << "  Regions outlined: " << Stats.RegionsOutlined
+                      << "\n"
+                      << "  Instructions outlined: "
+                      << Stats.InstructionsOutlined << "\n"
+                      << "  Not profitable: " << Stats.NotProfitable << "\n"
+                      << "  Not eligible: " << Stats.NotEligible << "\n");
+
+    if (!Changed) {
+        return PreservedAnalyses::all();
+    }
+    return PreservedAnalyses::none();
+}
@@ -113,6 +113,25 @@ Constant* ConstantFoldingPass::tryFold(Instruction *I, const DataLayout &DL) {
     return ConstantFoldInstruction(I, DL);
 }
 
+Constant* ConstantFoldingPass::foldWithOperands(Instruction *I,
+                                                ArrayRef<Constant*> Ops,
+                                                const DataLayout &DL) {
+    assert(Ops.size() == I->getNumOperands() && "operand count mismatch");
+
+    // Compares need their predicate; ConstantFoldInstOperands rejects them
+    if (auto *CI = dyn_cast<CmpInst>(I)) {
+        return ConstantFoldCompareInstOperands(CI->getPredicate(), Ops[0],
+                                               Ops[1], DL);
+    }
+
+    if (!isa<BinaryOperator>(I) && !isa<CastInst>(I) && !isa<SelectInst>(I) &&
+        !isa<GetElementPtrInst>(I)) {
+        return nullptr;
+    }
+
+    return ConstantFoldInstOperands(I, Ops, DL);
+}
+
 void ConstantFoldingPass::replaceAndScheduleRemoval(
     Instruction *I, Constant *Replacement,
     std::vector<Instruction*> &ToDelete) {
@@ -157,9 +176,11 @@ PreservedAnalyses ConstantFoldingPass::run(Function &F,
     // We need to iterate until no more folding is possible (fixed point)
     bool Changed = false;
     unsigned TotalFolded = 0;
+    unsigned Iterations = 0;
     
     do {
         Changed = false;
+        Iterations++;
         std::vector<Instruction*> ToDelete;
         
         // Process in reverse order to handle chains of constants
@@ -178,7 +199,8 @@ PreservedAnalyses ConstantFoldingPass::run(Function &F,
             I->eraseFromParent();
         }
         
-    } while (Changed);  // Repeat until no more folding possible
+    } while (Changed &&  // Repeat until no more folding possible
+             (Config.MaxIterations == 0 || Iterations < Config.MaxIterations));
 
     debugPrint("  Folded " + Twine(TotalFolded) + " instructions");
 
@@ -0,0 +1,457 @@
+//===- DeadStoreEliminationPass.cpp - MemorySSA-Based DSE -------*- C++ -*-===//
+//
+// For every store, follows the MemorySSA def chain downwards. Later stores to
+// the same base that post-dominate it mark bytes overwritten; reads mark the
+// bytes they observe first. The walk gives up at MemoryPhis, branching def
+// chains and the configured step limits, so every candidate costs at most
+// MemorySSAWalkLimit steps. Unless the store is to a local that does not
+// escape, it also gives up at instructions that may unwind.
+//
+//===----------------------------------------------------------------------===//
+
+#include "DeadStoreEliminationPass.h"
+#include "llvm/Analysis/CaptureTracking.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/MathExtras.h"
+
+#define DEBUG_TYPE "dead-store-elimination"
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+//===----------------------------------------------------------------------===//
+// OverwriteTracker Implementation
+//===----------------------------------------------------------------------===//
+
+void OverwriteTracker::paint(int64_t S, int64_t E, ByteState State) {
+    S = std::max(S, Start);
+    E = std::min(E, End);
+    if (S >= E) {
+        return;
+    }
+
+    // Collect the gaps between already painted intervals inside [S, E)
+    SmallVector<std::pair<int64_t, int64_t>, 4> Gaps;
+    int64_t Cursor = S;
+
+    auto It = Intervals.upper_bound(S);
+    if (It != Intervals.begin() && std::prev(It)->second.End > S) {
+        --It;
+    }
+
+    for (; It != Intervals.end() && It->first < E; ++It) {
+        if (It->first > Cursor) {
+            Gaps.push_back({Cursor, It->first});
+        }
+        Cursor = std::max(Cursor, It->second.End);
+    }
+    if (Cursor < E) {
+        Gaps.push_back({Cursor, E});
+    }
+
+    for (const auto &[GapStart, GapEnd] : Gaps) {
+        Intervals[GapStart] = Interval{GapEnd, State};
+        if (State == Read) {
+            HasReads = true;
+        }
+    }
+
+    // Coalesce neighbours with the same state
+    for (auto Cur = Intervals.begin(); Cur != Intervals.end(); ) {
+        auto Next = std::next(Cur);
+        if (Next != Intervals.end() && Cur->second.End == Next->first &&
+            Cur->second.State == Next->second.State) {
+            Cur->second.End = Next->second.End;
+            Intervals.erase(Next);
+            continue;
+        }
+        Cur = Next;
+    }
+}
+
+bool OverwriteTracker::isFullyOverwritten() const {
+    auto It = Intervals.find(Start);
+    return It != Intervals.end() && It->second.State == Overwritten &&
+           It->second.End >= End;
+}
+
+int64_t OverwriteTracker::getOverwrittenPrefix() const {
+    auto It = Intervals.find(Start);
+    if (It == Intervals.end() || It->second.State != Overwritten) {
+        return 0;
+    }
+    return It->second.End - Start;
+}
+
+int64_t OverwriteTracker::getOverwrittenSuffix() const {
+    if (Intervals.empty()) {
+        return 0;
+    }
+    auto Last = std::prev(Intervals.end());
+    if (Last->second.End != End || Last->second.State != Overwritten) {
+        return 0;
+    }
+    return End - Last->first;
+}
+
+//===----------------------------------------------------------------------===//
+// DeadStoreEliminationPass Implementation
+//===----------------------------------------------------------------------===//
+
+void DeadStoreEliminationPass::debugPrint(const Twine &Msg) const {
+    if (DebugMode) {
+        errs() << "[DeadStoreElimination] " << Msg << "\n";
+    }
+}
+
+bool DeadStoreEliminationPass::isRemovableStore(Instruction *I) {
+    if (auto *SI = dyn_cast<StoreInst>(I)) {
+        return SI->isSimple();
+    }
+    if (auto *MSI = dyn_cast<MemSetInst>(I)) {
+        return !MSI->isVolatile() && isa<ConstantInt>(MSI->getLength());
+    }
+    return false;
+}
+
+bool DeadStoreEliminationPass::getWriteExtent(Instruction *I,
+                                              const DataLayout &DL,
+                                              WriteExtent &Extent) {
+    if (auto *SI = dyn_cast<StoreInst>(I)) {
+        Extent.Loc = MemoryLocation::get(SI);
+    } else if (auto *MSI = dyn_cast<MemSetInst>(I)) {
+        Extent.Loc = MemoryLocation::getForDest(MSI);
+    } else {
+        return false;
+    }
+
+    if (!Extent.Loc.Size.isPrecise()) {
+        return false;
+    }
+
+    Extent.Offset = 0;
+    Extent.Base = GetPointerBaseWithConstantOffset(Extent.Loc.Ptr,
+                                                   Extent.Offset, DL);
+    Extent.Object = getUnderlyingObject(Extent.Loc.Ptr);
+    return true;
+}
+
+bool DeadStoreEliminationPass::isNonEscapingLocal(const Value *Obj,
+                                                  FunctionState &State) {
+    if (!isa<AllocaInst>(Obj)) {
+        return false;
+    }
+
+    auto It = State.NonEscapingCache.find(Obj);
+    if (It != State.NonEscapingCache.end()) {
+        return It->second;
+    }
+
+    bool NonEscaping = !PointerMayBeCaptured(Obj, /*ReturnCaptures=*/true,
+                                             /*StoreCaptures=*/true);
+    State.NonEscapingCache[Obj] = NonEscaping;
+    return NonEscaping;
+}
+
+bool DeadStoreEliminationPass::mayUnwindBetween(Instruction *DeadI,
+                                                Instruction *KillingI,
+                                                const WriteExtent &Dead,
+                                                FunctionState &State) {
+    if (State.UnwindBlocks.empty() || isNonEscapingLocal(Dead.Object, State)) {
+        return false;
+    }
+
+    // Across blocks, any such instruction might be on a path between them
+    if (DeadI->getParent() != KillingI->getParent()) {
+        return true;
+    }
+    if (!State.UnwindBlocks.count(DeadI->getParent())) {
+        return false;
+    }
+    for (Instruction *I = DeadI->getNextNode(); I != KillingI;
+         I = I->getNextNode()) {
+        if (I->mayThrow()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void DeadStoreEliminationPass::recordRead(Instruction *ReadI,
+                                          const WriteExtent &Dead,
+                                          FunctionState &State,
+                                          OverwriteTracker &Tracker) {
+    LLVM_DEBUG(dbgs() << "  Read by: " << *ReadI << "\n");
+
+    // Loads from the same base only pin the bytes they actually read
+    if (auto *LI = dyn_cast<LoadInst>(ReadI)) {
+        MemoryLocation Loc = MemoryLocation::get(LI);
+        int64_t Offset = 0;
+        const Value *Base =
+            GetPointerBaseWithConstantOffset(Loc.Ptr, Offset, State.DL);
+        if (Base == Dead.Base && Loc.Size.isPrecise()) {
+            Tracker.addRead(Offset, Offset + Loc.Size.getValue());
+            return;
+        }
+    }
+
+    Tracker.addReadOfEverything();
+}
+
+DeadStoreEliminationPass::WalkResult
+DeadStoreEliminationPass::walkDefChain(Instruction *DeadI,
+                                       const WriteExtent &Dead,
+                                       FunctionState &State,
+                                       OverwriteTracker &Tracker) {
+    MemoryAccess *Current = State.MSSA.getMemoryAccess(DeadI);
+
+    // Plain stores cannot be trimmed, so their walk ends at the first read;
+    // memsets keep going to find overwritten prefixes and suffixes
+    bool StopAtFirstRead = !isa<MemSetInst>(DeadI) ||
+                           !Config.TrimPartialMemSets;
+
+    for (unsigned Steps = 0; ; ++Steps) {
+        if (Steps >= Config.MemorySSAWalkLimit || State.BudgetLeft == 0) {
+            LLVM_DEBUG(dbgs() << "  Walk limit reached for: " << *DeadI << "\n");
+            Stats.WalkLimitReached++;
+            return WalkResult::Live;
+        }
+        State.BudgetLeft--;
+
+        // Look at everything that observes the memory state after Current.
+        // A MemoryUse attached here sees Current's bytes, whatever its
+        // position relative to later defs on the chain.
+        MemoryDef *Next = nullptr;
+        for (User *U : Current->users()) {
+            auto *UseOrDef = dyn_cast<MemoryUseOrDef>(U);
+            if (!UseOrDef) {
+                // MemoryPhi: the state merges with other paths
+                return WalkResult::Live;
+            }
+
+            Instruction *UI = UseOrDef->getMemoryInst();
+            if (isa<MemoryUse>(UseOrDef)) {
+                // A read of other memory can still unwind to the caller
+                if (UI->mayThrow() && !isNonEscapingLocal(Dead.Object, State)) {
+                    return WalkResult::Live;
+                }
+                if (isRefSet(State.AA.getModRefInfo(UI, Dead.Loc))) {
+                    recordRead(UI, Dead, State, Tracker);
+                }
+                continue;
+            }
+
+            // A second def means the chain forks into different blocks
+            if (Next) {
+                return WalkResult::Live;
+            }
+            Next = cast<MemoryDef>(UseOrDef);
+        }
+
+        if (Tracker.hasReads() && StopAtFirstRead) {
+            return WalkResult::Live;
+        }
+
+        // Nothing below this point touches memory again in this function
+        if (!Next) {
+            return !Tracker.hasReads() && isNonEscapingLocal(Dead.Object, State)
+                       ? WalkResult::EndOfLifetime
+                       : WalkResult::Live;
+        }
+
+        Instruction *NextI = Next->getMemoryInst();
+
+        // If NextI unwinds, the caller sees the candidate's bytes
+        if (NextI->mayThrow() && !isNonEscapingLocal(Dead.Object, State)) {
+            return WalkResult::Live;
+        }
+
+        // Without a MemoryPhi in between, a def in the same block is later
+        // in program order; otherwise it must post-dominate the candidate
+        bool PostDominates =
+            NextI->getParent() == DeadI->getParent() ||
+            State.PDT.dominates(NextI->getParent(), DeadI->getParent());
+
+        if (auto *II = dyn_cast<IntrinsicInst>(NextI)) {
+            if (II->getIntrinsicID() == Intrinsic::lifetime_end) {
+                if (PostDominates && !Tracker.hasReads() &&
+                    isa<AllocaInst>(Dead.Object) &&
+                    getUnderlyingObject(II->getArgOperand(1)) == Dead.Object) {
+                    return WalkResult::EndOfLifetime;
+                }
+                Current = Next;
+                continue;
+            }
+        }
+
+        if (isRefSet(State.AA.getModRefInfo(NextI, Dead.Loc))) {
+            recordRead(NextI, Dead, State, Tracker);
+            if (StopAtFirstRead) {
+                return WalkResult::Live;
+            }
+        }
+
+        // Later writes to the same base cover part of the candidate
+        WriteExtent Killing;
+        if (PostDominates && isRemovableStore(NextI) &&
+            getWriteExtent(NextI, State.DL, Killing) &&
+            Killing.Base == Dead.Base) {
+            if (mayUnwindBetween(DeadI, NextI, Dead, State)) {
+                return WalkResult::Live;
+            }
+            int64_t KillStart = Killing.Offset;
+            int64_t KillEnd = KillStart + Killing.Loc.Size.getValue();
+            Tracker.addOverwrite(KillStart, KillEnd);
+
+            if (Tracker.isFullyOverwritten()) {
+                LLVM_DEBUG(dbgs() << "  Overwritten by: " << *NextI << "\n");
+                return WalkResult::Overwritten;
+            }
+        }
+
+        Current = Next;
+    }
+}
+
+bool DeadStoreEliminationPass::trimMemSet(MemSetInst *MSI,
+                                          const OverwriteTracker &Tracker) {
+    uint64_t Length = cast<ConstantInt>(MSI->getLength())->getZExtValue();
+    Align DestAlign = MSI->getDestAlign().valueOrOne();
+
+    // Only move the start by whole alignment units so the memset keeps its
+    // original alignment guarantees
+    uint64_t Prefix = alignDown(Tracker.getOverwrittenPrefix(),
+                                DestAlign.value());
+    uint64_t Suffix = Tracker.getOverwrittenSuffix();
+
+    if ((Prefix == 0 && Suffix == 0) || Prefix + Suffix >= Length) {
+        return false;
+    }
+
+    LLVM_DEBUG(dbgs() << "  Trimming memset by " << Prefix << " leading and "
+                      << Suffix << " trailing bytes: " << *MSI << "\n");
+
+    if (Prefix > 0) {
+        IRBuilder<> Builder(MSI);
+        Value *NewDest = Builder.CreateInBoundsGEP(
+            Builder.getInt8Ty(), MSI->getRawDest(), Builder.getInt64(Prefix));
+        MSI->setDest(NewDest);
+        MSI->setDestAlignment(commonAlignment(DestAlign, Prefix));
+    }
+
+    MSI->setLength(ConstantInt::get(MSI->getLength()->getType(),
+                                    Length - Prefix - Suffix));
+    return true;
+}
+
+void DeadStoreEliminationPass::deleteDeadStore(Instruction *I,
+                                               MemorySSAUpdater &MSSAU,
+                                               const TargetLibraryInfo &TLI) {
+    debugPrint("  Deleting dead store: " + I->getName());
+
+    SmallVector<WeakTrackingVH, 4> DeadOperands;
+    for (Value *Op : I->operands()) {
+        if (isa<Instruction>(Op)) {
+            DeadOperands.push_back(Op);
+        }
+    }
+
+    MSSAU.removeMemoryAccess(I);
+    I->eraseFromParent();
+
+    // The stored value and address computation are often dead now too
+    RecursivelyDeleteTriviallyDeadInstructionsPermissive(DeadOperands, &TLI,
+                                                         &MSSAU);
+}
+
+PreservedAnalyses DeadStoreEliminationPass::run(Function &F,
+                                                FunctionAnalysisManager &AM) {
+    debugPrint("Processing function: " + F.getName());
+
+    auto &MSSA = AM.getResult<MemorySSAAnalysis>(F).getMSSA();
+    auto &AA = AM.getResult<AAManager>(F);
+    auto &PDT = AM.getResult<PostDominatorTreeAnalysis>(F);
+    auto &TLI = AM.getResult<TargetLibraryAnalysis>(F);
+
+    MemorySSAUpdater MSSAU(&MSSA);
+    FunctionState State{MSSA, AA, PDT, F.getParent()->getDataLayout(),
+                        Config.FunctionWalkBudget,
+                        DenseMap<const Value*, bool>(), {}};
+
+    // Collect candidates first; deletion only ever removes the candidate
+    // itself and trivially dead non-store instructions
+    std::vector<Instruction*> Candidates;
+    for (BasicBlock &BB : F) {
+        for (Instruction &I : BB) {
+            if (isRemovableStore(&I) && MSSA.getMemoryAccess(&I)) {
+                Candidates.push_back(&I);
+            }
+            if (I.mayThrow() &&
+                !isa_and_nonnull<MemoryDef>(MSSA.getMemoryAccess(&I))) {
+                State.UnwindBlocks.insert(&BB);
+            }
+        }
+    }
+
+    bool Changed = false;
+
+    for (Instruction *I : Candidates) {
+        WriteExtent Dead;
+        if (!getWriteExtent(I, State.DL, Dead)) {
+            continue;
+        }
+        Stats.StoresAnalyzed++;
+
+        OverwriteTracker Tracker(Dead.Offset,
+                                 Dead.Offset + Dead.Loc.Size.getValue());
+
+        switch (walkDefChain(I, Dead, State, Tracker)) {
+            case WalkResult::Overwritten:
+                deleteDeadStore(I, MSSAU, TLI);
+                Stats.OverwrittenStoresDeleted++;
+                Changed = true;
+                break;
+
+            case WalkResult::EndOfLifetime:
+                deleteDeadStore(I, MSSAU, TLI);
+                Stats.EndOfLifetimeStoresDeleted++;
+                Changed = true;
+                break;
+
+            case WalkResult::Live:
+                // Bytes overwritten before the first read can still go
+                if (auto *MSI = dyn_cast<MemSetInst>(I)) {
+                    if (Config.TrimPartialMemSets && trimMemSet(MSI, Tracker)) {
+                        Stats.MemSetsTrimmed++;
+                        Changed = true;
+                    }
+                }
+                break;
+        }
+    }
+
+    LLVM_DEBUG(dbgs() << "DeadStoreElimination Statistics:\n"
+                      << "  Stores analyzed: " << Stats.StoresAnalyzed << "\n"
+                      << "  Overwritten stores deleted: "
+                      << Stats.OverwrittenStoresDeleted << "\n"
+                      << "  End-of-lifetime stores deleted: "
+                      << Stats.EndOfLifetimeStoresDeleted << "\n"
+                      << "  Memsets trimmed: " << Stats.MemSetsTrimmed << "\n"
+                      << "  Walk limit reached: " << Stats.WalkLimitReached
+                      << "\n");
+
+    if (!Changed) {
+        return PreservedAnalyses::all();
+    }
+
+    // Only memory instructions were removed; MemorySSA was kept up to date
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    PA.preserve<MemorySSAAnalysis>();
+    return PA;
+}
@@ -0,0 +1,521 @@
+//===- FunctionCachePass.cpp - Per-function optimization cache ------------===//
+//
+// The key is a SHA-256 over:
+//
+//   - the plugin and LLVM versions, and the pipeline with its configuration
+//   - the function printed in a module of its own, with declarations of
+//     the globals it references: the target triple and data layout, which
+//     drive TTI and alias queries, and callee attributes (readnone,
+//     noreturn, ...), which passes consult instead of callee bodies
+//   - the linkage of F and of each referenced global, and the initializers
+//     of referenced variables, since constant folding reads through
+//     constant globals
+//
+// Functions with debug info are not cached: splicing their body would
+// also have to merge the cached compile unit into the module's.
+//
+//===----------------------------------------------------------------------===//
+
+#include "FunctionCachePass.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/WithColor.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#define DEBUG_TYPE "function-cache"
+
+#ifndef LLVM_OPT_PASSES_VERSION
+#define LLVM_OPT_PASSES_VERSION "unknown"
+#endif
+
+#ifndef LLVM_OPT_PASSES_SOURCES_HASH
+#define LLVM_OPT_PASSES_SOURCES_HASH "unknown"
+#endif
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+//===----------------------------------------------------------------------===//
+// Referenced Globals
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// Globals a function body refers to, through constants and metadata too.
+/// Fails on references a cache entry cannot carry: block addresses, and
+/// aliases or unnamed globals, which cannot be matched up by name.
+class GlobalCollector {
+public:
+    SetVector<const GlobalValue*> Globals;
+
+    bool collect(const Function &F) {
+        if (F.hasPersonalityFn() && !visitValue(F.getPersonalityFn())) {
+            return false;
+        }
+        if (!visitAttachments(F)) {
+            return false;
+        }
+        for (const BasicBlock &BB : F) {
+            for (const Instruction &I : BB) {
+                for (const Value *Op : I.operands()) {
+                    if (!visitValue(Op)) {
+                        return false;
+                    }
+                }
+                if (!visitAttachments(I)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    SmallPtrSet<const Value*, 32> VisitedValues;
+    SmallPtrSet<const Metadata*, 32> VisitedMetadata;
+
+    template <typename T>
+    bool visitAttachments(const T &Object) {
+        SmallVector<std::pair<unsigned, MDNode*>, 4> MDs;
+        Object.getAllMetadata(MDs);
+        for (const auto &[Kind, MD] : MDs) {
+            if (!visitMetadata(MD)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool visitValue(const Value *V) {
+        if (isa<BlockAddress>(V)) {
+            return false;
+        }
+        if (auto *MAV = dyn_cast<MetadataAsValue>(V)) {
+            return visitMetadata(MAV->getMetadata());
+        }
+        if (auto *GV = dyn_cast<GlobalValue>(V)) {
+            if (!GV->hasName() ||
+                !(isa<Function>(GV) || isa<GlobalVariable>(GV))) {
+                return false;
+            }
+            Globals.insert(GV);
+            return true;
+        }
+        if (!isa<Constant>(V) || !VisitedValues.insert(V).second) {
+            return true;
+        }
+        for (const Value *Op : cast<Constant>(V)->operands()) {
+            if (!visitValue(Op)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool visitMetadata(const Metadata *MD) {
+        if (!VisitedMetadata.insert(MD).second) {
+            return true;
+        }
+        if (auto *VAM = dyn_cast<ValueAsMetadata>(MD)) {
+            return visitValue(VAM->getValue());
+        }
+        if (auto *N = dyn_cast<MDNode>(MD)) {
+            for (const MDOperand &Op : N->operands()) {
+                if (Op && !visitMetadata(Op.get())) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+} // end anonymous namespace
+
+static bool hasDebugInfo(const Function &F) {
+    if (F.getSubprogram()) {
+        return true;
+    }
+    for (const BasicBlock &BB : F) {
+        for (const Instruction &I : BB) {
+            if (I.getDebugLoc() || isa<DbgInfoIntrinsic>(I)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/// Put the use lists of F's arguments, blocks and instructions in layout
+/// order of their users. Passes leave them in whatever order they created
+/// the uses, and cloning a cached body creates them in yet another, while
+/// use lists order predecessors and users for later passes and the printer.
+/// Sorting both a hit and a miss keeps them indistinguishable.
+static void sortUseLists(Function &F) {
+    DenseMap<const User*, unsigned> Position;
+    for (BasicBlock &BB : F) {
+        for (Instruction &I : BB) {
+            Position[&I] = Position.size();
+        }
+    }
+
+    auto Sort = [&](Value &V) {
+        if (V.hasOneUse() || V.use_empty()) {
+            return;
+        }
+        V.sortUseList([&](const Use &L, const Use &R) {
+            return std::make_pair(Position.lookup(L.getUser()),
+                                  L.getOperandNo()) <
+                   std::make_pair(Position.lookup(R.getUser()),
+                                  R.getOperandNo());
+        });
+    };
+
+    for (Argument &A : F.args()) {
+        Sort(A);
+    }
+    for (BasicBlock &BB : F) {
+        Sort(BB);
+        for (Instruction &I : BB) {
+            Sort(I);
+        }
+    }
+}
+
+/// A module holding a copy of F, with external linkage, and declarations
+/// of the globals it references; null if a reference cannot be carried
+static std::unique_ptr<Module> extractFunction(const Function &F) {
+    GlobalCollector Collector;
+    if (!Collector.collect(F)) {
+        return nullptr;
+    }
+
+    const Module &M = *F.getParent();
+    auto Entry = std::make_unique<Module>(F.getName(), F.getContext());
+    Entry->setTargetTriple(M.getTargetTriple());
+    Entry->setDataLayout(M.getDataLayout());
+
+    Function *NewF = Function::Create(F.getFunctionType(),
+                                      GlobalValue::ExternalLinkage,
+                                      F.getAddressSpace(), F.getName(),
+                                      Entry.get());
+    ValueToValueMapTy VMap;
+    VMap[&F] = NewF;
+    for (const GlobalValue *GV : Collector.Globals) {
+        if (GV == &F) {
+            continue;
+        }
+        if (auto *Var = dyn_cast<GlobalVariable>(GV)) {
+            VMap[Var] = new GlobalVariable(
+                *Entry, Var->getValueType(), Var->isConstant(),
+                GlobalValue::ExternalLinkage, nullptr, Var->getName(),
+                nullptr, Var->getThreadLocalMode(), Var->getAddressSpace());
+            continue;
+        }
+        auto *Callee = cast<Function>(GV);
+        Function *Decl = Function::Create(
+            Callee->getFunctionType(), GlobalValue::ExternalLinkage,
+            Callee->getAddressSpace(), Callee->getName(), Entry.get());
+        Decl->setAttributes(Callee->getAttributes());
+        VMap[Callee] = Decl;
+    }
+
+    Function::arg_iterator Arg = NewF->arg_begin();
+    for (const Argument &A : F.args()) {
+        VMap[&A] = &*Arg++;
+    }
+    SmallVector<ReturnInst*, 4> Returns;
+    CloneFunctionInto(NewF, &F, VMap, CloneFunctionChangeType::DifferentModule,
+                      Returns);
+
+    // Empty, as F has no debug info; the reader would warn about it
+    if (NamedMDNode *CUs = Entry->getNamedMetadata("llvm.dbg.cu")) {
+        Entry->eraseNamedMetadata(CUs);
+    }
+    return Entry;
+}
+
+//===----------------------------------------------------------------------===//
+// FunctionCache Implementation
+//===----------------------------------------------------------------------===//
+
+FunctionCache::FunctionCache(FunctionCacheConfig Config)
+    : Config(std::move(Config)) {
+    Expected<CachePruningPolicy> PolicyOrErr =
+        parseCachePruningPolicy(this->Config.PruningPolicy);
+    if (!PolicyOrErr) {
+        // A bad policy should not fail the build the cache only speeds up
+        WithColor::warning() << "invalid function cache policy: "
+                             << toString(PolicyOrErr.takeError())
+                             << "; using the default\n";
+        PolicyOrErr =
+            parseCachePruningPolicy(FunctionCacheConfig().PruningPolicy);
+    }
+    Policy = *PolicyOrErr;
+
+    // Stores fail quietly if this does; the cache is only an accelerator
+    sys::fs::create_directories(this->Config.Directory);
+}
+
+FunctionCache::~FunctionCache() {
+    // Pipelines are also built just to check that a name parses
+    if (Stats.Lookups == 0 && Stats.Uncacheable == 0) {
+        return;
+    }
+
+    pruneCache(Config.Directory, Policy);
+
+    if (Config.PrintStatistics) {
+        errs() << "[FunctionCache] " << Stats.Lookups << " lookups, "
+               << Stats.Hits << " hits, " << Stats.Misses << " misses, "
+               << Stats.Stores << " stores, " << Stats.Uncacheable
+               << " uncacheable, " << Stats.StaleEntries
+               << " stale entries\n";
+    }
+
+    LLVM_DEBUG({
+        dbgs() << "FunctionCache Statistics:\n";
+        dbgs() << "  Lookups: " << Stats.Lookups << "\n";
+        dbgs() << "  Hits: " << Stats.Hits << "\n";
+        dbgs() << "  Misses: " << Stats.Misses << "\n";
+        dbgs() << "  Stores: " << Stats.Stores << "\n";
+        dbgs() << "  Uncacheable: " << Stats.Uncacheable << "\n";
+        dbgs() << "  Stale entries: " << Stats.StaleEntries << "\n";
+    });
+}
+
+std::string FunctionCache::getEntryPath(StringRef Key) const {
+    // pruneCache only considers files with this prefix
+    SmallString<128> Path(Config.Directory);
+    sys::path::append(Path, "llvmcache-" + Key);
+    return std::string(Path);
+}
+
+std::optional<std::string>
+FunctionCache::computeKey(const Function &F, StringRef PipelineKey) const {
+    if (!F.hasName() || F.hasPrefixData() || F.hasPrologueData() ||
+        hasDebugInfo(F)) {
+        return std::nullopt;
+    }
+    std::unique_ptr<Module> Entry = extractFunction(F);
+    if (!Entry) {
+        return std::nullopt;
+    }
+
+    std::string Material;
+    raw_string_ostream OS(Material);
+    OS << "llvm-opt-passes " << LLVM_OPT_PASSES_VERSION << " "
+       << LLVM_OPT_PASSES_SOURCES_HASH << " LLVM " << LLVM_VERSION_STRING
+       << "\n"
+       << PipelineKey << "\n"
+       << "linkage " << F.getLinkage() << "\n";
+
+    // The copy rather than F: printing a value of the module being compiled
+    // scans the whole module each time, and numbers attribute groups and
+    // metadata module-wide, so unrelated edits would renumber them
+    Entry->print(OS, /*AAW=*/nullptr);
+
+    // What the declarations leave out. Initializers are printed on their
+    // own, which refers to other globals by name without a module.
+    const Function *Copy = Entry->getFunction(F.getName());
+    for (const GlobalValue &GV : Entry->global_values()) {
+        const GlobalValue *Original =
+            F.getParent()->getNamedValue(GV.getName());
+        if (&GV == Copy || !Original) {
+            continue;
+        }
+        OS << "@" << GV.getName() << " linkage " << Original->getLinkage()
+           << (Original->isDeclaration() ? " declaration" : " definition");
+        if (auto *Var = dyn_cast<GlobalVariable>(Original)) {
+            if (Var->isExternallyInitialized()) {
+                OS << " externally_initialized";
+            }
+            if (MaybeAlign Align = Var->getAlign()) {
+                OS << " align " << Align->value();
+            }
+            if (Var->hasInitializer()) {
+                OS << " ";
+                Var->getInitializer()->printAsOperand(OS,
+                                                      /*PrintType=*/true);
+            }
+        }
+        OS << "\n";
+    }
+
+    return toHex(SHA256::hash(arrayRefFromStringRef(OS.str())),
+                 /*LowerCase=*/true);
+}
+
+bool FunctionCache::lookup(StringRef Key, Function &F) {
+    ++Stats.Lookups;
+
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+        MemoryBuffer::getFile(getEntryPath(Key));
+    if (!Buffer) {
+        ++Stats.Misses;
+        return false;
+    }
+
+    auto Stale = [&]() {
+        ++Stats.StaleEntries;
+        ++Stats.Misses;
+        return false;
+    };
+
+    Expected<std::unique_ptr<Module>> EntryOrErr =
+        parseBitcodeFile((*Buffer)->getMemBufferRef(), F.getContext());
+    if (!EntryOrErr) {
+        consumeError(EntryOrErr.takeError());
+        return Stale();
+    }
+    Module &Entry = **EntryOrErr;
+    Function *Cached = Entry.getFunction(F.getName());
+    if (!Cached || Cached->isDeclaration() ||
+        Cached->getFunctionType() != F.getFunctionType()) {
+        return Stale();
+    }
+
+    // Match the entry's declarations to the module's globals. Intrinsics a
+    // pass introduced may be missing; anything else means the key missed
+    // a change, so the entry is not used.
+    Module &M = *F.getParent();
+    ValueToValueMapTy VMap;
+    SmallVector<Function*, 4> MissingIntrinsics;
+    VMap[Cached] = &F;
+    for (GlobalValue &GV : Entry.global_values()) {
+        if (&GV == Cached) {
+            continue;
+        }
+        GlobalValue *Target = M.getNamedValue(GV.getName());
+        if (!Target) {
+            auto *Intrinsic = dyn_cast<Function>(&GV);
+            if (!Intrinsic || !Intrinsic->isIntrinsic()) {
+                return Stale();
+            }
+            MissingIntrinsics.push_back(Intrinsic);
+            continue;
+        }
+        if (isa<Function>(Target) != isa<Function>(GV) ||
+            isa<GlobalAlias>(Target) ||
+            Target->getValueType() != GV.getValueType()) {
+            return Stale();
+        }
+        VMap[&GV] = Target;
+    }
+    for (Function *Intrinsic : MissingIntrinsics) {
+        VMap[Intrinsic] = Function::Create(
+            Intrinsic->getFunctionType(), GlobalValue::ExternalLinkage,
+            Intrinsic->getAddressSpace(), Intrinsic->getName(), &M);
+    }
+
+    // Cloning into another module adds !llvm.dbg.cu for the compile units
+    // it brings along; there are none, so do not leave an empty one
+    bool HadCompileUnits = M.getNamedMetadata("llvm.dbg.cu");
+
+    F.dropAllReferences();
+    Function::arg_iterator Arg = F.arg_begin();
+    for (Argument &CachedArg : Cached->args()) {
+        VMap[&CachedArg] = &*Arg++;
+    }
+    SmallVector<ReturnInst*, 4> Returns;
+    CloneFunctionInto(&F, Cached, VMap,
+                      CloneFunctionChangeType::DifferentModule, Returns);
+    sortUseLists(F);
+
+    if (!HadCompileUnits) {
+        if (NamedMDNode *CUs = M.getNamedMetadata("llvm.dbg.cu")) {
+            M.eraseNamedMetadata(CUs);
+        }
+    }
+
+    ++Stats.Hits;
+    return true;
+}
+
+void FunctionCache::store(StringRef Key, const Function &F) {
+    std::unique_ptr<Module> Entry = extractFunction(F);
+    if (!Entry) {
+        return;
+    }
+
+    // Written aside and renamed, so readers never see half an entry. Not a
+    // TempFile: each one registers for removal on signals, and that list
+    // only grows, making thousands of stores quadratic.
+    SmallString<128> Model(Config.Directory);
+    sys::path::append(Model, "custom-opt-%%%%%%%%.tmp");
+    SmallString<128> TempPath;
+    int FD;
+    if (std::error_code EC = sys::fs::createUniqueFile(Model, FD, TempPath)) {
+        LLVM_DEBUG(dbgs() << "function cache: " << EC.message() << "\n");
+        return;
+    }
+    {
+        raw_fd_ostream OS(FD, /*shouldClose=*/true);
+        WriteBitcodeToFile(*Entry, OS);
+        OS.close();
+        if (OS.has_error()) {
+            LLVM_DEBUG(dbgs() << "function cache: " << OS.error().message()
+                              << "\n");
+            OS.clear_error();
+            sys::fs::remove(TempPath);
+            return;
+        }
+    }
+    if (std::error_code EC = sys::fs::rename(TempPath, getEntryPath(Key))) {
+        LLVM_DEBUG(dbgs() << "function cache: " << EC.message() << "\n");
+        sys::fs::remove(TempPath);
+        return;
+    }
+    ++Stats.Stores;
+}
+
+//===----------------------------------------------------------------------===//
+// FunctionCachePass Implementation
+//===----------------------------------------------------------------------===//
+
+void FunctionCachePass::debugPrint(const Twine &Msg) const {
+    if (DebugMode) {
+        errs() << "[FunctionCache] " << Msg << "\n";
+    }
+}
+
+PreservedAnalyses FunctionCachePass::run(Function &F,
+                                         FunctionAnalysisManager &AM) {
+    if (F.isDeclaration()) {
+        return PreservedAnalyses::all();
+    }
+
+    std::optional<std::string> Key = Cache->computeKey(F, PipelineKey);
+    if (!Key) {
+        debugPrint("Not cacheable: " + F.getName());
+        Cache->noteUncacheable();
+        return Pipeline.run(F, AM);
+    }
+
+    if (Cache->lookup(*Key, F)) {
+        debugPrint("Hit: " + F.getName());
+        return PreservedAnalyses::none();
+    }
+
+    debugPrint("Miss: " + F.getName());
+    PreservedAnalyses PA = Pipeline.run(F, AM);
+    Cache->store(*Key, F);
+    sortUseLists(F);
+    return PA;
+}
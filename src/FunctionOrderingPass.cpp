@@ -0,0 +1,274 @@
+//===- FunctionOrderingPass.cpp - Function Ordering -----------------------===//
+//
+// Call-chain clustering (Ottoni and Maher, CGO 2017). Every hot function
+// starts in its own cluster. Visiting functions from hottest to coldest,
+// a function's cluster is appended to the cluster of its most frequent
+// caller, unless
+//
+//   - that caller accounts for less than MinCallerPercent of its calls
+//   - the merged cluster would exceed MaxClusterSize bytes
+//
+// Clusters are then laid out by decreasing density (samples per byte).
+//
+// Counts come from the profile: function_entry_count for functions and,
+// per call site, the call's own branch_weights total when the sample
+// loader attached one, or else its block's count from BlockFrequencyInfo.
+//
+//===----------------------------------------------------------------------===//
+
+#include "FunctionOrderingPass.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Mangler.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+#define DEBUG_TYPE "function-ordering"
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+//===----------------------------------------------------------------------===//
+// FunctionOrderingPass Implementation
+//===----------------------------------------------------------------------===//
+
+void FunctionOrderingPass::debugPrint(const Twine &Msg) const {
+    if (DebugMode) {
+        errs() << "[FunctionOrdering] " << Msg << "\n";
+    }
+}
+
+void FunctionOrderingPass::buildCallGraph(
+    Module &M, FunctionAnalysisManager &FAM,
+    DenseMap<Function*, CallerList> &Callers) {
+    for (Function &Caller : M) {
+        if (Caller.isDeclaration() || !Caller.getEntryCount()) {
+            continue;
+        }
+        auto &BFI = FAM.getResult<BlockFrequencyAnalysis>(Caller);
+
+        for (BasicBlock &BB : Caller) {
+            for (Instruction &I : BB) {
+                auto *CB = dyn_cast<CallBase>(&I);
+                if (!CB || isa<IntrinsicInst>(CB)) {
+                    continue;
+                }
+                Function *Callee = CB->getCalledFunction();
+                if (!Callee || Callee->isDeclaration()) {
+                    continue;
+                }
+
+                uint64_t Count = 0;
+                if (!CB->extractProfTotalWeight(Count)) {
+                    if (auto BlockCount = BFI.getBlockProfileCount(&BB)) {
+                        Count = *BlockCount;
+                    }
+                }
+                if (Count == 0) {
+                    continue;
+                }
+
+                CallerList &List = Callers[Callee];
+                auto It = find_if(List, [&](const auto &Edge) {
+                    return Edge.first == &Caller;
+                });
+                if (It == List.end()) {
+                    List.push_back({&Caller, Count});
+                    Stats.CallEdges++;
+                } else {
+                    It->second += Count;
+                }
+            }
+        }
+    }
+}
+
+std::vector<FunctionCluster> FunctionOrderingPass::clusterFunctions(
+    ArrayRef<Function*> Hot, const DenseMap<Function*, uint64_t> &Samples,
+    const DenseMap<Function*, CallerList> &Callers) {
+    std::vector<FunctionCluster> Clusters;
+    DenseMap<Function*, unsigned> ClusterOf;
+
+    for (Function *F : Hot) {
+        FunctionCluster C;
+        C.Functions.push_back(F);
+        C.Samples = Samples.lookup(F);
+        C.Size = std::max(F->getInstructionCount(), 1u) *
+                 static_cast<uint64_t>(Config.BytesPerInstruction);
+        ClusterOf[F] = Clusters.size();
+        Clusters.push_back(std::move(C));
+    }
+
+    SmallVector<Function*, 16> ByHotness(Hot.begin(), Hot.end());
+    std::stable_sort(ByHotness.begin(), ByHotness.end(),
+                     [&](Function *A, Function *B) {
+                         return Samples.lookup(A) > Samples.lookup(B);
+                     });
+
+    for (Function *F : ByHotness) {
+        auto It = Callers.find(F);
+        if (It == Callers.end()) {
+            continue;
+        }
+
+        // The most frequent hot caller; ties go to the first one seen
+        Function *Best = nullptr;
+        uint64_t BestCount = 0;
+        for (const auto &[Caller, Count] : It->second) {
+            if (Caller != F && ClusterOf.count(Caller) && Count > BestCount) {
+                Best = Caller;
+                BestCount = Count;
+            }
+        }
+        if (!Best) {
+            continue;
+        }
+
+        // A caller that rarely calls F does not decide where F goes
+        uint64_t FSamples = Samples.lookup(F);
+        if (BestCount * 100 < FSamples * Config.MinCallerPercent) {
+            continue;
+        }
+
+        unsigned From = ClusterOf[F];
+        unsigned To = ClusterOf[Best];
+        if (From == To ||
+            Clusters[To].Size + Clusters[From].Size > Config.MaxClusterSize) {
+            continue;
+        }
+
+        debugPrint("  Placing " + F->getName() + " after caller " +
+                   Best->getName() + " (" + Twine(BestCount) + " calls)");
+
+        FunctionCluster &Dst = Clusters[To];
+        FunctionCluster &Src = Clusters[From];
+        for (Function *G : Src.Functions) {
+            Dst.Functions.push_back(G);
+            ClusterOf[G] = To;
+        }
+        Dst.Samples += Src.Samples;
+        Dst.Size += Src.Size;
+        Src = FunctionCluster();
+        Stats.ClustersMerged++;
+    }
+
+    // Merged-away clusters are empty
+    Clusters.erase(std::remove_if(Clusters.begin(), Clusters.end(),
+                                  [](const FunctionCluster &C) {
+                                      return C.Functions.empty();
+                                  }),
+                   Clusters.end());
+    std::stable_sort(Clusters.begin(), Clusters.end(),
+                     [](const FunctionCluster &A, const FunctionCluster &B) {
+                         return A.getDensity() > B.getDensity();
+                     });
+    return Clusters;
+}
+
+void FunctionOrderingPass::writeOrderFile(Module &M,
+                                          ArrayRef<Function*> Order) const {
+    std::error_code EC;
+    raw_fd_ostream OS(Config.OrderFile, EC, sys::fs::OF_Text);
+    if (EC) {
+        M.getContext().emitError("cannot write function order file '" +
+                                 Config.OrderFile + "': " + EC.message());
+        return;
+    }
+
+    // Linker symbol names, e.g. with the leading underscore on Mach-O
+    Mangler Mang;
+    for (Function *F : Order) {
+        Mang.getNameWithPrefix(OS, F, /*CannotUsePrivateLabel=*/false);
+        OS << "\n";
+    }
+}
+
+PreservedAnalyses FunctionOrderingPass::run(Module &M,
+                                            ModuleAnalysisManager &AM) {
+    Stats = Statistics();
+
+    auto &FAM =
+        AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+
+    DenseMap<Function*, uint64_t> Samples;
+    SmallVector<Function*, 16> Hot;
+    SmallVector<Function*, 16> Unlikely;
+    for (Function &F : M) {
+        if (F.isDeclaration()) {
+            continue;
+        }
+        auto Count = F.getEntryCount();
+        if (!Count) {
+            continue;
+        }
+        Stats.FunctionsWithProfile++;
+
+        if (Count->getCount() > 0) {
+            Samples[&F] = Count->getCount();
+            Hot.push_back(&F);
+        } else {
+            Unlikely.push_back(&F);
+        }
+    }
+
+    if (Stats.FunctionsWithProfile == 0) {
+        debugPrint("No profile data, keeping the function order");
+        return PreservedAnalyses::all();
+    }
+
+    DenseMap<Function*, CallerList> Callers;
+    buildCallGraph(M, FAM, Callers);
+
+    std::vector<FunctionCluster> Clusters =
+        clusterFunctions(Hot, Samples, Callers);
+
+    SmallVector<Function*, 16> Order;
+    for (const FunctionCluster &C : Clusters) {
+        debugPrint("Cluster of " + Twine(C.Functions.size()) +
+                   " function(s), " + Twine(C.Size) + " bytes, " +
+                   Twine(C.Samples) + " samples");
+        Order.append(C.Functions.begin(), C.Functions.end());
+    }
+
+    // Hot functions first, in cluster order; the rest keep their order
+    for (Function *F : reverse(Order)) {
+        F->removeFromParent();
+        M.getFunctionList().push_front(F);
+    }
+    Stats.FunctionsOrdered = Order.size();
+
+    if (Config.SetSectionPrefixes) {
+        for (Function *F : Order) {
+            F->setSectionPrefix("hot");
+        }
+        for (Function *F : Unlikely) {
+            F->setSectionPrefix("unlikely");
+        }
+        Stats.FunctionsUnlikely = Unlikely.size();
+    }
+
+    if (!Config.OrderFile.empty()) {
+        writeOrderFile(M, Order);
+    }
+
+    LLVM_DEBUG(dbgs() << "FunctionOrdering Statistics:\n"
+                      << "  Functions with profile: "
+                      << Stats.FunctionsWithProfile << "\n"
+                      << "  Call edges: " << Stats.CallEdges << "\n"
+                      << "  Clusters merged: " << Stats.ClustersMerged
+                      << "\n"
+                      << "  Functions ordered: " << Stats.FunctionsOrdered
+                      << "\n"
+                      << "  Functions unlikely: " << Stats.FunctionsUnlikely
+                      << "\n");
+
+    // Only the placement of whole functions changed
+    PreservedAnalyses PA;
+    PA.preserveSet<AllAnalysesOn<Function>>();
+    PA.preserve<FunctionAnalysisManagerModuleProxy>();
+    return PA;
+}
@@ -0,0 +1,304 @@
+//===- InliningPass.cpp - Cost-Based Inliner --------------------*- C++ -*-===//
+//
+// The cost of a call site is estimated on the callee as it stands after its
+// own SCC was optimized:
+//
+//   cost = sum of TTI size-and-latency over the callee's instructions,
+//          skipping those that fold once constant arguments are substituted
+//          and blocks behind branches those constants resolve
+//        - ConstantArgBonus per constant argument that folds anything
+//        - CallSiteSavings + one per argument
+//
+// and the call is inlined when cost <= InlineThreshold (+ LoopBonus inside
+// a loop). alwaysinline call sites skip the cost check.
+//
+//===----------------------------------------------------------------------===//
+
+#include "InliningPass.h"
+#include "ConstantFoldingPass.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/InlineCost.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include <algorithm>
+#include <climits>
+
+#define DEBUG_TYPE "inlining"
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+//===----------------------------------------------------------------------===//
+// InliningPass Implementation
+//===----------------------------------------------------------------------===//
+
+void InliningPass::debugPrint(const Twine &Msg) const {
+    if (DebugMode) {
+        errs() << "[Inlining] " << Msg << "\n";
+    }
+}
+
+Function *InliningPass::getInlinableCallee(CallBase &CB,
+                                           TargetTransformInfo &TTI) {
+    Function *Callee = CB.getCalledFunction();
+    if (!Callee || Callee->isDeclaration()) {
+        return nullptr;
+    }
+
+    Function *Caller = CB.getCaller();
+    if (CB.isNoInline() || Callee->isInterposable() ||
+        CB.getFunctionType() != Callee->getFunctionType() ||
+        !AttributeFuncs::areInlineCompatible(*Caller, *Callee) ||
+        !TTI.areInlineCompatible(Caller, Callee)) {
+        Stats.NotViable++;
+        return nullptr;
+    }
+
+    InlineResult Viable = isInlineViable(*Callee);
+    if (!Viable.isSuccess()) {
+        debugPrint("  " + Callee->getName() + " not viable: " +
+                   Viable.getFailureReason());
+        Stats.NotViable++;
+        return nullptr;
+    }
+    return Callee;
+}
+
+int InliningPass::getInlineCost(CallBase &CB, Function &Callee,
+                                TargetTransformInfo &CalleeTTI) {
+    const DataLayout &DL = Callee.getParent()->getDataLayout();
+
+    // Values that become constants once the call site's arguments are
+    // substituted, and the instructions that fold or resolve because of them
+    DenseMap<const Value*, Constant*> Known;
+    SmallPtrSet<const Instruction*, 32> Folded;
+    for (Argument &A : Callee.args()) {
+        if (auto *C = dyn_cast<Constant>(CB.getArgOperand(A.getArgNo()))) {
+            Known[&A] = C;
+        }
+    }
+
+    auto Lookup = [&](Value *V) -> Constant* {
+        if (auto *C = dyn_cast<Constant>(V)) {
+            return C;
+        }
+        return Known.lookup(V);
+    };
+
+    // Blocks still reachable once branches on known conditions are resolved
+    SmallPtrSet<const BasicBlock*, 32> Live;
+    Live.insert(&Callee.getEntryBlock());
+
+    int64_t Cost = 0;
+    ReversePostOrderTraversal<Function*> RPOT(&Callee);
+    for (BasicBlock *BB : RPOT) {
+        if (!Live.count(BB)) {
+            continue;
+        }
+
+        for (Instruction &I : *BB) {
+            // A branch on a known condition keeps only the taken successor
+            if (I.isTerminator()) {
+                BasicBlock *Taken = nullptr;
+                if (auto *BI = dyn_cast<BranchInst>(&I)) {
+                    if (BI->isConditional()) {
+                        auto *C = dyn_cast_or_null<ConstantInt>(
+                            Lookup(BI->getCondition()));
+                        if (C) {
+                            Taken = BI->getSuccessor(C->isZero() ? 1 : 0);
+                        }
+                    }
+                } else if (auto *SI = dyn_cast<SwitchInst>(&I)) {
+                    auto *C = dyn_cast_or_null<ConstantInt>(
+                        Lookup(SI->getCondition()));
+                    if (C) {
+                        Taken = SI->findCaseValue(C)->getCaseSuccessor();
+                    }
+                }
+
+                if (Taken) {
+                    Folded.insert(&I);
+                    Live.insert(Taken);
+                    continue;
+                }
+                for (BasicBlock *Succ : successors(BB)) {
+                    Live.insert(Succ);
+                }
+            }
+
+            // Pure instructions over constant arguments fold away
+            if (!isa<PHINode>(I) && !isa<CallBase>(I) && !I.isTerminator() &&
+                !I.mayReadOrWriteMemory() && !I.mayHaveSideEffects() &&
+                any_of(I.operands(),
+                       [&](const Value *V) { return Known.count(V); })) {
+                SmallVector<Constant*, 4> Ops;
+                for (Value *Op : I.operands()) {
+                    if (Constant *C = Lookup(Op)) {
+                        Ops.push_back(C);
+                    }
+                }
+                if (Ops.size() == I.getNumOperands()) {
+                    Constant *C =
+                        ConstantFoldingPass::foldWithOperands(&I, Ops, DL);
+                    if (C) {
+                        Known[&I] = C;
+                        Folded.insert(&I);
+                        continue;
+                    }
+                }
+            }
+
+            InstructionCost C = CalleeTTI.getInstructionCost(
+                &I, TargetTransformInfo::TCK_SizeAndLatency);
+            if (!C.isValid()) {
+                return INT_MAX;
+            }
+            Cost += *C.getValue();
+        }
+    }
+
+    // Constant arguments that fold or resolve at least one instruction
+    unsigned FoldingArgs = 0;
+    for (Argument &A : Callee.args()) {
+        if (Known.count(&A) && any_of(A.users(), [&](const User *U) {
+                return Folded.count(dyn_cast<Instruction>(U));
+            })) {
+            FoldingArgs++;
+        }
+    }
+    Stats.ConstantArgsFolding += FoldingArgs;
+
+    Cost -= static_cast<int64_t>(FoldingArgs) * Config.ConstantArgBonus;
+    Cost -= Config.CallSiteSavings + static_cast<int64_t>(CB.arg_size());
+    return static_cast<int>(std::min<int64_t>(Cost, INT_MAX));
+}
+
+PreservedAnalyses InliningPass::run(LazyCallGraph::SCC &C,
+                                    CGSCCAnalysisManager &AM,
+                                    LazyCallGraph &CG, CGSCCUpdateResult &UR) {
+    auto &FAM =
+        AM.getResult<FunctionAnalysisManagerCGSCCProxy>(C, CG).getManager();
+    auto GetAssumptionCache = [&](Function &F) -> AssumptionCache & {
+        return FAM.getResult<AssumptionAnalysis>(F);
+    };
+
+    // Updating the call graph may split C, so take the functions up front
+    SmallVector<Function*, 4> Functions;
+    for (LazyCallGraph::Node &N : C) {
+        Functions.push_back(&N.getFunction());
+    }
+
+    LazyCallGraph::SCC *CurrentC = &C;
+    bool Changed = false;
+
+    for (Function *Caller : Functions) {
+        LazyCallGraph::Node &N = *CG.lookup(*Caller);
+        if (Caller->isDeclaration() || Caller->hasOptNone() ||
+            CG.lookupSCC(N) != CurrentC) {
+            continue;
+        }
+
+        debugPrint("Running on function: " + Caller->getName());
+
+        // Collect first: inlining invalidates the loop info and adds new
+        // call sites that are not revisited
+        auto &LI = FAM.getResult<LoopAnalysis>(*Caller);
+        SmallVector<std::pair<CallBase*, bool>, 16> Calls;
+        for (BasicBlock &BB : *Caller) {
+            for (Instruction &I : BB) {
+                auto *CB = dyn_cast<CallBase>(&I);
+                if (CB && !isa<IntrinsicInst>(CB)) {
+                    Calls.push_back({CB, LI.getLoopFor(&BB) != nullptr});
+                }
+            }
+        }
+
+        auto &CallerTTI = FAM.getResult<TargetIRAnalysis>(*Caller);
+        unsigned CallerSize = Caller->getInstructionCount();
+        bool Inlined = false;
+
+        for (auto &[CB, InLoop] : Calls) {
+            Stats.CallSitesAnalyzed++;
+
+            Function *Callee = getInlinableCallee(*CB, CallerTTI);
+            if (!Callee) {
+                continue;
+            }
+
+            // Calls back into this SCC are recursion
+            LazyCallGraph::Node *CalleeN = CG.lookup(*Callee);
+            if (!CalleeN || CG.lookupSCC(*CalleeN) == CurrentC) {
+                continue;
+            }
+
+            if (!CB->hasFnAttr(Attribute::AlwaysInline)) {
+                int Cost = getInlineCost(
+                    *CB, *Callee, FAM.getResult<TargetIRAnalysis>(*Callee));
+                int Threshold = Config.InlineThreshold +
+                                (InLoop ? Config.LoopBonus : 0);
+                unsigned CalleeSize = Callee->getInstructionCount();
+
+                if (Cost > Threshold ||
+                    CallerSize + CalleeSize > Config.MaxCallerSize) {
+                    debugPrint("  Not inlining " + Callee->getName() +
+                               ": cost " + Twine(Cost) + ", threshold " +
+                               Twine(Threshold));
+                    Stats.NotProfitable++;
+                    continue;
+                }
+                debugPrint("  Inlining " + Callee->getName() + ": cost " +
+                           Twine(Cost) + ", threshold " + Twine(Threshold));
+            }
+
+            InlineFunctionInfo IFI(GetAssumptionCache);
+            InlineResult Result = InlineFunction(*CB, IFI);
+            if (!Result.isSuccess()) {
+                debugPrint("  Inlining " + Callee->getName() + " failed: " +
+                           Result.getFailureReason());
+                Stats.NotViable++;
+                continue;
+            }
+
+            AttributeFuncs::mergeAttributesForInlining(*Caller, *Callee);
+            CallerSize += Callee->getInstructionCount();
+            Stats.CallsInlined++;
+            Inlined = true;
+        }
+
+        if (!Inlined) {
+            continue;
+        }
+        Changed = true;
+
+        // Invalidate the caller now rather than every function of the SCC
+        // at the end, then add the callee's call edges to the caller
+        FAM.invalidate(*Caller, PreservedAnalyses::none());
+        CurrentC = &updateCGAndAnalysisManagerForCGSCCPass(CG, *CurrentC, N,
+                                                           AM, UR, FAM);
+    }
+
+    LLVM_DEBUG(dbgs() << "Inlining Statistics:\n"
+                      << "  Call sites analyzed: " << Stats.CallSitesAnalyzed
+                      << "\n"
+                      << "  Calls inlined: " << Stats.CallsInlined << "\n"
+                      << "  Not viable: " << Stats.NotViable << "\n"
+                      << "  Not profitable: " << Stats.NotProfitable << "\n"
+                      << "  Constant arguments folding: "
+                      << Stats.ConstantArgsFolding << "\n");
+
+    if (!Changed) {
+        return PreservedAnalyses::all();
+    }
+
+    // Modified functions were invalidated above
+    PreservedAnalyses PA;
+    PA.preserveSet<AllAnalysesOn<Function>>();
+    PA.preserve<FunctionAnalysisManagerCGSCCProxy>();
+    return PA;
+}
@@ -0,0 +1,332 @@
+//===- InvariantDivisionPass.cpp - Loop-Invariant Division ------*- C++ -*-===//
+//
+// Divisions are grouped by (loop, divisor, signedness), hoisting to the
+// outermost loop in which the divisor is invariant. For each profitable
+// group the preheader computes libdivide's branch-free constants:
+//
+//   unsigned: q = mulhi(magic, n); t = ((n - q) >> 1) + q; q = t >> shift
+//   signed:   q = mulhi(magic, n) + n; q += (q >> (W-1)) & bias;
+//             q = ((q >> shift) ^ sign) - sign
+//
+// The divisor is replaced by 1 where it is 0 before the double-width setup
+// division, so the preheader never traps; a zero divisor was undefined in
+// the original loop anyway.
+//
+//===----------------------------------------------------------------------===//
+
+#include "InvariantDivisionPass.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/Support/Debug.h"
+
+#include <algorithm>
+
+#define DEBUG_TYPE "invariant-division"
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+//===----------------------------------------------------------------------===//
+// InvariantDivisionPass Implementation
+//===----------------------------------------------------------------------===//
+
+void InvariantDivisionPass::debugPrint(const Twine &Msg) const {
+    if (DebugMode) {
+        errs() << "[InvariantDivision] " << Msg << "\n";
+    }
+}
+
+Loop *InvariantDivisionPass::getHoistLoop(BinaryOperator *I, LoopInfo &LI) {
+    Value *D = I->getOperand(1);
+    Loop *Result = nullptr;
+    for (Loop *L = LI.getLoopFor(I->getParent());
+         L && L->isLoopInvariant(D) && L->getLoopPreheader();
+         L = L->getParentLoop()) {
+        Result = L;
+    }
+    return Result;
+}
+
+uint64_t InvariantDivisionPass::estimateIterations(BinaryOperator *I,
+                                                   Loop *Outer, LoopInfo &LI,
+                                                   ScalarEvolution &SE) const {
+    // Large enough for any decision, small enough not to overflow
+    const uint64_t Cap = 1ULL << 32;
+
+    uint64_t Iterations = 1;
+    for (Loop *L = LI.getLoopFor(I->getParent()); L; L = L->getParentLoop()) {
+        uint64_t TripCount = SE.getSmallConstantTripCount(L);
+        if (!TripCount) {
+            TripCount = SE.getSmallConstantMaxTripCount(L);
+        }
+        if (!TripCount) {
+            TripCount = Config.UnknownTripCount;
+        }
+        Iterations = std::min(Iterations * TripCount, Cap);
+
+        if (L == Outer) {
+            break;
+        }
+    }
+    return Iterations;
+}
+
+DivisorMagic InvariantDivisionPass::buildUnsignedMagic(Value *D,
+                                                       IRBuilder<> &Builder) {
+    auto *Ty = cast<IntegerType>(D->getType());
+    unsigned W = Ty->getBitWidth();
+    Type *WideTy = Builder.getIntNTy(2 * W);
+    Constant *Zero = ConstantInt::get(Ty, 0);
+    Constant *One = ConstantInt::get(Ty, 1);
+
+    DivisorMagic M;
+    Value *SafeD = Builder.CreateSelect(Builder.CreateICmpEQ(D, Zero), One, D,
+                                        "div.safe");
+
+    // k = floor(log2(d))
+    Value *Lz = Builder.CreateBinaryIntrinsic(Intrinsic::ctlz, SafeD,
+                                              Builder.getFalse());
+    Value *K = Builder.CreateSub(ConstantInt::get(Ty, W - 1), Lz, "div.log2");
+    Value *IsPow2 = Builder.CreateICmpEQ(
+        Builder.CreateAnd(SafeD, Builder.CreateSub(SafeD, One)), Zero);
+
+    // m = 2^(W+k) / d, computed in double width; only used if d is not a
+    // power of two, where it fits in W bits
+    Value *Num = Builder.CreateShl(
+        Builder.CreateZExt(Builder.CreateShl(One, K), WideTy), W);
+    Value *WideD = Builder.CreateZExt(SafeD, WideTy);
+    Value *Proposed = Builder.CreateTrunc(Builder.CreateUDiv(Num, WideD), Ty);
+    Value *Rem = Builder.CreateTrunc(Builder.CreateURem(Num, WideD), Ty);
+
+    // One more bit of precision: magic = 2m + (2r >= d) + 1 (mod 2^W)
+    Value *TwiceRem = Builder.CreateAdd(Rem, Rem);
+    Value *RoundUp = Builder.CreateOr(Builder.CreateICmpUGE(TwiceRem, SafeD),
+                                      Builder.CreateICmpULT(TwiceRem, Rem));
+    Value *Magic = Builder.CreateAdd(
+        Builder.CreateAdd(Proposed, Proposed),
+        Builder.CreateAdd(Builder.CreateZExt(RoundUp, Ty), One));
+    M.Magic = Builder.CreateSelect(IsPow2, Zero, Magic, "div.magic");
+    M.WideMagic = Builder.CreateZExt(M.Magic, WideTy, "div.magic.wide");
+
+    // Powers of two rely on the fixed shift by one in the quotient sequence;
+    // d == 1 is patched with IsOne instead
+    Value *KMinusOne = Builder.CreateSelect(
+        Builder.CreateICmpEQ(K, Zero), Zero, Builder.CreateSub(K, One));
+    M.Shift = Builder.CreateSelect(IsPow2, KMinusOne, K, "div.shift");
+    M.IsOne = Builder.CreateICmpEQ(D, One, "div.isone");
+    return M;
+}
+
+DivisorMagic InvariantDivisionPass::buildSignedMagic(Value *D,
+                                                     IRBuilder<> &Builder) {
+    auto *Ty = cast<IntegerType>(D->getType());
+    unsigned W = Ty->getBitWidth();
+    Type *WideTy = Builder.getIntNTy(2 * W);
+    Constant *Zero = ConstantInt::get(Ty, 0);
+    Constant *One = ConstantInt::get(Ty, 1);
+
+    DivisorMagic M;
+
+    // |d| as an unsigned value; INT_MIN stays 2^(W-1)
+    Value *IsNeg = Builder.CreateICmpSLT(D, Zero);
+    Value *AbsD = Builder.CreateSelect(IsNeg, Builder.CreateNeg(D), D);
+    Value *SafeAbs = Builder.CreateSelect(Builder.CreateICmpEQ(AbsD, Zero),
+                                          One, AbsD, "div.safe");
+
+    Value *Lz = Builder.CreateBinaryIntrinsic(Intrinsic::ctlz, SafeAbs,
+                                              Builder.getFalse());
+    Value *K = Builder.CreateSub(ConstantInt::get(Ty, W - 1), Lz, "div.log2");
+    Value *IsPow2 = Builder.CreateICmpEQ(
+        Builder.CreateAnd(SafeAbs, Builder.CreateSub(SafeAbs, One)), Zero);
+
+    // m = 2^(W+k-1) / |d|; k >= 1 whenever |d| is not a power of two
+    Value *KMinusOne = Builder.CreateSelect(
+        Builder.CreateICmpEQ(K, Zero), Zero, Builder.CreateSub(K, One));
+    Value *Num = Builder.CreateShl(
+        Builder.CreateZExt(Builder.CreateShl(One, KMinusOne), WideTy), W);
+    Value *WideD = Builder.CreateZExt(SafeAbs, WideTy);
+    Value *Proposed = Builder.CreateTrunc(Builder.CreateUDiv(Num, WideD), Ty);
+    Value *Rem = Builder.CreateTrunc(Builder.CreateURem(Num, WideD), Ty);
+
+    Value *TwiceRem = Builder.CreateAdd(Rem, Rem);
+    Value *RoundUp = Builder.CreateOr(Builder.CreateICmpUGE(TwiceRem, SafeAbs),
+                                      Builder.CreateICmpULT(TwiceRem, Rem));
+    Value *Magic = Builder.CreateAdd(
+        Builder.CreateAdd(Proposed, Proposed),
+        Builder.CreateAdd(Builder.CreateZExt(RoundUp, Ty), One));
+    M.Magic = Builder.CreateSelect(IsPow2, Zero, Magic, "div.magic");
+    M.WideMagic = Builder.CreateSExt(M.Magic, WideTy, "div.magic.wide");
+    M.Shift = K;
+
+    // Negative quotients round toward zero: add 2^k - 1 for powers of two,
+    // 2^k otherwise
+    M.Bias = Builder.CreateSub(Builder.CreateShl(One, K),
+                               Builder.CreateZExt(IsPow2, Ty), "div.bias");
+    M.Sign = Builder.CreateAShr(D, W - 1, "div.sign");
+    return M;
+}
+
+Value *InvariantDivisionPass::emitUnsignedQuotient(Value *N,
+                                                   const DivisorMagic &M,
+                                                   IRBuilder<> &Builder) {
+    auto *Ty = cast<IntegerType>(N->getType());
+    unsigned W = Ty->getBitWidth();
+    Type *WideTy = Builder.getIntNTy(2 * W);
+
+    Value *Product = Builder.CreateMul(M.WideMagic,
+                                       Builder.CreateZExt(N, WideTy));
+    Value *Q = Builder.CreateTrunc(Builder.CreateLShr(Product, W), Ty,
+                                   "div.mulhi");
+    Value *T = Builder.CreateAdd(Builder.CreateLShr(Builder.CreateSub(N, Q), 1),
+                                 Q);
+    Value *Quotient = Builder.CreateLShr(T, M.Shift);
+    return Builder.CreateSelect(M.IsOne, N, Quotient);
+}
+
+Value *InvariantDivisionPass::emitSignedQuotient(Value *N,
+                                                 const DivisorMagic &M,
+                                                 IRBuilder<> &Builder) {
+    auto *Ty = cast<IntegerType>(N->getType());
+    unsigned W = Ty->getBitWidth();
+    Type *WideTy = Builder.getIntNTy(2 * W);
+
+    Value *Product = Builder.CreateMul(M.WideMagic,
+                                       Builder.CreateSExt(N, WideTy));
+    Value *Q = Builder.CreateTrunc(Builder.CreateAShr(Product, W), Ty,
+                                   "div.mulhi");
+    Q = Builder.CreateAdd(Q, N);
+    Value *QSign = Builder.CreateAShr(Q, W - 1);
+    Q = Builder.CreateAdd(Q, Builder.CreateAnd(QSign, M.Bias));
+    Q = Builder.CreateAShr(Q, M.Shift);
+    return Builder.CreateSub(Builder.CreateXor(Q, M.Sign), M.Sign);
+}
+
+PreservedAnalyses InvariantDivisionPass::run(Function &F,
+                                             FunctionAnalysisManager &AM) {
+    debugPrint("Running on function: " + F.getName());
+
+    auto &LI = AM.getResult<LoopAnalysis>(F);
+    if (LI.empty()) {
+        return PreservedAnalyses::all();
+    }
+    auto &SE = AM.getResult<ScalarEvolutionAnalysis>(F);
+
+    // ((hoist loop, divisor), is signed) -> divisions sharing one setup
+    using GroupKey = std::pair<std::pair<Loop*, Value*>, unsigned>;
+    MapVector<GroupKey, SmallVector<BinaryOperator*, 4>> Groups;
+
+    for (BasicBlock &BB : F) {
+        Loop *Inner = LI.getLoopFor(&BB);
+        if (!Inner) {
+            continue;
+        }
+
+        for (Instruction &I : BB) {
+            auto *BO = dyn_cast<BinaryOperator>(&I);
+            if (!BO) {
+                continue;
+            }
+
+            unsigned Opcode = BO->getOpcode();
+            if (Opcode != Instruction::UDiv && Opcode != Instruction::URem &&
+                Opcode != Instruction::SDiv && Opcode != Instruction::SRem) {
+                continue;
+            }
+
+            // The mulhi needs a double-width multiply; vectors are left to
+            // the backend
+            auto *Ty = dyn_cast<IntegerType>(BO->getType());
+            if (!Ty || Ty->getBitWidth() < 8 || Ty->getBitWidth() > 64 ||
+                !isPowerOf2_32(Ty->getBitWidth())) {
+                continue;
+            }
+            Stats.DivisionsAnalyzed++;
+
+            // Constant divisors are strength-reduced by the backend, and a
+            // fully invariant division is a hoisting opportunity instead
+            Value *D = BO->getOperand(1);
+            if (isa<Constant>(D) || Inner->isLoopInvariant(BO->getOperand(0))) {
+                continue;
+            }
+
+            Loop *L = getHoistLoop(BO, LI);
+            if (!L) {
+                continue;
+            }
+
+            bool Signed = Opcode == Instruction::SDiv ||
+                          Opcode == Instruction::SRem;
+            Groups[{{L, D}, Signed ? 1u : 0u}].push_back(BO);
+        }
+    }
+
+    bool Changed = false;
+
+    for (auto &[Key, Divisions] : Groups) {
+        Loop *L = Key.first.first;
+        Value *D = Key.first.second;
+        bool Signed = Key.second != 0;
+
+        uint64_t Savings = 0;
+        if (Config.DivisionCost > Config.MagicDivideCost) {
+            for (BinaryOperator *BO : Divisions) {
+                Savings += estimateIterations(BO, L, LI, SE) *
+                           (Config.DivisionCost - Config.MagicDivideCost);
+            }
+        }
+        if (Savings <= Config.MagicSetupCost) {
+            debugPrint("  Not profitable for divisor " + D->getName());
+            Stats.NotProfitable++;
+            continue;
+        }
+
+        debugPrint("  Preparing divisor " + D->getName() + " for " +
+                   Twine(Divisions.size()) + " division(s)");
+
+        IRBuilder<> Setup(L->getLoopPreheader()->getTerminator());
+        DivisorMagic M = Signed ? buildSignedMagic(D, Setup)
+                                : buildUnsignedMagic(D, Setup);
+        Stats.DivisorsPrepared++;
+
+        for (BinaryOperator *BO : Divisions) {
+            IRBuilder<> Builder(BO);
+            Value *N = BO->getOperand(0);
+            Value *Q = Signed ? emitSignedQuotient(N, M, Builder)
+                              : emitUnsignedQuotient(N, M, Builder);
+
+            Value *Result = Q;
+            unsigned Opcode = BO->getOpcode();
+            if (Opcode == Instruction::URem || Opcode == Instruction::SRem) {
+                Result = Builder.CreateSub(N, Builder.CreateMul(Q, D));
+                Stats.RemaindersRewritten++;
+            } else {
+                Stats.DivisionsRewritten++;
+            }
+
+            Result->takeName(BO);
+            BO->replaceAllUsesWith(Result);
+            BO->eraseFromParent();
+        }
+        Changed = true;
+    }
+
+    LLVM_DEBUG(dbgs() << "InvariantDivision Statistics:\n"
+                      << "  Divisions analyzed: " << Stats.DivisionsAnalyzed
+                      << "\n"
+                      << "  Divisors prepared: " << Stats.DivisorsPrepared
+                      << "\n"
+                      << "  Divisions rewritten: " << Stats.DivisionsRewritten
+                      << "\n"
+                      << "  Remainders rewritten: "
+                      << Stats.RemaindersRewritten << "\n"
+                      << "  Not profitable: " << Stats.NotProfitable << "\n");
+
+    if (!Changed) {
+        return PreservedAnalyses::all();
+    }
+
+    // Instructions were added to existing blocks only
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    return PA;
+}
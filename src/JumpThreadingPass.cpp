@@ -0,0 +1,351 @@
+//===- JumpThreadingPass.cpp - Jump Threading -------------------*- C++ -*-===//
+//
+// For every block ending in a conditional branch or switch, the condition is
+// re-evaluated per predecessor: PHIs are replaced by their incoming value and
+// instructions of the block are folded with ConstantFoldingPass. When an
+// edge fixes the successor and the block is small, the block is cloned for
+// that edge. Values that now have two definitions are reconnected with
+// SSAUpdater; dominator tree changes go through a lazy DomTreeUpdater.
+//
+//===----------------------------------------------------------------------===//
+
+#include "JumpThreadingPass.h"
+#include "ConstantFoldingPass.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/Analysis/CFG.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+#include "llvm/Support/Debug.h"
+
+#define DEBUG_TYPE "jump-threading"
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+//===----------------------------------------------------------------------===//
+// JumpThreadingPass Implementation
+//===----------------------------------------------------------------------===//
+
+void JumpThreadingPass::debugPrint(const Twine &Msg) const {
+    if (DebugMode) {
+        errs() << "[JumpThreading] " << Msg << "\n";
+    }
+}
+
+Constant *JumpThreadingPass::evaluateOnEdge(Value *V, BasicBlock *BB,
+                                            BasicBlock *Pred,
+                                            const DataLayout &DL,
+                                            unsigned Depth) const {
+    if (auto *C = dyn_cast<Constant>(V)) {
+        // undef could be chosen differently by each use; do not branch on it
+        return isa<UndefValue>(C) ? nullptr : C;
+    }
+
+    auto *I = dyn_cast<Instruction>(V);
+    if (!I || I->getParent() != BB) {
+        return nullptr;
+    }
+
+    if (auto *PN = dyn_cast<PHINode>(I)) {
+        return evaluateOnEdge(PN->getIncomingValueForBlock(Pred), BB, Pred, DL,
+                              Config.MaxConditionDepth);
+    }
+
+    if (Depth >= Config.MaxConditionDepth) {
+        return nullptr;
+    }
+
+    SmallVector<Constant*, 4> Ops;
+    for (Value *Op : I->operands()) {
+        Constant *C = evaluateOnEdge(Op, BB, Pred, DL, Depth + 1);
+        if (!C) {
+            return nullptr;
+        }
+        Ops.push_back(C);
+    }
+
+    Constant *Folded = ConstantFoldingPass::foldWithOperands(I, Ops, DL);
+    if (Folded && isa<UndefValue>(Folded)) {
+        return nullptr;
+    }
+    return Folded;
+}
+
+BasicBlock *JumpThreadingPass::getKnownSuccessor(Instruction *Term,
+                                                 Constant *C) {
+    auto *CI = dyn_cast<ConstantInt>(C);
+    if (!CI) {
+        return nullptr;
+    }
+
+    if (auto *BI = dyn_cast<BranchInst>(Term)) {
+        return BI->getSuccessor(CI->isOne() ? 0 : 1);
+    }
+
+    auto *SI = cast<SwitchInst>(Term);
+    return SI->findCaseValue(CI)->getCaseSuccessor();
+}
+
+bool JumpThreadingPass::canDuplicate(BasicBlock *BB) {
+    if (BB->hasAddressTaken() || BB->isEHPad()) {
+        return false;
+    }
+
+    unsigned Size = 0;
+    for (Instruction &I : *BB) {
+        if (isa<PHINode>(I) || isa<DbgInfoIntrinsic>(I) || I.isTerminator()) {
+            continue;
+        }
+
+        // Tokens cannot be PHI'd; these calls must not be duplicated
+        if (I.getType()->isTokenTy()) {
+            return false;
+        }
+        if (auto *CB = dyn_cast<CallBase>(&I)) {
+            if (CB->cannotDuplicate() || CB->isConvergent()) {
+                return false;
+            }
+        }
+
+        if (++Size > Config.DuplicationThreshold) {
+            Stats.TooCostly++;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void JumpThreadingPass::threadEdge(BasicBlock *Pred, BasicBlock *BB,
+                                   BasicBlock *Dest, DomTreeUpdater &DTU) {
+    LLVMContext &Ctx = BB->getContext();
+    BasicBlock *NewBB = BasicBlock::Create(Ctx, BB->getName() + ".thread",
+                                           BB->getParent(), BB);
+
+    // PHIs collapse to the value flowing in from Pred; everything else is
+    // cloned with remapped operands
+    ValueToValueMapTy VMap;
+    for (PHINode &PN : BB->phis()) {
+        VMap[&PN] = PN.getIncomingValueForBlock(Pred);
+    }
+
+    BranchInst *NewTerm = BranchInst::Create(Dest, NewBB);
+
+    for (Instruction &I : *BB) {
+        if (isa<PHINode>(I) || I.isTerminator()) {
+            continue;
+        }
+        Instruction *New = I.clone();
+        New->setName(I.getName());
+        New->insertBefore(NewTerm);
+        RemapInstruction(New, VMap,
+                         RF_NoModuleLevelChanges | RF_IgnoreMissingLocals);
+        VMap[&I] = New;
+        Stats.InstructionsDuplicated++;
+    }
+
+    // Dest receives from NewBB what it received from BB
+    for (PHINode &PN : Dest->phis()) {
+        Value *V = PN.getIncomingValueForBlock(BB);
+        if (Value *Mapped = VMap.lookup(V)) {
+            V = Mapped;
+        }
+        PN.addIncoming(V, NewBB);
+    }
+
+    // Retarget every Pred->BB edge
+    Instruction *PredTerm = Pred->getTerminator();
+    for (unsigned I = 0, E = PredTerm->getNumSuccessors(); I != E; ++I) {
+        if (PredTerm->getSuccessor(I) == BB) {
+            BB->removePredecessor(Pred, /*KeepOneInputPHIs=*/true);
+            PredTerm->setSuccessor(I, NewBB);
+        }
+    }
+
+    // Values of BB used outside it now have a second definition in NewBB
+    for (Instruction &I : *BB) {
+        if (I.isTerminator()) {
+            continue;
+        }
+
+        SmallVector<Use*, 8> OutsideUses;
+        for (Use &U : I.uses()) {
+            auto *User = cast<Instruction>(U.getUser());
+            BasicBlock *UseBB = User->getParent();
+            if (auto *UserPN = dyn_cast<PHINode>(User)) {
+                UseBB = UserPN->getIncomingBlock(U);
+            }
+            if (UseBB != BB && UseBB != NewBB) {
+                OutsideUses.push_back(&U);
+            }
+        }
+        if (OutsideUses.empty()) {
+            continue;
+        }
+
+        SSAUpdater SSA;
+        SSA.Initialize(I.getType(), I.getName());
+        SSA.AddAvailableValue(BB, &I);
+        SSA.AddAvailableValue(NewBB, VMap[&I]);
+        for (Use *U : OutsideUses) {
+            SSA.RewriteUse(*U);
+        }
+    }
+
+    // The branch condition is usually dead in the clone
+    for (Instruction &I : make_early_inc_range(reverse(*NewBB))) {
+        if (isInstructionTriviallyDead(&I)) {
+            I.eraseFromParent();
+        }
+    }
+
+    Stats.EdgesThreaded++;
+
+    // A clone left with only its branch is bypassed, unless Pred already
+    // reaches Dest (its PHIs could then need two values from Pred)
+    if (&NewBB->front() == NewTerm &&
+        !is_contained(predecessors(Dest), Pred)) {
+        PredTerm->replaceSuccessorWith(NewBB, Dest);
+        Dest->replacePhiUsesWith(NewBB, Pred);
+        NewBB->eraseFromParent();
+        DTU.applyUpdatesPermissive({{DominatorTree::Insert, Pred, Dest},
+                                    {DominatorTree::Delete, Pred, BB}});
+        return;
+    }
+
+    DTU.applyUpdatesPermissive({{DominatorTree::Insert, Pred, NewBB},
+                                {DominatorTree::Insert, NewBB, Dest},
+                                {DominatorTree::Delete, Pred, BB}});
+}
+
+bool JumpThreadingPass::processBlock(
+    BasicBlock *BB, const SmallPtrSetImpl<BasicBlock*> &LoopHeaders,
+    DomTreeUpdater &DTU) {
+    Instruction *Term = BB->getTerminator();
+    Value *Cond = nullptr;
+
+    if (auto *BI = dyn_cast<BranchInst>(Term)) {
+        if (BI->isConditional()) {
+            Cond = BI->getCondition();
+        }
+    } else if (auto *SI = dyn_cast<SwitchInst>(Term)) {
+        Cond = SI->getCondition();
+    }
+
+    // Constant conditions are left to the folding passes
+    if (!Cond || isa<Constant>(Cond)) {
+        return false;
+    }
+
+    // Threading into or across a loop header would create irreducible or
+    // multi-entry loops
+    if (LoopHeaders.count(BB) || BB->isEntryBlock()) {
+        return false;
+    }
+
+    Stats.BlocksAnalyzed++;
+    const DataLayout &DL = BB->getModule()->getDataLayout();
+
+    SmallSetVector<BasicBlock*, 8> Preds(pred_begin(BB), pred_end(BB));
+    bool Changed = false;
+
+    for (BasicBlock *Pred : Preds) {
+        Instruction *PredTerm = Pred->getTerminator();
+        if (Pred == BB ||
+            (!isa<BranchInst>(PredTerm) && !isa<SwitchInst>(PredTerm))) {
+            continue;
+        }
+
+        Constant *C = evaluateOnEdge(Cond, BB, Pred, DL, 0);
+        if (!C) {
+            continue;
+        }
+
+        BasicBlock *Dest = getKnownSuccessor(Term, C);
+        if (!Dest || Dest == BB || LoopHeaders.count(Dest)) {
+            continue;
+        }
+
+        if (!canDuplicate(BB)) {
+            return Changed;
+        }
+
+        debugPrint("Threading " + Pred->getName() + " -> " + BB->getName() +
+                   " -> " + Dest->getName());
+        threadEdge(Pred, BB, Dest, DTU);
+        Changed = true;
+    }
+
+    // All predecessors may have been threaded away
+    if (Changed && pred_empty(BB)) {
+        DeleteDeadBlock(BB, &DTU);
+        Stats.DeadBlocksRemoved++;
+    }
+
+    return Changed;
+}
+
+PreservedAnalyses JumpThreadingPass::run(Function &F,
+                                         FunctionAnalysisManager &AM) {
+    debugPrint("Running on function: " + F.getName());
+
+    auto &DT = AM.getResult<DominatorTreeAnalysis>(F);
+    DomTreeUpdater DTU(DT, DomTreeUpdater::UpdateStrategy::Lazy);
+
+    bool Changed = false;
+
+    for (unsigned Iter = 0; Iter < Config.MaxIterations; ++Iter) {
+        // Recomputed each sweep since threading changes the CFG
+        SmallVector<std::pair<const BasicBlock*, const BasicBlock*>, 8>
+            Backedges;
+        FindFunctionBackedges(F, Backedges);
+        SmallPtrSet<BasicBlock*, 8> LoopHeaders;
+        for (const auto &Edge : Backedges) {
+            LoopHeaders.insert(const_cast<BasicBlock*>(Edge.second));
+        }
+
+        bool SweepChanged = false;
+        SmallVector<BasicBlock*, 32> Blocks;
+        for (BasicBlock &BB : F) {
+            Blocks.push_back(&BB);
+        }
+
+        for (BasicBlock *BB : Blocks) {
+            // Skip blocks already queued for deletion by the updater
+            if (DTU.isBBPendingDeletion(BB)) {
+                continue;
+            }
+            SweepChanged |= processBlock(BB, LoopHeaders, DTU);
+        }
+
+        Changed |= SweepChanged;
+        if (!SweepChanged) {
+            break;
+        }
+    }
+
+    DTU.flush();
+
+    LLVM_DEBUG(dbgs() << "JumpThreading Statistics:\n"
+                      << "  Blocks analyzed: " << Stats.BlocksAnalyzed << "\n"
+                      << "  Edges threaded: " << Stats.EdgesThreaded << "\n"
+                      << "  Instructions duplicated: "
+                      << Stats.InstructionsDuplicated << "\n"
+                      << "  Too costly: " << Stats.TooCostly << "\n"
+                      << "  Dead blocks removed: " << Stats.DeadBlocksRemoved
+                      << "\n");
+
+    if (!Changed) {
+        return PreservedAnalyses::all();
+    }
+
+    // The CFG changed, but the DominatorTree was kept up to date
+    PreservedAnalyses PA;
+    PA.preserve<DominatorTreeAnalysis>();
+    return PA;
+}
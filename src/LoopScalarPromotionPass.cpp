@@ -0,0 +1,428 @@
+//===- LoopScalarPromotionPass.cpp - Loop Scalar Promotion ------*- C++ -*-===//
+//
+// For each innermost loop, groups simple loads/stores by must-alias address.
+// A group is promoted when its address can be hoisted to the preheader, no
+// other instruction in the loop may touch the location (AliasAnalysis), and
+// storing at the exits cannot introduce a store the original program would
+// not have executed. The loop then works on an SSA value built by SSAUpdater.
+//
+//===----------------------------------------------------------------------===//
+
+#include "LoopScalarPromotionPass.h"
+#include "llvm/Analysis/CaptureTracking.h"
+#include "llvm/Analysis/Loads.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+#include "llvm/Support/Debug.h"
+
+#define DEBUG_TYPE "loop-scalar-promotion"
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+/// Mirror of Loop::makeLoopInvariant without mutating: V is invariant or
+/// computed in the loop from speculatable, non-memory instructions
+static bool canHoistAddress(Value *V, Loop *L, unsigned Depth = 0) {
+    if (L->isLoopInvariant(V)) {
+        return true;
+    }
+
+    auto *I = dyn_cast<Instruction>(V);
+    if (!I || Depth > 8 || isa<PHINode>(I) || I->mayReadFromMemory() ||
+        I->isEHPad() || !isSafeToSpeculativelyExecute(I)) {
+        return false;
+    }
+
+    for (Value *Op : I->operands()) {
+        if (!canHoistAddress(Op, L, Depth + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//===----------------------------------------------------------------------===//
+// LoopScalarPromotionPass Implementation
+//===----------------------------------------------------------------------===//
+
+void LoopScalarPromotionPass::debugPrint(const Twine &Msg) const {
+    if (DebugMode) {
+        errs() << "[LoopScalarPromotion] " << Msg << "\n";
+    }
+}
+
+bool LoopScalarPromotionPass::isPromotableLoop(Loop *L) const {
+    if (!L->isInnermost()) {
+        return false;
+    }
+
+    if (!L->getLoopPreheader() || !L->getLoopLatch()) {
+        LLVM_DEBUG(dbgs() << "  Not in simplified form\n");
+        return false;
+    }
+
+    // Exit stores go into blocks only reachable from the loop
+    if (!L->hasDedicatedExits()) {
+        LLVM_DEBUG(dbgs() << "  Exits are not dedicated\n");
+        return false;
+    }
+
+    SmallVector<BasicBlock*, 4> ExitBlocks;
+    L->getUniqueExitBlocks(ExitBlocks);
+    for (BasicBlock *Exit : ExitBlocks) {
+        if (Exit->isEHPad()) {
+            LLVM_DEBUG(dbgs() << "  Exit through an EH pad\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool LoopScalarPromotionPass::collectCandidates(
+    Loop *L, AAResults &AA,
+    std::vector<PromotionCandidate> &Candidates) const {
+    const DataLayout &DL = L->getHeader()->getModule()->getDataLayout();
+    unsigned MemoryInstructions = 0;
+
+    for (BasicBlock *BB : L->blocks()) {
+        for (Instruction &I : *BB) {
+            if (!I.mayReadOrWriteMemory()) {
+                continue;
+            }
+            if (++MemoryInstructions > Config.MaxMemoryInstructions) {
+                LLVM_DEBUG(dbgs() << "  Too many memory instructions\n");
+                return false;
+            }
+
+            Value *Ptr = nullptr;
+            Type *AccessTy = nullptr;
+            Align Alignment;
+
+            if (auto *Load = dyn_cast<LoadInst>(&I)) {
+                if (!Load->isSimple()) {
+                    continue;
+                }
+                Ptr = Load->getPointerOperand();
+                AccessTy = Load->getType();
+                Alignment = Load->getAlign();
+            } else if (auto *Store = dyn_cast<StoreInst>(&I)) {
+                if (!Store->isSimple()) {
+                    continue;
+                }
+                Ptr = Store->getPointerOperand();
+                AccessTy = Store->getValueOperand()->getType();
+                Alignment = Store->getAlign();
+            } else {
+                continue;
+            }
+
+            TypeSize Size = DL.getTypeStoreSize(AccessTy);
+            if (Size.isScalable()) {
+                continue;
+            }
+            MemoryLocation Loc(Ptr, LocationSize::precise(Size.getFixedValue()));
+
+            // Join the group of an earlier must-alias access of the same type
+            PromotionCandidate *Group = nullptr;
+            for (PromotionCandidate &C : Candidates) {
+                if (C.AccessTy != AccessTy) {
+                    continue;
+                }
+                MemoryLocation GroupLoc(C.Ptr, Loc.Size);
+                if (AA.alias(GroupLoc, Loc) == AliasResult::MustAlias) {
+                    Group = &C;
+                    break;
+                }
+            }
+
+            if (!Group) {
+                Candidates.emplace_back(Ptr, AccessTy, Alignment);
+                Group = &Candidates.back();
+            }
+
+            Group->Alignment = std::min(Group->Alignment, Alignment);
+            if (auto *Load = dyn_cast<LoadInst>(&I)) {
+                Group->Loads.push_back(Load);
+            } else {
+                Group->Stores.push_back(cast<StoreInst>(&I));
+            }
+        }
+    }
+
+    return true;
+}
+
+bool LoopScalarPromotionPass::isAccessedOnlyByCandidate(
+    Loop *L, const PromotionCandidate &C, AAResults &AA) const {
+    const DataLayout &DL = L->getHeader()->getModule()->getDataLayout();
+    MemoryLocation Loc(C.Ptr, LocationSize::precise(
+                                  DL.getTypeStoreSize(C.AccessTy).getFixedValue()));
+
+    SmallPtrSet<const Instruction*, 16> Members;
+    Members.insert(C.Loads.begin(), C.Loads.end());
+    Members.insert(C.Stores.begin(), C.Stores.end());
+
+    for (BasicBlock *BB : L->blocks()) {
+        for (Instruction &I : *BB) {
+            if (!I.mayReadOrWriteMemory() || Members.count(&I)) {
+                continue;
+            }
+            if (isModOrRefSet(AA.getModRefInfo(&I, Loc))) {
+                LLVM_DEBUG(dbgs() << "  Location also accessed by " << I
+                                  << "\n");
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool LoopScalarPromotionPass::hasGuaranteedStore(Loop *L,
+                                                 const PromotionCandidate &C,
+                                                 DominatorTree &DT,
+                                                 ScalarEvolution &SE) const {
+    // Every iteration that starts must reach its end or an exit
+    for (BasicBlock *BB : L->blocks()) {
+        for (Instruction &I : *BB) {
+            if (!isGuaranteedToTransferExecutionToSuccessor(&I)) {
+                return false;
+            }
+        }
+    }
+
+    BasicBlock *Latch = L->getLoopLatch();
+    SmallVector<BasicBlock*, 4> ExitingBlocks;
+    L->getExitingBlocks(ExitingBlocks);
+
+    // A store on every path through the body runs in the first iteration
+    // unless an exit ahead of it may be taken before the first backedge
+    for (StoreInst *SI : C.Stores) {
+        BasicBlock *StoreBB = SI->getParent();
+        if (!DT.dominates(StoreBB, Latch)) {
+            continue;
+        }
+
+        bool ReachedInFirstIteration = true;
+        for (BasicBlock *Exiting : ExitingBlocks) {
+            if (DT.dominates(StoreBB, Exiting)) {
+                continue;
+            }
+            const SCEV *ExitCount = SE.getExitCount(L, Exiting);
+            if (isa<SCEVCouldNotCompute>(ExitCount) ||
+                !SE.isKnownNonZero(ExitCount)) {
+                ReachedInFirstIteration = false;
+                break;
+            }
+        }
+
+        if (ReachedInFirstIteration) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool LoopScalarPromotionPass::isSafeToIntroduceStore(
+    Loop *L, const PromotionCandidate &C) const {
+    if (!Config.PromoteConditionalLocalStores) {
+        return false;
+    }
+
+    // Only a non-escaping alloca is invisible to other threads
+    const Value *Obj = getUnderlyingObject(C.Ptr);
+    if (!isa<AllocaInst>(Obj) ||
+        PointerMayBeCaptured(Obj, /*ReturnCaptures=*/true,
+                             /*StoreCaptures=*/true)) {
+        return false;
+    }
+
+    // The preheader load must not trap either
+    const DataLayout &DL = L->getHeader()->getModule()->getDataLayout();
+    return isSafeToLoadUnconditionally(C.Ptr, C.AccessTy, C.Alignment, DL,
+                                       L->getLoopPreheader()->getTerminator());
+}
+
+bool LoopScalarPromotionPass::promote(Loop *L, PromotionCandidate &C,
+                                      ScalarEvolution &SE) {
+    BasicBlock *Preheader = L->getLoopPreheader();
+
+    // Move the address computation out of the loop
+    if (auto *PtrI = dyn_cast<Instruction>(C.Ptr)) {
+        bool Hoisted = false;
+        if (!L->makeLoopInvariant(PtrI, Hoisted)) {
+            return false;
+        }
+    }
+
+    std::string Name = (C.Ptr->hasName() ? C.Ptr->getName() : "mem").str();
+
+    SmallVector<PHINode*, 8> NewPHIs;
+    SSAUpdater SSA(&NewPHIs);
+    SSA.Initialize(C.AccessTy, Name);
+
+    auto *Initial = new LoadInst(C.AccessTy, C.Ptr, Name + ".promoted",
+                                 /*isVolatile=*/false, C.Alignment,
+                                 Preheader->getTerminator());
+    SSA.AddAvailableValue(Preheader, Initial);
+
+    SmallPtrSet<Instruction*, 16> Members;
+    Members.insert(C.Loads.begin(), C.Loads.end());
+    Members.insert(C.Stores.begin(), C.Stores.end());
+
+    // Within a block, a load after a store reads that store's value; the
+    // last store of a block is what flows out of it
+    DenseMap<LoadInst*, Value*> Replacements;
+    SmallVector<LoadInst*, 4> LiveInLoads;
+
+    for (BasicBlock *BB : L->blocks()) {
+        Value *Live = nullptr;
+        for (Instruction &I : *BB) {
+            if (!Members.count(&I)) {
+                continue;
+            }
+            if (auto *SI = dyn_cast<StoreInst>(&I)) {
+                Live = SI->getValueOperand();
+            } else if (Live) {
+                Replacements[cast<LoadInst>(&I)] = Live;
+            } else {
+                LiveInLoads.push_back(cast<LoadInst>(&I));
+            }
+        }
+        if (Live) {
+            SSA.AddAvailableValue(BB, Live);
+        }
+    }
+
+    for (LoadInst *Load : LiveInLoads) {
+        Replacements[Load] = SSA.GetValueInMiddleOfBlock(Load->getParent());
+    }
+
+    SmallVector<BasicBlock*, 4> ExitBlocks;
+    L->getUniqueExitBlocks(ExitBlocks);
+    SmallVector<std::pair<BasicBlock*, Value*>, 4> ExitValues;
+    for (BasicBlock *Exit : ExitBlocks) {
+        ExitValues.push_back({Exit, SSA.GetValueInMiddleOfBlock(Exit)});
+    }
+
+    // Stored values may themselves be promoted loads
+    auto Resolve = [&](Value *V) {
+        while (auto *Load = dyn_cast<LoadInst>(V)) {
+            auto It = Replacements.find(Load);
+            if (It == Replacements.end()) {
+                break;
+            }
+            V = It->second;
+        }
+        return V;
+    };
+
+    for (auto &[Load, V] : Replacements) {
+        Load->replaceAllUsesWith(Resolve(V));
+    }
+
+    for (auto &[Exit, V] : ExitValues) {
+        new StoreInst(Resolve(V), C.Ptr, /*isVolatile=*/false, C.Alignment,
+                      &*Exit->getFirstInsertionPt());
+        Stats.ExitStoresInserted++;
+    }
+
+    // Drop the in-loop accesses and address computations left unused
+    SmallVector<WeakTrackingVH, 8> DeadPointers;
+    for (Instruction *I : Members) {
+        DeadPointers.push_back(getLoadStorePointerOperand(I));
+        I->eraseFromParent();
+    }
+    RecursivelyDeleteTriviallyDeadInstructionsPermissive(DeadPointers);
+
+    if (Initial->use_empty()) {
+        Initial->eraseFromParent();
+    }
+
+    Stats.LocationsPromoted++;
+    Stats.LoadsEliminated += C.Loads.size();
+    Stats.StoresEliminated += C.Stores.size();
+
+    debugPrint("Promoted " + Twine(Name) + " (" + Twine(C.Loads.size()) +
+               " loads, " + Twine(C.Stores.size()) + " stores, " +
+               Twine(NewPHIs.size()) + " PHIs)");
+
+    SE.forgetLoop(L);
+    return true;
+}
+
+PreservedAnalyses LoopScalarPromotionPass::run(Function &F,
+                                               FunctionAnalysisManager &AM) {
+    debugPrint("Running on function: " + F.getName());
+
+    auto &LI = AM.getResult<LoopAnalysis>(F);
+    if (LI.empty()) {
+        return PreservedAnalyses::all();
+    }
+
+    auto &DT = AM.getResult<DominatorTreeAnalysis>(F);
+    auto &AA = AM.getResult<AAManager>(F);
+    auto &SE = AM.getResult<ScalarEvolutionAnalysis>(F);
+
+    bool Changed = false;
+
+    for (Loop *L : LI.getLoopsInPreorder()) {
+        if (!L->isInnermost()) {
+            continue;
+        }
+        Stats.LoopsAnalyzed++;
+
+        LLVM_DEBUG(dbgs() << "Analyzing loop: " << L->getName() << "\n");
+        if (!isPromotableLoop(L)) {
+            continue;
+        }
+
+        std::vector<PromotionCandidate> Candidates;
+        if (!collectCandidates(L, AA, Candidates)) {
+            continue;
+        }
+
+        for (PromotionCandidate &C : Candidates) {
+            // Read-only locations are left to redundancy elimination
+            if (C.Stores.empty() || !canHoistAddress(C.Ptr, L)) {
+                continue;
+            }
+
+            if (!isAccessedOnlyByCandidate(L, C, AA)) {
+                continue;
+            }
+
+            if (!hasGuaranteedStore(L, C, DT, SE) &&
+                !isSafeToIntroduceStore(L, C)) {
+                LLVM_DEBUG(dbgs() << "  Store is not guaranteed to execute\n");
+                continue;
+            }
+
+            Changed |= promote(L, C, SE);
+        }
+    }
+
+    LLVM_DEBUG(dbgs() << "LoopScalarPromotion Statistics:\n"
+                      << "  Loops analyzed: " << Stats.LoopsAnalyzed << "\n"
+                      << "  Locations promoted: " << Stats.LocationsPromoted
+                      << "\n"
+                      << "  Loads eliminated: " << Stats.LoadsEliminated << "\n"
+                      << "  Stores eliminated: " << Stats.StoresEliminated
+                      << "\n"
+                      << "  Exit stores inserted: " << Stats.ExitStoresInserted
+                      << "\n");
+
+    if (!Changed) {
+        return PreservedAnalyses::all();
+    }
+
+    // Instructions were added and removed but no block or edge changed
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    return PA;
+}
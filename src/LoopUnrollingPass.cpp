@@ -316,6 +316,14 @@ PreservedAnalyses LoopUnrollingPass::run(Function &F,
         return PreservedAnalyses::all();
     }
 
+    // UnrollLoop expects loop-simplify and LCSSA form; mem2reg and scalar
+    // promotion leave values live out of loops without LCSSA PHIs
+    bool Changed = false;
+    for (Loop *L : LI) {
+        Changed |= simplifyLoop(L, &DT, &LI, &SE, &AC, nullptr, false);
+        Changed |= formLCSSARecursively(*L, DT, &LI, &SE);
+    }
+
     // Analyze all loops
     LoopAnalyzer Analyzer(LI, SE, TTI, Config);
     std::vector<LoopUnrollCandidate> Candidates = Analyzer.getCandidates();
@@ -324,14 +332,17 @@ PreservedAnalyses LoopUnrollingPass::run(Function &F,
 
     if (Candidates.empty()) {
         LLVM_DEBUG(dbgs() << "  No unrolling candidates found\n");
-        return PreservedAnalyses::all();
+        if (!Changed) {
+            return PreservedAnalyses::all();
+        }
+        PreservedAnalyses PA;
+        PA.preserve<DominatorTreeAnalysis>();
+        return PA;
     }
 
     LLVM_DEBUG(dbgs() << "  Found " << Candidates.size() 
                       << " unrolling candidates\n");
 
-    bool Changed = false;
-
     // Process candidates (innermost first due to post-order traversal)
     for (const auto &Candidate : Candidates) {
         // Re-check that the loop still exists (previous unrolling may have deleted it)
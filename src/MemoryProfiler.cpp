@@ -0,0 +1,271 @@
+//===- MemoryProfiler.cpp - Per-pass heap profile -------------------------===//
+//
+// Each run pushes a frame holding the counters at its start. The heap
+// hook keeps a single high-water mark, so a run resets it to the current
+// heap when it starts, and when it ends restores the enclosing run's mark
+// raised by its own. Nested runs therefore see their own peak, and the
+// enclosing run still sees theirs.
+//
+// The profiler's own bookkeeping allocates too; it is done outside the
+// counted windows, and the frames on the stack are shifted past it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "MemoryProfiler.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/Format.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+void MemoryUsage::add(const MemoryUsage &Other) {
+    Runs += Other.Runs;
+    Allocations += Other.Allocations;
+    PeakBytes = std::max(PeakBytes, Other.PeakBytes);
+    RetainedBytes += Other.RetainedBytes;
+}
+
+/// Pass managers and adaptors only hold other passes, and proxies only
+/// hand out other analysis managers
+static bool isContainer(StringRef PassID) {
+    return isSpecialPass(PassID, {"PassManager", "PassAdaptor",
+                                  "AnalysisManagerProxy"});
+}
+
+/// The function a function or loop pass runs on; nullptr for module and
+/// CGSCC passes
+static const Function *getFunction(const Any &IR) {
+    if (const auto *F = any_cast<const Function *>(&IR)) {
+        return *F;
+    }
+    if (const auto *L = any_cast<const Loop *>(&IR)) {
+        return (*L)->getHeader()->getParent();
+    }
+    return nullptr;
+}
+
+//===----------------------------------------------------------------------===//
+// MemoryProfiler Implementation
+//===----------------------------------------------------------------------===//
+
+std::unique_ptr<MemoryProfiler>
+MemoryProfiler::create(raw_ostream &OS, MemoryProfilerConfig Config) {
+    // A preloaded library is part of the program's global scope
+    sys::DynamicLibrary Program =
+        sys::DynamicLibrary::getPermanentLibrary(nullptr);
+    auto Read = reinterpret_cast<ReadFn>(
+        Program.getAddressOfSymbol("llvm_opt_passes_heap_read"));
+    auto ExchangePeak = reinterpret_cast<ExchangePeakFn>(
+        Program.getAddressOfSymbol("llvm_opt_passes_heap_exchange_peak"));
+    if (!Read || !ExchangePeak) {
+        return nullptr;
+    }
+    return std::unique_ptr<MemoryProfiler>(
+        new MemoryProfiler(OS, Config, Read, ExchangePeak));
+}
+
+MemoryProfiler::MemoryProfiler(raw_ostream &OS, MemoryProfilerConfig Config,
+                               ReadFn Read, ExchangePeakFn ExchangePeak)
+    : OS(OS), Config(Config), Read(Read), ExchangePeak(ExchangePeak) {}
+
+MemoryProfiler::~MemoryProfiler() {
+    // Pipelines are also built just to check that a name parses
+    if (!Passes.empty()) {
+        print(OS);
+    }
+}
+
+void MemoryProfiler::registerCallbacks(
+    std::shared_ptr<MemoryProfiler> Profiler,
+    PassInstrumentationCallbacks &PIC) {
+    PIC.registerBeforeNonSkippedPassCallback(
+        [Profiler](StringRef PassID, Any IR) {
+            if (!isContainer(PassID)) {
+                Profiler->beforeRun(PassID, IR, /*IsAnalysis=*/false);
+            }
+        });
+    PIC.registerAfterPassCallback(
+        [Profiler](StringRef PassID, Any IR, const PreservedAnalyses &) {
+            if (!isContainer(PassID)) {
+                Profiler->afterRun();
+            }
+        });
+    PIC.registerAfterPassInvalidatedCallback(
+        [Profiler](StringRef PassID, const PreservedAnalyses &) {
+            if (!isContainer(PassID)) {
+                Profiler->afterRun();
+            }
+        });
+    PIC.registerBeforeAnalysisCallback(
+        [Profiler](StringRef PassID, Any IR) {
+            if (!isContainer(PassID)) {
+                Profiler->beforeRun(PassID, IR, /*IsAnalysis=*/true);
+            }
+        });
+    PIC.registerAfterAnalysisCallback(
+        [Profiler](StringRef PassID, Any IR) {
+            if (!isContainer(PassID)) {
+                Profiler->afterRun();
+            }
+        });
+}
+
+void MemoryProfiler::withoutCharge(function_ref<void()> Bookkeeping) {
+    llvm_opt_passes_heap_counters Before, After;
+    Read(&Before);
+    Bookkeeping();
+    Read(&After);
+    for (Frame &Run : Stack) {
+        Run.StartAllocations += After.allocations - Before.allocations;
+        Run.StartBytes += After.live_bytes - Before.live_bytes;
+    }
+}
+
+void MemoryProfiler::beforeRun(StringRef PassID, Any IR, bool IsAnalysis) {
+    withoutCharge([&] {
+        Frame Run{PassID.str(), "", IsAnalysis, 0, 0, 0};
+        if (const Function *F = getFunction(IR)) {
+            Run.Function = F->getName().str();
+            FunctionUsage &Usage = Functions[Run.Function];
+            Usage.Instructions =
+                std::max(Usage.Instructions, F->getInstructionCount());
+        }
+        Stack.push_back(std::move(Run));
+    });
+
+    llvm_opt_passes_heap_counters Counters;
+    Read(&Counters);
+    Frame &Run = Stack.back();
+    Run.StartAllocations = Counters.allocations;
+    Run.StartBytes = Counters.live_bytes;
+    Run.OuterPeakBytes = ExchangePeak(Counters.live_bytes);
+}
+
+void MemoryProfiler::afterRun() {
+    llvm_opt_passes_heap_counters Counters;
+    Read(&Counters);
+    withoutCharge([&] {
+        Frame Run = Stack.pop_back_val();
+        ExchangePeak(std::max(Run.OuterPeakBytes, Counters.peak_bytes));
+
+        MemoryUsage Usage;
+        Usage.Runs = 1;
+        Usage.Allocations = Counters.allocations - Run.StartAllocations;
+        Usage.PeakBytes = Counters.peak_bytes > Run.StartBytes
+                              ? Counters.peak_bytes - Run.StartBytes
+                              : 0;
+        Usage.RetainedBytes =
+            int64_t(Counters.live_bytes) - int64_t(Run.StartBytes);
+
+        (Run.IsAnalysis ? Analyses : Passes)[Run.PassID].add(Usage);
+        if (!Run.Function.empty()) {
+            FunctionUsage &Function = Functions[Run.Function];
+            Function.Passes[Run.PassID].add(Usage);
+            if (Usage.PeakBytes > Function.PeakBytes) {
+                Function.PeakBytes = Usage.PeakBytes;
+                Function.PeakPassID = Run.PassID;
+            }
+        }
+    });
+}
+
+//===----------------------------------------------------------------------===//
+// Report
+//===----------------------------------------------------------------------===//
+
+static void printHeader(raw_ostream &OS, StringRef Title) {
+    OS << "===" << std::string(73, '-') << "===\n";
+    size_t Indent = Title.size() < 79 ? (79 - Title.size()) / 2 : 0;
+    OS.indent(Indent) << Title << "\n";
+    OS << "===" << std::string(73, '-') << "===\n";
+}
+
+/// Usage rows with the highest peak first
+static void printUsageTable(raw_ostream &OS, const StringMap<MemoryUsage> &Map,
+                            StringRef What) {
+    std::vector<const StringMapEntry<MemoryUsage> *> Entries;
+    for (const auto &Entry : Map) {
+        Entries.push_back(&Entry);
+    }
+    llvm::sort(Entries, [](const auto *A, const auto *B) {
+        if (A->second.PeakBytes != B->second.PeakBytes) {
+            return A->second.PeakBytes > B->second.PeakBytes;
+        }
+        return A->first() < B->first();
+    });
+
+    OS << "      Runs  Allocations     Peak KiB   Retained KiB  " << What
+       << "\n";
+    for (const auto *Entry : Entries) {
+        const MemoryUsage &Usage = Entry->second;
+        OS << format("  %8llu %12llu %12.1f %14.1f  ",
+                     (unsigned long long)Usage.Runs,
+                     (unsigned long long)Usage.Allocations,
+                     Usage.PeakBytes / 1024.0, Usage.RetainedBytes / 1024.0)
+           << Entry->first() << "\n";
+    }
+}
+
+void MemoryProfiler::print(raw_ostream &OS) const {
+    printHeader(OS, "Heap profile of passes");
+    OS << "  Peak: most heap above the level at the start of a run.\n"
+       << "  Retained: heap the runs allocated and did not free.\n"
+       << "  Passes include the analyses they computed.\n\n";
+    printUsageTable(OS, Passes, "Pass");
+    if (!Analyses.empty()) {
+        OS << "\n";
+        printUsageTable(OS, Analyses, "Analysis");
+    }
+
+    std::vector<const StringMapEntry<FunctionUsage> *> Largest;
+    for (const auto &Entry : Functions) {
+        Largest.push_back(&Entry);
+    }
+    llvm::sort(Largest, [](const auto *A, const auto *B) {
+        if (A->second.Instructions != B->second.Instructions) {
+            return A->second.Instructions > B->second.Instructions;
+        }
+        return A->first() < B->first();
+    });
+
+    if (Config.TopFunctions && !Largest.empty()) {
+        OS << "\n";
+        printHeader(OS, "High-water marks of the largest functions");
+        OS << "  Instructions  Allocations     Peak KiB  "
+           << left_justify("Pass at peak", 32) << " Function\n";
+        size_t Shown = std::min<size_t>(Largest.size(), Config.TopFunctions);
+        for (size_t I = 0; I < Shown; I++) {
+            const StringMapEntry<FunctionUsage> *Entry = Largest[I];
+            const FunctionUsage &Usage = Entry->second;
+            uint64_t Allocations = 0;
+            for (const auto &Pass : Usage.Passes) {
+                Allocations += Pass.second.Allocations;
+            }
+            OS << format("  %12u %12llu %12.1f  %-32s ", Usage.Instructions,
+                         (unsigned long long)Allocations,
+                         Usage.PeakBytes / 1024.0,
+                         Usage.PeakPassID.c_str())
+               << Entry->first() << "\n";
+        }
+        if (Largest.size() > Shown) {
+            OS << "  (" << Largest.size() - Shown
+               << " smaller functions not shown)\n";
+        }
+    }
+
+    if (Config.PerFunction) {
+        for (const auto *Entry : Largest) {
+            OS << "\n";
+            printHeader(OS, ("Heap profile of " + Entry->first()).str());
+            OS << "  " << Entry->second.Instructions << " instructions\n\n";
+            printUsageTable(OS, Entry->second.Passes, "Pass or analysis");
+        }
+    }
+    OS.flush();
+}
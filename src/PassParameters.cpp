@@ -0,0 +1,220 @@
+//===- PassParameters.cpp - Pass name parameters --------------------------===//
+//
+// Each Config's parameters are listed once, as names of its fields, and
+// the parser and printer both work from that list, so they cannot drift
+// apart when a field is added.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassParameters.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+std::optional<StringRef> llvm::optpasses::getPassParameters(
+    StringRef Name, StringRef PassName) {
+    if (!Name.consume_front(PassName)) {
+        return std::nullopt;
+    }
+    if (Name.empty()) {
+        return StringRef();
+    }
+    if (!Name.consume_front("<") || !Name.consume_back(">")) {
+        return std::nullopt;
+    }
+    return Name;
+}
+
+//===----------------------------------------------------------------------===//
+// Parameter Tables
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// Name=Value parameter setting an unsigned field to at least Min
+template <typename ConfigT>
+struct NumberParameter {
+    StringRef Name;
+    unsigned ConfigT::*Field;
+    unsigned Min = 0;
+};
+
+/// [no-]Name parameter setting a bool field
+template <typename ConfigT>
+struct FlagParameter {
+    StringRef Name;
+    bool ConfigT::*Field;
+};
+
+} // end anonymous namespace
+
+static const NumberParameter<LoopUnrollConfig> LoopUnrollNumbers[] = {
+    {"full-max", &LoopUnrollConfig::FullUnrollMaxCount},
+    {"full-max-insts", &LoopUnrollConfig::FullUnrollMaxInstructions},
+    {"partial", &LoopUnrollConfig::PartialUnrollFactor, 1},
+    {"max-size", &LoopUnrollConfig::MaxUnrolledSize},
+};
+
+static const FlagParameter<LoopUnrollConfig> LoopUnrollFlags[] = {
+    {"runtime", &LoopUnrollConfig::AllowRuntimeUnroll},
+    {"calls", &LoopUnrollConfig::UnrollLoopsWithCalls},
+};
+
+static const NumberParameter<ConstantFoldingConfig> ConstantFoldingNumbers[] = {
+    {"max-iterations", &ConstantFoldingConfig::MaxIterations},
+};
+
+static const FlagParameter<RedundancyEliminationConfig>
+    RedundancyEliminationFlags[] = {
+        {"load-cse", &RedundancyEliminationConfig::EliminateLoads},
+};
+
+//===----------------------------------------------------------------------===//
+// Parser and Printer
+//===----------------------------------------------------------------------===//
+
+template <typename ConfigT>
+static Expected<ConfigT>
+parseParameters(StringRef PassName, StringRef Params,
+                ArrayRef<NumberParameter<ConfigT>> Numbers,
+                ArrayRef<FlagParameter<ConfigT>> Flags) {
+    ConfigT Config;
+    if (Params.empty()) {
+        return Config;
+    }
+
+    auto Invalid = [&](const Twine &Msg) {
+        return createStringError(inconvertibleErrorCode(),
+                                 "invalid " + PassName + " parameter " + Msg);
+    };
+
+    SmallVector<StringRef, 8> Parts;
+    Params.split(Parts, ';');
+    for (StringRef Param : Parts) {
+        StringRef Name, Value;
+        std::tie(Name, Value) = Param.split('=');
+        auto Number = find_if(Numbers, [&](const auto &P) {
+            return P.Name == Name;
+        });
+
+        if (Param.contains('=')) {
+            if (Number == Numbers.end()) {
+                return Invalid("'" + Param + "'");
+            }
+            unsigned N;
+            if (Value.getAsInteger(0, N)) {
+                return Invalid("'" + Param +
+                               "': expected an unsigned integer");
+            }
+            if (N < Number->Min) {
+                return Invalid("'" + Param + "': expected at least " +
+                               Twine(Number->Min));
+            }
+            Config.*(Number->Field) = N;
+            continue;
+        }
+
+        if (Number != Numbers.end()) {
+            return Invalid("'" + Param + "': expected " + Name + "=<value>");
+        }
+        bool Enable = !Name.consume_front("no-");
+        auto Flag = find_if(Flags, [&](const auto &P) {
+            return P.Name == Name;
+        });
+        if (Flag == Flags.end()) {
+            return Invalid("'" + Param + "'");
+        }
+        Config.*(Flag->Field) = Enable;
+    }
+    return Config;
+}
+
+template <typename ConfigT>
+static std::string printParameters(const ConfigT &Config,
+                                   ArrayRef<NumberParameter<ConfigT>> Numbers,
+                                   ArrayRef<FlagParameter<ConfigT>> Flags) {
+    std::string Params;
+    raw_string_ostream OS(Params);
+    ListSeparator LS(";");
+    for (const auto &P : Numbers) {
+        OS << LS << P.Name << "=" << Config.*(P.Field);
+    }
+    for (const auto &P : Flags) {
+        OS << LS << (Config.*(P.Field) ? "" : "no-") << P.Name;
+    }
+    return OS.str();
+}
+
+//===----------------------------------------------------------------------===//
+// Per-Pass Entry Points
+//===----------------------------------------------------------------------===//
+
+Expected<LoopUnrollConfig>
+llvm::optpasses::parseLoopUnrollParameters(StringRef Params) {
+    return parseParameters<LoopUnrollConfig>(
+        "custom-loop-unroll", Params, LoopUnrollNumbers, LoopUnrollFlags);
+}
+
+Expected<ConstantFoldingConfig>
+llvm::optpasses::parseConstantFoldingParameters(StringRef Params) {
+    return parseParameters<ConstantFoldingConfig>(
+        "custom-constant-fold", Params, ConstantFoldingNumbers, {});
+}
+
+Expected<RedundancyEliminationConfig>
+llvm::optpasses::parseRedundancyEliminationParameters(StringRef Params) {
+    return parseParameters<RedundancyEliminationConfig>(
+        "custom-redundancy-elim", Params, {}, RedundancyEliminationFlags);
+}
+
+std::string
+llvm::optpasses::printLoopUnrollParameters(const LoopUnrollConfig &Config) {
+    return printParameters<LoopUnrollConfig>(Config, LoopUnrollNumbers,
+                                             LoopUnrollFlags);
+}
+
+std::string llvm::optpasses::printConstantFoldingParameters(
+    const ConstantFoldingConfig &Config) {
+    return printParameters<ConstantFoldingConfig>(
+        Config, ConstantFoldingNumbers, {});
+}
+
+std::string llvm::optpasses::printRedundancyEliminationParameters(
+    const RedundancyEliminationConfig &Config) {
+    return printParameters<RedundancyEliminationConfig>(
+        Config, {}, RedundancyEliminationFlags);
+}
+
+//===----------------------------------------------------------------------===//
+// Pipeline Config Files
+//===----------------------------------------------------------------------===//
+
+Expected<std::vector<std::string>>
+llvm::optpasses::readPipelineConfig(StringRef Path) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+        MemoryBuffer::getFile(Path, /*IsText=*/true);
+    if (!Buffer) {
+        return createFileError(Path, Buffer.getError());
+    }
+
+    std::vector<std::string> Passes;
+    SmallVector<StringRef, 16> Lines;
+    (*Buffer)->getBuffer().split(Lines, '\n');
+    for (StringRef Line : Lines) {
+        Line = Line.split('#').first.trim();
+        if (!Line.empty()) {
+            Passes.push_back(Line.str());
+        }
+    }
+
+    if (Passes.empty()) {
+        return createStringError(inconvertibleErrorCode(),
+                                 Path + ": no passes listed");
+    }
+    return Passes;
+}
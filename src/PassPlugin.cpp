@@ -0,0 +1,54 @@
+//===- PassPlugin.cpp - Plugin entry point --------------------------------===//
+//
+// llvmGetPassPluginInfo() export for -load-pass-plugin. Everything but the
+// banner is shared with the custom-opt driver through registerOptPasses().
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassRegistration.h"
+
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+//===----------------------------------------------------------------------===//
+// Plugin Interface
+//
+// This is the entry point for the plugin loader. It's called when the
+// shared library is loaded via -load-pass-plugin.
+//===----------------------------------------------------------------------===//
+
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo() {
+    return {
+        LLVM_PLUGIN_API_VERSION,
+        "LLVMOptPasses",
+        LLVM_VERSION_STRING,
+        [](PassBuilder &PB) {
+            registerOptPasses(PB);
+            
+            // Print registration success
+            errs() << "LLVMOptPasses plugin loaded successfully\n";
+            errs() << "Available passes:\n";
+            errs() << "  custom-alloca-promote   - SSA construction (SROA + mem2reg)\n";
+            errs() << "  custom-constant-fold    - Constant folding optimization\n";
+            errs() << "  custom-loop-unroll      - Loop unrolling optimization\n";
+            errs() << "  custom-jump-thread      - Jump threading on known conditions\n";
+            errs() << "  custom-scalar-promote   - Loop scalar promotion of memory\n";
+            errs() << "  custom-reassociate      - Expression reassociation\n";
+            errs() << "  custom-poly-rewrite     - Power and polynomial rewriting\n";
+            errs() << "  custom-invariant-div    - Loop-invariant division by magic numbers\n";
+            errs() << "  custom-specialize       - Function specialization on constant arguments\n";
+            errs() << "  custom-hot-cold-split   - Outline cold regions into cold functions\n";
+            errs() << "  custom-function-order   - Profile-driven function ordering (C3)\n";
+            errs() << "  custom-inline           - Bottom-up cost-based inliner (CGSCC)\n";
+            errs() << "  custom-redundancy-elim  - GVN-based redundancy elimination\n";
+            errs() << "  custom-dse              - MemorySSA dead store elimination\n";
+            errs() << "  custom-store-forward    - MemorySSA store-to-load forwarding\n";
+            errs() << "  print<custom-redundancy> - Print redundancy analysis\n";
+            errs() << "  custom-optimize         - Combined optimization pipeline\n";
+        }
+    };
+}
@@ -1,22 +1,114 @@
-//===- PassRegistration.cpp - Plugin entry point --------------------------===//
+//===- PassRegistration.cpp - Pass registration ---------------------------===//
 //
-// llvmGetPassPluginInfo() export for -load-pass-plugin. Registers passes
-// with the PassBuilder's pipeline parsing callback.
+// Registers passes with the PassBuilder's pipeline parsing callbacks, for
+// both the plugin and the custom-opt driver.
 //
 //===----------------------------------------------------------------------===//
 
+#include "PassRegistration.h"
+#include "AllocaPromotionPass.h"
+#include "ArgumentSpecializationPass.h"
+#include "ColdRegionSplittingPass.h"
 #include "ConstantFoldingPass.h"
+#include "DeadStoreEliminationPass.h"
+#include "FunctionCachePass.h"
+#include "FunctionOrderingPass.h"
+#include "InliningPass.h"
+#include "InvariantDivisionPass.h"
+#include "JumpThreadingPass.h"
+#include "LoopScalarPromotionPass.h"
 #include "LoopUnrollingPass.h"
+#include "MemoryProfiler.h"
+#include "PassParameters.h"
+#include "PolynomialRewritePass.h"
+#include "ReassociationPass.h"
 #include "RedundancyAnalysis.h"
 #include "RedundancyEliminationPass.h"
+#include "StoreForwardingPass.h"
 
 #include "llvm/Passes/PassBuilder.h"
-#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/WithColor.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <memory>
+
 using namespace llvm;
 using namespace llvm::optpasses;
 
+/// Symbol ordering file for the linker, written by custom-function-order
+static cl::opt<std::string> FunctionOrderFile(
+    "custom-function-order-file",
+    cl::desc("Write the function order computed by custom-function-order "
+             "to this file, one symbol per line"),
+    cl::value_desc("filename"));
+
+/// Per-function cache of the custom-optimize function pipeline
+static cl::opt<std::string> FunctionCacheDir(
+    "custom-cache-dir",
+    cl::desc("Cache the custom-optimize function pipeline's result for "
+             "each function in this directory"),
+    cl::value_desc("directory"));
+
+static cl::opt<std::string> FunctionCachePolicy(
+    "custom-cache-policy",
+    cl::desc("Eviction policy of the function cache, e.g. "
+             "prune_after=168h:cache_size_bytes=1g"),
+    cl::init(FunctionCacheConfig().PruningPolicy));
+
+static cl::opt<bool> FunctionCacheStats(
+    "custom-cache-stats",
+    cl::desc("Print function cache hits and misses"));
+
+/// Function pipeline of custom-optimize, e.g. as tuned by autotune.py
+static cl::opt<std::string> OptimizeConfigFile(
+    "custom-optimize-config",
+    cl::desc("Read the passes of the custom-optimize function pipeline "
+             "from this file, one per line"),
+    cl::value_desc("filename"));
+
+/// Heap profile of every pass and analysis; needs the heap hook preloaded
+static cl::opt<bool> MemoryProfile(
+    "custom-memory-profile",
+    cl::desc("Print the heap usage of each pass and analysis and the "
+             "high-water marks of the largest functions (run with "
+             "LD_PRELOAD=LLVMOptPassesHeapHook.so)"));
+
+static cl::opt<unsigned> MemoryProfileTop(
+    "custom-memory-profile-top",
+    cl::desc("Largest functions in the memory profile's high-water marks"),
+    cl::init(MemoryProfilerConfig().TopFunctions));
+
+static cl::opt<bool> MemoryProfileFunctions(
+    "custom-memory-profile-functions",
+    cl::desc("Break the memory profile down by function"));
+
+/// Config for a pass named PassName or PassName<params>, parsed by Parse.
+/// Bad parameters are reported here, since the PassBuilder will only say
+/// the name is unknown.
+template <typename ConfigT>
+static std::optional<ConfigT>
+parsePassName(StringRef Name, StringRef PassName,
+              Expected<ConfigT> (*Parse)(StringRef)) {
+    std::optional<StringRef> Params = getPassParameters(Name, PassName);
+    if (!Params) {
+        return std::nullopt;
+    }
+    Expected<ConfigT> Config = Parse(*Params);
+    if (!Config) {
+        WithColor::error() << toString(Config.takeError()) << "\n";
+        return std::nullopt;
+    }
+    return *Config;
+}
+
+/// Function ordering with the command line's order file, if any
+static FunctionOrderingPass createFunctionOrderingPass() {
+    FunctionOrderingConfig Config;
+    Config.OrderFile = FunctionOrderFile;
+    return FunctionOrderingPass(Config);
+}
+
 //===----------------------------------------------------------------------===//
 // Pass Registration Callbacks
 //
@@ -24,32 +116,180 @@ using namespace llvm::optpasses;
 // for use with the -passes command line option.
 //===----------------------------------------------------------------------===//
 
+static bool registerPipelineParsingCallback(
+    StringRef Name, FunctionPassManager &FPM,
+    ArrayRef<PassBuilder::PipelineElement>);
+
 /// Register our function passes with the pass builder
 static void registerFunctionPasses(FunctionPassManager &FPM,
                                    ArrayRef<PassBuilder::PipelineElement>) {
     // This callback allows insertion into the function pass pipeline
 }
 
+/// Passes of the function pipeline shared by both forms of custom-optimize
+static void addOptimizationPasses(FunctionPassManager &FPM) {
+    // Run passes in optimal order:
+    // 1. Alloca promotion (puts -O0 locals into SSA registers)
+    // 2. Constant folding (simplifies expressions)
+    // 3. Jump threading (bypasses branches decided by folded constants)
+    // 4. Scalar promotion (keeps loop accumulators in registers)
+    // 5. Store forwarding (reuses stored values instead of reloading)
+    // 6. Reassociation (merges constants, canonical operand order)
+    // 7. Polynomial rewriting (fewer multiplies; after reassociation,
+    //    which would flatten the squaring trees again)
+    // 8. Redundancy elimination (removes duplicates)
+    // 9. Dead store elimination (removes overwritten stores)
+    // 10. Invariant division (no hardware divide inside loops)
+    // 11. Loop unrolling (exposes more optimization opportunities)
+    FPM.addPass(AllocaPromotionPass());
+    FPM.addPass(ConstantFoldingPass());
+    FPM.addPass(JumpThreadingPass());
+    FPM.addPass(LoopScalarPromotionPass());
+    FPM.addPass(StoreForwardingPass());
+    FPM.addPass(ReassociationPass());
+    FPM.addPass(PolynomialRewritePass());
+    FPM.addPass(RedundancyEliminationPass());
+    FPM.addPass(DeadStoreEliminationPass());
+    FPM.addPass(InvariantDivisionPass());
+    FPM.addPass(LoopUnrollingPass());
+}
+
+/// The function pipeline as the cache key names it: the parameterized
+/// passes with their parameters
+static std::string getOptimizationKey() {
+    return "custom-optimize custom-constant-fold<" +
+           printConstantFoldingParameters(ConstantFoldingConfig()) +
+           "> custom-redundancy-elim<" +
+           printRedundancyEliminationParameters(
+               RedundancyEliminationConfig()) +
+           "> custom-loop-unroll<" +
+           printLoopUnrollParameters(LoopUnrollConfig()) + ">";
+}
+
+/// Add the passes of the config file instead of the built-in order, and
+/// set Key to name them for the cache. Errors are reported here, as for
+/// bad pass parameters.
+static bool addConfiguredPasses(FunctionPassManager &FPM, std::string &Key) {
+    Expected<std::vector<std::string>> Passes =
+        readPipelineConfig(OptimizeConfigFile);
+    if (!Passes) {
+        WithColor::error() << toString(Passes.takeError()) << "\n";
+        return false;
+    }
+
+    Key = "custom-optimize-config";
+    for (const std::string &Name : *Passes) {
+        // The file replaces custom-optimize, so it cannot contain it
+        if (Name == "custom-optimize" ||
+            !registerPipelineParsingCallback(Name, FPM, {})) {
+            WithColor::error() << OptimizeConfigFile
+                               << ": unknown function pass '" << Name
+                               << "'\n";
+            return false;
+        }
+        Key += " " + Name;
+    }
+    return true;
+}
+
+/// The function pipeline of custom-optimize, behind the function cache if
+/// the command line gives one
+static bool addOptimizationPipeline(FunctionPassManager &FPM) {
+    FunctionPassManager Passes;
+    std::string Key = getOptimizationKey();
+    if (OptimizeConfigFile.empty()) {
+        addOptimizationPasses(Passes);
+    } else if (!addConfiguredPasses(Passes, Key)) {
+        return false;
+    }
+
+    if (FunctionCacheDir.empty()) {
+        FPM.addPass(std::move(Passes));
+        return true;
+    }
+
+    FunctionCacheConfig Config;
+    Config.Directory = FunctionCacheDir;
+    Config.PruningPolicy = FunctionCachePolicy;
+    Config.PrintStatistics = FunctionCacheStats;
+
+    FPM.addPass(FunctionCachePass(std::make_shared<FunctionCache>(Config),
+                                  std::move(Passes), Key));
+    return true;
+}
+
 /// Register passes for parsing from command line
 static bool registerPipelineParsingCallback(
     StringRef Name, FunctionPassManager &FPM,
     ArrayRef<PassBuilder::PipelineElement>) {
     
-    // Constant Folding Pass
-    if (Name == "custom-constant-fold") {
-        FPM.addPass(ConstantFoldingPass());
+    // SSA Construction Pass (SROA + mem2reg)
+    if (Name == "custom-alloca-promote") {
+        FPM.addPass(AllocaPromotionPass());
+        return true;
+    }
+    
+    // Constant Folding Pass (custom-constant-fold<max-iterations=N>)
+    if (auto Config = parsePassName(Name, "custom-constant-fold",
+                                    parseConstantFoldingParameters)) {
+        FPM.addPass(ConstantFoldingPass(*Config));
+        return true;
+    }
+    
+    // Loop Unrolling Pass (e.g. custom-loop-unroll<full-max=16;no-runtime>)
+    if (auto Config = parsePassName(Name, "custom-loop-unroll",
+                                    parseLoopUnrollParameters)) {
+        FPM.addPass(LoopUnrollingPass(*Config));
+        return true;
+    }
+    
+    // Jump Threading Pass (duplicates blocks along known-condition edges)
+    if (Name == "custom-jump-thread") {
+        FPM.addPass(JumpThreadingPass());
+        return true;
+    }
+    
+    // Reassociation Pass (canonical operand order, merged constants)
+    if (Name == "custom-reassociate") {
+        FPM.addPass(ReassociationPass());
+        return true;
+    }
+    
+    // Polynomial Rewrite Pass (powers by squaring, Horner/Estrin form)
+    if (Name == "custom-poly-rewrite") {
+        FPM.addPass(PolynomialRewritePass());
         return true;
     }
     
-    // Loop Unrolling Pass
-    if (Name == "custom-loop-unroll") {
-        FPM.addPass(LoopUnrollingPass());
+    // Invariant Division Pass (magic-number division in loops)
+    if (Name == "custom-invariant-div") {
+        FPM.addPass(InvariantDivisionPass());
         return true;
     }
     
-    // Redundancy Elimination Pass (includes analysis)
-    if (Name == "custom-redundancy-elim") {
-        FPM.addPass(RedundancyEliminationPass());
+    // Loop Scalar Promotion Pass (registers for loop-carried memory)
+    if (Name == "custom-scalar-promote") {
+        FPM.addPass(LoopScalarPromotionPass());
+        return true;
+    }
+    
+    // Redundancy Elimination Pass (includes analysis;
+    // custom-redundancy-elim<load-cse> also removes repeated loads)
+    if (auto Config = parsePassName(Name, "custom-redundancy-elim",
+                                    parseRedundancyEliminationParameters)) {
+        FPM.addPass(RedundancyEliminationPass(*Config));
+        return true;
+    }
+    
+    // Dead Store Elimination Pass (MemorySSA based)
+    if (Name == "custom-dse") {
+        FPM.addPass(DeadStoreEliminationPass());
+        return true;
+    }
+    
+    // Store-to-Load Forwarding Pass (MemorySSA based)
+    if (Name == "custom-store-forward") {
+        FPM.addPass(StoreForwardingPass());
         return true;
     }
     
@@ -59,15 +299,84 @@ static bool registerPipelineParsingCallback(
         return true;
     }
     
-    // Combined optimization pass
+    // Combined optimization pass (function-only form, e.g. function(...))
+    if (Name == "custom-optimize") {
+        return addOptimizationPipeline(FPM);
+    }
+    
+    return false;
+}
+
+/// Register CGSCC passes for parsing from command line
+static bool registerCGSCCPipelineParsingCallback(
+    StringRef Name, CGSCCPassManager &CGPM,
+    ArrayRef<PassBuilder::PipelineElement>) {
+    
+    // Inlining Pass (bottom-up, TTI cost model)
+    if (Name == "custom-inline") {
+        CGPM.addPass(InliningPass());
+        return true;
+    }
+    
+    return false;
+}
+
+/// Register module passes for parsing from command line
+static bool registerModulePipelineParsingCallback(
+    StringRef Name, ModulePassManager &MPM,
+    ArrayRef<PassBuilder::PipelineElement>) {
+    
+    // Argument Specialization Pass (clones for constant call arguments)
+    if (Name == "custom-specialize") {
+        MPM.addPass(ArgumentSpecializationPass());
+        return true;
+    }
+    
+    // Hot/Cold Splitting Pass (outlines cold regions into cold functions)
+    if (Name == "custom-hot-cold-split") {
+        MPM.addPass(ColdRegionSplittingPass());
+        return true;
+    }
+    
+    // Function Ordering Pass (C3 clustering of hot callers and callees)
+    if (Name == "custom-function-order") {
+        MPM.addPass(createFunctionOrderingPass());
+        return true;
+    }
+    
+    // Combined optimization pipeline. At the top level this form wins over
+    // the function one: functions are visited bottom-up over the call
+    // graph, so each caller inlines callees that are already optimized and
+    // is then optimized itself
     if (Name == "custom-optimize") {
-        // Run passes in optimal order:
-        // 1. Constant folding (simplifies expressions)
-        // 2. Redundancy elimination (removes duplicates)
-        // 3. Loop unrolling (exposes more optimization opportunities)
-        FPM.addPass(ConstantFoldingPass());
-        FPM.addPass(RedundancyEliminationPass());
-        FPM.addPass(LoopUnrollingPass());
+        // Built first, so a bad config file leaves MPM untouched
+        FunctionPassManager FPM;
+        if (!addOptimizationPipeline(FPM)) {
+            return false;
+        }
+
+        // Early cleanup so call sites see constant arguments rather than
+        // loads of -O0 locals
+        FunctionPassManager EarlyFPM;
+        EarlyFPM.addPass(AllocaPromotionPass());
+        EarlyFPM.addPass(ConstantFoldingPass());
+        MPM.addPass(createModuleToFunctionPassAdaptor(std::move(EarlyFPM)));
+
+        // Clone functions too large to inline for their constant call
+        // arguments, before the walk optimizes the clones
+        MPM.addPass(ArgumentSpecializationPass());
+
+        CGSCCPassManager CGPM;
+        CGPM.addPass(InliningPass());
+        CGPM.addPass(createCGSCCToFunctionPassAdaptor(std::move(FPM)));
+        MPM.addPass(createModuleToPostOrderCGSCCPassAdaptor(std::move(CGPM)));
+
+        // Split last, once inlining has brought callers' error paths and
+        // their callees' together into one body
+        MPM.addPass(ColdRegionSplittingPass());
+
+        // Lay out the final functions; without a profile this does nothing
+        MPM.addPass(createFunctionOrderingPass());
         return true;
     }
     
@@ -80,52 +389,206 @@ static void registerAnalyses(FunctionAnalysisManager &FAM) {
 }
 
 //===----------------------------------------------------------------------===//
-// Plugin Interface
+// Default Pipeline Extension Points
 //
-// This is the entry point for the plugin loader. It's called when the
-// shared library is loaded via -load-pass-plugin.
+// Under clang -O<n> -fpass-plugin=, each pass joins the default pipeline
+// where it helps most, with thresholds for the level:
+//   Peephole:             constant folding, after every InstCombine
+//   ScalarOptimizerLate:  redundancy elimination, after GVN and LICM
+//   VectorizerStart:      full unrolling of short loops, none at -Oz
+// Partial and runtime unrolling are left to the vectorizer's interleaving
+// and LLVM's own unroller, which run after it.
 //===----------------------------------------------------------------------===//
 
-extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
-llvmGetPassPluginInfo() {
-    return {
-        LLVM_PLUGIN_API_VERSION,
-        "LLVMOptPasses",
-        LLVM_VERSION_STRING,
-        [](PassBuilder &PB) {
-            // Register analysis passes
-            PB.registerAnalysisRegistrationCallback(
-                [](FunctionAnalysisManager &FAM) {
-                    registerAnalyses(FAM);
-                });
-            
-            // Register transformation passes for -passes option
-            PB.registerPipelineParsingCallback(registerPipelineParsingCallback);
-            
-            // Optionally register passes to run at specific extension points
-            // For example, to run at the end of the optimization pipeline:
-            PB.registerOptimizerLastEPCallback(
-                [](ModulePassManager &MPM, OptimizationLevel Level) {
-                    if (Level != OptimizationLevel::O0) {
-                        // Add our passes at the end of optimization
-                        FunctionPassManager FPM;
-                        FPM.addPass(ConstantFoldingPass());
-                        FPM.addPass(RedundancyEliminationPass());
-                        // Don't auto-add loop unrolling - it's expensive
-                        MPM.addPass(createModuleToFunctionPassAdaptor(std::move(FPM)));
-                    }
-                });
-            
-            // Print registration success
-            errs() << "LLVMOptPasses plugin loaded successfully\n";
-            errs() << "Available passes:\n";
-            errs() << "  custom-constant-fold    - Constant folding optimization\n";
-            errs() << "  custom-loop-unroll      - Loop unrolling optimization\n";
-            errs() << "  custom-redundancy-elim  - GVN-based redundancy elimination\n";
-            errs() << "  print<custom-redundancy> - Print redundancy analysis\n";
-            errs() << "  custom-optimize         - Combined optimization pipeline\n";
-        }
-    };
+/// Folding at every peephole point. These recur throughout the pipeline,
+/// so one sweep each is enough.
+static ConstantFoldingConfig getPeepholeFoldingConfig() {
+    ConstantFoldingConfig Config;
+    Config.MaxIterations = 1;
+    return Config;
+}
+
+/// Unrolling ahead of the vectorizer at Level, if any
+static std::optional<LoopUnrollConfig>
+getVectorizerStartUnrollConfig(OptimizationLevel Level) {
+    if (Level == OptimizationLevel::Oz) {
+        return std::nullopt;
+    }
+
+    // Full unrolling only: partially unrolled loops are harder to vectorize
+    LoopUnrollConfig Config;
+    Config.PartialUnrollFactor = 1;
+    Config.AllowRuntimeUnroll = false;
+
+    if (Level == OptimizationLevel::Os) {
+        // Only loops that unroll to about the size of the loop itself
+        Config.FullUnrollMaxCount = 4;
+        Config.FullUnrollMaxInstructions = 32;
+        Config.MaxUnrolledSize = 32;
+    } else if (Level == OptimizationLevel::O3) {
+        Config.FullUnrollMaxCount = 16;
+        Config.FullUnrollMaxInstructions = 200;
+        Config.MaxUnrolledSize = 800;
+    }
+    return Config;
+}
+
+static void registerDefaultPipelinePasses(PassBuilder &PB) {
+    PB.registerPeepholeEPCallback(
+        [](FunctionPassManager &FPM, OptimizationLevel Level) {
+            if (Level != OptimizationLevel::O0) {
+                FPM.addPass(ConstantFoldingPass(getPeepholeFoldingConfig()));
+            }
+        });
+
+    PB.registerScalarOptimizerLateEPCallback(
+        [](FunctionPassManager &FPM, OptimizationLevel Level) {
+            if (Level != OptimizationLevel::O0) {
+                FPM.addPass(RedundancyEliminationPass());
+            }
+        });
+
+    PB.registerVectorizerStartEPCallback(
+        [](FunctionPassManager &FPM, OptimizationLevel Level) {
+            if (Level == OptimizationLevel::O0) {
+                return;
+            }
+            if (auto Config = getVectorizerStartUnrollConfig(Level)) {
+                FPM.addPass(LoopUnrollingPass(*Config));
+            }
+        });
+}
+
+//===----------------------------------------------------------------------===//
+// Link-Time Optimization
+//
+// Full LTO sees the whole program with its symbols internalized, so every
+// call site of a function is known when specializing, and the function
+// order covers the final binary. ThinLTO backends see one module plus the
+// definitions imported into it as available_externally, and specialize
+// those at OptimizerEarly, so constants cross modules through LLVM's own
+// import decisions rather than through a summary of ours.
+//
+// OptimizerEarly also runs in -O<n> compiles and in both pre-link
+// pipelines, where the program is not yet visible. The callbacks do not
+// say which pipeline is being built, but only pipelines that start from a
+// frontend's IR run PipelineStart first; the LTO backends never do. So
+// specialization is added at OptimizerEarly only when PipelineStart did not
+// run earlier in the same pipeline, i.e. in the ThinLTO backends.
+//
+// ThinLTO backends build one pipeline per thread, and the passes keep
+// their state (configs and statistics) in the pass objects, so backends
+// share nothing mutable. The function order file is written only by full
+// LTO, which runs one pipeline for the whole program.
+//===----------------------------------------------------------------------===//
+
+static void registerLinkTimePasses(PassBuilder &PB) {
+    PB.registerFullLinkTimeOptimizationEarlyEPCallback(
+        [](ModulePassManager &MPM, OptimizationLevel Level) {
+            // Clones before LTO's inliner and IPSCCP, which then treat them
+            // like any other internal function
+            if (Level.getSpeedupLevel() >= 2 && !Level.isOptimizingForSize()) {
+                MPM.addPass(ArgumentSpecializationPass());
+            }
+        });
+
+    PB.registerFullLinkTimeOptimizationLastEPCallback(
+        [](ModulePassManager &MPM, OptimizationLevel Level) {
+            if (Level == OptimizationLevel::O0) {
+                return;
+            }
+            MPM.addPass(ColdRegionSplittingPass());
+
+            // Lay out the final functions; without a profile this does nothing
+            MPM.addPass(createFunctionOrderingPass());
+        });
+
+    // Whether the pipeline being built started at PipelineStart; each
+    // PassBuilder builds one pipeline at a time
+    auto FromFrontend = std::make_shared<bool>(false);
+
+    PB.registerPipelineStartEPCallback(
+        [FromFrontend](ModulePassManager &, OptimizationLevel) {
+            *FromFrontend = true;
+        });
+
+    PB.registerOptimizerEarlyEPCallback(
+        [FromFrontend](ModulePassManager &MPM, OptimizationLevel Level) {
+            // After the inliner, so only calls too large to inline are left
+            if (!*FromFrontend && Level.getSpeedupLevel() >= 2 &&
+                !Level.isOptimizingForSize()) {
+                MPM.addPass(ArgumentSpecializationPass());
+            }
+        });
+
+    // Every pipeline ends here, so the next one starts unmarked
+    PB.registerOptimizerLastEPCallback(
+        [FromFrontend](ModulePassManager &, OptimizationLevel) {
+            *FromFrontend = false;
+        });
+}
+
+//===----------------------------------------------------------------------===//
+// Memory Profile
+//
+// The profiler hooks into the instrumentation of the pass builder, so it
+// sees every pass of the pipeline, LLVM's included, and the analyses they
+// request. It prints its report when the instrumentation is destroyed,
+// after the pipeline has run.
+//===----------------------------------------------------------------------===//
+
+static void registerMemoryProfiler(PassBuilder &PB) {
+    PassInstrumentationCallbacks *PIC = PB.getPassInstrumentationCallbacks();
+    if (!PIC) {
+        WithColor::warning() << "-custom-memory-profile: this tool runs "
+                                "passes without instrumentation\n";
+        return;
+    }
+
+    MemoryProfilerConfig Config;
+    Config.TopFunctions = MemoryProfileTop;
+    Config.PerFunction = MemoryProfileFunctions;
+    std::unique_ptr<MemoryProfiler> Profiler =
+        MemoryProfiler::create(errs(), Config);
+    if (!Profiler) {
+        WithColor::warning() << "-custom-memory-profile needs the heap hook: "
+                                "run with LD_PRELOAD=<build>/"
+                                "LLVMOptPassesHeapHook.so\n";
+        return;
+    }
+    MemoryProfiler::registerCallbacks(std::move(Profiler), *PIC);
+}
+
+//===----------------------------------------------------------------------===//
+// Registration Entry Point
+//
+// Shared by the plugin entry point (PassPlugin.cpp) and the custom-opt
+// driver, which links the passes statically.
+//===----------------------------------------------------------------------===//
+
+void llvm::optpasses::registerOptPasses(PassBuilder &PB) {
+    // Register analysis passes
+    PB.registerAnalysisRegistrationCallback(
+        [](FunctionAnalysisManager &FAM) {
+            registerAnalyses(FAM);
+        });
+    
+    // Register transformation passes for -passes option
+    PB.registerPipelineParsingCallback(registerPipelineParsingCallback);
+    PB.registerPipelineParsingCallback(
+        registerCGSCCPipelineParsingCallback);
+    PB.registerPipelineParsingCallback(
+        registerModulePipelineParsingCallback);
+    
+    // Extend the default pipelines (clang -O<n> -fpass-plugin=)
+    registerDefaultPipelinePasses(PB);
+
+    // Extend the full and thin LTO pipelines (-flto[=thin])
+    registerLinkTimePasses(PB);
+
+    if (MemoryProfile) {
+        registerMemoryProfiler(PB);
+    }
 }
 
 //===----------------------------------------------------------------------===//
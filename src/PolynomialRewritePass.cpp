@@ -0,0 +1,642 @@
+//===- PolynomialRewritePass.cpp - Polynomial Rewriting ---------*- C++ -*-===//
+//
+// Works one block at a time. Sums are handled first: each maximal tree of
+// single-use adds is flattened into product terms, the variable shared by
+// most terms is chosen as x, and the terms are regrouped by their power of
+// x into Horner's or Estrin's scheme. Remaining product trees are then
+// rewritten with exponentiation by squaring. Powers are cached per block,
+// so x^2 built for one expression is reused by the next. A rewrite is only
+// done when it needs fewer multiplies than the code it replaces.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PolynomialRewritePass.h"
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+
+#include <string>
+
+#define DEBUG_TYPE "polynomial-rewrite"
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+//===----------------------------------------------------------------------===//
+// PolynomialRewritePass Implementation
+//===----------------------------------------------------------------------===//
+
+void PolynomialRewritePass::debugPrint(const Twine &Msg) const {
+    if (DebugMode) {
+        errs() << "[PolynomialRewrite] " << Msg << "\n";
+    }
+}
+
+unsigned PolynomialRewritePass::getPowiExponent(const Value *V) const {
+    auto *II = dyn_cast<IntrinsicInst>(V);
+    if (!II || II->getIntrinsicID() != Intrinsic::powi) {
+        return 0;
+    }
+
+    // Negative exponents would need a division
+    auto *Exp = dyn_cast<ConstantInt>(II->getArgOperand(1));
+    if (!Exp || Exp->isNegative() || Exp->isZero() ||
+        Exp->getZExtValue() > Config.MaxExponent) {
+        return 0;
+    }
+    return Exp->getZExtValue();
+}
+
+bool PolynomialRewritePass::isReassociableMul(const Value *V,
+                                              unsigned MulOpcode) {
+    auto *BO = dyn_cast<BinaryOperator>(V);
+    if (!BO || BO->getOpcode() != MulOpcode) {
+        return false;
+    }
+    return MulOpcode == Instruction::Mul || BO->hasAllowReassoc();
+}
+
+bool PolynomialRewritePass::isReassociableAdd(const Value *V,
+                                              unsigned AddOpcode) {
+    auto *BO = dyn_cast<BinaryOperator>(V);
+    if (!BO || BO->getOpcode() != AddOpcode) {
+        return false;
+    }
+    if (AddOpcode == Instruction::Add) {
+        return true;
+    }
+    return AddOpcode == Instruction::FAdd && BO->hasAllowReassoc() &&
+           BO->hasNoSignedZeros();
+}
+
+bool PolynomialRewritePass::isInnerFactor(const Value *V,
+                                          const Instruction *Parent,
+                                          unsigned MulOpcode) const {
+    auto *I = dyn_cast<Instruction>(V);
+    if (!I || !I->hasOneUse() || I->getParent() != Parent->getParent()) {
+        return false;
+    }
+
+    // powi leaves the order of its multiplies unspecified
+    return isReassociableMul(I, MulOpcode) ||
+           (MulOpcode == Instruction::FMul && getPowiExponent(I));
+}
+
+bool PolynomialRewritePass::collectProduct(Instruction *Root,
+                                           unsigned MulOpcode, ProductTerm &T,
+                                           const DataLayout &DL) const {
+    SmallVector<Instruction*, 8> Worklist;
+    Worklist.push_back(Root);
+    T.Nodes.push_back(Root);
+
+    while (!Worklist.empty()) {
+        Instruction *N = Worklist.pop_back_val();
+
+        if (unsigned E = getPowiExponent(N)) {
+            T.Powers[cast<CallBase>(N)->getArgOperand(0)] += E;
+            SmallDenseSet<unsigned, 8> Have;
+            T.MultiplyCost += getPowerCost(nullptr, E, FastMathFlags(), Have);
+            continue;
+        }
+
+        T.MultiplyCost++;
+        for (Value *Op : N->operands()) {
+            if (isInnerFactor(Op, N, MulOpcode)) {
+                auto *Inner = cast<Instruction>(Op);
+                T.Nodes.push_back(Inner);
+                Worklist.push_back(Inner);
+                continue;
+            }
+
+            auto *C = dyn_cast<Constant>(Op);
+            if (C && !T.Coefficient) {
+                T.Coefficient = C;
+                continue;
+            }
+            if (C) {
+                if (Constant *R = ConstantFoldBinaryOpOperands(
+                        MulOpcode, T.Coefficient, C, DL)) {
+                    T.Coefficient = R;
+                    continue;
+                }
+            }
+            T.Powers[Op]++;
+        }
+    }
+
+    for (const auto &Entry : T.Powers) {
+        if (Entry.second > Config.MaxExponent) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Value *PolynomialRewritePass::findPower(Value *Base, unsigned E,
+                                        FastMathFlags FMF) const {
+    auto It = Cache.find({Base, E});
+    if (It == Cache.end()) {
+        return nullptr;
+    }
+
+    // A power computed under flags the expression lacks may be poison, or
+    // differ, where the expression is not
+    FastMathFlags Common = It->second.Assumed;
+    Common &= FMF;
+    return Common != It->second.Assumed ? nullptr : It->second.Power;
+}
+
+unsigned PolynomialRewritePass::getPowerCost(
+    Value *Base, unsigned E, FastMathFlags FMF,
+    SmallDenseSet<unsigned, 8> &Have) const {
+    if (E <= 1 || Have.count(E) || findPower(Base, E, FMF)) {
+        return 0;
+    }
+
+    // Mirrors buildPower: square for even exponents, else one more factor
+    unsigned Cost =
+        1 + getPowerCost(Base, E % 2 ? E - 1 : E / 2, FMF, Have);
+    Have.insert(E);
+    return Cost;
+}
+
+Value *PolynomialRewritePass::buildPower(Value *Base, unsigned E,
+                                         unsigned MulOpcode,
+                                         IRBuilder<> &Builder) {
+    if (E == 1) {
+        return Base;
+    }
+
+    FastMathFlags FMF = Builder.getFastMathFlags();
+    if (Value *Cached = findPower(Base, E, FMF)) {
+        Stats.PowersReused++;
+        return Cached;
+    }
+
+    std::string Name;
+    if (Base->hasName()) {
+        Name = (Base->getName() + ".pow" + Twine(E)).str();
+    }
+
+    Value *Power;
+    auto Op = static_cast<Instruction::BinaryOps>(MulOpcode);
+    if (E % 2 == 0) {
+        Value *Half = buildPower(Base, E / 2, MulOpcode, Builder);
+        Power = Builder.CreateBinOp(Op, Half, Half, Name);
+    } else {
+        Value *Prev = buildPower(Base, E - 1, MulOpcode, Builder);
+        Power = Builder.CreateBinOp(Op, Prev, Base, Name);
+    }
+
+    Cache[{Base, E}] = {Power, FMF};
+    return Power;
+}
+
+Value *PolynomialRewritePass::buildProduct(const ProductTerm &T, Value *Skip,
+                                           unsigned MulOpcode,
+                                           IRBuilder<> &Builder) {
+    auto Op = static_cast<Instruction::BinaryOps>(MulOpcode);
+    Value *Product = nullptr;
+
+    for (const auto &[Base, E] : T.Powers) {
+        if (Base == Skip) {
+            continue;
+        }
+        Value *Power = buildPower(Base, E, MulOpcode, Builder);
+        Product = Product ? Builder.CreateBinOp(Op, Product, Power) : Power;
+    }
+
+    // Constant last, as custom-reassociate orders it
+    if (T.Coefficient && !T.Coefficient->isOneValue()) {
+        Product = Product ? Builder.CreateBinOp(Op, Product, T.Coefficient)
+                          : T.Coefficient;
+    }
+
+    // nullptr stands for 1
+    return Product;
+}
+
+void PolynomialRewritePass::cacheKeptPower(const ProductTerm &T,
+                                           Instruction *Root) {
+    // Reused, the power brings the flags of every node computing it
+    FastMathFlags Assumed;
+    for (Instruction *N : T.Nodes) {
+        if (isa<OverflowingBinaryOperator>(N) &&
+            (N->hasNoSignedWrap() || N->hasNoUnsignedWrap())) {
+            return;
+        }
+        if (isa<FPMathOperator>(N)) {
+            Assumed |= N->getFastMathFlags();
+        }
+    }
+    Cache.try_emplace({T.Powers.front().first, T.Powers.front().second},
+                      CachedPower{Root, Assumed});
+}
+
+bool PolynomialRewritePass::rewriteProduct(Instruction *Root,
+                                           const DataLayout &DL) {
+    unsigned MulOpcode = getPowiExponent(Root) ? unsigned(Instruction::FMul)
+                                               : Root->getOpcode();
+
+    ProductTerm T;
+    if (!collectProduct(Root, MulOpcode, T, DL)) {
+        return false;
+    }
+
+    bool HasCoefficient = T.Coefficient && !T.Coefficient->isOneValue();
+    bool HasPowi = false;
+    for (Instruction *N : T.Nodes) {
+        HasPowi |= isa<CallBase>(N);
+    }
+
+    // The rewrite keeps the flags all nodes share, and drops nsw/nuw
+    FastMathFlags FMF;
+    if (isa<FPMathOperator>(Root)) {
+        FMF = Root->getFastMathFlags();
+        for (Instruction *N : T.Nodes) {
+            FMF &= N->getFastMathFlags();
+        }
+    }
+
+    unsigned NewCost = 0;
+    unsigned Factors = HasCoefficient ? 1 : 0;
+    bool HasRepeatedFactor = false;
+    for (const auto &[Base, E] : T.Powers) {
+        SmallDenseSet<unsigned, 8> Have;
+        NewCost += getPowerCost(Base, E, FMF, Have);
+        HasRepeatedFactor |= E > 1;
+        Factors++;
+    }
+    NewCost += Factors ? Factors - 1 : 0;
+
+    // A plain power that stays is still a reusable power
+    bool IsPurePower = T.Powers.size() == 1 && !HasCoefficient;
+
+    // powi is expanded even at equal cost: its squares become reusable
+    bool Profitable = NewCost < T.MultiplyCost ||
+                      (HasPowi && NewCost == T.MultiplyCost);
+    if (!HasRepeatedFactor || !Profitable) {
+        if (IsPurePower) {
+            cacheKeptPower(T, Root);
+        }
+        return false;
+    }
+
+    IRBuilder<> Builder(Root);
+    Builder.setFastMathFlags(FMF);
+
+    Value *Result = buildProduct(T, nullptr, MulOpcode, Builder);
+    if (!Result) {
+        Result = T.Coefficient;
+    }
+    if (auto *I = dyn_cast<Instruction>(Result); I && !I->hasName()) {
+        I->takeName(Root);
+    }
+
+    debugPrint("  Expanded product " + Root->getName() + " with " +
+               Twine(NewCost) + " multiplies instead of " +
+               Twine(T.MultiplyCost));
+
+    Root->replaceAllUsesWith(Result);
+    for (Instruction *N : T.Nodes) {
+        N->eraseFromParent();
+    }
+
+    Stats.PowersExpanded++;
+    Stats.MultipliesSaved += T.MultiplyCost - NewCost;
+    return true;
+}
+
+bool PolynomialRewritePass::rewritePolynomial(Instruction *Root,
+                                              const DataLayout &DL) {
+    unsigned AddOpcode = Root->getOpcode();
+    unsigned MulOpcode =
+        AddOpcode == Instruction::Add ? Instruction::Mul : Instruction::FMul;
+    Type *Ty = Root->getType();
+
+    // Flatten the sum
+    SmallVector<Instruction*, 8> AddNodes;
+    SmallVector<Value*, 8> Leaves;
+    SmallVector<Instruction*, 8> Worklist;
+    AddNodes.push_back(Root);
+    Worklist.push_back(Root);
+    while (!Worklist.empty()) {
+        Instruction *N = Worklist.pop_back_val();
+        for (Value *Op : N->operands()) {
+            auto *I = dyn_cast<Instruction>(Op);
+            if (I && I->hasOneUse() && I->getParent() == N->getParent() &&
+                isReassociableAdd(I, AddOpcode)) {
+                AddNodes.push_back(I);
+                Worklist.push_back(I);
+            } else {
+                Leaves.push_back(Op);
+            }
+        }
+    }
+
+    // Every leaf becomes a product term
+    SmallVector<ProductTerm, 8> Terms(Leaves.size());
+    for (size_t I = 0; I < Leaves.size(); ++I) {
+        Value *L = Leaves[I];
+        if (isInnerFactor(L, Root, MulOpcode)) {
+            if (!collectProduct(cast<Instruction>(L), MulOpcode, Terms[I], DL)) {
+                return false;
+            }
+        } else if (auto *C = dyn_cast<Constant>(L)) {
+            Terms[I].Coefficient = C;
+        } else {
+            Terms[I].Powers[L] = 1;
+        }
+    }
+
+    // x is the value that appears in the most terms, then the highest power
+    MapVector<Value*, std::pair<unsigned, unsigned>> Candidates;
+    for (const ProductTerm &T : Terms) {
+        for (const auto &[Base, E] : T.Powers) {
+            auto &Entry = Candidates[Base];
+            Entry.first++;
+            Entry.second = std::max(Entry.second, E);
+        }
+    }
+
+    Value *X = nullptr;
+    unsigned TermsWithX = 0, Degree = 0;
+    for (const auto &[Base, Entry] : Candidates) {
+        if (isa<Constant>(Base)) {
+            continue;
+        }
+        if (Entry.first > TermsWithX ||
+            (Entry.first == TermsWithX && Entry.second > Degree)) {
+            X = Base;
+            TermsWithX = Entry.first;
+            Degree = Entry.second;
+        }
+    }
+
+    if (!X || TermsWithX < 2 || Degree < 2 || Degree > Config.MaxDegree) {
+        return false;
+    }
+
+    SmallVector<SmallVector<const ProductTerm*, 2>, 8> ByDegree(Degree + 1);
+    unsigned OldCost = 0;
+    for (const ProductTerm &T : Terms) {
+        ByDegree[T.Powers.lookup(X)].push_back(&T);
+        OldCost += T.MultiplyCost;
+    }
+
+    // The rewrite keeps the flags all nodes share, and drops nsw/nuw
+    FastMathFlags FMF;
+    if (isa<FPMathOperator>(Root)) {
+        FMF = Root->getFastMathFlags();
+        for (Instruction *N : AddNodes) {
+            FMF &= N->getFastMathFlags();
+        }
+        for (const ProductTerm &T : Terms) {
+            for (Instruction *N : T.Nodes) {
+                FMF &= N->getFastMathFlags();
+            }
+        }
+    }
+
+    // Cost of the coefficients, which keep their other factors
+    unsigned NewCost = 0;
+    for (const ProductTerm &T : Terms) {
+        unsigned Factors =
+            T.Coefficient && !T.Coefficient->isOneValue() ? 1 : 0;
+        for (const auto &[Base, E] : T.Powers) {
+            if (Base == X) {
+                continue;
+            }
+            SmallDenseSet<unsigned, 8> Have;
+            NewCost += getPowerCost(Base, E, FMF, Have);
+            Factors++;
+        }
+        NewCost += Factors ? Factors - 1 : 0;
+    }
+
+    bool UseEstrin = Config.Scheme == PolynomialRewriteConfig::Estrin &&
+                     Degree >= Config.EstrinMinDegree;
+
+    if (UseEstrin) {
+        SmallVector<bool, 8> Level;
+        for (const auto &Group : ByDegree) {
+            Level.push_back(!Group.empty());
+        }
+        SmallDenseSet<unsigned, 8> Have;
+        unsigned PowE = 1;
+        while (Level.size() > 1) {
+            SmallVector<bool, 8> Next;
+            for (size_t J = 0; J < Level.size(); J += 2) {
+                bool High = J + 1 < Level.size() && Level[J + 1];
+                NewCost += High ? 1 : 0;
+                Next.push_back(Level[J] || High);
+            }
+            Level = std::move(Next);
+            if (Level.size() > 1) {
+                PowE *= 2;
+                NewCost += getPowerCost(X, PowE, FMF, Have);
+            }
+        }
+    } else {
+        // A leading coefficient of one starts the chain at x itself
+        const auto &Leading = ByDegree[Degree];
+        bool LeadingIsOne =
+            Leading.size() == 1 && Leading.front()->Powers.size() == 1 &&
+            (!Leading.front()->Coefficient ||
+             Leading.front()->Coefficient->isOneValue());
+        NewCost += LeadingIsOne ? Degree - 1 : Degree;
+    }
+
+    if (NewCost >= OldCost) {
+        debugPrint("  Polynomial " + Root->getName() + " not profitable (" +
+                   Twine(NewCost) + " vs " + Twine(OldCost) + " multiplies)");
+        return false;
+    }
+
+    IRBuilder<> Builder(Root);
+    Builder.setFastMathFlags(FMF);
+
+    auto Add = static_cast<Instruction::BinaryOps>(AddOpcode);
+    auto Mul = static_cast<Instruction::BinaryOps>(MulOpcode);
+    Constant *One = MulOpcode == Instruction::FMul ? ConstantFP::get(Ty, 1.0)
+                                                   : ConstantInt::get(Ty, 1);
+    auto IsOne = [](Value *V) {
+        auto *C = dyn_cast<Constant>(V);
+        return C && C->isOneValue();
+    };
+    // Constants go on the right, as everywhere else in the IR
+    auto CreateMul = [&](Value *Coeff, Value *Power, const Twine &N) {
+        return isa<Constant>(Coeff) ? Builder.CreateBinOp(Mul, Power, Coeff, N)
+                                    : Builder.CreateBinOp(Mul, Coeff, Power, N);
+    };
+
+    std::string Name = Root->getName().str();
+
+    // c_k = sum of the other factors of the terms with x^k
+    SmallVector<Value*, 8> Coeffs(Degree + 1, nullptr);
+    for (unsigned K = 0; K <= Degree; ++K) {
+        for (const ProductTerm *T : ByDegree[K]) {
+            Value *P = buildProduct(*T, X, MulOpcode, Builder);
+            if (!P) {
+                P = One;
+            }
+            Coeffs[K] = Coeffs[K]
+                ? Builder.CreateBinOp(Add, Coeffs[K], P, Name + ".coef")
+                : P;
+        }
+    }
+
+    Value *Result;
+    if (UseEstrin) {
+        // Level j holds polynomials in x^(2^j); pairs are joined as
+        // low + high * x^(2^j)
+        SmallVector<Value*, 8> Level(Coeffs.begin(), Coeffs.end());
+        Value *Power = X;
+        unsigned PowE = 1;
+        while (Level.size() > 1) {
+            SmallVector<Value*, 8> Next;
+            for (size_t J = 0; J < Level.size(); J += 2) {
+                Value *Low = Level[J];
+                Value *High = J + 1 < Level.size() ? Level[J + 1] : nullptr;
+                if (!High) {
+                    Next.push_back(Low);
+                    continue;
+                }
+                Value *Term = IsOne(High)
+                    ? Power
+                    : CreateMul(High, Power, Name + ".estrin");
+                if (!Low) {
+                    Next.push_back(Term);
+                } else if (isa<Constant>(Low)) {
+                    Next.push_back(
+                        Builder.CreateBinOp(Add, Term, Low, Name + ".estrin"));
+                } else {
+                    Next.push_back(
+                        Builder.CreateBinOp(Add, Low, Term, Name + ".estrin"));
+                }
+            }
+            Level = std::move(Next);
+            if (Level.size() > 1) {
+                PowE *= 2;
+                Power = buildPower(X, PowE, MulOpcode, Builder);
+            }
+        }
+        Result = Level.front();
+        Stats.EstrinPolynomials++;
+    } else {
+        // ((c_n * x + c_n-1) * x + ...) * x + c_0
+        Result = Coeffs[Degree];
+        for (unsigned K = Degree; K-- > 0;) {
+            Result = IsOne(Result) ? X
+                                   : CreateMul(Result, X, Name + ".horner");
+            if (Coeffs[K]) {
+                Result = Builder.CreateBinOp(Add, Result, Coeffs[K],
+                                             Name + ".horner");
+            }
+        }
+    }
+
+    Result->takeName(Root);
+
+    debugPrint("  Rewrote polynomial of degree " + Twine(Degree) + " with " +
+               Twine(NewCost) + " multiplies instead of " + Twine(OldCost));
+
+    Root->replaceAllUsesWith(Result);
+
+    // Adds first: afterwards every product term is unused
+    for (Instruction *N : AddNodes) {
+        N->eraseFromParent();
+    }
+    for (ProductTerm &T : Terms) {
+        for (Instruction *N : T.Nodes) {
+            N->eraseFromParent();
+        }
+    }
+
+    Stats.PolynomialsRewritten++;
+    Stats.MultipliesSaved += OldCost - NewCost;
+    return true;
+}
+
+bool PolynomialRewritePass::processBlock(BasicBlock &BB,
+                                         const DataLayout &DL) {
+    bool Changed = false;
+
+    // Sums go first, while their terms are still plain products
+    Cache.clear();
+    SmallVector<Instruction*, 16> Roots;
+    for (Instruction &I : BB) {
+        if (!isReassociableAdd(&I, I.getOpcode())) {
+            continue;
+        }
+        if (I.hasOneUse()) {
+            auto *User = cast<Instruction>(I.user_back());
+            if (User->getParent() == &BB &&
+                isReassociableAdd(User, I.getOpcode())) {
+                continue;
+            }
+        }
+        Roots.push_back(&I);
+    }
+    for (Instruction *Root : Roots) {
+        Changed |= rewritePolynomial(Root, DL);
+    }
+
+    // Powers built for the sums may sit after earlier products
+    Cache.clear();
+    Roots.clear();
+    for (Instruction &I : BB) {
+        unsigned MulOpcode = getPowiExponent(&I)
+                                 ? unsigned(Instruction::FMul)
+                                 : I.getOpcode();
+        if (!getPowiExponent(&I) && !isReassociableMul(&I, MulOpcode)) {
+            continue;
+        }
+        if (I.hasOneUse()) {
+            auto *User = cast<Instruction>(I.user_back());
+            if (isReassociableMul(User, MulOpcode) &&
+                isInnerFactor(&I, User, MulOpcode)) {
+                continue;
+            }
+        }
+        Roots.push_back(&I);
+    }
+    for (Instruction *Root : Roots) {
+        Changed |= rewriteProduct(Root, DL);
+    }
+
+    return Changed;
+}
+
+PreservedAnalyses PolynomialRewritePass::run(Function &F,
+                                             FunctionAnalysisManager &AM) {
+    debugPrint("Running on function: " + F.getName());
+
+    const DataLayout &DL = F.getParent()->getDataLayout();
+
+    bool Changed = false;
+    for (BasicBlock &BB : F) {
+        Changed |= processBlock(BB, DL);
+    }
+    Cache.clear();
+
+    LLVM_DEBUG(dbgs() << "PolynomialRewrite Statistics:\n"
+                      << "  Powers expanded: " << Stats.PowersExpanded << "\n"
+                      << "  Powers reused: " << Stats.PowersReused << "\n"
+                      << "  Polynomials rewritten: "
+                      << Stats.PolynomialsRewritten << "\n"
+                      << "  Estrin polynomials: " << Stats.EstrinPolynomials
+                      << "\n"
+                      << "  Multiplies saved: " << Stats.MultipliesSaved
+                      << "\n");
+
+    if (!Changed) {
+        return PreservedAnalyses::all();
+    }
+
+    // Only instructions inside blocks were rewritten
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    return PA;
+}
@@ -0,0 +1,358 @@
+//===- ReassociationPass.cpp - Expression Reassociation ---------*- C++ -*-===//
+//
+// Ranks every value in reverse post-order, then linearizes each maximal tree
+// of single-use nodes with the same associative opcode inside one block.
+// Constant leaves are folded together, identities and idempotent or
+// self-cancelling duplicates are dropped, and the remaining leaves are
+// rebuilt lowest rank first as ((l0 op l1) op l2) ... op C. Rebuilt nodes
+// carry no nsw/nuw flags; FP nodes get the intersection of the tree's
+// fast-math flags.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ReassociationPass.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+
+#include <algorithm>
+
+#define DEBUG_TYPE "reassociation"
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+//===----------------------------------------------------------------------===//
+// ReassociationPass Implementation
+//===----------------------------------------------------------------------===//
+
+void ReassociationPass::debugPrint(const Twine &Msg) const {
+    if (DebugMode) {
+        errs() << "[Reassociation] " << Msg << "\n";
+    }
+}
+
+void ReassociationPass::computeRanks(Function &F) {
+    Ranks.clear();
+    unsigned Order = 0;
+
+    for (Argument &A : F.args()) {
+        Ranks[&A] = {A.getArgNo() + 1, Order++};
+    }
+
+    // Block ranks leave room for the instruction ranks computed inside them
+    unsigned BlockNumber = 0;
+    ReversePostOrderTraversal<Function*> RPOT(&F);
+    for (BasicBlock *BB : RPOT) {
+        unsigned BlockRank = (++BlockNumber) << 16;
+
+        for (Instruction &I : *BB) {
+            unsigned Rank = BlockRank;
+            bool Movable = !isa<PHINode>(I) && !I.mayReadOrWriteMemory() &&
+                           !I.mayHaveSideEffects() &&
+                           isSafeToSpeculativelyExecute(&I);
+            if (Movable) {
+                Rank = 0;
+                for (Value *Op : I.operands()) {
+                    Rank = std::max(Rank, getRank(Op).first);
+                }
+                Rank = std::min(Rank + 1, BlockRank);
+            }
+            Ranks[&I] = {Rank, Order++};
+        }
+    }
+}
+
+ReassociationPass::RankKey ReassociationPass::getRank(const Value *V) const {
+    if (isa<Constant>(V)) {
+        return {0, 0};
+    }
+    return Ranks.lookup(V);
+}
+
+unsigned ReassociationPass::getTreeOpcode(const Instruction *I) const {
+    auto *BO = dyn_cast<BinaryOperator>(I);
+    if (!BO) {
+        return 0;
+    }
+
+    switch (BO->getOpcode()) {
+        case Instruction::Add:
+        case Instruction::Mul:
+        case Instruction::And:
+        case Instruction::Or:
+        case Instruction::Xor:
+            return BO->getOpcode();
+        case Instruction::Sub:
+            // X - C is X + (-C)
+            return isa<Constant>(BO->getOperand(1)) ? Instruction::Add : 0;
+        case Instruction::FAdd:
+        case Instruction::FMul:
+            // Without reassoc the rounding of every step is observable, and
+            // without nsz folding x + 0.0 would change the sign of -0.0
+            if (Config.ReassociateFloatingPoint && BO->hasAllowReassoc() &&
+                BO->hasNoSignedZeros()) {
+                return BO->getOpcode();
+            }
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+bool ReassociationPass::isInnerNode(const Value *Op, const Instruction *Parent,
+                                    unsigned Opcode) const {
+    auto *I = dyn_cast<Instruction>(Op);
+    return I && I->hasOneUse() && I->getParent() == Parent->getParent() &&
+           getTreeOpcode(I) == Opcode;
+}
+
+bool ReassociationPass::linearize(Instruction *Root, unsigned Opcode,
+                                  SmallVectorImpl<Value*> &Leaves,
+                                  SmallVectorImpl<Instruction*> &Nodes,
+                                  const DataLayout &DL) {
+    SmallVector<Instruction*, 8> Worklist;
+    Worklist.push_back(Root);
+    Nodes.push_back(Root);
+
+    while (!Worklist.empty()) {
+        Instruction *N = Worklist.pop_back_val();
+        Value *Ops[2] = {N->getOperand(0), N->getOperand(1)};
+
+        if (N->getOpcode() == Instruction::Sub) {
+            auto *C = cast<Constant>(Ops[1]);
+            Ops[1] = ConstantFoldBinaryOpOperands(
+                Instruction::Sub, Constant::getNullValue(C->getType()), C, DL);
+            if (!Ops[1]) {
+                return false;
+            }
+        }
+
+        for (Value *Op : Ops) {
+            if (isInnerNode(Op, N, Opcode)) {
+                auto *Inner = cast<Instruction>(Op);
+                Nodes.push_back(Inner);
+                Worklist.push_back(Inner);
+                continue;
+            }
+
+            Leaves.push_back(Op);
+            if (Leaves.size() > Config.MaxTreeSize) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+Value *ReassociationPass::simplifyLeaves(unsigned Opcode, Type *Ty,
+                                         SmallVectorImpl<Value*> &Leaves,
+                                         const DataLayout &DL) {
+    // Fold every constant leaf into one
+    Constant *Folded = nullptr;
+    SmallVector<Value*, 8> Kept;
+    for (Value *V : Leaves) {
+        auto *C = dyn_cast<Constant>(V);
+        if (!C) {
+            Kept.push_back(V);
+            continue;
+        }
+        if (!Folded) {
+            Folded = C;
+            continue;
+        }
+        if (Constant *R = ConstantFoldBinaryOpOperands(Opcode, Folded, C, DL)) {
+            Folded = R;
+            Stats.ConstantsFolded++;
+        } else {
+            Kept.push_back(Folded);
+            Folded = C;
+        }
+    }
+
+    if (Folded) {
+        // x & 0, x | -1, x * 0
+        if (Folded == ConstantExpr::getBinOpAbsorber(Opcode, Ty)) {
+            return Folded;
+        }
+
+        // x + 0, x * 1, ...; with nsz both zeros are an fadd identity
+        bool IsIdentity =
+            Folded == ConstantExpr::getBinOpIdentity(Opcode, Ty) ||
+            (Opcode == Instruction::FAdd && Folded->isZeroValue());
+        if (IsIdentity) {
+            Folded = nullptr;
+        }
+    }
+
+    std::stable_sort(Kept.begin(), Kept.end(),
+                     [this](const Value *A, const Value *B) {
+                         return getRank(A) < getRank(B);
+                     });
+
+    // Equal leaves are adjacent now: x & x == x, x | x == x, x ^ x == 0
+    if (Opcode == Instruction::And || Opcode == Instruction::Or ||
+        Opcode == Instruction::Xor) {
+        SmallVector<Value*, 8> Unique;
+        for (Value *V : Kept) {
+            if (Unique.empty() || Unique.back() != V) {
+                Unique.push_back(V);
+                continue;
+            }
+            Stats.OperandsCancelled++;
+            if (Opcode == Instruction::Xor) {
+                Unique.pop_back();
+                Stats.OperandsCancelled++;
+            }
+        }
+        Kept = std::move(Unique);
+    }
+
+    if (Folded) {
+        Kept.push_back(Folded);
+    }
+
+    Leaves.assign(Kept.begin(), Kept.end());
+    if (Leaves.empty()) {
+        return ConstantExpr::getBinOpIdentity(Opcode, Ty);
+    }
+    if (Leaves.size() == 1) {
+        return Leaves.front();
+    }
+    return nullptr;
+}
+
+bool ReassociationPass::matchesChain(Instruction *Root, unsigned Opcode,
+                                     ArrayRef<Value*> Leaves) {
+    Instruction *N = Root;
+    for (size_t K = Leaves.size() - 1; K > 0; --K) {
+        if (N->getOpcode() != Opcode || N->getOperand(1) != Leaves[K]) {
+            return false;
+        }
+
+        Value *LHS = N->getOperand(0);
+        if (K == 1) {
+            return LHS == Leaves[0];
+        }
+
+        // The next link must be a node of this tree, not an equal leaf
+        auto *Next = dyn_cast<Instruction>(LHS);
+        if (!Next || !Next->hasOneUse() || Next->getParent() != N->getParent()) {
+            return false;
+        }
+        N = Next;
+    }
+    return false;
+}
+
+bool ReassociationPass::reassociate(Instruction *Root, const DataLayout &DL) {
+    unsigned Opcode = getTreeOpcode(Root);
+    Stats.TreesAnalyzed++;
+
+    SmallVector<Value*, 8> Leaves;
+    SmallVector<Instruction*, 8> Nodes;
+    if (!linearize(Root, Opcode, Leaves, Nodes, DL)) {
+        debugPrint("  Tree too large at: " + Root->getName());
+        return false;
+    }
+
+    Value *Result = simplifyLeaves(Opcode, Root->getType(), Leaves, DL);
+    if (!Result && matchesChain(Root, Opcode, Leaves)) {
+        return false;
+    }
+
+    IRBuilder<> Builder(Root);
+    if (isa<FPMathOperator>(Root)) {
+        FastMathFlags FMF = Root->getFastMathFlags();
+        for (Instruction *N : Nodes) {
+            FMF &= N->getFastMathFlags();
+        }
+        Builder.setFastMathFlags(FMF);
+    }
+
+    if (!Result) {
+        Result = Leaves.front();
+        for (size_t K = 1; K < Leaves.size(); ++K) {
+            Value *Next = Builder.CreateBinOp(
+                static_cast<Instruction::BinaryOps>(Opcode), Result, Leaves[K],
+                Root->hasName() ? Root->getName() + ".reass" : "");
+            if (auto *NewI = dyn_cast<Instruction>(Next)) {
+                unsigned Rank = std::max(getRank(Result).first,
+                                         getRank(Leaves[K]).first) + 1;
+                Ranks[NewI] = {Rank, getRank(Root).second};
+            }
+            Result = Next;
+        }
+
+        if (auto *Last = dyn_cast<Instruction>(Result)) {
+            Last->takeName(Root);
+        }
+    }
+
+    debugPrint("  Rewrote tree of " + Twine(Nodes.size()) + " nodes into " +
+               Twine(Leaves.size()) + " leaves");
+
+    Root->replaceAllUsesWith(Result);
+
+    // Parents come first, so every node is unused by the time it is erased
+    for (Instruction *N : Nodes) {
+        Ranks.erase(N);
+        N->eraseFromParent();
+    }
+
+    Stats.TreesRewritten++;
+    return true;
+}
+
+PreservedAnalyses ReassociationPass::run(Function &F,
+                                         FunctionAnalysisManager &AM) {
+    debugPrint("Running on function: " + F.getName());
+
+    computeRanks(F);
+
+    const DataLayout &DL = F.getParent()->getDataLayout();
+
+    // Roots are nodes whose value leaves the tree; inner nodes are erased
+    // while their root is rewritten, so collect the roots up front
+    SmallVector<Instruction*, 32> Roots;
+    ReversePostOrderTraversal<Function*> RPOT(&F);
+    for (BasicBlock *BB : RPOT) {
+        for (Instruction &I : *BB) {
+            if (!getTreeOpcode(&I)) {
+                continue;
+            }
+            if (I.hasOneUse()) {
+                auto *User = cast<Instruction>(I.user_back());
+                if (isInnerNode(&I, User, getTreeOpcode(User))) {
+                    continue;
+                }
+            }
+            Roots.push_back(&I);
+        }
+    }
+
+    bool Changed = false;
+    for (Instruction *Root : Roots) {
+        Changed |= reassociate(Root, DL);
+    }
+
+    LLVM_DEBUG(dbgs() << "Reassociation Statistics:\n"
+                      << "  Trees analyzed: " << Stats.TreesAnalyzed << "\n"
+                      << "  Trees rewritten: " << Stats.TreesRewritten << "\n"
+                      << "  Constants folded: " << Stats.ConstantsFolded << "\n"
+                      << "  Operands cancelled: " << Stats.OperandsCancelled
+                      << "\n");
+
+    if (!Changed) {
+        return PreservedAnalyses::all();
+    }
+
+    // Only instructions inside blocks were rewritten
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    return PA;
+}
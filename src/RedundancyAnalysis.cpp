@@ -70,6 +70,10 @@ unsigned ValueNumberTable::lookupValueNumber(Value *V) const {
     return It != ValueNumbers.end() ? It->second : 0;
 }
 
+void ValueNumberTable::assignLeaderValueNumber(Value *V, Value *Leader) {
+    ValueNumbers[V] = getValueNumber(Leader);
+}
+
 ExpressionKey ValueNumberTable::createExpressionKey(Instruction *I) {
     ExpressionKey Key;
     Key.Opcode = I->getOpcode();
@@ -204,6 +208,10 @@ void RedundancyAnalysis::processBlock(BasicBlock *BB, ValueNumberTable &VNT,
             // Found redundant computation!
             Result.RedundantInstructions[&I] = Available;
             Result.Statistics.RedundantInstructions++;
+
+            // Users of I then match users of Available, e.g. x*y*z after
+            // x*y was found redundant
+            VNT.assignLeaderValueNumber(&I, Available);
             
             LLVM_DEBUG(dbgs() << "  REDUNDANT: " << I << "\n"
                               << "    replaced by: " << *Available << "\n");
@@ -3,10 +3,19 @@
 // Consumes RedundancyAnalysis, does replaceAllUsesWith + eraseFromParent
 // for each flagged instruction.
 //
+// With EliminateLoads, loads are first replaced by dominating loads of the
+// same address and type, as EarlyCSE does with MemorySSA: the later load's
+// clobbering access must dominate the earlier load, so no store between
+// them may write the address. The analysis then sees one value where it
+// saw two, and finds the computations on them redundant as well.
+//
 //===----------------------------------------------------------------------===//
 
 #include "RedundancyEliminationPass.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/Analysis/MemorySSAUpdater.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Utils/Local.h"
 
 #define DEBUG_TYPE "redundancy-elimination"
 
@@ -59,6 +68,59 @@ bool RedundancyEliminationPass::eliminateRedundancies(Function &F,
     return !ToDelete.empty();
 }
 
+bool RedundancyEliminationPass::eliminateRedundantLoads(Function &F,
+                                                        DominatorTree &DT,
+                                                        MemorySSA &MSSA) {
+    MemorySSAWalker &Walker = *MSSA.getWalker();
+
+    // Earlier loads by address and type, visited in dominator tree preorder
+    DenseMap<std::pair<Value*, Type*>, SmallVector<LoadInst*, 4>> Available;
+    std::vector<LoadInst*> ToDelete;
+
+    for (auto *Node : depth_first(DT.getRootNode())) {
+        for (Instruction &I : *Node->getBlock()) {
+            auto *LI = dyn_cast<LoadInst>(&I);
+            if (!LI || !LI->isSimple() || !MSSA.getMemoryAccess(LI)) {
+                continue;
+            }
+
+            auto &Candidates =
+                Available[{LI->getPointerOperand(), LI->getType()}];
+            MemoryAccess *Clobber = Walker.getClobberingMemoryAccess(LI);
+            LoadInst *Earlier = nullptr;
+            for (LoadInst *Candidate : reverse(Candidates)) {
+                if (DT.dominates(Candidate, LI) &&
+                    MSSA.dominates(Clobber, MSSA.getMemoryAccess(Candidate))) {
+                    Earlier = Candidate;
+                    break;
+                }
+            }
+            if (!Earlier) {
+                Candidates.push_back(LI);
+                continue;
+            }
+
+            LLVM_DEBUG(dbgs() << "  Replacing load: " << *LI << "\n"
+                              << "            with: " << *Earlier << "\n");
+
+            // Replaced right away, so loads through LI's result are keyed
+            // by Earlier's
+            combineMetadataForCSE(Earlier, LI, /*DoesKMove=*/false);
+            LI->replaceAllUsesWith(Earlier);
+            ToDelete.push_back(LI);
+            Stats.LoadsEliminated++;
+        }
+    }
+
+    MemorySSAUpdater MSSAU(&MSSA);
+    for (LoadInst *LI : ToDelete) {
+        MSSAU.removeMemoryAccess(LI);
+        LI->eraseFromParent();
+    }
+
+    return !ToDelete.empty();
+}
+
 PreservedAnalyses RedundancyEliminationPass::run(Function &F,
                                                  FunctionAnalysisManager &AM) {
     LLVM_DEBUG(dbgs() << "RedundancyEliminationPass: Processing function "
@@ -66,14 +128,30 @@ PreservedAnalyses RedundancyEliminationPass::run(Function &F,
     
     Stats.FunctionsProcessed++;
     
+    bool Changed = false;
+    if (Config.EliminateLoads) {
+        auto &DT = AM.getResult<DominatorTreeAnalysis>(F);
+        auto &MSSA = AM.getResult<MemorySSAAnalysis>(F).getMSSA();
+        Changed = eliminateRedundantLoads(F, DT, MSSA);
+
+        // A cached analysis result would still hold the removed loads
+        if (Changed) {
+            PreservedAnalyses PA;
+            PA.preserveSet<CFGAnalyses>();
+            PA.preserve<MemorySSAAnalysis>();
+            AM.invalidate(F, PA);
+        }
+    }
+    
     // Get redundancy analysis results
     const auto &RI = AM.getResult<RedundancyAnalysis>(F);
     
     // Perform elimination
-    bool Changed = eliminateRedundancies(F, RI);
+    Changed |= eliminateRedundancies(F, RI);
     
     LLVM_DEBUG(dbgs() << "  Eliminated " << Stats.InstructionsEliminated 
-                      << " instructions\n");
+                      << " instructions and " << Stats.LoadsEliminated
+                      << " loads\n");
     
     if (!Changed) {
         return PreservedAnalyses::all();
@@ -0,0 +1,373 @@
+//===- StoreForwardingPass.cpp - Store-to-Load Forwarding -------*- C++ -*-===//
+//
+// For every simple load, asks the MemorySSA walker for its clobbering access.
+// A clobbering store that writes every loaded byte through the same base
+// pointer is forwarded directly. A clobbering MemoryPhi is looked through by
+// re-querying the walker on each incoming access; if every path ends in such
+// a store, a PHI of the (extracted) stored values replaces the load.
+//
+//===----------------------------------------------------------------------===//
+
+#include "StoreForwardingPass.h"
+#include "llvm/Analysis/MemorySSAUpdater.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+
+#define DEBUG_TYPE "store-forwarding"
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+/// Integer, FP and vector types whose every bit is stored, so a byte offset
+/// into the value maps to a fixed bit range
+static bool hasNoPaddingBits(Type *Ty, const DataLayout &DL) {
+    if (!Ty->isIntOrIntVectorTy() && !Ty->isFPOrFPVectorTy()) {
+        return false;
+    }
+    TypeSize Bits = DL.getTypeSizeInBits(Ty);
+    return !Bits.isScalable() &&
+           Bits.getFixedValue() == DL.getTypeStoreSizeInBits(Ty).getFixedValue();
+}
+
+//===----------------------------------------------------------------------===//
+// StoreForwardingPass Implementation
+//===----------------------------------------------------------------------===//
+
+void StoreForwardingPass::debugPrint(const Twine &Msg) const {
+    if (DebugMode) {
+        errs() << "[StoreForwarding] " << Msg << "\n";
+    }
+}
+
+bool StoreForwardingPass::planExtraction(StoreInst *SI, LoadInst *LI,
+                                         const DataLayout &DL,
+                                         Extraction &E) const {
+    if (!SI->isSimple()) {
+        return false;
+    }
+
+    Type *StoredTy = SI->getValueOperand()->getType();
+    Type *LoadTy = LI->getType();
+    TypeSize StoreSize = DL.getTypeStoreSize(StoredTy);
+    TypeSize LoadSize = DL.getTypeStoreSize(LoadTy);
+    if (StoreSize.isScalable() || LoadSize.isScalable()) {
+        return false;
+    }
+
+    // Both accesses must be constant offsets from the same base
+    int64_t StoreOffset = 0;
+    int64_t LoadOffset = 0;
+    const Value *StoreBase = GetPointerBaseWithConstantOffset(
+        SI->getPointerOperand(), StoreOffset, DL);
+    const Value *LoadBase = GetPointerBaseWithConstantOffset(
+        LI->getPointerOperand(), LoadOffset, DL);
+    if (StoreBase != LoadBase) {
+        return false;
+    }
+
+    int64_t Offset = LoadOffset - StoreOffset;
+    uint64_t Size = LoadSize.getFixedValue();
+    if (Offset < 0 ||
+        static_cast<uint64_t>(Offset) + Size > StoreSize.getFixedValue()) {
+        return false;
+    }
+
+    // Descend into the aggregate element holding all loaded bytes
+    E.Indices.clear();
+    E.LeafTy = StoredTy;
+    E.LeafOffset = Offset;
+    E.NeedsShift = false;
+
+    while (E.LeafTy->isAggregateType()) {
+        if (E.LeafTy == LoadTy && E.LeafOffset == 0) {
+            break;
+        }
+
+        unsigned Index = 0;
+        uint64_t ElementStart = 0;
+        Type *ElementTy = nullptr;
+
+        if (auto *STy = dyn_cast<StructType>(E.LeafTy)) {
+            const StructLayout *SL = DL.getStructLayout(STy);
+            Index = SL->getElementContainingOffset(E.LeafOffset);
+            ElementStart = SL->getElementOffset(Index);
+            ElementTy = STy->getElementType(Index);
+        } else {
+            auto *ATy = cast<ArrayType>(E.LeafTy);
+            ElementTy = ATy->getElementType();
+            uint64_t Stride = DL.getTypeAllocSize(ElementTy);
+            if (Stride == 0) {
+                return false;
+            }
+            Index = E.LeafOffset / Stride;
+            ElementStart = Index * Stride;
+        }
+
+        // Loads spanning elements or reading padding are not forwarded
+        uint64_t ElementSize = DL.getTypeStoreSize(ElementTy);
+        if (E.LeafOffset < ElementStart ||
+            E.LeafOffset + Size > ElementStart + ElementSize) {
+            return false;
+        }
+
+        E.Indices.push_back(Index);
+        E.LeafTy = ElementTy;
+        E.LeafOffset -= ElementStart;
+    }
+
+    if (E.LeafOffset == 0 && E.LeafTy == LoadTy) {
+        return E.Indices.empty() || Config.AllowPartialForwarding;
+    }
+
+    if (E.LeafOffset == 0 &&
+        DL.getTypeStoreSize(E.LeafTy) == LoadSize &&
+        CastInst::isBitCastable(E.LeafTy, LoadTy)) {
+        return E.Indices.empty() || Config.AllowPartialForwarding;
+    }
+
+    // Sub-range of a scalar: bitcast to an integer, shift and truncate
+    if (!Config.AllowPartialForwarding || !hasNoPaddingBits(E.LeafTy, DL) ||
+        !hasNoPaddingBits(LoadTy, DL)) {
+        return false;
+    }
+    E.NeedsShift = true;
+    return true;
+}
+
+Value *StoreForwardingPass::materializeFromStore(StoreInst *SI, LoadInst *LI,
+                                                 Instruction *InsertPt,
+                                                 const DataLayout &DL) {
+    Extraction E;
+    bool Planned = planExtraction(SI, LI, DL, E);
+    assert(Planned && "store was not checked for forwarding");
+    (void)Planned;
+
+    IRBuilder<> Builder(InsertPt);
+    Type *LoadTy = LI->getType();
+    Value *Val = SI->getValueOperand();
+
+    if (!E.Indices.empty() || E.NeedsShift) {
+        Stats.PartialForwards++;
+    }
+
+    if (!E.Indices.empty()) {
+        Val = Builder.CreateExtractValue(Val, E.Indices,
+                                         LI->getName() + ".extract");
+    }
+
+    if (E.NeedsShift) {
+        uint64_t LeafBytes = DL.getTypeStoreSize(E.LeafTy).getFixedValue();
+        uint64_t LoadBytes = DL.getTypeStoreSize(LoadTy).getFixedValue();
+        uint64_t ShiftBytes = DL.isLittleEndian()
+                                  ? E.LeafOffset
+                                  : LeafBytes - E.LeafOffset - LoadBytes;
+
+        Val = Builder.CreateBitCast(Val, Builder.getIntNTy(LeafBytes * 8));
+        if (ShiftBytes != 0) {
+            Val = Builder.CreateLShr(Val, ShiftBytes * 8,
+                                    LI->getName() + ".shift");
+        }
+        Val = Builder.CreateTrunc(Val, Builder.getIntNTy(LoadBytes * 8),
+                                LI->getName() + ".trunc");
+    }
+
+    if (Val->getType() != LoadTy) {
+        Val = Builder.CreateBitCast(Val, LoadTy);
+    }
+    return Val;
+}
+
+bool StoreForwardingPass::canForwardThroughPhi(
+    MemoryPhi *Phi, LoadInst *LI, const MemoryLocation &Loc,
+    FunctionState &State, unsigned Depth,
+    SmallPtrSetImpl<MemoryPhi*> &Visiting) {
+    PhiKey Key{Phi, {Loc.Ptr, LI->getType()}};
+    if (State.PhiCache.count(Key)) {
+        return true;
+    }
+
+    // A cycle back to a PHI being planned is closed by that PHI itself
+    if (Visiting.count(Phi)) {
+        return true;
+    }
+
+    if (Depth > Config.MaxPhiDepth) {
+        return false;
+    }
+
+    BasicBlock *BB = Phi->getBlock();
+    if (BB->isEHPad() || Phi->getNumIncomingValues() > Config.MaxPhiIncoming) {
+        return false;
+    }
+
+    // The address has to be available on every incoming edge
+    if (auto *PtrI = dyn_cast<Instruction>(Loc.Ptr)) {
+        if (!State.DT.properlyDominates(PtrI->getParent(), BB)) {
+            return false;
+        }
+    }
+
+    Visiting.insert(Phi);
+
+    for (unsigned I = 0, E = Phi->getNumIncomingValues(); I != E; ++I) {
+        MemoryAccess *Clobber = State.Walker.getClobberingMemoryAccess(
+            Phi->getIncomingValue(I), Loc);
+
+        if (State.MSSA.isLiveOnEntryDef(Clobber)) {
+            return false;
+        }
+
+        if (auto *InPhi = dyn_cast<MemoryPhi>(Clobber)) {
+            if (!canForwardThroughPhi(InPhi, LI, Loc, State, Depth + 1,
+                                      Visiting)) {
+                return false;
+            }
+            continue;
+        }
+
+        auto *SI = dyn_cast_or_null<StoreInst>(
+            cast<MemoryDef>(Clobber)->getMemoryInst());
+        Extraction Ext;
+        if (!SI || !planExtraction(SI, LI, State.DL, Ext)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+Value *StoreForwardingPass::materializeThroughPhi(MemoryPhi *Phi,
+                                                  LoadInst *LI,
+                                                  const MemoryLocation &Loc,
+                                                  FunctionState &State) {
+    PhiKey Key{Phi, {Loc.Ptr, LI->getType()}};
+    auto Cached = State.PhiCache.find(Key);
+    if (Cached != State.PhiCache.end()) {
+        return Cached->second;
+    }
+
+    // Create the PHI before filling it so cycles can refer to it
+    BasicBlock *BB = Phi->getBlock();
+    PHINode *PN = PHINode::Create(LI->getType(), Phi->getNumIncomingValues(),
+                                  LI->getName() + ".fwd", &BB->front());
+    State.PhiCache[Key] = PN;
+    Stats.PhisInserted++;
+
+    // MemoryPhis list a predecessor once per edge; reuse the first value
+    SmallDenseMap<BasicBlock*, Value*, 8> PredValues;
+
+    for (unsigned I = 0, E = Phi->getNumIncomingValues(); I != E; ++I) {
+        BasicBlock *Pred = Phi->getIncomingBlock(I);
+        Value *&Incoming = PredValues[Pred];
+
+        if (!Incoming) {
+            MemoryAccess *Clobber = State.Walker.getClobberingMemoryAccess(
+                Phi->getIncomingValue(I), Loc);
+
+            if (auto *InPhi = dyn_cast<MemoryPhi>(Clobber)) {
+                Incoming = materializeThroughPhi(InPhi, LI, Loc, State);
+            } else {
+                auto *SI = cast<StoreInst>(
+                    cast<MemoryDef>(Clobber)->getMemoryInst());
+                Incoming = materializeFromStore(SI, LI, Pred->getTerminator(),
+                                                State.DL);
+            }
+        }
+
+        PN->addIncoming(Incoming, Pred);
+    }
+
+    return PN;
+}
+
+Value *StoreForwardingPass::forwardLoad(LoadInst *LI, FunctionState &State) {
+    MemoryAccess *Clobber = State.Walker.getClobberingMemoryAccess(LI);
+    if (State.MSSA.isLiveOnEntryDef(Clobber)) {
+        return nullptr;
+    }
+
+    if (auto *Def = dyn_cast<MemoryDef>(Clobber)) {
+        auto *SI = dyn_cast_or_null<StoreInst>(Def->getMemoryInst());
+        Extraction E;
+        if (!SI || !planExtraction(SI, LI, State.DL, E)) {
+            return nullptr;
+        }
+        debugPrint("Forwarding dominating store into load " + LI->getName());
+        return materializeFromStore(SI, LI, LI, State.DL);
+    }
+
+    auto *Phi = cast<MemoryPhi>(Clobber);
+    MemoryLocation Loc = MemoryLocation::get(LI).getWithoutAATags();
+
+    SmallPtrSet<MemoryPhi*, 8> Visiting;
+    if (!canForwardThroughPhi(Phi, LI, Loc, State, 1, Visiting)) {
+        return nullptr;
+    }
+
+    debugPrint("Forwarding stores through MemoryPhi in " +
+               Phi->getBlock()->getName() + " into load " + LI->getName());
+    return materializeThroughPhi(Phi, LI, Loc, State);
+}
+
+PreservedAnalyses StoreForwardingPass::run(Function &F,
+                                           FunctionAnalysisManager &AM) {
+    debugPrint("Running on function: " + F.getName());
+
+    auto &MSSA = AM.getResult<MemorySSAAnalysis>(F).getMSSA();
+    auto &DT = AM.getResult<DominatorTreeAnalysis>(F);
+
+    FunctionState State{MSSA, *MSSA.getWalker(), DT,
+                        F.getParent()->getDataLayout(),
+                        DenseMap<PhiKey, PHINode*>()};
+
+    std::vector<LoadInst*> Loads;
+    for (BasicBlock &BB : F) {
+        for (Instruction &I : BB) {
+            auto *LI = dyn_cast<LoadInst>(&I);
+            if (LI && LI->isSimple() && MSSA.getMemoryAccess(LI) &&
+                !State.DL.getTypeStoreSize(LI->getType()).isScalable()) {
+                Loads.push_back(LI);
+            }
+        }
+    }
+
+    // Forwarded loads stay in place until the end so that pointers held in
+    // the PHI cache never dangle
+    std::vector<LoadInst*> DeadLoads;
+
+    for (LoadInst *LI : Loads) {
+        Stats.LoadsAnalyzed++;
+
+        if (Value *V = forwardLoad(LI, State)) {
+            LI->replaceAllUsesWith(V);
+            DeadLoads.push_back(LI);
+            Stats.LoadsForwarded++;
+        }
+    }
+
+    MemorySSAUpdater MSSAU(&MSSA);
+    for (LoadInst *LI : DeadLoads) {
+        MSSAU.removeMemoryAccess(LI);
+        LI->eraseFromParent();
+    }
+
+    LLVM_DEBUG(dbgs() << "StoreForwarding Statistics:\n"
+                      << "  Loads analyzed: " << Stats.LoadsAnalyzed << "\n"
+                      << "  Loads forwarded: " << Stats.LoadsForwarded << "\n"
+                      << "  Partial forwards: " << Stats.PartialForwards
+                      << "\n"
+                      << "  PHIs inserted: " << Stats.PhisInserted << "\n");
+
+    if (DeadLoads.empty()) {
+        return PreservedAnalyses::all();
+    }
+
+    // Only loads were removed and PHIs/casts added; MemorySSA is up to date
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    PA.preserve<MemorySSAAnalysis>();
+    return PA;
+}
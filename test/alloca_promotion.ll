@@ -0,0 +1,129 @@
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-alloca-promote" -S %s | FileCheck %s
+;
+; Test cases for Alloca Promotion Pass
+; These test mem2reg and scalar replacement of aggregates on -O0 style IR
+
+; Test 1: Scalar locals become SSA values
+; CHECK-LABEL: @test_scalar_locals
+; CHECK-NOT: alloca
+; CHECK-NOT: load
+; CHECK-NOT: store
+; CHECK: %add = add nsw i32 %x, 20
+; CHECK: ret i32 %add
+define i32 @test_scalar_locals(i32 %x) {
+entry:
+    %x.addr = alloca i32, align 4
+    %a = alloca i32, align 4
+    store i32 %x, ptr %x.addr, align 4
+    store i32 20, ptr %a, align 4
+    %0 = load i32, ptr %x.addr, align 4
+    %1 = load i32, ptr %a, align 4
+    %add = add nsw i32 %0, %1
+    ret i32 %add
+}
+
+; Test 2: Values stored on different paths are merged with a PHI
+; CHECK-LABEL: @test_diamond
+; CHECK-NOT: alloca
+; CHECK: phi i32 [ 1, %then ], [ 2, %else ]
+define i32 @test_diamond(i1 %cond) {
+entry:
+    %r = alloca i32, align 4
+    br i1 %cond, label %then, label %else
+
+then:
+    store i32 1, ptr %r, align 4
+    br label %merge
+
+else:
+    store i32 2, ptr %r, align 4
+    br label %merge
+
+merge:
+    %v = load i32, ptr %r, align 4
+    ret i32 %v
+}
+
+; Test 3: Loop counter in memory becomes an induction PHI
+; CHECK-LABEL: @test_loop_counter
+; CHECK-NOT: alloca
+; CHECK: loop:
+; CHECK: phi i32
+; CHECK: icmp slt i32 %{{.*}}, 8
+define i32 @test_loop_counter() {
+entry:
+    %i = alloca i32, align 4
+    store i32 0, ptr %i, align 4
+    br label %loop
+
+loop:
+    %iv = load i32, ptr %i, align 4
+    %next = add nsw i32 %iv, 1
+    store i32 %next, ptr %i, align 4
+    %cond = icmp slt i32 %next, 8
+    br i1 %cond, label %loop, label %exit
+
+exit:
+    %res = load i32, ptr %i, align 4
+    ret i32 %res
+}
+
+; Test 4: Struct with constant-index field accesses is split and promoted
+; CHECK-LABEL: @test_struct_sroa
+; CHECK-NOT: alloca
+; CHECK: %sum = add i32 %a, %b
+; CHECK: ret i32 %sum
+%struct.pair = type { i32, i32 }
+
+define i32 @test_struct_sroa(i32 %a, i32 %b) {
+entry:
+    %p = alloca %struct.pair, align 4
+    %f0 = getelementptr inbounds %struct.pair, ptr %p, i32 0, i32 0
+    %f1 = getelementptr inbounds %struct.pair, ptr %p, i32 0, i32 1
+    store i32 %a, ptr %f0, align 4
+    store i32 %b, ptr %f1, align 4
+    %x = load i32, ptr %f0, align 4
+    %y = load i32, ptr %f1, align 4
+    %sum = add i32 %x, %y
+    ret i32 %sum
+}
+
+; Test 5: Nested array of arrays with constant indices is split recursively
+; CHECK-LABEL: @test_nested_array
+; CHECK-NOT: alloca
+; CHECK: ret i32 7
+define i32 @test_nested_array() {
+entry:
+    %m = alloca [2 x [2 x i32]], align 16
+    %e = getelementptr inbounds [2 x [2 x i32]], ptr %m, i64 0, i64 1, i64 1
+    store i32 7, ptr %e, align 4
+    %v = load i32, ptr %e, align 4
+    ret i32 %v
+}
+
+; Test 6: Variable indexing keeps the aggregate in memory
+; CHECK-LABEL: @test_dynamic_index
+; CHECK: alloca [4 x i32]
+define i32 @test_dynamic_index(i64 %idx) {
+entry:
+    %arr = alloca [4 x i32], align 16
+    %e = getelementptr inbounds [4 x i32], ptr %arr, i64 0, i64 %idx
+    store i32 3, ptr %e, align 4
+    %v = load i32, ptr %e, align 4
+    ret i32 %v
+}
+
+; Test 7: Escaping allocas are not promoted
+; CHECK-LABEL: @test_escape
+; CHECK: alloca i32
+; CHECK: call void @use(ptr %x)
+declare void @use(ptr)
+
+define i32 @test_escape() {
+entry:
+    %x = alloca i32, align 4
+    store i32 1, ptr %x, align 4
+    call void @use(ptr %x)
+    %v = load i32, ptr %x, align 4
+    ret i32 %v
+}
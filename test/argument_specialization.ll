@@ -0,0 +1,148 @@
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-specialize" -S %s | FileCheck %s
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-specialize" -S %s | FileCheck %s --check-prefix=IMPORT
+;
+; Test cases for Argument Specialization Pass
+; These test cloning for constant trip counts and constant divisors,
+; sharing clones between call sites, and the per-function clone cap
+
+; Test 1: Calls with a constant bound get a clone; hot call sites first,
+; at most two clones of one function
+; CHECK-LABEL: @test_trip_counts
+; CHECK: call i32 @[[SPEC8:sum.spec.[0-9]+]](ptr %a, i32 8)
+; CHECK: call i32 @[[SPEC8]](ptr %a, i32 8)
+; CHECK: call i32 @sum(ptr %a, i32 32)
+; CHECK: call i32 @sum(ptr %a, i32 %n)
+; CHECK: loop:
+; CHECK: call i32 @sum.spec(ptr %a, i32 16)
+define i32 @sum(ptr %a, i32 %n) {
+entry:
+    %z = icmp sgt i32 %n, 0
+    br i1 %z, label %loop, label %exit
+
+loop:
+    %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+    %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+    %p = getelementptr i32, ptr %a, i32 %i
+    %v = load i32, ptr %p
+    %acc.next = add i32 %acc, %v
+    %i.next = add i32 %i, 1
+    %c = icmp slt i32 %i.next, %n
+    br i1 %c, label %loop, label %exit
+
+exit:
+    %r = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+    ret i32 %r
+}
+
+define i32 @test_trip_counts(ptr %a, i32 %n, i32 %m) {
+entry:
+    %s1 = call i32 @sum(ptr %a, i32 8)
+    %s2 = call i32 @sum(ptr %a, i32 8)
+    %s3 = call i32 @sum(ptr %a, i32 32)
+    %s4 = call i32 @sum(ptr %a, i32 %n)
+    %t1 = add i32 %s1, %s2
+    %t2 = add i32 %s3, %s4
+    %t3 = add i32 %t1, %t2
+    br label %loop
+
+loop:
+    %j = phi i32 [ 0, %entry ], [ %j.next, %loop ]
+    %acc = phi i32 [ %t3, %entry ], [ %acc.next, %loop ]
+    %s5 = call i32 @sum(ptr %a, i32 16)
+    %acc.next = add i32 %acc, %s5
+    %j.next = add i32 %j, 1
+    %c = icmp slt i32 %j.next, %m
+    br i1 %c, label %loop, label %exit
+
+exit:
+    ret i32 %acc.next
+}
+
+; Test 2: A constant divisor (i % size in loop_unroll_large)
+; CHECK-LABEL: @test_divisor
+; CHECK: call i32 @wrap.spec(ptr %a, i32 10)
+define i32 @wrap(ptr %a, i32 %size) {
+entry:
+    br label %loop
+
+loop:
+    %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+    %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+    %idx = srem i32 %i, %size
+    %p = getelementptr i32, ptr %a, i32 %idx
+    %v = load i32, ptr %p
+    %acc.next = add i32 %acc, %v
+    %i.next = add i32 %i, 1
+    %c = icmp slt i32 %i.next, 64
+    br i1 %c, label %loop, label %exit
+
+exit:
+    ret i32 %acc.next
+}
+
+define i32 @test_divisor(ptr %a) {
+    %r = call i32 @wrap(ptr %a, i32 10)
+    ret i32 %r
+}
+
+; Test 3: A constant that only reaches memory is not worth a clone
+; CHECK-LABEL: @test_no_benefit
+; CHECK: call void @fill(ptr %a, i32 7)
+; CHECK-NOT: @fill.spec
+define void @fill(ptr %a, i32 %v) {
+    store i32 %v, ptr %a
+    ret void
+}
+
+define void @test_no_benefit(ptr %a) {
+    call void @fill(ptr %a, i32 7)
+    ret void
+}
+
+; Test 4: A definition imported by ThinLTO (available_externally) is
+; specialized into an internal clone in the importing module
+; IMPORT-LABEL: @test_imported_callee
+; IMPORT: call i32 @scale.spec(ptr %a, i32 8)
+define available_externally i32 @scale(ptr %a, i32 %n) {
+entry:
+    br label %loop
+
+loop:
+    %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+    %p = getelementptr i32, ptr %a, i32 %i
+    %v = load i32, ptr %p
+    %w = mul i32 %v, 3
+    store i32 %w, ptr %p
+    %i.next = add i32 %i, 1
+    %c = icmp slt i32 %i.next, %n
+    br i1 %c, label %loop, label %exit
+
+exit:
+    ret i32 %i.next
+}
+
+define i32 @test_imported_callee(ptr %a) {
+    %r = call i32 @scale(ptr %a, i32 8)
+    ret i32 %r
+}
+
+; Test 5: Call sites in imported bodies are not specialized: those bodies
+; are dropped before code generation
+; IMPORT-LABEL: @imported_caller
+; IMPORT: call i32 @scale(ptr %a, i32 12)
+; IMPORT-NOT: @scale.spec{{.*}}i32 12
+define available_externally i32 @imported_caller(ptr %a) {
+    %r = call i32 @scale(ptr %a, i32 12)
+    ret i32 %r
+}
+
+; IMPORT-LABEL: define internal i32 @scale.spec(ptr %a, i32 %n)
+; IMPORT: %c = icmp slt i32 %i.next, 8
+
+; The clones: constants substituted, the original signature kept
+; CHECK-LABEL: define internal i32 @sum.spec(ptr %a, i32 %n)
+; CHECK: %c = icmp slt i32 %i.next, 16
+; CHECK: define internal i32 @[[SPEC8]](ptr %a, i32 %n)
+; CHECK: %c = icmp slt i32 %i.next, 8
+; CHECK-LABEL: define internal i32 @wrap.spec(ptr %a, i32 %size)
+; CHECK: %idx = srem i32 %i, 10
@@ -79,9 +79,11 @@ int redundancy_test(int x, int y, int z) {
 }
 
 // Test 5: Combined optimization opportunities
-void matrix_multiply_small(int A[4][4], int B[4][4], int C[4][4]) {
+void matrix_multiply_small(int A[4][4], int B[4][4], int C[restrict 4][4]) {
     // Small matrix multiply with constant dimensions
     // Benefits from:
+    // - Scalar promotion (C[i][j] stays in a register across k; needs the
+    //   restrict qualifier to prove A and B never alias it)
     // - Loop unrolling (4 iterations)
     // - Constant folding (array indexing)
     // - Redundancy elimination (repeated index computations)
@@ -0,0 +1,153 @@
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-hot-cold-split" -S %s | FileCheck %s
+;
+; Test cases for Hot/Cold Splitting Pass
+; These test outlining of error paths ending in noreturn calls, of regions
+; behind zero-weight branches, of calls to cold functions, and that small
+; cold blocks stay in place
+
+declare void @abort() noreturn
+declare void @report(ptr, i32, i32)
+declare void @log_slow(i32) cold
+declare i32 @printf(ptr, ...)
+
+@msg = private constant [16 x i8] c"bad index %d/%d\00"
+
+; Test 1: An error path ending in abort moves to a cold function; the hot
+; path keeps the check and a call
+; CHECK-LABEL: define i32 @test_abort_path
+; CHECK: br i1 %bad, label %[[ERR:.*]], label %ok
+; CHECK: [[ERR]]:
+; CHECK-NEXT: call void @test_abort_path.cold
+; CHECK-NEXT: unreachable
+; CHECK-NOT: call void @abort
+; CHECK: ret i32
+define i32 @test_abort_path(ptr %a, i32 %i, i32 %n) {
+entry:
+    %bad = icmp uge i32 %i, %n
+    br i1 %bad, label %error, label %ok
+
+error:
+    %i2 = mul i32 %i, 2
+    %n2 = add i32 %n, 7
+    %x = xor i32 %i2, %n2
+    %y = shl i32 %x, 3
+    call void @report(ptr @msg, i32 %i, i32 %y)
+    call i32 (ptr, ...) @printf(ptr @msg, i32 %i, i32 %n)
+    call void @abort()
+    unreachable
+
+ok:
+    %p = getelementptr i32, ptr %a, i32 %i
+    %v = load i32, ptr %p
+    ret i32 %v
+}
+
+; Test 2: A region behind a zero-weight branch is outlined and control
+; returns to the hot path
+; CHECK-LABEL: define i32 @test_profile_weights
+; CHECK: call void @test_profile_weights.cold
+; CHECK: join:
+; CHECK: ret i32
+define i32 @test_profile_weights(i32 %x, i32 %y) {
+entry:
+    %c = icmp eq i32 %x, 12345
+    br i1 %c, label %rare, label %join, !prof !0
+
+rare:
+    %a1 = mul i32 %x, %y
+    %a2 = add i32 %a1, 17
+    %a3 = xor i32 %a2, %x
+    call void @report(ptr @msg, i32 %a3, i32 %a2)
+    call void @report(ptr @msg, i32 %a1, i32 %y)
+    br label %join
+
+join:
+    %r = add i32 %x, %y
+    ret i32 %r
+}
+
+; Test 3: A cold block smaller than the call replacing it stays
+; CHECK-LABEL: define i32 @test_small_cold
+; CHECK: call void @abort()
+; CHECK-NOT: .cold
+; CHECK: ret i32
+define i32 @test_small_cold(i32 %x) {
+entry:
+    %c = icmp slt i32 %x, 0
+    br i1 %c, label %fail, label %ok
+
+fail:
+    call void @abort()
+    unreachable
+
+ok:
+    ret i32 %x
+}
+
+; Test 4: A call to a cold function makes its block cold
+; CHECK-LABEL: define i32 @test_cold_call
+; CHECK: call void @test_cold_call.cold
+; CHECK-NOT: call void @log_slow
+; CHECK: ret i32
+define i32 @test_cold_call(i32 %x, i32 %t) {
+entry:
+    %slow = icmp ugt i32 %x, %t
+    br i1 %slow, label %log, label %done
+
+log:
+    %d = sub i32 %x, %t
+    %d2 = mul i32 %d, %d
+    %d3 = lshr i32 %d2, 4
+    call void @log_slow(i32 %d3)
+    call void @log_slow(i32 %d)
+    br label %done
+
+done:
+    %r = shl i32 %x, 1
+    ret i32 %r
+}
+
+; Test 5: An error path inside a loop is outlined; the loop body stays
+; CHECK-LABEL: define i32 @test_loop_check
+; CHECK: loop:
+; CHECK: call void @test_loop_check.cold
+; CHECK: body:
+; CHECK: add i32 %acc
+define i32 @test_loop_check(ptr %a, i32 %n, i32 %lim) {
+entry:
+    br label %loop
+
+loop:
+    %i = phi i32 [ 0, %entry ], [ %i.next, %body ]
+    %acc = phi i32 [ 0, %entry ], [ %acc.next, %body ]
+    %p = getelementptr i32, ptr %a, i32 %i
+    %v = load i32, ptr %p
+    %over = icmp sgt i32 %v, %lim
+    br i1 %over, label %overflow, label %body
+
+overflow:
+    %e1 = sub i32 %v, %lim
+    %e2 = mul i32 %e1, 3
+    %e3 = or i32 %e2, 1
+    call void @report(ptr @msg, i32 %i, i32 %e3)
+    call i32 (ptr, ...) @printf(ptr @msg, i32 %v, i32 %lim)
+    call void @abort()
+    unreachable
+
+body:
+    %acc.next = add i32 %acc, %v
+    %i.next = add i32 %i, 1
+    %c = icmp slt i32 %i.next, %n
+    br i1 %c, label %loop, label %exit
+
+exit:
+    ret i32 %acc.next
+}
+
+; Outlined functions are cold, minsize and never inlined back
+; CHECK: define internal void @test_abort_path.cold
+; CHECK-SAME: #[[ATTR:[0-9]+]]
+; CHECK: call void @abort()
+; CHECK: attributes #[[ATTR]] = { cold minsize noinline
+
+!0 = !{!"branch_weights", i32 0, i32 1000}
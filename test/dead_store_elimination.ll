@@ -0,0 +1,179 @@
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-dse" -S %s | FileCheck %s
+;
+; Test cases for Dead Store Elimination Pass
+; These test MemorySSA def-chain walks, partial overwrites and lifetimes
+
+; Test 1: Store completely overwritten before any read
+; CHECK-LABEL: @test_overwritten
+; CHECK-NOT: store i32 0
+; CHECK: store i32 %v, ptr %p
+define void @test_overwritten(ptr %p, i32 %v) {
+entry:
+    store i32 0, ptr %p, align 4
+    store i32 %v, ptr %p, align 4
+    ret void
+}
+
+; Test 2: An intervening read keeps the first store alive
+; CHECK-LABEL: @test_read_between
+; CHECK: store i32 0, ptr %p
+; CHECK: load i32, ptr %p
+; CHECK: store i32 %v, ptr %p
+define i32 @test_read_between(ptr %p, i32 %v) {
+entry:
+    store i32 0, ptr %p, align 4
+    %old = load i32, ptr %p, align 4
+    store i32 %v, ptr %p, align 4
+    ret i32 %old
+}
+
+; Test 3: Two narrower stores together cover a wider one
+; CHECK-LABEL: @test_partial_overwrites
+; CHECK-NOT: store i64
+; CHECK: store i32 1, ptr %p
+; CHECK: store i32 2, ptr %hi
+define void @test_partial_overwrites(ptr %p) {
+entry:
+    store i64 0, ptr %p, align 8
+    store i32 1, ptr %p, align 8
+    %hi = getelementptr inbounds i8, ptr %p, i64 4
+    store i32 2, ptr %hi, align 4
+    ret void
+}
+
+; Test 4: Overwrite on only one path is not enough
+; CHECK-LABEL: @test_one_path
+; CHECK: store i32 0, ptr %p
+define void @test_one_path(ptr %p, i1 %c) {
+entry:
+    store i32 0, ptr %p, align 4
+    br i1 %c, label %then, label %exit
+
+then:
+    store i32 1, ptr %p, align 4
+    br label %exit
+
+exit:
+    ret void
+}
+
+; Test 5: Overwrite in a post-dominating block
+; CHECK-LABEL: @test_postdominating
+; CHECK-NOT: store i32 0
+; CHECK: store i32 1, ptr %p
+define void @test_postdominating(ptr %p, ptr %q, i1 %c) {
+entry:
+    store i32 0, ptr %p, align 4
+    br i1 %c, label %then, label %join
+
+then:
+    br label %join
+
+join:
+    store i32 1, ptr %p, align 4
+    ret void
+}
+
+; Test 6: Partially overwritten memset is trimmed
+; CHECK-LABEL: @test_trim_memset
+; CHECK: call void @llvm.memset.p0.i64(ptr align 8 %p, i8 0, i64 24, i1 false)
+define void @test_trim_memset(ptr %p) {
+entry:
+    call void @llvm.memset.p0.i64(ptr align 8 %p, i8 0, i64 32, i1 false)
+    %tail = getelementptr inbounds i8, ptr %p, i64 24
+    store i64 7, ptr %tail, align 8
+    %v = load i8, ptr %p, align 1
+    call void @sink(i8 %v)
+    ret void
+}
+
+; Test 7: Store to a local object that is never read again
+; CHECK-LABEL: @test_end_of_lifetime
+; CHECK-NOT: store i32 42
+; CHECK: ret i32
+define i32 @test_end_of_lifetime(i32 %x) {
+entry:
+    %buf = alloca [4 x i32], align 16
+    %e = getelementptr inbounds [4 x i32], ptr %buf, i64 0, i64 1
+    store i32 %x, ptr %e, align 4
+    %r = load i32, ptr %e, align 4
+    store i32 42, ptr %e, align 4
+    ret i32 %r
+}
+
+; Test 8: Store before lifetime.end of its object
+; CHECK-LABEL: @test_lifetime_end
+; CHECK-NOT: store i32 5
+; CHECK: call void @llvm.lifetime.end.p0(i64 4, ptr %a)
+define void @test_lifetime_end() {
+entry:
+    %a = alloca i32, align 4
+    call void @llvm.lifetime.start.p0(i64 4, ptr %a)
+    call void @escape(ptr %a)
+    store i32 5, ptr %a, align 4
+    call void @llvm.lifetime.end.p0(i64 4, ptr %a)
+    call void @escape(ptr null)
+    ret void
+}
+
+; Test 9: Stores to non-local memory survive the end of the function
+; CHECK-LABEL: @test_global_store
+; CHECK: store i32 3, ptr @g
+@g = global i32 0
+
+define void @test_global_store() {
+entry:
+    store i32 3, ptr @g, align 4
+    ret void
+}
+
+; Test 10: A call that may unwind between the stores lets the caller see
+; the first one; it touches no memory the stores write
+; CHECK-LABEL: @test_may_throw_between
+; CHECK: store i32 1, ptr @g
+; CHECK: call void @may_throw()
+; CHECK: store i32 2, ptr @g
+define void @test_may_throw_between() {
+entry:
+    store i32 1, ptr @g, align 4
+    call void @may_throw()
+    store i32 2, ptr @g, align 4
+    ret void
+}
+
+; Test 11: A local that does not escape is invisible to the caller, so
+; unwinding does not keep the store
+; CHECK-LABEL: @test_may_throw_local
+; CHECK-NOT: store i32 1
+; CHECK: call void @may_throw()
+; CHECK: store i32 2, ptr %a
+define i32 @test_may_throw_local() {
+entry:
+    %a = alloca i32, align 4
+    store i32 1, ptr %a, align 4
+    call void @may_throw()
+    store i32 2, ptr %a, align 4
+    %v = load i32, ptr %a, align 4
+    ret i32 %v
+}
+
+; Test 12: A call that only reads other memory may still unwind
+; CHECK-LABEL: @test_may_throw_read
+; CHECK: store i32 1, ptr @g
+; CHECK: call void @may_throw_read(ptr %q)
+; CHECK: store i32 2, ptr @g
+define void @test_may_throw_read(ptr noalias %q) {
+entry:
+    store i32 1, ptr @g, align 4
+    call void @may_throw_read(ptr %q)
+    store i32 2, ptr @g, align 4
+    ret void
+}
+
+declare void @sink(i8)
+declare void @may_throw_read(ptr) readonly argmemonly
+declare void @may_throw() inaccessiblememonly
+declare void @escape(ptr)
+declare void @llvm.memset.p0.i64(ptr, i8, i64, i1)
+declare void @llvm.lifetime.start.p0(i64, ptr)
+declare void @llvm.lifetime.end.p0(i64, ptr)
@@ -0,0 +1,41 @@
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="default<O2>" -debug-pass-manager -disable-output %s 2>&1 | FileCheck %s --check-prefix=O2
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="default<Oz>" -debug-pass-manager -disable-output %s 2>&1 | FileCheck %s --check-prefix=OZ
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="default<O0>" -debug-pass-manager -disable-output %s 2>&1 | FileCheck %s --check-prefix=O0
+;
+; Test cases for the default pipeline extension points
+; The passes join default<O1..3,s,z> without a -passes string naming them
+
+; Folding runs at the peephole points, redundancy elimination late in the
+; scalar optimizer, and full unrolling at the start of the vectorizer
+; O2: Running pass: ConstantFoldingPass on test_extension_points
+; O2: Running pass: RedundancyEliminationPass on test_extension_points
+; O2: Running pass: LoopUnrollingPass on test_extension_points
+; O2: Running pass: LoopVectorizePass on test_extension_points
+
+; No unrolling at -Oz, which must not grow the code
+; OZ: Running pass: ConstantFoldingPass on test_extension_points
+; OZ: Running pass: RedundancyEliminationPass on test_extension_points
+; OZ-NOT: Running pass: LoopUnrollingPass
+
+; Nothing at -O0
+; O0-NOT: ConstantFoldingPass
+; O0-NOT: RedundancyEliminationPass
+; O0-NOT: LoopUnrollingPass
+define i32 @test_extension_points(ptr %a) {
+entry:
+    br label %loop
+
+loop:
+    %i = phi i32 [ 0, %entry ], [ %next, %loop ]
+    %sum = phi i32 [ 0, %entry ], [ %add, %loop ]
+    %idx = zext i32 %i to i64
+    %p = getelementptr inbounds i32, ptr %a, i64 %idx
+    %v = load i32, ptr %p
+    %add = add i32 %sum, %v
+    %next = add i32 %i, 1
+    %cond = icmp slt i32 %next, 4
+    br i1 %cond, label %loop, label %exit
+
+exit:
+    ret i32 %add
+}
@@ -0,0 +1,88 @@
+; RUN: rm -rf %t
+; RUN: opt -load=%S/../build/LLVMOptPasses.so -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-optimize" -custom-cache-dir=%t -custom-cache-stats -S %s 2>%t.cold | FileCheck %s
+; RUN: FileCheck --check-prefix=COLD %s < %t.cold
+; RUN: opt -load=%S/../build/LLVMOptPasses.so -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-optimize" -custom-cache-dir=%t -custom-cache-stats -S %s 2>%t.warm | FileCheck %s
+; RUN: FileCheck --check-prefix=WARM %s < %t.warm
+; RUN: sed -e 's/i32 3, i32 5\]/i32 3, i32 8]/' %s | opt -load=%S/../build/LLVMOptPasses.so -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-optimize" -custom-cache-dir=%t -custom-cache-stats -S 2>%t.table | FileCheck --check-prefix=TABLE %s
+; RUN: FileCheck --check-prefix=EDIT %s < %t.table
+; RUN: sed -e 's/{ nounwind readnone willreturn }/{ nounwind }/' %s | opt -load=%S/../build/LLVMOptPasses.so -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-optimize" -custom-cache-dir=%t -custom-cache-stats -disable-output 2>%t.callee
+; RUN: FileCheck --check-prefix=EDIT %s < %t.callee
+;
+; Test cases for the Function Cache
+; These test that a warm cache replays the cold run's output, that edits
+; to what a function reads miss, and that functions with debug info are
+; compiled without the cache
+
+; Test 1: Cold, every function without debug info misses and is stored
+; COLD: [FunctionCache] 3 lookups, 0 hits, 3 misses, 3 stores, 1 uncacheable, 0 stale entries
+
+; Test 2: Warm, they all hit, and the output is the same
+; WARM: [FunctionCache] 3 lookups, 3 hits, 0 misses, 0 stores, 1 uncacheable, 0 stale entries
+
+; CHECK-LABEL: define i32 @fold(
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %c = add i32 %x, 20
+; CHECK-NEXT: ret i32 %c
+
+; CHECK-LABEL: define i32 @lookup(
+; CHECK-NEXT: entry:
+; CHECK-NEXT: ret i32 5
+
+; CHECK-LABEL: define i32 @with_debug(
+; CHECK: add i32 %x, 1
+
+; Test 3: Changing a constant initializer the function folded misses
+; TABLE-LABEL: define i32 @lookup(
+; TABLE-NEXT: entry:
+; TABLE-NEXT: ret i32 8
+
+; Test 4: So does changing a callee's attributes
+; EDIT: [FunctionCache] 3 lookups, 2 hits, 1 misses, 1 stores, 1 uncacheable, 0 stale entries
+
+@table = internal constant [4 x i32] [i32 1, i32 2, i32 3, i32 5]
+
+define i32 @fold(i32 %x) {
+entry:
+    %a = add i32 2, 3
+    %b = mul i32 %a, 4
+    %c = add i32 %x, %b
+    ret i32 %c
+}
+
+define i32 @lookup() {
+entry:
+    %p = getelementptr [4 x i32], ptr @table, i32 0, i32 3
+    %v = load i32, ptr %p
+    ret i32 %v
+}
+
+declare i32 @ext(i32) #0
+
+define i32 @twice(i32 %x) {
+entry:
+    %a = call i32 @ext(i32 %x)
+    %b = call i32 @ext(i32 %x)
+    %s = add i32 %a, %b
+    ret i32 %s
+}
+
+define i32 @with_debug(i32 %x) !dbg !5 {
+entry:
+    %a = add i32 %x, 1, !dbg !8
+    ret i32 %a, !dbg !8
+}
+
+attributes #0 = { nounwind readnone willreturn }
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!3, !4}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug, enums: !2)
+!1 = !DIFile(filename: "a.c", directory: "/tmp")
+!2 = !{}
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!4 = !{i32 7, !"Dwarf Version", i32 4}
+!5 = distinct !DISubprogram(name: "with_debug", scope: !1, file: !1, line: 1, type: !6, scopeLine: 1, spFlags: DISPFlagDefinition, unit: !0, retainedNodes: !2)
+!6 = !DISubroutineType(types: !7)
+!7 = !{null}
+!8 = !DILocation(line: 2, column: 3, scope: !5)
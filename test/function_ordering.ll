@@ -0,0 +1,102 @@
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-function-order" -S %s | FileCheck %s
+; RUN: opt -load=%S/../build/LLVMOptPasses.so -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-function-order" -custom-function-order-file=%t -disable-output %s && FileCheck --check-prefix=ORDER %s < %t
+;
+; Test cases for Function Ordering Pass
+; These test call-chain clustering of profiled callers and callees, the
+; section prefixes of hot and never-run functions, and the order file
+
+; Test 1: A hot function whose profiled caller accounts for few of its
+; calls starts a cluster of its own; it is the densest, so it goes first
+; CHECK-LABEL: define i32 @hash(
+; CHECK-SAME: !section_prefix ![[HOT:[0-9]+]]
+
+; Test 2: The hot chain main -> parse -> lex is laid out back to back,
+; in the hot section
+; CHECK-LABEL: define i32 @main()
+; CHECK-SAME: !section_prefix ![[HOT]]
+; CHECK-LABEL: define i32 @parse(
+; CHECK-SAME: !section_prefix ![[HOT]]
+; CHECK-LABEL: define i32 @lex(
+; CHECK-SAME: !section_prefix ![[HOT]]
+
+; Test 3: Functions that never ran go to the unlikely section; functions
+; without a profile are left alone, behind the ordered ones
+; CHECK-LABEL: define void @report_error(
+; CHECK-SAME: !section_prefix ![[UNLIKELY:[0-9]+]]
+; CHECK-LABEL: define i32 @no_profile(
+; CHECK-NOT: section_prefix
+; CHECK: ret i32
+
+; CHECK-DAG: ![[HOT]] = !{!"function_section_prefix", !"hot"}
+; CHECK-DAG: ![[UNLIKELY]] = !{!"function_section_prefix", !"unlikely"}
+
+; The order file lists the ordered symbols only
+; ORDER: hash
+; ORDER-NEXT: main
+; ORDER-NEXT: parse
+; ORDER-NEXT: lex
+; ORDER-NOT: {{.}}
+
+define void @report_error(i32 %code) !prof !0 {
+entry:
+    ret void
+}
+
+define i32 @no_profile(i32 %x) {
+entry:
+    %r = add i32 %x, 1
+    ret i32 %r
+}
+
+define i32 @lex(ptr %p, i32 %i) !prof !1 {
+entry:
+    %q = getelementptr i8, ptr %p, i32 %i
+    %c = load i8, ptr %q
+    %r = zext i8 %c to i32
+    ret i32 %r
+}
+
+define i32 @hash(i32 %x) !prof !2 {
+entry:
+    %a = mul i32 %x, 31
+    %b = xor i32 %a, 17
+    ret i32 %b
+}
+
+define i32 @parse(ptr %p, i32 %n) !prof !3 {
+entry:
+    %t = call i32 @lex(ptr %p, i32 %n), !prof !4
+    %bad = icmp slt i32 %t, 0
+    br i1 %bad, label %error, label %ok
+
+error:
+    call void @report_error(i32 %t)
+    ret i32 -1
+
+ok:
+    %h = call i32 @hash(i32 %t), !prof !5
+    ret i32 %h
+}
+
+define i32 @main() !prof !6 {
+entry:
+    br label %loop
+
+loop:
+    %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+    %v = call i32 @parse(ptr null, i32 %i), !prof !4
+    %i.next = add i32 %i, 1
+    %c = icmp slt i32 %i.next, 100
+    br i1 %c, label %loop, label %exit
+
+exit:
+    ret i32 0
+}
+
+!0 = !{!"function_entry_count", i64 0}
+!1 = !{!"function_entry_count", i64 100}
+!2 = !{!"function_entry_count", i64 100000}
+!3 = !{!"function_entry_count", i64 100}
+!4 = !{!"branch_weights", i32 100}
+!5 = !{!"branch_weights", i32 100}
+!6 = !{!"function_entry_count", i64 1}
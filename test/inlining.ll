@@ -0,0 +1,271 @@
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-inline" -S %s | FileCheck %s
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-optimize" -S %s | FileCheck %s --check-prefix=OPT
+;
+; Test cases for Inlining Pass
+; These test the TTI cost model, the constant argument and loop bonuses,
+; and the bottom-up order of the combined pipeline
+
+; Test 1: Small leaf functions are inlined
+; CHECK-LABEL: @test_small_leaf
+; CHECK-NOT: call
+; CHECK: %s.i = add i32 %a, %b
+; CHECK: ret i32 %s.i
+define internal i32 @add(i32 %a, i32 %b) {
+    %s = add i32 %a, %b
+    ret i32 %s
+}
+
+define i32 @test_small_leaf(i32 %a, i32 %b) {
+    %r = call i32 @add(i32 %a, i32 %b)
+    ret i32 %r
+}
+
+; Test 2: A large callee stays behind the call with an unknown mode...
+; CHECK-LABEL: @test_unknown_mode
+; CHECK: call i32 @dispatch(i32 %mode, i32 %x)
+define i32 @dispatch(i32 %mode, i32 %x) {
+entry:
+    %fast = icmp eq i32 %mode, 0
+    br i1 %fast, label %quick, label %slow
+
+quick:
+    %q = add i32 %x, 1
+    ret i32 %q
+
+slow:
+    %s0 = mul i32 %x, 3
+    %s1 = add i32 %s0, 4
+    %s2 = xor i32 %s1, 5
+    %s3 = mul i32 %s2, 6
+    %s4 = add i32 %s3, 7
+    %s5 = xor i32 %s4, 8
+    %s6 = mul i32 %s5, 9
+    %s7 = add i32 %s6, 10
+    %s8 = xor i32 %s7, 11
+    %s9 = mul i32 %s8, 12
+    %s10 = add i32 %s9, 13
+    %s11 = xor i32 %s10, 14
+    %s12 = mul i32 %s11, 15
+    %s13 = add i32 %s12, 16
+    %s14 = xor i32 %s13, 17
+    %s15 = mul i32 %s14, 18
+    %s16 = add i32 %s15, 19
+    %s17 = xor i32 %s16, 20
+    %s18 = mul i32 %s17, 21
+    %s19 = add i32 %s18, 22
+    %s20 = xor i32 %s19, 23
+    %s21 = mul i32 %s20, 24
+    %s22 = add i32 %s21, 25
+    %s23 = xor i32 %s22, 26
+    %s24 = mul i32 %s23, 27
+    %s25 = add i32 %s24, 28
+    %s26 = xor i32 %s25, 29
+    %s27 = mul i32 %s26, 30
+    %s28 = add i32 %s27, 31
+    %s29 = xor i32 %s28, 32
+    %s30 = mul i32 %s29, 33
+    %s31 = add i32 %s30, 34
+    %s32 = xor i32 %s31, 35
+    %s33 = mul i32 %s32, 36
+    %s34 = add i32 %s33, 37
+    %s35 = xor i32 %s34, 38
+    %s36 = mul i32 %s35, 39
+    %s37 = add i32 %s36, 40
+    %s38 = xor i32 %s37, 41
+    %s39 = mul i32 %s38, 42
+    %s40 = add i32 %s39, 43
+    %s41 = xor i32 %s40, 44
+    %s42 = mul i32 %s41, 45
+    %s43 = add i32 %s42, 46
+    %s44 = xor i32 %s43, 47
+    %s45 = mul i32 %s44, 48
+    %s46 = add i32 %s45, 49
+    %s47 = xor i32 %s46, 50
+    %s48 = mul i32 %s47, 51
+    %s49 = add i32 %s48, 52
+    %s50 = xor i32 %s49, 53
+    %s51 = mul i32 %s50, 54
+    %s52 = add i32 %s51, 55
+    %s53 = xor i32 %s52, 56
+    %s54 = mul i32 %s53, 57
+    %s55 = add i32 %s54, 58
+    %s56 = xor i32 %s55, 59
+    %s57 = mul i32 %s56, 60
+    %s58 = add i32 %s57, 61
+    %s59 = xor i32 %s58, 62
+    ret i32 %s59
+}
+
+define i32 @test_unknown_mode(i32 %mode, i32 %x) {
+    %r = call i32 @dispatch(i32 %mode, i32 %x)
+    ret i32 %r
+}
+
+; Test 3: ...but a constant mode that rules out the slow path is inlined
+; CHECK-LABEL: @test_constant_mode
+; CHECK-NOT: call
+; CHECK: ret i32
+define i32 @test_constant_mode(i32 %x) {
+    %r = call i32 @dispatch(i32 0, i32 %x)
+    ret i32 %r
+}
+
+; Test 4: A medium callee is inlined only inside a loop
+; CHECK-LABEL: @test_medium_straight
+; CHECK: call i32 @medium(i32 %x)
+; CHECK-LABEL: @test_medium_in_loop
+; CHECK: loop:
+; CHECK-NOT: call
+; CHECK: br i1
+define i32 @medium(i32 %x) {
+    %m0 = mul i32 %x, 3
+    %m1 = add i32 %m0, 4
+    %m2 = xor i32 %m1, 5
+    %m3 = mul i32 %m2, 6
+    %m4 = add i32 %m3, 7
+    %m5 = xor i32 %m4, 8
+    %m6 = mul i32 %m5, 9
+    %m7 = add i32 %m6, 10
+    %m8 = xor i32 %m7, 11
+    %m9 = mul i32 %m8, 12
+    %m10 = add i32 %m9, 13
+    %m11 = xor i32 %m10, 14
+    %m12 = mul i32 %m11, 15
+    %m13 = add i32 %m12, 16
+    %m14 = xor i32 %m13, 17
+    %m15 = mul i32 %m14, 18
+    %m16 = add i32 %m15, 19
+    %m17 = xor i32 %m16, 20
+    %m18 = mul i32 %m17, 21
+    %m19 = add i32 %m18, 22
+    %m20 = xor i32 %m19, 23
+    %m21 = mul i32 %m20, 24
+    %m22 = add i32 %m21, 25
+    %m23 = xor i32 %m22, 26
+    %m24 = mul i32 %m23, 27
+    %m25 = add i32 %m24, 28
+    %m26 = xor i32 %m25, 29
+    %m27 = mul i32 %m26, 30
+    %m28 = add i32 %m27, 31
+    %m29 = xor i32 %m28, 32
+    %m30 = mul i32 %m29, 33
+    %m31 = add i32 %m30, 34
+    %m32 = xor i32 %m31, 35
+    %m33 = mul i32 %m32, 36
+    %m34 = add i32 %m33, 37
+    %m35 = xor i32 %m34, 38
+    %m36 = mul i32 %m35, 39
+    %m37 = add i32 %m36, 40
+    %m38 = xor i32 %m37, 41
+    %m39 = mul i32 %m38, 42
+    %m40 = add i32 %m39, 43
+    %m41 = xor i32 %m40, 44
+    %m42 = mul i32 %m41, 45
+    %m43 = add i32 %m42, 46
+    %m44 = xor i32 %m43, 47
+    %m45 = mul i32 %m44, 48
+    %m46 = add i32 %m45, 49
+    %m47 = xor i32 %m46, 50
+    %m48 = mul i32 %m47, 51
+    %m49 = add i32 %m48, 52
+    %m50 = xor i32 %m49, 53
+    %m51 = mul i32 %m50, 54
+    %m52 = add i32 %m51, 55
+    %m53 = xor i32 %m52, 56
+    %m54 = mul i32 %m53, 57
+    %m55 = add i32 %m54, 58
+    %m56 = xor i32 %m55, 59
+    %m57 = mul i32 %m56, 60
+    %m58 = add i32 %m57, 61
+    %m59 = xor i32 %m58, 62
+    ret i32 %m59
+}
+
+define i32 @test_medium_straight(i32 %x) {
+    %r = call i32 @medium(i32 %x)
+    ret i32 %r
+}
+
+define i32 @test_medium_in_loop(ptr %a, i32 %n) {
+entry:
+    br label %loop
+
+loop:
+    %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+    %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+    %p = getelementptr i32, ptr %a, i32 %i
+    %v = load i32, ptr %p
+    %m = call i32 @medium(i32 %v)
+    %acc.next = add i32 %acc, %m
+    %i.next = add i32 %i, 1
+    %c = icmp slt i32 %i.next, %n
+    br i1 %c, label %loop, label %exit
+
+exit:
+    ret i32 %acc.next
+}
+
+; Test 5: noinline and recursive calls are left alone
+; CHECK-LABEL: @test_not_inlinable
+; CHECK: call i32 @opaque(i32 %x)
+; CHECK: call i32 @countdown(i32 %x)
+define i32 @opaque(i32 %x) noinline {
+    %r = add i32 %x, 1
+    ret i32 %r
+}
+
+define i32 @countdown(i32 %n) {
+entry:
+    %done = icmp eq i32 %n, 0
+    br i1 %done, label %exit, label %recurse
+
+recurse:
+    %m = sub i32 %n, 1
+    %r = call i32 @countdown(i32 %m)
+    ret i32 %r
+
+exit:
+    ret i32 0
+}
+
+define i32 @test_not_inlinable(i32 %x) {
+    %a = call i32 @opaque(i32 %x)
+    %b = call i32 @countdown(i32 %x)
+    %r = add i32 %a, %b
+    ret i32 %r
+}
+
+; Test 6: In custom-optimize the callee is optimized first, then inlined
+; and folded into the caller (constant_folding_test from benchmark.c)
+; OPT-LABEL: @test_pipeline
+; OPT-NEXT: ret i32 148
+define internal i32 @constant_folding_test() {
+entry:
+    %result = alloca i32
+    %a = alloca i32
+    store i32 0, ptr %result
+    %t0 = add i32 10, 20
+    store i32 %t0, ptr %a
+    %a0 = load i32, ptr %a
+    %b = mul i32 %a0, 2
+    %c = sdiv i32 %b, 3
+    %d = add i32 20, 18
+    %cmp = icmp sgt i32 100, 50
+    br i1 %cmp, label %then, label %end
+
+then:
+    %s1 = add i32 %a0, %b
+    %s2 = add i32 %s1, %c
+    %s3 = add i32 %s2, %d
+    store i32 %s3, ptr %result
+    br label %end
+
+end:
+    %r = load i32, ptr %result
+    ret i32 %r
+}
+
+define i32 @test_pipeline() {
+    %r = call i32 @constant_folding_test()
+    ret i32 %r
+}
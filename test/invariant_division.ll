@@ -0,0 +1,167 @@
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-invariant-div" -S %s | FileCheck %s
+;
+; Test cases for Invariant Division Pass
+; These test magic-number division by loop-invariant divisors, sharing one
+; setup between divisions, hoisting to outer loops and the cost model
+
+; Test 1: i % size with a run-time size needs no urem inside the loop
+; CHECK-LABEL: @test_urem_invariant
+; CHECK: entry:
+; CHECK: %div.safe = select
+; CHECK: udiv i64
+; CHECK: %div.magic = select
+; CHECK: %div.magic.wide = zext i32 %div.magic to i64
+; CHECK: br label %loop
+; CHECK: loop:
+; CHECK-NOT: urem
+; CHECK: %div.mulhi = trunc
+; CHECK: %r = sub i32 %i, {{%[0-9]+}}
+; CHECK-NOT: urem
+; CHECK: exit:
+define void @test_urem_invariant(ptr %out, i32 %n, i32 %size) {
+entry:
+    br label %loop
+
+loop:
+    %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+    %r = urem i32 %i, %size
+    %p = getelementptr i32, ptr %out, i32 %i
+    store i32 %r, ptr %p
+    %i.next = add i32 %i, 1
+    %c = icmp ult i32 %i.next, %n
+    br i1 %c, label %loop, label %exit
+
+exit:
+    ret void
+}
+
+; Test 2: Signed division and remainder by the same divisor share one setup
+; CHECK-LABEL: @test_sdiv_srem_shared
+; CHECK: %div.sign = ashr i32 %d, 31
+; CHECK-NOT: %div.sign{{[0-9]+}} =
+; CHECK: loop:
+; CHECK-NOT: sdiv
+; CHECK-NOT: srem
+; CHECK: %q = sub i32
+; CHECK: %r = sub i32 %x,
+; CHECK: exit:
+define i32 @test_sdiv_srem_shared(ptr %a, i32 %n, i32 %d) {
+entry:
+    br label %loop
+
+loop:
+    %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+    %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+    %p = getelementptr i32, ptr %a, i32 %i
+    %x = load i32, ptr %p
+    %q = sdiv i32 %x, %d
+    %r = srem i32 %x, %d
+    %s = add i32 %q, %r
+    %acc.next = add i32 %acc, %s
+    %i.next = add i32 %i, 1
+    %c = icmp slt i32 %i.next, %n
+    br i1 %c, label %loop, label %exit
+
+exit:
+    ret i32 %acc.next
+}
+
+; Test 3: Constant divisors are left to the backend
+; CHECK-LABEL: @test_constant_divisor
+; CHECK: %r = udiv i32 %i, 7
+; CHECK-NOT: div.magic
+define void @test_constant_divisor(ptr %out, i32 %n) {
+entry:
+    br label %loop
+
+loop:
+    %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+    %r = udiv i32 %i, 7
+    %p = getelementptr i32, ptr %out, i32 %i
+    store i32 %r, ptr %p
+    %i.next = add i32 %i, 1
+    %c = icmp ult i32 %i.next, %n
+    br i1 %c, label %loop, label %exit
+
+exit:
+    ret void
+}
+
+; Test 4: Two iterations do not pay for the setup
+; CHECK-LABEL: @test_short_trip_count
+; CHECK: %r = udiv i32 %x, %d
+; CHECK-NOT: div.magic
+define i32 @test_short_trip_count(ptr %a, i32 %d) {
+entry:
+    br label %loop
+
+loop:
+    %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+    %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+    %p = getelementptr i32, ptr %a, i32 %i
+    %x = load i32, ptr %p
+    %r = udiv i32 %x, %d
+    %acc.next = add i32 %acc, %r
+    %i.next = add i32 %i, 1
+    %c = icmp ult i32 %i.next, 2
+    br i1 %c, label %loop, label %exit
+
+exit:
+    ret i32 %acc.next
+}
+
+; Test 5: A fully invariant division is left for hoisting
+; CHECK-LABEL: @test_invariant_numerator
+; CHECK: %r = udiv i32 %x, %d
+; CHECK-NOT: div.magic
+define void @test_invariant_numerator(ptr %out, i32 %n, i32 %x, i32 %d) {
+entry:
+    br label %loop
+
+loop:
+    %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+    %r = udiv i32 %x, %d
+    %p = getelementptr i32, ptr %out, i32 %i
+    store i32 %r, ptr %p
+    %i.next = add i32 %i, 1
+    %c = icmp ult i32 %i.next, %n
+    br i1 %c, label %loop, label %exit
+
+exit:
+    ret void
+}
+
+; Test 6: The setup is hoisted to the outermost loop where d is invariant
+; CHECK-LABEL: @test_nested_hoist
+; CHECK: entry:
+; CHECK: %div.magic = select
+; CHECK: br label %outer
+; CHECK: inner:
+; CHECK-NOT: urem
+; CHECK: %r = sub i64 %j,
+; CHECK: outer.latch:
+define void @test_nested_hoist(ptr %out, i64 %n, i64 %m, i64 %d) {
+entry:
+    br label %outer
+
+outer:
+    %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+    br label %inner
+
+inner:
+    %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+    %r = urem i64 %j, %d
+    %p = getelementptr i64, ptr %out, i64 %j
+    store i64 %r, ptr %p
+    %j.next = add i64 %j, 1
+    %ci = icmp ult i64 %j.next, %m
+    br i1 %ci, label %inner, label %outer.latch
+
+outer.latch:
+    %i.next = add i64 %i, 1
+    %co = icmp ult i64 %i.next, %n
+    br i1 %co, label %outer, label %exit
+
+exit:
+    ret void
+}
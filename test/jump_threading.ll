@@ -0,0 +1,162 @@
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-jump-thread" -S %s | FileCheck %s
+;
+; Test cases for Jump Threading Pass
+; These test threading of PHI/compare conditions, switches and cost limits
+
+; Test 1: Branch on a PHI with a constant incoming value
+; CHECK-LABEL: @test_phi_condition
+; CHECK: then:
+; CHECK-NEXT: br label %yes
+; CHECK: else:
+; CHECK: br label %merge
+; CHECK: merge:
+; CHECK-NEXT: %c = phi i1 [ %c0, %else ]
+; CHECK-NEXT: br i1 %c, label %yes, label %no
+define i32 @test_phi_condition(i1 %a, i1 %b) {
+entry:
+    br i1 %a, label %then, label %else
+
+then:
+    br label %merge
+
+else:
+    %c0 = xor i1 %b, true
+    br label %merge
+
+merge:
+    %c = phi i1 [ true, %then ], [ %c0, %else ]
+    br i1 %c, label %yes, label %no
+
+yes:
+    ret i32 1
+
+no:
+    ret i32 0
+}
+
+; Test 2: Compare of a PHI folded per predecessor with a cloned value
+; CHECK-LABEL: @test_compare_of_phi
+; CHECK: left:
+; CHECK-NEXT: br label %[[LEFT:mid.thread[0-9]*]]
+; CHECK: right:
+; CHECK-NEXT: br label %[[RIGHT:mid.thread[0-9]*]]
+; CHECK: [[RIGHT]]:
+; CHECK-NEXT: %[[VR:v1[0-9]*]] = add i32 200, 10
+; CHECK-NEXT: br label %large
+; CHECK: [[LEFT]]:
+; CHECK-NEXT: %[[VL:v1[0-9]*]] = add i32 1, 10
+; CHECK-NEXT: br label %small
+; CHECK: small:
+; CHECK-NEXT: ret i32 %[[VL]]
+; CHECK: large:
+; CHECK-NEXT: ret i32 %[[VR]]
+define i32 @test_compare_of_phi(i1 %a) {
+entry:
+    br i1 %a, label %left, label %right
+
+left:
+    br label %mid
+
+right:
+    br label %mid
+
+mid:
+    %x = phi i32 [ 1, %left ], [ 200, %right ]
+    %v1 = add i32 %x, 10
+    %cmp = icmp slt i32 %x, 100
+    br i1 %cmp, label %small, label %large
+
+small:
+    ret i32 %v1
+
+large:
+    ret i32 %v1
+}
+
+; Test 3: Switch over a state PHI
+; CHECK-LABEL: @test_switch_state
+; CHECK: init:
+; CHECK-NEXT: br label %state1
+; CHECK: resume:
+; CHECK-NEXT: br label %state2
+; CHECK-NOT: switch
+define i32 @test_switch_state(i1 %first) {
+entry:
+    br i1 %first, label %init, label %resume
+
+init:
+    br label %dispatch
+
+resume:
+    br label %dispatch
+
+dispatch:
+    %state = phi i32 [ 1, %init ], [ 2, %resume ]
+    switch i32 %state, label %done [
+        i32 1, label %state1
+        i32 2, label %state2
+    ]
+
+state1:
+    ret i32 10
+
+state2:
+    ret i32 20
+
+done:
+    ret i32 0
+}
+
+; Test 4: Block too large to duplicate stays untouched
+; CHECK-LABEL: @test_too_costly
+; CHECK: br label %big
+; CHECK: br label %big
+; CHECK: big:
+; CHECK: br i1 %c, label %yes, label %no
+define i32 @test_too_costly(i1 %a, i32 %x) {
+entry:
+    br i1 %a, label %p1, label %p2
+
+p1:
+    br label %big
+
+p2:
+    br label %big
+
+big:
+    %c = phi i1 [ true, %p1 ], [ false, %p2 ]
+    %x1 = mul i32 %x, 3
+    %x2 = mul i32 %x1, 5
+    %x3 = mul i32 %x2, 7
+    %x4 = mul i32 %x3, 11
+    %x5 = mul i32 %x4, 13
+    %x6 = mul i32 %x5, 17
+    %x7 = mul i32 %x6, 19
+    br i1 %c, label %yes, label %no
+
+yes:
+    ret i32 %x7
+
+no:
+    ret i32 0
+}
+
+; Test 5: Loop headers are never threaded
+; CHECK-LABEL: @test_loop_header
+; CHECK: header:
+; CHECK: br i1 %c, label %body, label %exit
+define void @test_loop_header(i32 %n) {
+entry:
+    br label %header
+
+header:
+    %c = phi i1 [ true, %entry ], [ %c.next, %body ]
+    br i1 %c, label %body, label %exit
+
+body:
+    %c.next = icmp ne i32 %n, 0
+    br label %header
+
+exit:
+    ret void
+}
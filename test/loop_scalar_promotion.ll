@@ -0,0 +1,179 @@
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-scalar-promote" -S %s | FileCheck %s
+;
+; Test cases for Loop Scalar Promotion Pass
+; These test accumulators kept in registers, alias checks and exit stores
+
+; Test 1: Accumulate-in-place with a constant trip count (matmul inner loop)
+; CHECK-LABEL: @test_accumulate
+; CHECK: entry:
+; CHECK: %c.promoted = load i32, ptr %c
+; CHECK: for.cond:
+; CHECK: phi i32 [ %c.promoted, %entry ]
+; CHECK-NOT: store
+; CHECK: for.end:
+; CHECK-NEXT: store i32 %{{.*}}, ptr %c
+define void @test_accumulate(ptr noalias %a, ptr noalias %c) {
+entry:
+    br label %for.cond
+
+for.cond:
+    %k = phi i64 [ 0, %entry ], [ %k.next, %for.body ]
+    %cmp = icmp slt i64 %k, 4
+    br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+    %pa = getelementptr inbounds i32, ptr %a, i64 %k
+    %va = load i32, ptr %pa, align 4
+    %old = load i32, ptr %c, align 4
+    %new = add i32 %old, %va
+    store i32 %new, ptr %c, align 4
+    %k.next = add nuw nsw i64 %k, 1
+    br label %for.cond
+
+for.end:
+    ret void
+}
+
+; Test 2: Address recomputed in the loop from invariant operands
+; CHECK-LABEL: @test_hoisted_address
+; CHECK: entry:
+; CHECK: %pc = getelementptr inbounds [4 x i32], ptr %c, i64 %i, i64 %j
+; CHECK: %pc.promoted = load i32, ptr %pc
+; CHECK: loop:
+; CHECK-NOT: load i32, ptr %pc
+; CHECK: exit:
+; CHECK-NEXT: store i32 %{{.*}}, ptr %pc
+define void @test_hoisted_address(ptr noalias %a, ptr noalias %c, i64 %i, i64 %j, i64 %n) {
+entry:
+    br label %loop
+
+loop:
+    %k = phi i64 [ 0, %entry ], [ %k.next, %loop ]
+    %pa = getelementptr inbounds i32, ptr %a, i64 %k
+    %va = load i32, ptr %pa, align 4
+    %pc = getelementptr inbounds [4 x i32], ptr %c, i64 %i, i64 %j
+    %old = load i32, ptr %pc, align 4
+    %new = add i32 %old, %va
+    %pc2 = getelementptr inbounds [4 x i32], ptr %c, i64 %i, i64 %j
+    store i32 %new, ptr %pc2, align 4
+    %k.next = add nuw nsw i64 %k, 1
+    %done = icmp eq i64 %k.next, %n
+    br i1 %done, label %exit, label %loop
+
+exit:
+    ret void
+}
+
+; Test 3: Other accesses may alias the location
+; CHECK-LABEL: @test_may_alias
+; CHECK: for.body:
+; CHECK: load i32, ptr %c
+; CHECK: store i32 %new, ptr %c
+define void @test_may_alias(ptr %a, ptr %c) {
+entry:
+    br label %for.cond
+
+for.cond:
+    %k = phi i64 [ 0, %entry ], [ %k.next, %for.body ]
+    %cmp = icmp slt i64 %k, 4
+    br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+    %pa = getelementptr inbounds i32, ptr %a, i64 %k
+    %va = load i32, ptr %pa, align 4
+    %old = load i32, ptr %c, align 4
+    %new = add i32 %old, %va
+    store i32 %new, ptr %c, align 4
+    %k.next = add nuw nsw i64 %k, 1
+    br label %for.cond
+
+for.end:
+    ret void
+}
+
+; Test 4: Loop may run zero times, so the exit store would be new
+; CHECK-LABEL: @test_zero_trip
+; CHECK: for.body:
+; CHECK: store i32 %new, ptr %c
+define void @test_zero_trip(ptr noalias %a, ptr noalias %c, i64 %n) {
+entry:
+    br label %for.cond
+
+for.cond:
+    %k = phi i64 [ 0, %entry ], [ %k.next, %for.body ]
+    %cmp = icmp slt i64 %k, %n
+    br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+    %pa = getelementptr inbounds i32, ptr %a, i64 %k
+    %va = load i32, ptr %pa, align 4
+    %old = load i32, ptr %c, align 4
+    %new = add i32 %old, %va
+    store i32 %new, ptr %c, align 4
+    %k.next = add nuw nsw i64 %k, 1
+    br label %for.cond
+
+for.end:
+    ret void
+}
+
+; Test 5: Conditional store to a non-escaping local is promoted
+; CHECK-LABEL: @test_local_conditional
+; CHECK: %acc.promoted = load i32, ptr %acc
+; CHECK: latch:
+; CHECK-NOT: store
+; CHECK: exit:
+; CHECK-NEXT: store i32 %{{.*}}, ptr %acc
+define i32 @test_local_conditional(ptr noalias %a, i64 %n) {
+entry:
+    %acc = alloca i32, align 4
+    store i32 0, ptr %acc, align 4
+    br label %loop
+
+loop:
+    %k = phi i64 [ 0, %entry ], [ %k.next, %latch ]
+    %pa = getelementptr inbounds i32, ptr %a, i64 %k
+    %va = load i32, ptr %pa, align 4
+    %pos = icmp sgt i32 %va, 0
+    br i1 %pos, label %add, label %latch
+
+add:
+    %old = load i32, ptr %acc, align 4
+    %new = add i32 %old, %va
+    store i32 %new, ptr %acc, align 4
+    br label %latch
+
+latch:
+    %k.next = add nuw nsw i64 %k, 1
+    %done = icmp eq i64 %k.next, %n
+    br i1 %done, label %exit, label %loop
+
+exit:
+    %r = load i32, ptr %acc, align 4
+    ret i32 %r
+}
+
+; Test 6: A call that may write memory blocks promotion
+; CHECK-LABEL: @test_call_in_loop
+; CHECK: loop:
+; CHECK: load i32, ptr %c
+; CHECK: store i32 %new, ptr %c
+define void @test_call_in_loop(ptr noalias %c, i64 %n) {
+entry:
+    br label %loop
+
+loop:
+    %k = phi i64 [ 0, %entry ], [ %k.next, %loop ]
+    %old = load i32, ptr %c, align 4
+    %new = add i32 %old, 1
+    store i32 %new, ptr %c, align 4
+    call void @unknown()
+    %k.next = add nuw nsw i64 %k, 1
+    %done = icmp eq i64 %k.next, %n
+    br i1 %done, label %exit, label %loop
+
+exit:
+    ret void
+}
+
+declare void @unknown()
@@ -1,12 +1,20 @@
 ; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-loop-unroll" -S %s | FileCheck %s
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-loop-unroll<full-max=2;partial=1>" -S %s | FileCheck %s --check-prefix=NOFULL
+; RUN: not opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-loop-unroll<partial=0>" -S %s 2>&1 | FileCheck %s --check-prefix=BADPARAM
 ;
 ; Test cases for Loop Unrolling Pass
 ; These test SCEV trip count computation and unroll strategies
 
+; A partial factor of 0 would unroll nothing, so it does not parse
+; BADPARAM: invalid custom-loop-unroll parameter 'partial=0': expected at least 1
+
 ; Test 1: Simple loop with known trip count (should fully unroll)
 ; CHECK-LABEL: @test_simple_loop
 ; CHECK-NOT: br i1
 ; The loop should be fully unrolled
+; With full-max=2 the trip count of 4 is too large, and partial=1 keeps it
+; NOFULL-LABEL: @test_simple_loop
+; NOFULL: br i1 %cond, label %loop, label %exit
 define i32 @test_simple_loop() {
 entry:
     br label %loop
@@ -0,0 +1,52 @@
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="lto<O2>" -debug-pass-manager -disable-output %s 2>&1 | FileCheck %s --check-prefix=LTO
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="lto<Os>" -debug-pass-manager -disable-output %s 2>&1 | FileCheck %s --check-prefix=LTO-OS
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="lto-pre-link<O2>" -debug-pass-manager -disable-output %s 2>&1 | FileCheck %s --check-prefix=PRELINK
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="thinlto-pre-link<O2>" -debug-pass-manager -disable-output %s 2>&1 | FileCheck %s --check-prefix=PRELINK
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="default<O2>" -debug-pass-manager -disable-output %s 2>&1 | FileCheck %s --check-prefix=PRELINK
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="thinlto<O2>" -debug-pass-manager -disable-output %s 2>&1 | FileCheck %s --check-prefix=THIN
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="thinlto<O2>" -S %s | FileCheck %s --check-prefix=THIN-IR
+;
+; Test cases for the LTO extension points
+
+; Full LTO: specialization first, splitting and ordering last
+; LTO: Running pass: ArgumentSpecializationPass
+; LTO: Running pass: ColdRegionSplittingPass
+; LTO: Running pass: FunctionOrderingPass
+
+; No clones when optimizing for size
+; LTO-OS-NOT: Running pass: ArgumentSpecializationPass
+; LTO-OS: Running pass: ColdRegionSplittingPass
+
+; Specialization waits for the link: neither pre-link pipeline nor a
+; plain -O2 compile runs it, only full LTO and the ThinLTO backends, where
+; imports are present
+; PRELINK-NOT: Running pass: ArgumentSpecializationPass
+; THIN: Running pass: ArgumentSpecializationPass
+; THIN-NOT: Running pass: ArgumentSpecializationPass
+
+; The imported definition is specialized into this module
+; THIN-IR-LABEL: define i32 @test_imported_callee
+; THIN-IR-NOT: call i32 @scale(
+; THIN-IR: ret i32
+define available_externally i32 @scale(ptr %a, i32 %n) noinline {
+entry:
+    br label %loop
+
+loop:
+    %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+    %p = getelementptr i32, ptr %a, i32 %i
+    %v = load i32, ptr %p
+    %w = mul i32 %v, 3
+    store i32 %w, ptr %p
+    %i.next = add i32 %i, 1
+    %c = icmp slt i32 %i.next, %n
+    br i1 %c, label %loop, label %exit
+
+exit:
+    ret i32 %i.next
+}
+
+define i32 @test_imported_callee(ptr %a) {
+    %r = call i32 @scale(ptr %a, i32 8)
+    ret i32 %r
+}
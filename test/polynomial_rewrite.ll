@@ -0,0 +1,140 @@
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-poly-rewrite" -S %s | FileCheck %s
+;
+; Test cases for Polynomial Rewrite Pass
+; These test exponentiation by squaring, power reuse, powi expansion,
+; Horner's scheme and the fast-math gating for FP
+
+; Test 1: x*x*x*x needs two multiplies
+; CHECK-LABEL: @test_power_by_squaring
+; CHECK-NEXT: %x.pow2 = mul i32 %x, %x
+; CHECK-NEXT: %x.pow4 = mul i32 %x.pow2, %x.pow2
+; CHECK-NEXT: ret i32 %x.pow4
+define i32 @test_power_by_squaring(i32 %x) {
+    %a = mul i32 %x, %x
+    %b = mul i32 %a, %x
+    %r = mul i32 %b, %x
+    ret i32 %r
+}
+
+; Test 2: Powers computed in the block are reused
+; CHECK-LABEL: @test_power_reuse
+; CHECK-NEXT: %x2 = mul i32 %x, %x
+; CHECK-NEXT: %x.pow3 = mul i32 %x2, %x
+; CHECK-NEXT: %x.pow6 = mul i32 %x.pow3, %x.pow3
+; CHECK-NEXT: %r = sub i32 %x.pow6, %x2
+define i32 @test_power_reuse(i32 %x) {
+    %x2 = mul i32 %x, %x
+    %a = mul i32 %x, %x
+    %b = mul i32 %a, %x
+    %c = mul i32 %b, %x
+    %d = mul i32 %c, %x
+    %x6 = mul i32 %d, %x
+    %r = sub i32 %x6, %x2
+    ret i32 %r
+}
+
+; Test 3: powi with a constant exponent combines with other factors
+; CHECK-LABEL: @test_powi
+; CHECK-NEXT: %x.pow2 = fmul reassoc double %x, %x
+; CHECK-NEXT: %x.pow4 = fmul reassoc double %x.pow2, %x.pow2
+; CHECK-NEXT: %x.pow5 = fmul reassoc double %x.pow4, %x
+; CHECK-NEXT: %r = fmul reassoc double %x.pow5, 3.000000e+00
+; CHECK-NOT: powi
+define double @test_powi(double %x) {
+    %p = call reassoc double @llvm.powi.f64.i32(double %x, i32 4)
+    %m = fmul reassoc double %p, 3.0
+    %r = fmul reassoc double %m, %x
+    ret double %r
+}
+
+; Test 4: polynomial_eval with fast-math becomes Horner's scheme
+; CHECK-LABEL: @test_horner
+; CHECK-NEXT: %r.horner = fmul fast double %x, 5.000000e+00
+; CHECK-NEXT: %r.horner1 = fadd fast double %r.horner, 4.000000e+00
+; CHECK-NEXT: %r.horner2 = fmul fast double %r.horner1, %x
+; CHECK-NEXT: %r.horner3 = fadd fast double %r.horner2, 3.000000e+00
+; CHECK-NEXT: %r.horner4 = fmul fast double %r.horner3, %x
+; CHECK-NEXT: %r.horner5 = fadd fast double %r.horner4, 5.000000e+00
+; CHECK-NEXT: %r.horner6 = fmul fast double %r.horner5, %x
+; CHECK-NEXT: %r = fadd fast double %r.horner6, 1.000000e+00
+; CHECK-NEXT: ret double %r
+define double @test_horner(double %x) {
+    %x2 = fmul fast double %x, %x
+    %m3 = fmul fast double %x, %x
+    %x3 = fmul fast double %m3, %x
+    %m4a = fmul fast double %x, %x
+    %m4b = fmul fast double %m4a, %x
+    %x4 = fmul fast double %m4b, %x
+    %t4 = fmul fast double 5.0, %x4
+    %t3 = fmul fast double 4.0, %x3
+    %t2 = fmul fast double 3.0, %x2
+    %t1 = fmul fast double 5.0, %x
+    %s1 = fadd fast double %t4, %t3
+    %s2 = fadd fast double %s1, %t2
+    %s3 = fadd fast double %s2, %t1
+    %r = fadd fast double %s3, 1.0
+    ret double %r
+}
+
+; Test 5: Symbolic coefficients and a missing x^1 term
+; CHECK-LABEL: @test_horner_symbolic
+; CHECK-NEXT: %r.horner = mul i32 %a, %x
+; CHECK-NEXT: %r.horner1 = add i32 %r.horner, %a
+; CHECK-NEXT: %r.horner2 = mul i32 %r.horner1, %x
+; CHECK-NEXT: %r.horner3 = mul i32 %r.horner2, %x
+; CHECK-NEXT: %r = add i32 %r.horner3, %b
+; CHECK-NEXT: ret i32 %r
+define i32 @test_horner_symbolic(i32 %a, i32 %b, i32 %x) {
+    %x2 = mul i32 %x, %x
+    %x3 = mul i32 %x2, %x
+    %t3 = mul i32 %a, %x3
+    %x2b = mul i32 %x, %x
+    %t2 = mul i32 %x2b, %a
+    %u = add i32 %t3, %b
+    %r = add i32 %u, %t2
+    ret i32 %r
+}
+
+; Test 6: Without reassoc FP expressions are left alone
+; CHECK-LABEL: @test_strict_fp
+; CHECK-NEXT: %a = fmul double %x, %x
+; CHECK-NEXT: %b = fmul double %a, %x
+; CHECK-NEXT: %r = fmul double %b, %x
+define double @test_strict_fp(double %x) {
+    %a = fmul double %x, %x
+    %b = fmul double %a, %x
+    %r = fmul double %b, %x
+    ret double %r
+}
+
+; Test 7: A kept power with nsw is not reused where the product lacks it
+; CHECK-LABEL: @test_nsw_power_not_reused
+; CHECK: %b = mul i32 %x, %x
+; CHECK-NEXT: %c = mul i32 %b, %b
+; CHECK-NOT: mul i32 %a, %a
+define void @test_nsw_power_not_reused(i32 %x) {
+    %a = mul nsw i32 %x, %x
+    call void @use(i32 %a)
+    %b = mul i32 %x, %x
+    %c = mul i32 %b, %b
+    call void @use(i32 %c)
+    ret void
+}
+
+; Test 8: Nor is one with fast-math flags the product lacks
+; CHECK-LABEL: @test_nnan_power_not_reused
+; CHECK: %b = fmul reassoc double %x, %x
+; CHECK-NEXT: %c = fmul reassoc double %b, %b
+; CHECK-NOT: fmul reassoc double %a, %a
+define void @test_nnan_power_not_reused(double %x) {
+    %a = fmul reassoc nnan ninf double %x, %x
+    call void @use.f64(double %a)
+    %b = fmul reassoc double %x, %x
+    %c = fmul reassoc double %b, %b
+    call void @use.f64(double %c)
+    ret void
+}
+
+declare double @llvm.powi.f64.i32(double, i32)
+declare void @use(i32)
+declare void @use.f64(double)
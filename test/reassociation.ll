@@ -0,0 +1,128 @@
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-reassociate" -S %s | FileCheck %s
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-reassociate,custom-redundancy-elim" -S %s | FileCheck %s --check-prefix=CSE
+;
+; Test cases for Reassociation Pass
+; These test constant merging, operand ordering, cancellation and FP flags
+
+; Test 1: (x + 3) + 5 becomes x + 8
+; CHECK-LABEL: @test_merge_constants
+; CHECK-NEXT: %r = add i32 %x, 8
+; CHECK-NEXT: ret i32 %r
+define i32 @test_merge_constants(i32 %x) {
+    %a = add nsw i32 %x, 3
+    %r = add nsw i32 %a, 5
+    ret i32 %r
+}
+
+; Test 2: Subtraction of a constant joins the add tree
+; CHECK-LABEL: @test_sub_constant
+; CHECK-NEXT: %r = add i32 %x, 2
+; CHECK-NEXT: ret i32 %r
+define i32 @test_sub_constant(i32 %x) {
+    %a = add i32 %x, 7
+    %r = sub i32 %a, 5
+    ret i32 %r
+}
+
+; Test 3: Constants in the middle of a tree are merged and moved last
+; CHECK-LABEL: @test_constant_in_middle
+; CHECK-NEXT: %r.reass = mul i32 %x, %y
+; CHECK-NEXT: %r = mul i32 %r.reass, 12
+; CHECK-NEXT: ret i32 %r
+define i32 @test_constant_in_middle(i32 %x, i32 %y) {
+    %a = mul i32 %x, 3
+    %b = mul i32 %a, %y
+    %r = mul i32 %b, 4
+    ret i32 %r
+}
+
+; Test 4: Differently written products become the same chain
+; CSE-LABEL: @test_canonical_order
+; CSE: %p.reass = mul i32 %x, %y
+; CSE-NEXT: %p = mul i32 %p.reass, %z
+; CSE-NOT: mul
+; CSE: add i32 %p, %p
+define i32 @test_canonical_order(i32 %x, i32 %y, i32 %z) {
+    %a = mul i32 %z, %y
+    %p = mul i32 %a, %x
+    %b = mul i32 %x, %z
+    %q = mul i32 %b, %y
+    %s = add i32 %p, %q
+    ret i32 %s
+}
+
+; Test 5: Equal operands cancel for xor and collapse for and
+; CHECK-LABEL: @test_cancel
+; CHECK-NEXT: %r = and i32 %x, %y
+; CHECK-NEXT: ret i32 %r
+define i32 @test_cancel(i32 %x, i32 %y) {
+    %a = xor i32 %x, %y
+    %b = xor i32 %a, %x
+    %c = xor i32 %b, %y
+    %d = xor i32 %c, %x
+    %e = and i32 %d, %y
+    %r = and i32 %e, %x
+    ret i32 %r
+}
+
+; Test 6: Absorbing constants decide the result
+; CHECK-LABEL: @test_absorb
+; CHECK-NEXT: ret i32 0
+define i32 @test_absorb(i32 %x, i32 %y) {
+    %a = and i32 %x, 12
+    %b = and i32 %a, %y
+    %r = and i32 %b, 3
+    ret i32 %r
+}
+
+; Test 7: Values with other uses stay leaves
+; CHECK-LABEL: @test_shared_subtree
+; CHECK-NEXT: %a = add i32 %x, 1
+; CHECK-NEXT: %r = add i32 %a, 1
+; CHECK-NEXT: %s = mul i32 %a, %r
+define i32 @test_shared_subtree(i32 %x) {
+    %a = add i32 %x, 1
+    %r = add i32 %a, 1
+    %s = mul i32 %a, %r
+    ret i32 %s
+}
+
+; Test 8: FP trees need reassoc and nsz
+; CHECK-LABEL: @test_fp_fast
+; CHECK-NEXT: %r = fadd reassoc nsz double %x, 8.000000e+00
+; CHECK-LABEL: @test_fp_strict
+; CHECK-NEXT: %a = fadd double %x, 3.000000e+00
+; CHECK-NEXT: %r = fadd double %a, 5.000000e+00
+define double @test_fp_fast(double %x) {
+    %a = fadd fast double %x, 3.0
+    %r = fadd reassoc nsz double %a, 5.0
+    ret double %r
+}
+
+define double @test_fp_strict(double %x) {
+    %a = fadd double %x, 3.0
+    %r = fadd double %a, 5.0
+    ret double %r
+}
+
+; Test 9: Polynomial terms share the powers of x after CSE
+; CSE-LABEL: @test_polynomial
+; CSE: %x2 = fmul fast double %x, %x
+; CSE-NEXT: %x3 = fmul fast double %x2, %x
+; CSE-NEXT: %[[X4:t4.reass[0-9]*]] = fmul fast double %x3, %x
+; CSE-NEXT: %t4 = fmul fast double %[[X4]], 5.000000e+00
+define double @test_polynomial(double %x) {
+    %x2 = fmul fast double %x, %x
+    %m3 = fmul fast double %x, %x
+    %x3 = fmul fast double %m3, %x
+    %m4a = fmul fast double %x, %x
+    %m4b = fmul fast double %m4a, %x
+    %x4 = fmul fast double %m4b, %x
+    %t4 = fmul fast double 5.0, %x4
+    %t3 = fmul fast double %x3, 4.0
+    %t2 = fmul fast double %x2, 3.0
+    %s1 = fadd fast double %t4, %t3
+    %s2 = fadd fast double %s1, %t2
+    %s3 = fadd fast double %s2, 1.0
+    ret double %s3
+}
@@ -1,5 +1,6 @@
 ; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="print<custom-redundancy>" -S %s 2>&1 | FileCheck %s --check-prefix=ANALYSIS
 ; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-redundancy-elim" -S %s | FileCheck %s
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-redundancy-elim<load-cse>" -S %s | FileCheck %s --check-prefix=LOADCSE
 ;
 ; Test cases for Redundancy Analysis and Elimination
 ; Tests GVN-based value numbering and dominance-based availability
@@ -154,3 +155,25 @@ entry:
     %c = or i32 %a, %b
     ret i32 %c
 }
+
+; Test 11: Repeated loads (only removed with load-cse)
+; CHECK-LABEL: @test_repeated_load
+; CHECK: %b = load i32, ptr %p
+; LOADCSE-LABEL: @test_repeated_load
+; LOADCSE: %a = load i32, ptr %p
+; LOADCSE-NOT: %b = load
+; LOADCSE-NOT: %d = add
+; LOADCSE: store i32 0, ptr %q
+; LOADCSE: %e = load i32, ptr %p
+define i32 @test_repeated_load(ptr %p, ptr %q) {
+entry:
+    %a = load i32, ptr %p
+    %c = add i32 %a, 1
+    %b = load i32, ptr %p      ; Same value as %a: no store in between
+    %d = add i32 %b, 1         ; Redundant with %c once %b is %a
+    store i32 0, ptr %q        ; May alias %p
+    %e = load i32, ptr %p      ; Not redundant
+    %r1 = add i32 %c, %d
+    %r2 = add i32 %r1, %e
+    ret i32 %r2
+}
@@ -0,0 +1,165 @@
+; RUN: opt -load-pass-plugin=%S/../build/LLVMOptPasses.so -passes="custom-store-forward" -S %s | FileCheck %s
+;
+; Test cases for Store-to-Load Forwarding Pass
+; These test direct, PHI-joined and partial forwarding through MemorySSA
+
+; Test 1: Load right after a store to the same address
+; CHECK-LABEL: @test_same_block
+; CHECK-NOT: load
+; CHECK: ret i32 %v
+define i32 @test_same_block(ptr %p, i32 %v) {
+entry:
+    store i32 %v, ptr %p, align 4
+    %r = load i32, ptr %p, align 4
+    ret i32 %r
+}
+
+; Test 2: Store in a dominating block, unrelated store in between
+; CHECK-LABEL: @test_dominating_block
+; CHECK-NOT: load i32, ptr %p
+; CHECK: ret i32 %v
+define i32 @test_dominating_block(ptr noalias %p, ptr noalias %q, i32 %v, i1 %c) {
+entry:
+    store i32 %v, ptr %p, align 4
+    br i1 %c, label %then, label %join
+
+then:
+    store i32 0, ptr %q, align 4
+    br label %join
+
+join:
+    %r = load i32, ptr %p, align 4
+    ret i32 %r
+}
+
+; Test 3: Stores on both paths are joined with a PHI
+; CHECK-LABEL: @test_diamond
+; CHECK: join:
+; CHECK-NEXT: %r.fwd = phi i32 [ %a, %then ], [ %b, %else ]
+; CHECK-NOT: load
+; CHECK: ret i32 %r.fwd
+define i32 @test_diamond(ptr %p, i32 %a, i32 %b, i1 %c) {
+entry:
+    br i1 %c, label %then, label %else
+
+then:
+    store i32 %a, ptr %p, align 4
+    br label %join
+
+else:
+    store i32 %b, ptr %p, align 4
+    br label %join
+
+join:
+    %r = load i32, ptr %p, align 4
+    ret i32 %r
+}
+
+; Test 4: One path without a store keeps the load
+; CHECK-LABEL: @test_missing_store
+; CHECK: %r = load i32, ptr %p
+define i32 @test_missing_store(ptr %p, i32 %a, i1 %c) {
+entry:
+    br i1 %c, label %then, label %join
+
+then:
+    store i32 %a, ptr %p, align 4
+    br label %join
+
+join:
+    %r = load i32, ptr %p, align 4
+    ret i32 %r
+}
+
+; Test 5: Low half of a wider integer store
+; CHECK-LABEL: @test_partial_low
+; CHECK-NOT: load
+; CHECK: %r.trunc = trunc i64 %v to i32
+; CHECK: ret i32 %r.trunc
+define i32 @test_partial_low(ptr %p, i64 %v) {
+entry:
+    store i64 %v, ptr %p, align 8
+    %r = load i32, ptr %p, align 4
+    ret i32 %r
+}
+
+; Test 6: High half needs a shift before the truncate
+; CHECK-LABEL: @test_partial_high
+; CHECK-NOT: load
+; CHECK: %r.shift = lshr i64 %v, 32
+; CHECK: %r.trunc = trunc i64 %r.shift to i32
+define i32 @test_partial_high(ptr %p, i64 %v) {
+entry:
+    store i64 %v, ptr %p, align 8
+    %hi = getelementptr inbounds i8, ptr %p, i64 4
+    %r = load i32, ptr %hi, align 4
+    ret i32 %r
+}
+
+; Test 7: Field of a stored struct is extracted
+; CHECK-LABEL: @test_struct_field
+; CHECK-NOT: load
+; CHECK: extractvalue { i32, i64 } %s, 1
+define i64 @test_struct_field(ptr %p, { i32, i64 } %s) {
+entry:
+    store { i32, i64 } %s, ptr %p, align 8
+    %f = getelementptr inbounds { i32, i64 }, ptr %p, i64 0, i32 1
+    %r = load i64, ptr %f, align 8
+    ret i64 %r
+}
+
+; Test 8: Same-size store of another type is bitcast
+; CHECK-LABEL: @test_bitcast
+; CHECK-NOT: load
+; CHECK: bitcast float %f to i32
+define i32 @test_bitcast(ptr %p, float %f) {
+entry:
+    store float %f, ptr %p, align 4
+    %r = load i32, ptr %p, align 4
+    ret i32 %r
+}
+
+; Test 9: Loop-carried value through the header MemoryPhi
+; CHECK-LABEL: @test_loop_carried
+; CHECK: loop:
+; CHECK-NEXT: %cur.fwd = phi i32 [ 0, %entry ], [ %next, %loop ]
+; CHECK-NOT: load
+; CHECK: %next = add i32 %cur.fwd, 1
+define void @test_loop_carried(ptr %p, i32 %n) {
+entry:
+    store i32 0, ptr %p, align 4
+    br label %loop
+
+loop:
+    %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+    %cur = load i32, ptr %p, align 4
+    %next = add i32 %cur, 1
+    store i32 %next, ptr %p, align 4
+    %i.next = add i32 %i, 1
+    %done = icmp eq i32 %i.next, %n
+    br i1 %done, label %exit, label %loop
+
+exit:
+    ret void
+}
+
+; Test 10: Volatile loads are never forwarded
+; CHECK-LABEL: @test_volatile
+; CHECK: load volatile i32, ptr %p
+define i32 @test_volatile(ptr %p, i32 %v) {
+entry:
+    store i32 %v, ptr %p, align 4
+    %r = load volatile i32, ptr %p, align 4
+    ret i32 %r
+}
+
+; Test 11: May-alias store in between blocks forwarding
+; CHECK-LABEL: @test_may_alias
+; CHECK: %r = load i32, ptr %p
+define i32 @test_may_alias(ptr %p, ptr %q, i32 %v) {
+entry:
+    store i32 %v, ptr %p, align 4
+    store i32 0, ptr %q, align 4
+    %r = load i32, ptr %p, align 4
+    ret i32 %r
+}
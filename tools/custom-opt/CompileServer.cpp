@@ -0,0 +1,110 @@
+//===- CompileServer.cpp - Persistent compile server ----------------------===//
+//
+// One request per connection. The accept loop hands each connection to
+// the thread pool; a failed compile is reported to its client and never
+// ends the server.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CompileServer.h"
+#include "CompileServerProtocol.h"
+#include "Optimizer.h"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/WithColor.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cerrno>
+#include <csignal>
+
+#ifdef LLVM_ON_UNIX
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+#ifdef LLVM_ON_UNIX
+
+/// Options a request's flags stand for
+static OptimizeOptions getOptions(const CompileRequest &Request) {
+    OptimizeOptions Options;
+    Options.Pipeline = Request.Pipeline;
+    Options.OutputAssembly = Request.Flags & CRF_OutputAssembly;
+    Options.DisableOutput = Request.Flags & CRF_DisableOutput;
+    Options.StreamFunctions = Request.Flags & CRF_StreamFunctions;
+    Options.DisableVerify = Request.Flags & CRF_DisableVerify;
+    return Options;
+}
+
+/// Answer the request on FD and close it
+static void serveConnection(int FD) {
+    // Warm for the lifetime of the worker thread
+    thread_local OptimizerSession Session;
+
+    std::string Diagnostics;
+    std::string Output;
+    bool Success = false;
+    if (Expected<CompileRequest> Request = readRequest(FD)) {
+        raw_string_ostream Diags(Diagnostics);
+        raw_string_ostream Out(Output);
+        if (Error E = Session.optimize(std::move(Request->Input),
+                                       getOptions(*Request), Out, Diags)) {
+            // As custom-opt itself would report it
+            Diags << "custom-opt: " << toString(std::move(E)) << "\n";
+        } else {
+            Success = true;
+        }
+        Diags.flush();
+        Out.flush();
+    } else {
+        // Not one of our clients, or one that went away
+        consumeError(Request.takeError());
+        ::close(FD);
+        return;
+    }
+
+    if (Error E = writeResponse(FD, Success, Diagnostics, Output)) {
+        WithColor::warning() << "custom-opt: " << toString(std::move(E))
+                             << "\n";
+    }
+    ::close(FD);
+}
+
+Error llvm::optpasses::runCompileServer(StringRef SocketPath, unsigned Jobs) {
+    Expected<int> ListenFD = listenOnSocket(SocketPath);
+    if (!ListenFD) {
+        return ListenFD.takeError();
+    }
+
+    // A client that disconnects early must not kill the server on write
+    ::signal(SIGPIPE, SIG_IGN);
+
+    ThreadPool Pool(hardware_concurrency(Jobs));
+    errs() << "custom-opt: serving on " << SocketPath << " with "
+           << Pool.getThreadCount() << " workers\n";
+
+    while (true) {
+        int FD = ::accept(*ListenFD, nullptr, nullptr);
+        if (FD < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::error_code EC(errno, std::generic_category());
+            return createStringError(EC, "accept: " + EC.message());
+        }
+        Pool.async([FD] { serveConnection(FD); });
+    }
+}
+
+#else // !LLVM_ON_UNIX
+
+Error llvm::optpasses::runCompileServer(StringRef, unsigned) {
+    return createStringError(inconvertibleErrorCode(),
+                             "the compile server needs Unix domain sockets");
+}
+
+#endif // LLVM_ON_UNIX
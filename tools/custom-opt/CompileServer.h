@@ -0,0 +1,28 @@
+//===- CompileServer.h - Persistent compile server --------------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// custom-opt -serve: a daemon that answers custom-opt-client requests on a
+// local socket. Each worker thread keeps its own OptimizerSession, so the
+// target machine and pass builder of a triple are set up once per worker
+// rather than once per compile, and no process is started per module.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_TOOLS_CUSTOM_OPT_COMPILE_SERVER_H
+#define LLVM_OPT_PASSES_TOOLS_CUSTOM_OPT_COMPILE_SERVER_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+namespace llvm {
+namespace optpasses {
+
+/// Serve requests on SocketPath with Jobs workers (0: one per core) until
+/// the process is killed. Returns only if the socket cannot be set up.
+Error runCompileServer(StringRef SocketPath, unsigned Jobs);
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_TOOLS_CUSTOM_OPT_COMPILE_SERVER_H
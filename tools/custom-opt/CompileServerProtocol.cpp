@@ -0,0 +1,345 @@
+//===- CompileServerProtocol.cpp - Compile server wire format -------------===//
+//
+// Blocking reads and writes of whole frames over Unix domain sockets.
+// Other platforms get errors from every entry point.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CompileServerProtocol.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef LLVM_ON_UNIX
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+static constexpr char Magic[4] = {'C', 'O', 'P', 'T'};
+
+/// Error for a failed system call, with errno's message
+static Error errnoError(const Twine &What) {
+    std::error_code EC(errno, std::generic_category());
+    return createStringError(EC, What + ": " + EC.message());
+}
+
+std::string llvm::optpasses::getDefaultCompileServerSocket() {
+    if (auto Path = sys::Process::GetEnv("CUSTOM_OPT_SOCKET")) {
+        return *Path;
+    }
+
+    SmallString<128> Path;
+    sys::path::system_temp_directory(/*ErasedOnReboot=*/true, Path);
+#ifdef LLVM_ON_UNIX
+    sys::path::append(Path, "custom-opt-" + Twine(::getuid()) + ".sock");
+#else
+    sys::path::append(Path, "custom-opt.sock");
+#endif
+    return std::string(Path);
+}
+
+#ifdef LLVM_ON_UNIX
+
+//===----------------------------------------------------------------------===//
+// Sockets
+//===----------------------------------------------------------------------===//
+
+/// Socket address for Path, which must fit sun_path
+static Expected<sockaddr_un> getSocketAddress(StringRef Path) {
+    sockaddr_un Addr;
+    std::memset(&Addr, 0, sizeof(Addr));
+    Addr.sun_family = AF_UNIX;
+    if (Path.size() >= sizeof(Addr.sun_path)) {
+        return createStringError(inconvertibleErrorCode(),
+                                 "socket path too long: " + Path);
+    }
+    std::memcpy(Addr.sun_path, Path.data(), Path.size());
+    return Addr;
+}
+
+Expected<int> llvm::optpasses::listenOnSocket(StringRef Path) {
+    Expected<sockaddr_un> Addr = getSocketAddress(Path);
+    if (!Addr) {
+        return Addr.takeError();
+    }
+
+    // A socket file left behind by a server that did not shut down refuses
+    // connections; one that accepts them belongs to a live server
+    int Probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (Probe < 0) {
+        return errnoError("socket");
+    }
+    if (::connect(Probe, reinterpret_cast<sockaddr*>(&*Addr),
+                  sizeof(*Addr)) == 0) {
+        ::close(Probe);
+        return createStringError(
+            std::make_error_code(std::errc::address_in_use),
+            "a compile server is already listening on " + Path);
+    }
+    bool Stale = errno == ECONNREFUSED;
+    ::close(Probe);
+    if (Stale) {
+        ::unlink(Addr->sun_path);
+    }
+
+    int FD = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (FD < 0) {
+        return errnoError("socket");
+    }
+    if (::bind(FD, reinterpret_cast<sockaddr*>(&*Addr), sizeof(*Addr)) < 0 ||
+        ::listen(FD, SOMAXCONN) < 0) {
+        Error E = errnoError("cannot listen on " + Path);
+        ::close(FD);
+        return E;
+    }
+    return FD;
+}
+
+Expected<int> llvm::optpasses::connectToSocket(StringRef Path) {
+    Expected<sockaddr_un> Addr = getSocketAddress(Path);
+    if (!Addr) {
+        return Addr.takeError();
+    }
+
+    int FD = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (FD < 0) {
+        return errnoError("socket");
+    }
+    if (::connect(FD, reinterpret_cast<sockaddr*>(&*Addr), sizeof(*Addr)) <
+        0) {
+        Error E = errnoError("no compile server at " + Path);
+        ::close(FD);
+        return E;
+    }
+    return FD;
+}
+
+//===----------------------------------------------------------------------===//
+// Framing
+//===----------------------------------------------------------------------===//
+
+static Error writeAll(int FD, StringRef Data) {
+    while (!Data.empty()) {
+        ssize_t N = ::write(FD, Data.data(), Data.size());
+        if (N < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errnoError("write");
+        }
+        Data = Data.drop_front(N);
+    }
+    return Error::success();
+}
+
+static Error readAll(int FD, char *Buf, size_t Size) {
+    while (Size > 0) {
+        ssize_t N = ::read(FD, Buf, Size);
+        if (N < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errnoError("read");
+        }
+        if (N == 0) {
+            return createStringError(inconvertibleErrorCode(),
+                                     "connection closed mid-message");
+        }
+        Buf += N;
+        Size -= N;
+    }
+    return Error::success();
+}
+
+static Error writeHeader(int FD, uint32_t Value) {
+    char Buf[12];
+    std::memcpy(Buf, Magic, 4);
+    support::endian::write32le(Buf + 4, CompileServerProtocolVersion);
+    support::endian::write32le(Buf + 8, Value);
+    return writeAll(FD, StringRef(Buf, sizeof(Buf)));
+}
+
+/// Checks magic and version; returns the word after them
+static Expected<uint32_t> readHeader(int FD) {
+    char Buf[12];
+    if (Error E = readAll(FD, Buf, sizeof(Buf))) {
+        return E;
+    }
+    if (std::memcmp(Buf, Magic, 4) != 0) {
+        return createStringError(inconvertibleErrorCode(),
+                                 "not a compile server message");
+    }
+    uint32_t Version = support::endian::read32le(Buf + 4);
+    if (Version != CompileServerProtocolVersion) {
+        return createStringError(inconvertibleErrorCode(),
+                                 "compile server protocol %u, expected %u",
+                                 Version, CompileServerProtocolVersion);
+    }
+    return support::endian::read32le(Buf + 8);
+}
+
+static Error writeString64(int FD, StringRef S) {
+    char Size[8];
+    support::endian::write64le(Size, S.size());
+    if (Error E = writeAll(FD, StringRef(Size, sizeof(Size)))) {
+        return E;
+    }
+    return writeAll(FD, S);
+}
+
+static Expected<uint64_t> readSize64(int FD) {
+    char Size[8];
+    if (Error E = readAll(FD, Size, sizeof(Size))) {
+        return E;
+    }
+    return support::endian::read64le(Size);
+}
+
+static Error readString64(int FD, std::string &S) {
+    Expected<uint64_t> Size = readSize64(FD);
+    if (!Size) {
+        return Size.takeError();
+    }
+    S.resize(*Size);
+    return readAll(FD, S.data(), S.size());
+}
+
+static Error writeString32(int FD, StringRef S) {
+    char Size[4];
+    support::endian::write32le(Size, S.size());
+    if (Error E = writeAll(FD, StringRef(Size, sizeof(Size)))) {
+        return E;
+    }
+    return writeAll(FD, S);
+}
+
+static Error readString32(int FD, std::string &S) {
+    char Size[4];
+    if (Error E = readAll(FD, Size, sizeof(Size))) {
+        return E;
+    }
+    S.resize(support::endian::read32le(Size));
+    return readAll(FD, S.data(), S.size());
+}
+
+Error llvm::optpasses::writeRequest(int FD, uint32_t Flags,
+                                    StringRef Pipeline, StringRef InputName,
+                                    StringRef Input) {
+    if (Error E = writeHeader(FD, Flags)) {
+        return E;
+    }
+    if (Error E = writeString32(FD, Pipeline)) {
+        return E;
+    }
+    if (Error E = writeString32(FD, InputName)) {
+        return E;
+    }
+    return writeString64(FD, Input);
+}
+
+Expected<CompileRequest> llvm::optpasses::readRequest(int FD) {
+    CompileRequest Request;
+    Expected<uint32_t> Flags = readHeader(FD);
+    if (!Flags) {
+        return Flags.takeError();
+    }
+    Request.Flags = *Flags;
+
+    if (Error E = readString32(FD, Request.Pipeline)) {
+        return E;
+    }
+    std::string InputName;
+    if (Error E = readString32(FD, InputName)) {
+        return E;
+    }
+
+    // Read straight into the buffer the module will own
+    Expected<uint64_t> InputSize = readSize64(FD);
+    if (!InputSize) {
+        return InputSize.takeError();
+    }
+    std::unique_ptr<WritableMemoryBuffer> Input =
+        WritableMemoryBuffer::getNewUninitMemBuffer(*InputSize, InputName);
+    if (!Input) {
+        return createStringError(inconvertibleErrorCode(),
+                                 "cannot allocate %llu bytes of input",
+                                 static_cast<unsigned long long>(*InputSize));
+    }
+    if (Error E = readAll(FD, Input->getBufferStart(), *InputSize)) {
+        return E;
+    }
+    Request.Input = std::move(Input);
+    return Request;
+}
+
+Error llvm::optpasses::writeResponse(int FD, bool Success,
+                                     StringRef Diagnostics, StringRef Output) {
+    if (Error E = writeHeader(FD, Success ? 0 : 1)) {
+        return E;
+    }
+    if (Error E = writeString64(FD, Diagnostics)) {
+        return E;
+    }
+    return writeString64(FD, Output);
+}
+
+Expected<CompileResponse> llvm::optpasses::readResponse(int FD) {
+    CompileResponse Response;
+    Expected<uint32_t> Status = readHeader(FD);
+    if (!Status) {
+        return Status.takeError();
+    }
+    Response.Success = *Status == 0;
+
+    if (Error E = readString64(FD, Response.Diagnostics)) {
+        return E;
+    }
+    if (Error E = readString64(FD, Response.Output)) {
+        return E;
+    }
+    return Response;
+}
+
+#else // !LLVM_ON_UNIX
+
+static Error unsupported() {
+    return createStringError(inconvertibleErrorCode(),
+                             "the compile server needs Unix domain sockets");
+}
+
+Expected<int> llvm::optpasses::listenOnSocket(StringRef) {
+    return unsupported();
+}
+
+Expected<int> llvm::optpasses::connectToSocket(StringRef) {
+    return unsupported();
+}
+
+Error llvm::optpasses::writeRequest(int, uint32_t, StringRef, StringRef,
+                                    StringRef) {
+    return unsupported();
+}
+
+Expected<CompileRequest> llvm::optpasses::readRequest(int) {
+    return unsupported();
+}
+
+Error llvm::optpasses::writeResponse(int, bool, StringRef, StringRef) {
+    return unsupported();
+}
+
+Expected<CompileResponse> llvm::optpasses::readResponse(int) {
+    return unsupported();
+}
+
+#endif // LLVM_ON_UNIX
@@ -0,0 +1,78 @@
+//===- CompileServerProtocol.h - Compile server wire format -----*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// One request and one response per connection over a local Unix socket.
+// Integers are little-endian; strings and modules are length-prefixed.
+//
+//   request:  "COPT" version:u32 flags:u32
+//             pipeline-size:u32 pipeline  name-size:u32 name
+//             input-size:u64 input
+//   response: "COPT" version:u32 status:u32
+//             diagnostics-size:u64 diagnostics  output-size:u64 output
+//
+// Only the library side of the client lives here, so custom-opt-client
+// links nothing but LLVMSupport.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_TOOLS_CUSTOM_OPT_COMPILE_SERVER_PROTOCOL_H
+#define LLVM_OPT_PASSES_TOOLS_CUSTOM_OPT_COMPILE_SERVER_PROTOCOL_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace llvm {
+namespace optpasses {
+
+/// Bumped on any change to the framing
+constexpr uint32_t CompileServerProtocolVersion = 1;
+
+/// Request flags, the boolean OptimizeOptions
+enum CompileRequestFlags : uint32_t {
+    CRF_OutputAssembly = 1 << 0,
+    CRF_DisableOutput = 1 << 1,
+    CRF_StreamFunctions = 1 << 2,
+    CRF_DisableVerify = 1 << 3,
+};
+
+struct CompileRequest {
+    uint32_t Flags = 0;
+    std::string Pipeline;
+    std::unique_ptr<MemoryBuffer> Input;   // named after the client's file
+};
+
+struct CompileResponse {
+    bool Success = false;
+    std::string Diagnostics;
+    std::string Output;
+};
+
+/// $CUSTOM_OPT_SOCKET, or a per-user socket in the temporary directory
+std::string getDefaultCompileServerSocket();
+
+/// Listening socket bound to Path, replacing a stale socket file; fails
+/// if a server is still listening there
+Expected<int> listenOnSocket(StringRef Path);
+
+/// Connection to the server listening on Path
+Expected<int> connectToSocket(StringRef Path);
+
+/// InputName is only used in diagnostics
+Error writeRequest(int FD, uint32_t Flags, StringRef Pipeline,
+                   StringRef InputName, StringRef Input);
+Expected<CompileRequest> readRequest(int FD);
+
+Error writeResponse(int FD, bool Success, StringRef Diagnostics,
+                    StringRef Output);
+Expected<CompileResponse> readResponse(int FD);
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_TOOLS_CUSTOM_OPT_COMPILE_SERVER_PROTOCOL_H
@@ -0,0 +1,208 @@
+//===- Optimizer.cpp - Warm optimizer sessions ----------------------------===//
+//
+// Bitcode is loaded lazily. With StreamFunctions the pipeline is parsed as
+// a function pipeline and functions are materialized, optimized and
+// released one at a time, so analyses of only one function are alive at
+// once. With DisableOutput the bodies are dropped as well, keeping peak
+// memory near one function's IR. Otherwise they must be kept for the
+// output, since bitcode is written a module at a time.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Optimizer.h"
+#include "PassRegistration.h"
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Target/TargetOptions.h"
+
+#include <optional>
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+namespace {
+
+/// Prints a context's diagnostics and remembers whether one was an error
+struct DiagnosticCollector {
+    raw_ostream &OS;
+    bool HadError = false;
+
+    static void handle(const DiagnosticInfo &DI, void *Context) {
+        auto *Self = static_cast<DiagnosticCollector*>(Context);
+        DiagnosticPrinterRawOStream DP(Self->OS);
+        Self->OS << LLVMContext::getDiagnosticMessagePrefix(DI.getSeverity())
+                 << ": ";
+        DI.print(DP);
+        Self->OS << "\n";
+        if (DI.getSeverity() == DS_Error) {
+            Self->HadError = true;
+        }
+    }
+};
+
+} // end anonymous namespace
+
+//===----------------------------------------------------------------------===//
+// OptimizerSession Implementation
+//===----------------------------------------------------------------------===//
+
+OptimizerSession::WarmTarget &
+OptimizerSession::getTarget(const Module &M, raw_ostream &Diags) {
+    std::string Triple = M.getTargetTriple();
+    auto [It, Inserted] = Targets.try_emplace(Triple);
+    WarmTarget &Target = It->second;
+    if (!Inserted) {
+        return Target;
+    }
+
+    // Without a target, TTI-based cost models fall back to generic costs
+    if (!Triple.empty()) {
+        std::string Error;
+        const llvm::Target *T = TargetRegistry::lookupTarget(Triple, Error);
+        if (T) {
+            Target.TM.reset(
+                T->createTargetMachine(Triple, "", "", TargetOptions(), {}));
+        } else {
+            Diags << "warning: " << Error << "; using generic cost models\n";
+        }
+    }
+
+    Target.PIC = std::make_unique<PassInstrumentationCallbacks>();
+    Target.PB = std::make_unique<PassBuilder>(
+        Target.TM.get(), PipelineTuningOptions(), std::nullopt,
+        Target.PIC.get());
+    registerOptPasses(*Target.PB);
+    return Target;
+}
+
+Expected<std::unique_ptr<Module>> OptimizerSession::loadModule(
+    std::unique_ptr<MemoryBuffer> Input, LLVMContext &Context) {
+    if (isBitcode(
+            reinterpret_cast<const unsigned char*>(Input->getBufferStart()),
+            reinterpret_cast<const unsigned char*>(Input->getBufferEnd()))) {
+        // The module owns the buffer until its functions are materialized
+        return getOwningLazyBitcodeModule(std::move(Input), Context,
+                                          /*ShouldLazyLoadMetadata=*/true);
+    }
+
+    // The assembly parser needs a null-terminated copy
+    std::unique_ptr<MemoryBuffer> Text = MemoryBuffer::getMemBufferCopy(
+        Input->getBuffer(), Input->getBufferIdentifier());
+    SMDiagnostic Diag;
+    std::unique_ptr<Module> M = parseIR(Text->getMemBufferRef(), Diag, Context);
+    if (!M) {
+        std::string Message;
+        raw_string_ostream OS(Message);
+        Diag.print(nullptr, OS);
+        return createStringError(inconvertibleErrorCode(), OS.str());
+    }
+    return M;
+}
+
+Error OptimizerSession::optimize(std::unique_ptr<MemoryBuffer> Input,
+                                 const OptimizeOptions &Options,
+                                 raw_ostream &Out, raw_ostream &Diags) {
+    // A fresh context per module: contexts are not shared between threads,
+    // and types and constants of earlier modules would pile up
+    LLVMContext Context;
+    DiagnosticCollector Collector{Diags};
+    Context.setDiagnosticHandlerCallBack(DiagnosticCollector::handle,
+                                         &Collector);
+
+    Expected<std::unique_ptr<Module>> MOrErr =
+        loadModule(std::move(Input), Context);
+    if (!MOrErr) {
+        return MOrErr.takeError();
+    }
+    Module &M = **MOrErr;
+
+    WarmTarget &Target = getTarget(M, Diags);
+    PassBuilder &PB = *Target.PB;
+
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    // Verification errors are returned rather than fatal, so a broken
+    // module does not take a compile server down
+    if (Options.StreamFunctions) {
+        FunctionPassManager FPM;
+        if (Error E = PB.parsePassPipeline(FPM, Options.Pipeline)) {
+            return E;
+        }
+
+        for (Function &F : M) {
+            if (Error E = F.materialize()) {
+                return E;
+            }
+            if (F.isDeclaration()) {
+                continue;
+            }
+
+            FPM.run(F, FAM);
+            if (!Options.DisableVerify && verifyFunction(F, &Diags)) {
+                return createStringError(inconvertibleErrorCode(),
+                                         "broken function after pipeline: %s",
+                                         F.getName().str().c_str());
+            }
+
+            // Nothing of F is needed again unless it is written out
+            FAM.clear(F, F.getName());
+            if (Options.DisableOutput) {
+                F.deleteBody();
+            }
+        }
+    } else {
+        if (Error E = M.materializeAll()) {
+            return E;
+        }
+
+        if (!Options.DisableVerify && verifyModule(M, &Diags)) {
+            return createStringError(inconvertibleErrorCode(),
+                                     "input module is broken");
+        }
+
+        ModulePassManager MPM;
+        if (Error E = PB.parsePassPipeline(MPM, Options.Pipeline)) {
+            return E;
+        }
+        MPM.run(M, MAM);
+
+        if (!Options.DisableVerify && verifyModule(M, &Diags)) {
+            return createStringError(inconvertibleErrorCode(),
+                                     "broken module after pipeline");
+        }
+    }
+
+    if (Collector.HadError) {
+        return createStringError(inconvertibleErrorCode(),
+                                 "optimization reported errors");
+    }
+    if (Options.DisableOutput) {
+        return Error::success();
+    }
+
+    // Metadata not attached to a function is still lazy
+    if (Error E = M.materializeAll()) {
+        return E;
+    }
+    if (Options.OutputAssembly) {
+        M.print(Out, nullptr);
+    } else {
+        WriteBitcodeToFile(M, Out);
+    }
+    return Error::success();
+}
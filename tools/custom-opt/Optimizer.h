@@ -0,0 +1,92 @@
+//===- Optimizer.h - Warm optimizer sessions --------------------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// One optimization of one module, as run by custom-opt on the command line
+// or by its compile server for each request. A session keeps the target
+// machines and pass builders it creates, so later modules for the same
+// triple skip their setup.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_TOOLS_CUSTOM_OPT_OPTIMIZER_H
+#define LLVM_OPT_PASSES_TOOLS_CUSTOM_OPT_OPTIMIZER_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <memory>
+#include <string>
+
+namespace llvm {
+namespace optpasses {
+
+//===----------------------------------------------------------------------===//
+// OptimizeOptions
+//
+// The per-module part of the custom-opt command line.
+//===----------------------------------------------------------------------===//
+
+struct OptimizeOptions {
+    /// Pipeline in the -passes syntax of opt
+    std::string Pipeline = "custom-optimize";
+
+    /// Write textual IR instead of bitcode
+    bool OutputAssembly = false;
+
+    /// Do not write the result
+    bool DisableOutput = false;
+
+    /// Materialize, optimize and release one function at a time; the
+    /// pipeline must be a function pipeline
+    bool StreamFunctions = false;
+
+    /// Do not verify input or output
+    bool DisableVerify = false;
+};
+
+//===----------------------------------------------------------------------===//
+// OptimizerSession
+//
+// Not thread-safe: the compile server gives each worker thread its own.
+//===----------------------------------------------------------------------===//
+
+class OptimizerSession {
+public:
+    /// Optimize the module in Input (bitcode or textual IR) and write the
+    /// result to Out. Warnings and diagnostics go to Diags.
+    Error optimize(std::unique_ptr<MemoryBuffer> Input,
+                   const OptimizeOptions &Options, raw_ostream &Out,
+                   raw_ostream &Diags);
+
+private:
+    /// Set up once per target triple
+    struct WarmTarget {
+        std::unique_ptr<TargetMachine> TM;   // nullptr: generic costs
+
+        /// Hooks such as -custom-memory-profile; they report when the
+        /// session ends
+        std::unique_ptr<PassInstrumentationCallbacks> PIC;
+        std::unique_ptr<PassBuilder> PB;
+    };
+
+    StringMap<WarmTarget> Targets;
+
+    /// Target machine and pass builder for the module's triple
+    WarmTarget &getTarget(const Module &M, raw_ostream &Diags);
+
+    /// Lazily loaded bitcode, or parsed textual IR
+    Expected<std::unique_ptr<Module>> loadModule(
+        std::unique_ptr<MemoryBuffer> Input, LLVMContext &Context);
+};
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_TOOLS_CUSTOM_OPT_OPTIMIZER_H
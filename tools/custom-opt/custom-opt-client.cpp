@@ -0,0 +1,174 @@
+//===- custom-opt-client.cpp - Compile server client ----------------------===//
+//
+// Sends one module to a running `custom-opt -serve` and writes the result.
+// Takes the subset of opt's options that is sent with each request:
+// -passes, -S, -o, -disable-output, -stream-functions and -disable-verify.
+// -load-pass-plugin and -load are accepted and ignored, since the server
+// has the passes linked in, so it can replace opt in build rules that use
+// only these. Every other option, such as -O2 or the plugin's -custom-*,
+// is global to the server's process and set when the server starts; the
+// client rejects it rather than compile without it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CompileServerProtocol.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SystemUtils.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <unistd.h>
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+static cl::opt<std::string> InputFilename(cl::Positional,
+                                          cl::desc("<input bitcode or IR>"),
+                                          cl::init("-"),
+                                          cl::value_desc("filename"));
+
+static cl::opt<std::string> OutputFilename("o",
+                                           cl::desc("Output filename"),
+                                           cl::init("-"),
+                                           cl::value_desc("filename"));
+
+static cl::opt<std::string> PassPipeline(
+    "passes",
+    cl::desc("Pipeline to run, in the -passes syntax of opt"),
+    cl::init("custom-optimize"));
+
+static cl::opt<bool> OutputAssembly("S",
+                                    cl::desc("Write textual IR, not bitcode"));
+
+static cl::opt<bool> DisableOutput("disable-output",
+                                   cl::desc("Do not write the result"));
+
+static cl::opt<bool> StreamFunctions(
+    "stream-functions",
+    cl::desc("Materialize, optimize and release one function at a time; "
+             "the pipeline must be a function pipeline"));
+
+static cl::opt<bool> DisableVerify("disable-verify",
+                                   cl::desc("Do not verify input or output"));
+
+static cl::opt<std::string> SocketPath(
+    "socket",
+    cl::desc("Socket of the compile server"),
+    cl::init(getDefaultCompileServerSocket()),
+    cl::value_desc("path"));
+
+// Accepted for opt compatibility
+static cl::list<std::string> PassPlugins("load-pass-plugin", cl::Hidden,
+                                         cl::ZeroOrMore);
+static cl::list<std::string> Plugins("load", cl::Hidden, cl::ZeroOrMore);
+
+/// Name of the option in Arg, or "" for positional arguments
+static StringRef getOptionName(StringRef Arg) {
+    if (Arg.size() < 2 || Arg[0] != '-') {
+        return "";
+    }
+    Arg = Arg.drop_front(Arg[1] == '-' ? 2 : 1);
+    return Arg.take_until([](char C) { return C == '='; });
+}
+
+/// Fail on options the client does not know, with a better message than
+/// the command line parser's: most are valid for opt, but apply to the
+/// whole server
+static bool checkOptionsSupported(int argc, char **argv) {
+    StringMap<cl::Option *> &Options = cl::getRegisteredOptions();
+    for (int I = 1; I < argc; I++) {
+        StringRef Name = getOptionName(argv[I]);
+        if (Name.empty()) {
+            // "--" ends the options
+            if (StringRef(argv[I]) == "--") {
+                break;
+            }
+            continue;
+        }
+        if (!Options.count(Name)) {
+            WithColor::error(errs(), argv[0])
+                << "-" << Name << " is not sent to the compile server, "
+                << "which takes only -passes, -S, -o, -disable-output, "
+                << "-stream-functions and -disable-verify per request; "
+                << "give the plugin's -custom-* options to `custom-opt "
+                << "-serve`, or run custom-opt or opt directly\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    InitLLVM X(argc, argv);
+    if (!checkOptionsSupported(argc, argv)) {
+        return 1;
+    }
+    cl::ParseCommandLineOptions(
+        argc, argv, "client for the custom-opt compile server\n");
+
+    ExitOnError ExitOnErr;
+    ExitOnErr.setBanner(std::string(argv[0]) + ": ");
+
+    std::unique_ptr<MemoryBuffer> Input = ExitOnErr(errorOrToExpected(
+        MemoryBuffer::getFileOrSTDIN(InputFilename, /*IsText=*/false,
+                                     /*RequiresNullTerminator=*/false)));
+
+    std::unique_ptr<ToolOutputFile> Out;
+    if (!DisableOutput) {
+        std::error_code EC;
+        Out = std::make_unique<ToolOutputFile>(
+            OutputFilename, EC,
+            OutputAssembly ? sys::fs::OF_Text : sys::fs::OF_None);
+        if (EC) {
+            WithColor::error(errs(), argv[0]) << EC.message() << "\n";
+            return 1;
+        }
+        if (!OutputAssembly && CheckBitcodeOutputToConsole(Out->os())) {
+            return 1;
+        }
+    }
+
+    uint32_t Flags = 0;
+    if (OutputAssembly) {
+        Flags |= CRF_OutputAssembly;
+    }
+    if (DisableOutput) {
+        Flags |= CRF_DisableOutput;
+    }
+    if (StreamFunctions) {
+        Flags |= CRF_StreamFunctions;
+    }
+    if (DisableVerify) {
+        Flags |= CRF_DisableVerify;
+    }
+
+    Expected<int> FD = connectToSocket(SocketPath);
+    if (!FD) {
+        WithColor::error(errs(), argv[0])
+            << toString(FD.takeError())
+            << " (start one with `custom-opt -serve`)\n";
+        return 1;
+    }
+    ExitOnErr(writeRequest(*FD, Flags, PassPipeline,
+                           Input->getBufferIdentifier(), Input->getBuffer()));
+    CompileResponse Response = ExitOnErr(readResponse(*FD));
+    ::close(*FD);
+
+    errs() << Response.Diagnostics;
+    if (!Response.Success) {
+        return 1;
+    }
+    if (DisableOutput) {
+        return 0;
+    }
+
+    Out->os() << Response.Output;
+    Out->keep();
+    return 0;
+}
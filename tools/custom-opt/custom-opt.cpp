@@ -0,0 +1,123 @@
+//===- custom-opt.cpp - Standalone optimizer driver -----------------------===//
+//
+// Runs custom-* pipelines without opt: the passes are linked in, so there
+// is no plugin to load, and input is memory-mapped. Optimization itself is
+// in Optimizer.cpp, shared with the compile server that -serve starts.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CompileServer.h"
+#include "CompileServerProtocol.h"
+#include "Optimizer.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SystemUtils.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+
+#include <memory>
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+static cl::opt<std::string> InputFilename(cl::Positional,
+                                          cl::desc("<input bitcode or IR>"),
+                                          cl::init("-"),
+                                          cl::value_desc("filename"));
+
+static cl::opt<std::string> OutputFilename("o",
+                                           cl::desc("Output filename"),
+                                           cl::init("-"),
+                                           cl::value_desc("filename"));
+
+static cl::opt<std::string> PassPipeline(
+    "passes",
+    cl::desc("Pipeline to run, in the -passes syntax of opt"),
+    cl::init("custom-optimize"));
+
+static cl::opt<bool> OutputAssembly("S",
+                                    cl::desc("Write textual IR, not bitcode"));
+
+static cl::opt<bool> DisableOutput("disable-output",
+                                   cl::desc("Do not write the result"));
+
+static cl::opt<bool> StreamFunctions(
+    "stream-functions",
+    cl::desc("Materialize, optimize and release one function at a time; "
+             "the pipeline must be a function pipeline"));
+
+static cl::opt<bool> DisableVerify("disable-verify",
+                                   cl::desc("Do not verify input or output"));
+
+static cl::opt<bool> Serve(
+    "serve",
+    cl::desc("Run as a compile server for custom-opt-client instead of "
+             "optimizing one module"));
+
+static cl::opt<std::string> SocketPath(
+    "socket",
+    cl::desc("Socket of the compile server"),
+    cl::init(getDefaultCompileServerSocket()),
+    cl::value_desc("path"));
+
+static cl::opt<unsigned> Jobs(
+    "jobs",
+    cl::desc("Compile server workers (0: one per core)"),
+    cl::init(0));
+
+int main(int argc, char **argv) {
+    InitLLVM X(argc, argv);
+    InitializeAllTargets();
+    InitializeAllTargetMCs();
+
+    cl::ParseCommandLineOptions(
+        argc, argv, "standalone driver for the llvm-opt-passes pipelines\n");
+
+    ExitOnError ExitOnErr;
+    ExitOnErr.setBanner(std::string(argv[0]) + ": ");
+
+    if (Serve) {
+        ExitOnErr(runCompileServer(SocketPath, Jobs));
+        return 0;
+    }
+
+    // Mapped rather than read when large
+    std::unique_ptr<MemoryBuffer> Input = ExitOnErr(errorOrToExpected(
+        MemoryBuffer::getFileOrSTDIN(InputFilename, /*IsText=*/false,
+                                     /*RequiresNullTerminator=*/false)));
+
+    std::unique_ptr<ToolOutputFile> Out;
+    if (!DisableOutput) {
+        std::error_code EC;
+        Out = std::make_unique<ToolOutputFile>(
+            OutputFilename, EC,
+            OutputAssembly ? sys::fs::OF_Text : sys::fs::OF_None);
+        if (EC) {
+            WithColor::error(errs(), argv[0]) << EC.message() << "\n";
+            return 1;
+        }
+        if (!OutputAssembly && CheckBitcodeOutputToConsole(Out->os())) {
+            return 1;
+        }
+    }
+
+    OptimizeOptions Options;
+    Options.Pipeline = PassPipeline;
+    Options.OutputAssembly = OutputAssembly;
+    Options.DisableOutput = DisableOutput;
+    Options.StreamFunctions = StreamFunctions;
+    Options.DisableVerify = DisableVerify;
+
+    OptimizerSession Session;
+    ExitOnErr(Session.optimize(std::move(Input), Options,
+                               Out ? Out->os() : nulls(), errs()));
+    if (Out) {
+        Out->keep();
+    }
+    return 0;
+}
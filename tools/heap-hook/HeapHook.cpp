@@ -0,0 +1,151 @@
+//===- HeapHook.cpp - Heap accounting through LD_PRELOAD ------------------===//
+//
+// Replaces glibc's allocation functions with wrappers around its __libc_*
+// entry points that count allocations and live bytes. Block sizes come from
+// malloc_usable_size rather than a header of our own, so blocks allocated
+// before the hook was loaded can still be freed through it.
+//
+// The wrappers run inside every allocation of the process: they must not
+// allocate, lock, or call into LLVM, and touch only relaxed atomics.
+//
+//===----------------------------------------------------------------------===//
+
+#include "HeapCounters.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <malloc.h>
+#include <unistd.h>
+
+extern "C" {
+void *__libc_malloc(size_t Size);
+void *__libc_calloc(size_t Count, size_t Size);
+void *__libc_realloc(void *Ptr, size_t Size);
+void *__libc_memalign(size_t Alignment, size_t Size);
+void *__libc_valloc(size_t Size);
+void *__libc_pvalloc(size_t Size);
+void __libc_free(void *Ptr);
+}
+
+static std::atomic<uint64_t> Allocations{0};
+
+// Signed: a block the dynamic loader allocated before the hook, freed
+// through it, makes the count dip below what the hook has seen
+static std::atomic<int64_t> LiveBytes{0};
+static std::atomic<int64_t> PeakBytes{0};
+
+static void *account(void *Ptr) {
+    if (!Ptr) {
+        return Ptr;
+    }
+    Allocations.fetch_add(1, std::memory_order_relaxed);
+    int64_t Size = malloc_usable_size(Ptr);
+    int64_t Live = LiveBytes.fetch_add(Size, std::memory_order_relaxed) + Size;
+    int64_t Peak = PeakBytes.load(std::memory_order_relaxed);
+    while (Live > Peak &&
+           !PeakBytes.compare_exchange_weak(Peak, Live,
+                                            std::memory_order_relaxed)) {
+    }
+    return Ptr;
+}
+
+static void release(void *Ptr) {
+    if (Ptr) {
+        LiveBytes.fetch_sub(malloc_usable_size(Ptr),
+                            std::memory_order_relaxed);
+    }
+}
+
+static uint64_t clampToZero(int64_t Bytes) {
+    return Bytes > 0 ? uint64_t(Bytes) : 0;
+}
+
+//===----------------------------------------------------------------------===//
+// Allocation functions
+//===----------------------------------------------------------------------===//
+
+extern "C" {
+
+void *malloc(size_t Size) noexcept {
+    return account(__libc_malloc(Size));
+}
+
+void *calloc(size_t Count, size_t Size) noexcept {
+    return account(__libc_calloc(Count, Size));
+}
+
+void *realloc(void *Ptr, size_t Size) noexcept {
+    size_t OldSize = Ptr ? malloc_usable_size(Ptr) : 0;
+    void *NewPtr = __libc_realloc(Ptr, Size);
+
+    // On failure Ptr is untouched, except that realloc(Ptr, 0) frees it
+    if (NewPtr || Size == 0) {
+        LiveBytes.fetch_sub(OldSize, std::memory_order_relaxed);
+    }
+    return account(NewPtr);
+}
+
+void *reallocarray(void *Ptr, size_t Count, size_t Size) noexcept {
+    size_t Bytes;
+    if (__builtin_mul_overflow(Count, Size, &Bytes)) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return realloc(Ptr, Bytes);
+}
+
+void *memalign(size_t Alignment, size_t Size) noexcept {
+    return account(__libc_memalign(Alignment, Size));
+}
+
+void *aligned_alloc(size_t Alignment, size_t Size) noexcept {
+    return account(__libc_memalign(Alignment, Size));
+}
+
+int posix_memalign(void **Out, size_t Alignment, size_t Size) noexcept {
+    if (Alignment % sizeof(void *) != 0 ||
+        (Alignment & (Alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void *Ptr = __libc_memalign(Alignment, Size);
+    if (!Ptr) {
+        return ENOMEM;
+    }
+    *Out = account(Ptr);
+    return 0;
+}
+
+void *valloc(size_t Size) noexcept {
+    return account(__libc_valloc(Size));
+}
+
+void *pvalloc(size_t Size) noexcept {
+    return account(__libc_pvalloc(Size));
+}
+
+void free(void *Ptr) noexcept {
+    release(Ptr);
+    __libc_free(Ptr);
+}
+
+//===----------------------------------------------------------------------===//
+// Counters (HeapCounters.h)
+//===----------------------------------------------------------------------===//
+
+void llvm_opt_passes_heap_read(llvm_opt_passes_heap_counters *Counters) {
+    Counters->allocations = Allocations.load(std::memory_order_relaxed);
+    Counters->live_bytes =
+        clampToZero(LiveBytes.load(std::memory_order_relaxed));
+    Counters->peak_bytes =
+        clampToZero(PeakBytes.load(std::memory_order_relaxed));
+}
+
+uint64_t llvm_opt_passes_heap_exchange_peak(uint64_t Peak) {
+    return clampToZero(
+        PeakBytes.exchange(int64_t(Peak), std::memory_order_relaxed));
+}
+
+} // extern "C"
@@ -0,0 +1,445 @@
+//===- IRGenerator.cpp - Synthetic IR generation --------------------------===//
+//
+// A function is a region: a sequence of statements, each a straight-line
+// run, a branch region or a loop, whose bodies are regions again. Values
+// are drawn from a window of recent values that dominate the insertion
+// point, so operands stay local as in real code and every function
+// verifies: arms and loop bodies work on a copy of the enclosing window,
+// and only their join PHI or exit value is added back to it.
+//
+// Constant folding is disabled in the builder, so constant expressions
+// stay instructions for the passes to fold. Random numbers come straight
+// from std::mt19937_64, whose output the standard fixes, rather than from
+// the <random> distributions, which differ between standard libraries.
+//
+//===----------------------------------------------------------------------===//
+
+#include "IRGenerator.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/NoFolder.h"
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+namespace {
+
+/// Values operands are drawn from; older values drop out
+constexpr unsigned WindowSize = 32;
+
+/// Expressions kept for recomputation
+constexpr unsigned ExpressionLimit = 4 * WindowSize;
+
+class ModuleBuilder {
+public:
+    ModuleBuilder(LLVMContext &Ctx, const IRGeneratorConfig &Config)
+        : Ctx(Ctx), Config(Config), Rng(Config.Seed),
+          M(std::make_unique<Module>("workload", Ctx)),
+          B(Ctx, NoFolder(), IRBuilderCallbackInserter([this](Instruction *) {
+                Emitted++;
+            })) {}
+
+    std::unique_ptr<Module> build() {
+        for (unsigned I = 0; I < std::max(Config.Functions, 1u); I++) {
+            buildFunction();
+        }
+        return std::move(M);
+    }
+
+private:
+    using Expression = std::tuple<Instruction::BinaryOps, Value*, Value*>;
+
+    /// What is available at the insertion point
+    struct Scope {
+        /// Recent values dominating the insertion point
+        std::vector<Value*> Values;
+
+        /// Recent values computed only from constants
+        std::vector<Value*> Constants;
+
+        /// Expressions whose operands dominate the insertion point
+        std::vector<Expression> Exprs;
+    };
+
+    LLVMContext &Ctx;
+    const IRGeneratorConfig &Config;
+    std::mt19937_64 Rng;
+    std::unique_ptr<Module> M;
+    IRBuilder<NoFolder, IRBuilderCallbackInserter> B;
+    Function *F = nullptr;
+    Value *P = nullptr, *N = nullptr;
+    unsigned Emitted = 0;
+
+    unsigned random(unsigned Bound) { return Rng() % Bound; }
+
+    bool chance(unsigned Percent) { return random(100) < Percent; }
+
+    static void push(std::vector<Value*> &Values, Value *V) {
+        Values.push_back(V);
+        if (Values.size() > WindowSize) {
+            Values.erase(Values.begin());
+        }
+    }
+
+    Value *pick(const std::vector<Value*> &Values) {
+        return Values[random(Values.size())];
+    }
+
+    ConstantInt *constant() { return B.getInt32(random(64) + 1); }
+
+    Instruction::BinaryOps binaryOp() {
+        static const Instruction::BinaryOps Ops[] = {
+            Instruction::Add, Instruction::Sub, Instruction::Mul,
+            Instruction::And, Instruction::Or,  Instruction::Xor,
+        };
+        return Ops[random(std::size(Ops))];
+    }
+
+    BasicBlock *newBlock(const Twine &Name) {
+        return BasicBlock::Create(Ctx, Name, F);
+    }
+
+    void continueIn(BasicBlock *BB) {
+        B.CreateBr(BB);
+        B.SetInsertPoint(BB);
+    }
+
+    void buildFunction() {
+        Type *I32 = B.getInt32Ty();
+        auto *FTy = FunctionType::get(
+            I32, {I32, I32, PointerType::getUnqual(Ctx), I32}, false);
+        F = Function::Create(FTy, GlobalValue::ExternalLinkage, "workload",
+                             *M);
+        auto Arg = F->arg_begin();
+        Value *X = Arg++;
+        Value *Y = Arg++;
+        P = Arg++;
+        N = Arg++;
+        X->setName("x");
+        Y->setName("y");
+        P->setName("p");
+        N->setName("n");
+
+        B.SetInsertPoint(BasicBlock::Create(Ctx, "entry", F));
+        Scope S;
+        S.Values = {X, Y, N};
+        Emitted = 0;
+        emitRegion(S, std::max(Config.FunctionSize, 1u), 0, 0);
+        B.CreateRet(S.Values.back());
+    }
+
+    //===------------------------------------------------------------------===//
+    // Regions
+    //===------------------------------------------------------------------===//
+
+    unsigned blockSize() const { return std::max(Config.BlockSize, 1u); }
+
+    /// Budget of a region nested at the given depths, out of Remaining
+    unsigned nestedBudget(unsigned Remaining, unsigned BranchDepth,
+                          unsigned LoopDepth) {
+        unsigned BranchLevels = Config.MaxBranchDepth > BranchDepth
+                                    ? Config.MaxBranchDepth - BranchDepth
+                                    : 0;
+        unsigned LoopLevels = Config.MaxLoopDepth > LoopDepth
+                                  ? Config.MaxLoopDepth - LoopDepth
+                                  : 0;
+        unsigned Levels = std::min(std::max(BranchLevels, LoopLevels), 10u);
+        uint64_t Cap = uint64_t(blockSize()) << (2 * Levels);
+        unsigned Budget = std::min<uint64_t>(Remaining / 2, Cap);
+        return std::max(Budget / 2 + random(Budget / 2 + 1), 1u);
+    }
+
+    void emitRegion(Scope &S, unsigned Budget, unsigned BranchDepth,
+                    unsigned LoopDepth) {
+        unsigned End = Emitted + Budget;
+        while (Emitted < End) {
+            unsigned Remaining = End - Emitted;
+            bool CanNest = Remaining >= 2 * blockSize();
+            if (CanNest && BranchDepth < Config.MaxBranchDepth &&
+                chance(Config.BranchPercent)) {
+                emitBranch(S, nestedBudget(Remaining, BranchDepth + 1,
+                                           LoopDepth),
+                           BranchDepth + 1, LoopDepth);
+            } else if (CanNest && LoopDepth < Config.MaxLoopDepth &&
+                       chance(Config.LoopPercent)) {
+                emitLoop(S, nestedBudget(Remaining, BranchDepth,
+                                         LoopDepth + 1),
+                         BranchDepth, LoopDepth + 1);
+            } else {
+                emitStraight(S, std::min(blockSize(), Remaining));
+            }
+        }
+    }
+
+    //===------------------------------------------------------------------===//
+    // Straight-line code
+    //===------------------------------------------------------------------===//
+
+    /// An operand, and whether it is computed only from constants
+    std::pair<Value*, bool> operand(const Scope &S) {
+        if (!chance(Config.ConstantPercent)) {
+            return {pick(S.Values), false};
+        }
+        if (S.Constants.empty() || chance(30)) {
+            return {constant(), true};
+        }
+        return {pick(S.Constants), true};
+    }
+
+    /// A new or repeated expression over the scope
+    void emitExpression(Scope &S) {
+        Instruction::BinaryOps Op;
+        Value *LHS, *RHS;
+        bool IsConstant = false;
+        if (!S.Exprs.empty() && chance(Config.RedundantPercent)) {
+            std::tie(Op, LHS, RHS) = S.Exprs[random(S.Exprs.size())];
+            if (Instruction::isCommutative(Op) && chance(50)) {
+                std::swap(LHS, RHS);
+            }
+        } else {
+            Op = binaryOp();
+            bool LHSConstant, RHSConstant;
+            std::tie(LHS, LHSConstant) = operand(S);
+            std::tie(RHS, RHSConstant) = operand(S);
+            IsConstant = LHSConstant && RHSConstant;
+        }
+
+        Value *V = B.CreateBinOp(Op, LHS, RHS);
+        S.Exprs.emplace_back(Op, LHS, RHS);
+        if (S.Exprs.size() > ExpressionLimit) {
+            S.Exprs.erase(S.Exprs.begin());
+        }
+        push(IsConstant ? S.Constants : S.Values, V);
+    }
+
+    void emitStraight(Scope &S, unsigned Count) {
+        for (unsigned I = 0; I < Count; I++) {
+            emitExpression(S);
+        }
+    }
+
+    //===------------------------------------------------------------------===//
+    // Branch regions
+    //===------------------------------------------------------------------===//
+
+    void emitBranch(Scope &S, unsigned Budget, unsigned BranchDepth,
+                    unsigned LoopDepth) {
+        unsigned Width = std::max(Config.BranchWidth, 2u);
+        unsigned Extra = std::max(Config.PhiFanIn, Width) - Width;
+
+        SmallVector<BasicBlock*, 8> Arms;
+        for (unsigned I = 0; I < Width; I++) {
+            Arms.push_back(newBlock("br.arm"));
+        }
+        if (Width == 2) {
+            B.CreateCondBr(B.CreateICmpSLT(pick(S.Values), pick(S.Values)),
+                           Arms[0], Arms[1]);
+        } else {
+            SwitchInst *SI = B.CreateSwitch(pick(S.Values), Arms[0],
+                                            Width - 1);
+            for (unsigned I = 1; I < Width; I++) {
+                SI->addCase(B.getInt32(I), Arms[I]);
+            }
+        }
+
+        // Arms see the dominating values but not each other's; the join is
+        // placed after them once they are complete
+        BasicBlock *Join = BasicBlock::Create(Ctx, "br.join");
+        SmallVector<std::pair<Value*, BasicBlock*>, 8> Incoming;
+        for (unsigned I = 0; I < Width; I++) {
+            B.SetInsertPoint(Arms[I]);
+            Scope Arm = S;
+            emitRegion(Arm, std::max(Budget / Width, 1u), BranchDepth,
+                       LoopDepth);
+
+            // Early exits to the join, for fan-in beyond the width
+            unsigned Exits = Extra / Width + (I < Extra % Width ? 1 : 0);
+            for (unsigned E = 0; E < Exits; E++) {
+                BasicBlock *Next = newBlock("br.exit");
+                B.CreateCondBr(
+                    B.CreateICmpSLT(pick(Arm.Values), pick(Arm.Values)),
+                    Join, Next);
+                Incoming.emplace_back(Arm.Values.back(), B.GetInsertBlock());
+                B.SetInsertPoint(Next);
+                emitExpression(Arm);
+            }
+            B.CreateBr(Join);
+            Incoming.emplace_back(Arm.Values.back(), B.GetInsertBlock());
+        }
+
+        Join->insertInto(F);
+        B.SetInsertPoint(Join);
+        PHINode *Phi = B.CreatePHI(B.getInt32Ty(), Incoming.size());
+        for (auto &[V, Pred] : Incoming) {
+            Phi->addIncoming(V, Pred);
+        }
+        push(S.Values, Phi);
+    }
+
+    //===------------------------------------------------------------------===//
+    // Loops
+    //===------------------------------------------------------------------===//
+
+    /// Log-uniform: a power of two range is chosen uniformly, then a count
+    /// in it
+    unsigned constantTripCount() {
+        unsigned Min = std::max(Config.MinTripCount, 1u);
+        unsigned Max = std::max(Config.MaxTripCount, Min);
+        unsigned MinLog = Log2_32(Min), MaxLog = Log2_32(Max);
+        unsigned Log = MinLog + random(MaxLog - MinLog + 1);
+        uint64_t Low = std::max<uint64_t>(uint64_t(1) << Log, Min);
+        uint64_t High = std::min<uint64_t>((uint64_t(2) << Log) - 1, Max);
+        return Low + random(High - Low + 1);
+    }
+
+    void emitLoop(Scope &S, unsigned Budget, unsigned BranchDepth,
+                  unsigned LoopDepth) {
+        Value *TripCount = chance(Config.RuntimeTripCountPercent)
+                               ? N
+                               : B.getInt32(constantTripCount());
+        BasicBlock *Preheader = B.GetInsertBlock();
+        Value *Init = pick(S.Values);
+        continueIn(newBlock("loop"));
+        BasicBlock *Header = B.GetInsertBlock();
+
+        PHINode *IV = B.CreatePHI(B.getInt32Ty(), 2, "i");
+        PHINode *Acc = B.CreatePHI(B.getInt32Ty(), 2, "acc");
+        Value *Addr = B.CreateGEP(B.getInt32Ty(), P, IV);
+
+        // The body mixes the element, the accumulator and outer values,
+        // which are invariant in it
+        Scope Body = S;
+        push(Body.Values, IV);
+        push(Body.Values, Acc);
+        push(Body.Values, B.CreateLoad(B.getInt32Ty(), Addr));
+        emitRegion(Body, Budget, BranchDepth, LoopDepth);
+        Value *Next = B.CreateAdd(Body.Values.back(), Acc);
+
+        Value *IVNext = B.CreateAdd(IV, B.getInt32(1));
+        BasicBlock *Latch = B.GetInsertBlock();
+        BasicBlock *Exit = newBlock("loop.exit");
+        B.CreateCondBr(B.CreateICmpSLT(IVNext, TripCount), Header, Exit);
+
+        IV->addIncoming(B.getInt32(0), Preheader);
+        IV->addIncoming(IVNext, Latch);
+        Acc->addIncoming(Init, Preheader);
+        Acc->addIncoming(Next, Latch);
+
+        B.SetInsertPoint(Exit);
+        PHINode *Result = B.CreatePHI(B.getInt32Ty(), 1, "acc.lcssa");
+        Result->addIncoming(Next, Latch);
+        push(S.Values, Result);
+    }
+};
+
+} // end anonymous namespace
+
+std::unique_ptr<Module>
+llvm::optpasses::generateModule(LLVMContext &Ctx,
+                                const IRGeneratorConfig &Config) {
+    return ModuleBuilder(Ctx, Config).build();
+}
+
+//===----------------------------------------------------------------------===//
+// Workload presets
+//===----------------------------------------------------------------------===//
+
+StringRef llvm::optpasses::getWorkloadName(IRWorkload Kind) {
+    switch (Kind) {
+    case IRWorkload::Folding:
+        return "folding";
+    case IRWorkload::Redundancy:
+        return "redundancy";
+    case IRWorkload::Loops:
+        return "loops";
+    }
+    llvm_unreachable("unknown workload");
+}
+
+IRGeneratorConfig llvm::optpasses::getWorkloadConfig(IRWorkload Kind,
+                                                     unsigned NumInstructions,
+                                                     uint64_t Seed) {
+    IRGeneratorConfig Config;
+    Config.FunctionSize = NumInstructions;
+    Config.Seed = Seed;
+    Config.MaxBranchDepth = 0;
+    Config.MaxLoopDepth = 0;
+    Config.RedundantPercent = 0;
+    Config.ConstantPercent = 0;
+
+    switch (Kind) {
+    case IRWorkload::Folding:
+        Config.BlockSize = 64;
+        Config.ConstantPercent = 50;
+        break;
+    case IRWorkload::Redundancy:
+        Config.BlockSize = 32;
+        Config.MaxBranchDepth = 2;
+        Config.BranchPercent = 25;
+        Config.RedundantPercent = 40;
+        break;
+    case IRWorkload::Loops:
+        // Mostly fully unrollable, some partially, some only at run time
+        Config.BlockSize = 8;
+        Config.MaxLoopDepth = 1;
+        Config.LoopPercent = 90;
+        Config.MinTripCount = 2;
+        Config.MaxTripCount = 128;
+        Config.RuntimeTripCountPercent = 15;
+        Config.ConstantPercent = 10;
+        break;
+    }
+    return Config;
+}
+
+std::unique_ptr<Module> llvm::optpasses::generateWorkload(
+    LLVMContext &Ctx, IRWorkload Kind, unsigned NumInstructions,
+    uint64_t Seed) {
+    return generateModule(Ctx, getWorkloadConfig(Kind, NumInstructions, Seed));
+}
+
+//===----------------------------------------------------------------------===//
+// Shape
+//===----------------------------------------------------------------------===//
+
+IRShape llvm::optpasses::measureShape(Module &M) {
+    IRShape Shape;
+    for (Function &F : M) {
+        if (F.isDeclaration()) {
+            continue;
+        }
+        Shape.Functions++;
+
+        DominatorTree DT(F);
+        LoopInfo LI(DT);
+        Shape.Loops += LI.getLoopsInPreorder().size();
+        for (BasicBlock &BB : F) {
+            Shape.Blocks++;
+            Shape.Instructions += BB.size();
+            Shape.MaxLoopDepth = std::max(Shape.MaxLoopDepth,
+                                          LI.getLoopDepth(&BB));
+            if (DomTreeNode *Node = DT.getNode(&BB)) {
+                Shape.MaxDomTreeDepth = std::max(Shape.MaxDomTreeDepth,
+                                                 Node->getLevel());
+                Shape.MaxDomTreeWidth = std::max<unsigned>(
+                    Shape.MaxDomTreeWidth, Node->getNumChildren());
+            }
+            for (PHINode &Phi : BB.phis()) {
+                Shape.MaxPhiFanIn = std::max(Shape.MaxPhiFanIn,
+                                             Phi.getNumIncomingValues());
+            }
+        }
+    }
+    return Shape;
+}
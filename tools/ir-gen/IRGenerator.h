@@ -0,0 +1,148 @@
+//===- IRGenerator.h - Synthetic IR generation ------------------*- C++ -*-===//
+//
+// Part of the llvm-opt-passes project
+//
+// Generates random, valid modules whose shape is set by knobs: function
+// size, nesting and width of branch regions (the dominator tree), PHI
+// fan-in at joins, loop nest depth and trip counts, and the density of
+// redundant and constant expressions. Generation is deterministic for a
+// given configuration and seed.
+//
+// pass-bench uses fixed presets of the knobs, one per pass; ir-gen exposes
+// all of them for stress testing.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OPT_PASSES_IR_GENERATOR_H
+#define LLVM_OPT_PASSES_IR_GENERATOR_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace llvm {
+namespace optpasses {
+
+/// Knobs of generateModule(). Percentages are per statement or operand
+/// and are clamped to 100.
+struct IRGeneratorConfig {
+    /// Functions in the module: @workload, @workload.1, ...
+    unsigned Functions = 1;
+
+    /// Instructions per function; a function stops at the first statement
+    /// boundary past it
+    unsigned FunctionSize = 1000;
+
+    /// Instructions in a straight-line run, and the unit in which nested
+    /// regions are sized: a region with L levels of nesting below it gets
+    /// at most BlockSize * 4^L instructions
+    unsigned BlockSize = 16;
+
+    //===------------------------------------------------------------------===//
+    // Branch regions (dominator tree shape)
+    //===------------------------------------------------------------------===//
+
+    /// Nesting depth of branch regions; each level adds at least one level
+    /// to the dominator tree
+    unsigned MaxBranchDepth = 2;
+
+    /// Arms of a branch region: 2 is an if/else, more is a switch. The
+    /// branching block immediately dominates the arms and the join, so
+    /// its dominator tree node has BranchWidth + 1 children.
+    unsigned BranchWidth = 2;
+
+    /// Predecessors of the join block of a branch region, and so incoming
+    /// values of its PHI. Edges beyond BranchWidth are early exits from
+    /// the arms; values below BranchWidth are raised to it.
+    unsigned PhiFanIn = 2;
+
+    /// Percent of statements that open a branch region while nesting allows
+    unsigned BranchPercent = 20;
+
+    //===------------------------------------------------------------------===//
+    // Loops
+    //===------------------------------------------------------------------===//
+
+    /// Nesting depth of loops
+    unsigned MaxLoopDepth = 2;
+
+    /// Percent of statements that open a loop while nesting allows
+    unsigned LoopPercent = 20;
+
+    /// Constant trip counts are log-uniform in [MinTripCount, MaxTripCount],
+    /// so small counts are as common as every larger power of two
+    unsigned MinTripCount = 2;
+    unsigned MaxTripCount = 128;
+
+    /// Percent of loops bounded by the %n argument, unknown at compile time
+    unsigned RuntimeTripCountPercent = 15;
+
+    //===------------------------------------------------------------------===//
+    // Expressions
+    //===------------------------------------------------------------------===//
+
+    /// Percent of expressions that recompute a dominating expression,
+    /// commuted half the time when the opcode allows
+    unsigned RedundantPercent = 20;
+
+    /// Percent of operands that are constants or values computed only from
+    /// constants
+    unsigned ConstantPercent = 20;
+
+    uint64_t Seed = 0;
+};
+
+/// Generates a module from Config. The functions have the signature
+/// i32 (i32 %x, i32 %y, ptr %p, i32 %n); loops load from %p.
+std::unique_ptr<Module> generateModule(LLVMContext &Ctx,
+                                       const IRGeneratorConfig &Config);
+
+/// Shapes of generated IR, each aimed at one of the passes
+enum class IRWorkload {
+    /// Straight-line arithmetic where about half the operands derive from
+    /// constants
+    Folding,
+
+    /// Expressions recomputed in dominated blocks, some with commuted
+    /// operands, and in sibling arms of diamonds (not redundant)
+    Redundancy,
+
+    /// Runs of small loops with constant, larger constant, and unknown trip
+    /// counts
+    Loops,
+};
+
+StringRef getWorkloadName(IRWorkload Kind);
+
+/// The preset for Kind: a single function of at least NumInstructions
+/// instructions
+IRGeneratorConfig getWorkloadConfig(IRWorkload Kind, unsigned NumInstructions,
+                                    uint64_t Seed = 0);
+
+/// generateModule() with the preset for Kind; the function is @workload
+std::unique_ptr<Module> generateWorkload(LLVMContext &Ctx, IRWorkload Kind,
+                                         unsigned NumInstructions,
+                                         uint64_t Seed = 0);
+
+/// Shape of generated (or any) IR, to check that the knobs had their effect
+struct IRShape {
+    unsigned Functions = 0;
+    unsigned Instructions = 0;
+    unsigned Blocks = 0;
+    unsigned MaxDomTreeDepth = 0;
+    unsigned MaxDomTreeWidth = 0;
+    unsigned MaxLoopDepth = 0;
+    unsigned Loops = 0;
+    unsigned MaxPhiFanIn = 0;
+};
+
+/// Measures the functions with bodies in M
+IRShape measureShape(Module &M);
+
+} // namespace optpasses
+} // namespace llvm
+
+#endif // LLVM_OPT_PASSES_IR_GENERATOR_H
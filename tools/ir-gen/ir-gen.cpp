@@ -0,0 +1,241 @@
+//===- ir-gen.cpp - Synthetic IR generator --------------------------------===//
+//
+// Writes a random, valid module shaped by the IRGeneratorConfig knobs, to
+// push RedundancyAnalysis, LoopAnalyzer and the passes built on them into
+// their worst cases. Output is the same for the same knobs and seed, so a
+// stress input can be named by its command line and regenerated later.
+//
+//===----------------------------------------------------------------------===//
+
+#include "IRGenerator.h"
+
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/SystemUtils.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+namespace {
+
+enum class Preset { None, Folding, Redundancy, Loops };
+
+} // end anonymous namespace
+
+static cl::opt<std::string> OutputFilename("o",
+                                           cl::desc("Output filename"),
+                                           cl::init("-"),
+                                           cl::value_desc("filename"));
+
+static cl::opt<bool> OutputAssembly("S",
+                                    cl::desc("Write textual IR, not bitcode"));
+
+static cl::opt<bool> PrintShape(
+    "print-shape",
+    cl::desc("Print the shape of the module (dominator tree, loops, PHIs) "
+             "to stderr"));
+
+static cl::opt<Preset> PresetKind(
+    "preset",
+    cl::desc("Start from a pass-bench workload; knobs given explicitly "
+             "override it"),
+    cl::init(Preset::None),
+    cl::values(clEnumValN(Preset::None, "none", "the knob defaults"),
+               clEnumValN(Preset::Folding, "folding", "constant chains"),
+               clEnumValN(Preset::Redundancy, "redundancy",
+                          "repeated expressions and diamonds"),
+               clEnumValN(Preset::Loops, "loops", "runs of small loops")));
+
+static cl::opt<uint64_t> Seed("seed", cl::desc("Random seed"), cl::init(0));
+
+static cl::opt<unsigned> Functions("functions",
+                                   cl::desc("Functions in the module"),
+                                   cl::init(1));
+
+static cl::opt<unsigned> FunctionSize(
+    "function-size", cl::desc("Instructions per function"), cl::init(1000));
+
+static cl::opt<unsigned> BlockSize(
+    "block-size",
+    cl::desc("Instructions per straight-line run; nested regions get at "
+             "most block-size * 4^levels"),
+    cl::init(16));
+
+static cl::opt<unsigned> MaxBranchDepth(
+    "branch-depth", cl::desc("Nesting depth of branch regions"),
+    cl::init(2));
+
+static cl::opt<unsigned> BranchWidth(
+    "branch-width",
+    cl::desc("Arms per branch region (dominator tree width); 2 is if/else, "
+             "more is a switch"),
+    cl::init(2));
+
+static cl::opt<unsigned> PhiFanIn(
+    "phi-fan-in",
+    cl::desc("Incoming values of join PHIs, at least branch-width; the "
+             "edges beyond it are early exits from the arms"),
+    cl::init(2));
+
+static cl::opt<unsigned> BranchPercent(
+    "branch-percent",
+    cl::desc("Percent of statements that open a branch region"),
+    cl::init(20));
+
+static cl::opt<unsigned> MaxLoopDepth("loop-depth",
+                                      cl::desc("Nesting depth of loops"),
+                                      cl::init(2));
+
+static cl::opt<unsigned> LoopPercent(
+    "loop-percent", cl::desc("Percent of statements that open a loop"),
+    cl::init(20));
+
+static cl::opt<unsigned> MinTripCount(
+    "min-trip-count",
+    cl::desc("Smallest constant trip count (log-uniform distribution)"),
+    cl::init(2));
+
+static cl::opt<unsigned> MaxTripCount(
+    "max-trip-count",
+    cl::desc("Largest constant trip count (log-uniform distribution)"),
+    cl::init(128));
+
+static cl::opt<unsigned> RuntimeTripCountPercent(
+    "runtime-trip-percent",
+    cl::desc("Percent of loops whose trip count is the %n argument"),
+    cl::init(15));
+
+static cl::opt<unsigned> RedundantPercent(
+    "redundant-percent",
+    cl::desc("Percent of expressions that recompute a dominating one"),
+    cl::init(20));
+
+static cl::opt<unsigned> ConstantPercent(
+    "constant-percent",
+    cl::desc("Percent of operands that are constants or constant chains"),
+    cl::init(20));
+
+/// Sets Field from Opt if it was given, or always without a preset
+template <typename T>
+static void applyOption(const cl::opt<T> &Opt, T &Field) {
+    if (PresetKind == Preset::None || Opt.getNumOccurrences()) {
+        Field = Opt;
+    }
+}
+
+static IRGeneratorConfig getConfig() {
+    IRGeneratorConfig Config;
+    switch (PresetKind) {
+    case Preset::None:
+        break;
+    case Preset::Folding:
+        Config = getWorkloadConfig(IRWorkload::Folding, FunctionSize);
+        break;
+    case Preset::Redundancy:
+        Config = getWorkloadConfig(IRWorkload::Redundancy, FunctionSize);
+        break;
+    case Preset::Loops:
+        Config = getWorkloadConfig(IRWorkload::Loops, FunctionSize);
+        break;
+    }
+
+    Config.Seed = Seed;
+    Config.FunctionSize = FunctionSize;
+    applyOption(Functions, Config.Functions);
+    applyOption(BlockSize, Config.BlockSize);
+    applyOption(MaxBranchDepth, Config.MaxBranchDepth);
+    applyOption(BranchWidth, Config.BranchWidth);
+    applyOption(PhiFanIn, Config.PhiFanIn);
+    applyOption(BranchPercent, Config.BranchPercent);
+    applyOption(MaxLoopDepth, Config.MaxLoopDepth);
+    applyOption(LoopPercent, Config.LoopPercent);
+    applyOption(MinTripCount, Config.MinTripCount);
+    applyOption(MaxTripCount, Config.MaxTripCount);
+    applyOption(RuntimeTripCountPercent, Config.RuntimeTripCountPercent);
+    applyOption(RedundantPercent, Config.RedundantPercent);
+    applyOption(ConstantPercent, Config.ConstantPercent);
+    return Config;
+}
+
+/// An error message for knobs the generator would otherwise clamp
+static std::string validateConfig(const IRGeneratorConfig &Config) {
+    if (Config.Functions == 0 || Config.FunctionSize == 0 ||
+        Config.BlockSize == 0) {
+        return "-functions, -function-size and -block-size must be positive";
+    }
+    if (Config.BranchWidth < 2) {
+        return "-branch-width must be at least 2";
+    }
+    if (Config.MinTripCount == 0 ||
+        Config.MinTripCount > Config.MaxTripCount) {
+        return "trip counts must satisfy 0 < -min-trip-count <= "
+               "-max-trip-count";
+    }
+    for (unsigned Percent :
+         {Config.BranchPercent, Config.LoopPercent,
+          Config.RuntimeTripCountPercent, Config.RedundantPercent,
+          Config.ConstantPercent}) {
+        if (Percent > 100) {
+            return "percentages must be at most 100";
+        }
+    }
+    return "";
+}
+
+int main(int argc, char **argv) {
+    InitLLVM X(argc, argv);
+    cl::ParseCommandLineOptions(argc, argv,
+                                "random IR generator for stress tests\n");
+
+    IRGeneratorConfig Config = getConfig();
+    std::string Invalid = validateConfig(Config);
+    if (!Invalid.empty()) {
+        WithColor::error(errs(), argv[0]) << Invalid << "\n";
+        return 1;
+    }
+
+    LLVMContext Ctx;
+    std::unique_ptr<Module> M = generateModule(Ctx, Config);
+    if (verifyModule(*M, &errs())) {
+        WithColor::error(errs(), argv[0])
+            << "generated module is invalid (a generator bug)\n";
+        return 1;
+    }
+
+    if (PrintShape) {
+        IRShape Shape = measureShape(*M);
+        errs() << "functions:          " << Shape.Functions << "\n"
+               << "instructions:       " << Shape.Instructions << "\n"
+               << "blocks:             " << Shape.Blocks << "\n"
+               << "dom tree depth:     " << Shape.MaxDomTreeDepth << "\n"
+               << "dom tree width:     " << Shape.MaxDomTreeWidth << "\n"
+               << "loops:              " << Shape.Loops << "\n"
+               << "loop depth:         " << Shape.MaxLoopDepth << "\n"
+               << "phi fan-in:         " << Shape.MaxPhiFanIn << "\n";
+    }
+
+    std::error_code EC;
+    ToolOutputFile Out(OutputFilename, EC,
+                       OutputAssembly ? sys::fs::OF_Text : sys::fs::OF_None);
+    if (EC) {
+        WithColor::error(errs(), argv[0]) << EC.message() << "\n";
+        return 1;
+    }
+    if (OutputAssembly) {
+        M->print(Out.os(), nullptr);
+    } else if (CheckBitcodeOutputToConsole(Out.os())) {
+        return 1;
+    } else {
+        WriteBitcodeToFile(*M, Out.os());
+    }
+    Out.keep();
+    return 0;
+}
@@ -0,0 +1,509 @@
+//===- pass-bench.cpp - Compile-time benchmarks of the passes -------------===//
+//
+// Times each pass on generated functions of growing size, next to the
+// upstream pass doing the nearest job:
+//
+//   constant-fold        ConstantFoldingPass         instcombine
+//   redundancy-analysis  RedundancyAnalysis          early-cse
+//   redundancy-elim      RedundancyEliminationPass   gvn
+//   loop-unroll          LoopUnrollingPass           loop-unroll
+//
+// Every point runs in a child process: a fresh heap makes the peak RSS of
+// the pass comparable between points, and a point that exceeds -timeout
+// can be killed. Each repetition regenerates the function and builds new
+// analysis managers outside the timed region, so required analyses are
+// timed with the pass, as they are for the upstream pass.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ConstantFoldingPass.h"
+#include "IRGenerator.h"
+#include "LoopUnrollingPass.h"
+#include "PassRegistration.h"
+#include "RedundancyAnalysis.h"
+#include "RedundancyEliminationPass.h"
+
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/Scalar/EarlyCSE.h"
+#include "llvm/Transforms/Scalar/GVN.h"
+#include "llvm/Transforms/Scalar/LoopUnrollPass.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace llvm;
+using namespace llvm::optpasses;
+
+static cl::opt<std::string> Filter(
+    "filter",
+    cl::desc("Run only the benchmarks whose name matches this regex"),
+    cl::init(".*"));
+
+static cl::opt<unsigned> MinInstructions(
+    "min-instructions",
+    cl::desc("Size of the smallest function"),
+    cl::init(1000));
+
+static cl::opt<unsigned> MaxInstructions(
+    "max-instructions",
+    cl::desc("Size of the largest function"),
+    cl::init(1000000));
+
+static cl::opt<unsigned> Growth(
+    "growth",
+    cl::desc("Factor between successive function sizes"),
+    cl::init(4));
+
+static cl::opt<unsigned> Repetitions(
+    "repetitions",
+    cl::desc("Timed runs per point; the median is reported"),
+    cl::init(3));
+
+static cl::opt<unsigned> Timeout(
+    "timeout",
+    cl::desc("Seconds a point may take before it and larger sizes are "
+             "skipped"),
+    cl::init(120));
+
+static cl::opt<uint64_t> Seed(
+    "seed",
+    cl::desc("Seed of the IR generator"),
+    cl::init(0));
+
+enum class OutputFormat { Console, CSV, JSON };
+
+static cl::opt<OutputFormat> Format(
+    "format",
+    cl::desc("Output format"),
+    cl::values(clEnumValN(OutputFormat::Console, "console", "table"),
+               clEnumValN(OutputFormat::CSV, "csv", "one row per point"),
+               clEnumValN(OutputFormat::JSON, "json", "array of points")),
+    cl::init(OutputFormat::Console));
+
+static cl::opt<std::string> OutputFilename(
+    "o",
+    cl::desc("Output filename"),
+    cl::init("-"),
+    cl::value_desc("filename"));
+
+//===----------------------------------------------------------------------===//
+// Benchmarks
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+struct PassBenchmark {
+    StringRef Name;
+    IRWorkload Workload;
+    StringRef UpstreamName;
+    std::function<void(FunctionPassManager &)> AddPass;
+    std::function<void(FunctionPassManager &)> AddUpstream;
+};
+
+/// Repetitions whose times are kept; a Measurement crosses a pipe, so it
+/// holds them in place
+constexpr unsigned MaxSamples = 64;
+
+/// One pass at one size
+struct Measurement {
+    uint64_t Instructions = 0;
+    double Nanoseconds = 0;  // Median over the repetitions
+    uint64_t PeakBytes = 0;  // 0 if unknown
+    bool Completed = false;
+
+    /// Times of the first MaxSamples repetitions, in run order
+    double Samples[MaxSamples];
+    unsigned NumSamples = 0;
+
+    double nanosPerInstruction() const {
+        return Instructions ? Nanoseconds / Instructions : 0;
+    }
+};
+
+/// Both passes at one size
+struct Point {
+    const PassBenchmark *Benchmark;
+    Measurement Ours;
+    Measurement Upstream;
+};
+
+} // end anonymous namespace
+
+static std::vector<PassBenchmark> getBenchmarks() {
+    return {
+        {"constant-fold", IRWorkload::Folding, "instcombine",
+         [](FunctionPassManager &FPM) { FPM.addPass(ConstantFoldingPass()); },
+         [](FunctionPassManager &FPM) { FPM.addPass(InstCombinePass()); }},
+        {"redundancy-analysis", IRWorkload::Redundancy, "early-cse",
+         [](FunctionPassManager &FPM) {
+             FPM.addPass(RequireAnalysisPass<RedundancyAnalysis, Function>());
+         },
+         [](FunctionPassManager &FPM) { FPM.addPass(EarlyCSEPass()); }},
+        {"redundancy-elim", IRWorkload::Redundancy, "gvn",
+         [](FunctionPassManager &FPM) {
+             FPM.addPass(RedundancyEliminationPass());
+         },
+         [](FunctionPassManager &FPM) { FPM.addPass(GVNPass()); }},
+        {"loop-unroll", IRWorkload::Loops, "loop-unroll",
+         [](FunctionPassManager &FPM) { FPM.addPass(LoopUnrollingPass()); },
+         [](FunctionPassManager &FPM) {
+             FPM.addPass(LoopUnrollPass(LoopUnrollOptions(/*OptLevel=*/2)));
+         }},
+    };
+}
+
+static std::vector<unsigned> getSizes() {
+    std::vector<unsigned> Sizes;
+    for (uint64_t Size = MinInstructions; Size < MaxInstructions;
+         Size *= std::max(2u, unsigned(Growth))) {
+        Sizes.push_back(Size);
+    }
+    Sizes.push_back(MaxInstructions);
+    return Sizes;
+}
+
+//===----------------------------------------------------------------------===//
+// Measuring
+//===----------------------------------------------------------------------===//
+
+/// A field of /proc/self/status in bytes, or 0 where there is none
+static uint64_t readProcessStatus(StringRef Field) {
+    std::ifstream Status("/proc/self/status");
+    std::string Line;
+    while (std::getline(Status, Line)) {
+        StringRef Rest(Line);
+        if (Rest.consume_front(Field) && Rest.consume_front(":")) {
+            uint64_t KiB = 0;
+            Rest.trim().split(' ').first.getAsInteger(10, KiB);
+            return KiB * 1024;
+        }
+    }
+    return 0;
+}
+
+/// Restart the peak RSS (VmHWM) from the current RSS; Linux 4.0 and later
+static bool resetPeakMemory() {
+    std::ofstream ClearRefs("/proc/self/clear_refs");
+    ClearRefs << "5";
+    ClearRefs.flush();
+    return ClearRefs.good();
+}
+
+static Measurement runPoint(IRWorkload Workload, unsigned Size,
+                            const std::function<void(FunctionPassManager &)>
+                                &AddPass) {
+    Measurement Result;
+    std::vector<double> Times;
+
+    for (unsigned Rep = 0; Rep < Repetitions; Rep++) {
+        LLVMContext Ctx;
+        std::unique_ptr<Module> M = generateWorkload(Ctx, Workload, Size, Seed);
+        Function &F = *M->getFunction("workload");
+        Result.Instructions = F.getInstructionCount();
+
+        LoopAnalysisManager LAM;
+        FunctionAnalysisManager FAM;
+        CGSCCAnalysisManager CGAM;
+        ModuleAnalysisManager MAM;
+        PassBuilder PB;
+        registerOptPasses(PB);
+        PB.registerModuleAnalyses(MAM);
+        PB.registerCGSCCAnalyses(CGAM);
+        PB.registerFunctionAnalyses(FAM);
+        PB.registerLoopAnalyses(LAM);
+        PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+        FunctionPassManager FPM;
+        AddPass(FPM);
+
+        // Peak memory of the first run, over what the IR already takes
+        bool MeasureMemory = Rep == 0 && resetPeakMemory();
+        uint64_t Baseline = MeasureMemory ? readProcessStatus("VmRSS") : 0;
+
+        auto Start = std::chrono::steady_clock::now();
+        FPM.run(F, FAM);
+        auto End = std::chrono::steady_clock::now();
+
+        Times.push_back(
+            std::chrono::duration<double, std::nano>(End - Start).count());
+        if (MeasureMemory) {
+            uint64_t Peak = readProcessStatus("VmHWM");
+            Result.PeakBytes = Peak > Baseline ? Peak - Baseline : 0;
+        }
+    }
+
+    Result.NumSamples = std::min<size_t>(Times.size(), MaxSamples);
+    std::copy_n(Times.begin(), Result.NumSamples, Result.Samples);
+    std::sort(Times.begin(), Times.end());
+    Result.Nanoseconds = Times[Times.size() / 2];
+    Result.Completed = true;
+    return Result;
+}
+
+/// runPoint in a child process, killed after -timeout seconds
+static Measurement measure(IRWorkload Workload, unsigned Size,
+                           const std::function<void(FunctionPassManager &)>
+                               &AddPass) {
+    int Pipe[2];
+    if (pipe(Pipe) != 0) {
+        return Measurement();
+    }
+
+    pid_t Child = fork();
+    if (Child == 0) {
+        close(Pipe[0]);
+        alarm(Timeout);
+        Measurement Result = runPoint(Workload, Size, AddPass);
+        ssize_t Written = write(Pipe[1], &Result, sizeof(Result));
+        _exit(Written == sizeof(Result) ? 0 : 1);
+    }
+
+    close(Pipe[1]);
+    Measurement Result;
+    if (Child < 0 || read(Pipe[0], &Result, sizeof(Result)) !=
+                         ssize_t(sizeof(Result))) {
+        Result = Measurement();
+    }
+    close(Pipe[0]);
+    if (Child > 0) {
+        int Status;
+        waitpid(Child, &Status, 0);
+    }
+    return Result;
+}
+
+//===----------------------------------------------------------------------===//
+// Reporting
+//===----------------------------------------------------------------------===//
+
+/// Exponent k of the best fit time ~ n^k over the completed points
+static double getScalingExponent(ArrayRef<Point> Points, bool Upstream) {
+    std::vector<std::pair<double, double>> LogLog;
+    for (const Point &P : Points) {
+        const Measurement &M = Upstream ? P.Upstream : P.Ours;
+        if (M.Completed && M.Nanoseconds > 0) {
+            LogLog.emplace_back(std::log(double(M.Instructions)),
+                                std::log(M.Nanoseconds));
+        }
+    }
+    if (LogLog.size() < 2) {
+        return NAN;
+    }
+
+    double MeanX = 0, MeanY = 0;
+    for (auto &[X, Y] : LogLog) {
+        MeanX += X / LogLog.size();
+        MeanY += Y / LogLog.size();
+    }
+    double Covariance = 0, Variance = 0;
+    for (auto &[X, Y] : LogLog) {
+        Covariance += (X - MeanX) * (Y - MeanY);
+        Variance += (X - MeanX) * (X - MeanX);
+    }
+    return Variance > 0 ? Covariance / Variance : NAN;
+}
+
+static double ratio(double A, double B) { return B > 0 ? A / B : NAN; }
+
+static void printConsole(raw_ostream &OS, ArrayRef<Point> Points) {
+    auto PrintMeasurement = [&](const Measurement &M) {
+        if (!M.Completed) {
+            OS << right_justify("timeout", 10) << " "
+               << right_justify("-", 10);
+        } else if (M.PeakBytes) {
+            OS << format("%10.1f %10.1f", M.nanosPerInstruction(),
+                         M.PeakBytes / 1048576.0);
+        } else {
+            OS << format("%10.1f ", M.nanosPerInstruction())
+               << right_justify("n/a", 10);
+        }
+    };
+
+    auto PrintRatio = [&](double R) {
+        if (std::isnan(R)) {
+            OS << " " << right_justify("-", 8);
+        } else {
+            OS << format(" %7.2fx", R);
+        }
+    };
+
+    OS << left_justify("Benchmark", 20) << " "
+       << right_justify("Instructions", 12) << " "
+       << right_justify("ns/inst", 10) << " "
+       << right_justify("Peak MiB", 10) << "   "
+       << left_justify("Upstream", 12) << " "
+       << right_justify("ns/inst", 10) << " "
+       << right_justify("Peak MiB", 10) << " "
+       << right_justify("Time", 8) << " "
+       << right_justify("Memory", 8) << "\n";
+    OS << std::string(110, '-') << "\n";
+    for (const Point &P : Points) {
+        OS << left_justify(P.Benchmark->Name, 20) << " "
+           << format("%12llu ", (unsigned long long)P.Ours.Instructions);
+        PrintMeasurement(P.Ours);
+        OS << "   " << left_justify(P.Benchmark->UpstreamName, 12) << " ";
+        PrintMeasurement(P.Upstream);
+        PrintRatio(ratio(P.Ours.Nanoseconds, P.Upstream.Nanoseconds));
+        PrintRatio(ratio(P.Ours.PeakBytes, P.Upstream.PeakBytes));
+        OS << "\n";
+    }
+
+    OS << "\nScaling (time ~ n^k):\n";
+    for (const PassBenchmark &B : getBenchmarks()) {
+        std::vector<Point> Own;
+        copy_if(Points, std::back_inserter(Own),
+                [&](const Point &P) { return P.Benchmark->Name == B.Name; });
+        if (Own.empty()) {
+            continue;
+        }
+        OS << "  " << left_justify(B.Name, 20)
+           << format(" k = %.2f   ", getScalingExponent(Own, false))
+           << left_justify(B.UpstreamName, 12)
+           << format(" k = %.2f\n", getScalingExponent(Own, true));
+    }
+}
+
+static void printCSV(raw_ostream &OS, ArrayRef<Point> Points) {
+    OS << "benchmark,instructions,ns_per_inst,peak_bytes,"
+          "upstream,upstream_ns_per_inst,upstream_peak_bytes\n";
+    auto PrintMeasurement = [&](const Measurement &M) {
+        if (M.Completed) {
+            OS << format("%.3f", M.nanosPerInstruction()) << ","
+               << M.PeakBytes;
+        } else {
+            OS << ",";
+        }
+    };
+    for (const Point &P : Points) {
+        OS << P.Benchmark->Name << "," << P.Ours.Instructions << ",";
+        PrintMeasurement(P.Ours);
+        OS << "," << P.Benchmark->UpstreamName << ",";
+        PrintMeasurement(P.Upstream);
+        OS << "\n";
+    }
+}
+
+static void printJSON(raw_ostream &OS, ArrayRef<Point> Points) {
+    json::OStream J(OS, 2);
+    auto WriteMeasurement = [&](StringRef Key, const Measurement &M) {
+        J.attributeObject(Key, [&] {
+            J.attribute("completed", M.Completed);
+            if (M.Completed) {
+                J.attribute("ns_per_inst", M.nanosPerInstruction());
+                J.attribute("peak_bytes", int64_t(M.PeakBytes));
+                J.attributeArray("samples_ns_per_inst", [&] {
+                    for (unsigned I = 0; I < M.NumSamples; I++) {
+                        J.value(M.Samples[I] / M.Instructions);
+                    }
+                });
+            }
+        });
+    };
+    J.array([&] {
+        for (const Point &P : Points) {
+            J.object([&] {
+                J.attribute("benchmark", P.Benchmark->Name);
+                J.attribute("upstream", P.Benchmark->UpstreamName);
+                J.attribute("instructions", int64_t(P.Ours.Instructions));
+                WriteMeasurement("pass", P.Ours);
+                WriteMeasurement("upstream_pass", P.Upstream);
+            });
+        }
+    });
+    OS << "\n";
+}
+
+int main(int argc, char **argv) {
+    InitLLVM X(argc, argv);
+
+    cl::ParseCommandLineOptions(
+        argc, argv,
+        "compile-time benchmarks of the passes against upstream LLVM\n");
+
+    Regex NameFilter(Filter);
+    std::string RegexError;
+    if (!NameFilter.isValid(RegexError)) {
+        WithColor::error() << "invalid -filter: " << RegexError << "\n";
+        return 1;
+    }
+    if (Repetitions == 0 || MinInstructions == 0 ||
+        MinInstructions > MaxInstructions) {
+        WithColor::error() << "need -repetitions > 0 and "
+                              "0 < -min-instructions <= -max-instructions\n";
+        return 1;
+    }
+
+    std::vector<PassBenchmark> Benchmarks = getBenchmarks();
+    std::vector<Point> Points;
+    for (const PassBenchmark &B : Benchmarks) {
+        if (!NameFilter.match(B.Name)) {
+            continue;
+        }
+
+        // After a timeout, larger sizes would only time out as well
+        bool OursTimedOut = false, UpstreamTimedOut = false;
+        for (unsigned Size : getSizes()) {
+            Point P{&B, Measurement(), Measurement()};
+            if (!OursTimedOut) {
+                P.Ours = measure(B.Workload, Size, B.AddPass);
+                OursTimedOut = !P.Ours.Completed;
+            }
+            if (!UpstreamTimedOut) {
+                P.Upstream = measure(B.Workload, Size, B.AddUpstream);
+                UpstreamTimedOut = !P.Upstream.Completed;
+            }
+            if (!P.Ours.Instructions) {
+                P.Ours.Instructions =
+                    P.Upstream.Instructions ? P.Upstream.Instructions : Size;
+            }
+            Points.push_back(P);
+
+            if (Format == OutputFormat::Console) {
+                errs() << B.Name << " @ " << Size << " done\n";
+            }
+            if (OursTimedOut && UpstreamTimedOut) {
+                break;
+            }
+        }
+    }
+
+    // Opened only now: a child that crashes would run the signal handlers
+    // that remove an open ToolOutputFile
+    std::error_code EC;
+    ToolOutputFile Out(OutputFilename, EC, sys::fs::OF_Text);
+    if (EC) {
+        WithColor::error(errs(), argv[0]) << EC.message() << "\n";
+        return 1;
+    }
+    switch (Format) {
+    case OutputFormat::Console:
+        printConsole(Out.os(), Points);
+        break;
+    case OutputFormat::CSV:
+        printCSV(Out.os(), Points);
+        break;
+    case OutputFormat::JSON:
+        printJSON(Out.os(), Points);
+        break;
+    }
+    Out.keep();
+    return 0;
+}